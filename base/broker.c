@@ -322,8 +322,11 @@ int broker_service_check(int type, int flags, int attr, service *svc, int check_
 	ds.perf_data = svc->perf_data;
 	ds.check_result_ptr = cr;
 
-	/* make callbacks */
-	return_code = neb_make_callbacks(NEBCALLBACK_SERVICE_CHECK_DATA, (void *)&ds);
+	/* make callbacks (unchanged results only go to modules that asked for them) */
+	if(attr & NEBATTR_CHECK_UNCHANGED)
+		return_code = neb_make_callbacks(NEBCALLBACK_SERVICE_CHECK_UNCHANGED_DATA, (void *)&ds);
+	else
+		return_code = neb_make_callbacks(NEBCALLBACK_SERVICE_CHECK_DATA, (void *)&ds);
 
 	/* free data */
 	my_free(command_buf);
@@ -50,8 +50,9 @@ int reap_check_results(void) {
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "reap_check_results() start\n");
 	log_debug_info(DEBUGL_CHECKS, 0, "Starting to reap check results.\n");
 
-	/* process files in the check result queue */
-	reaped_checks = process_check_result_queue(check_result_path);
+	/* new files are usually picked up as they arrive, else scan for them */
+	if((reaped_checks = reap_check_result_spool()) < 0)
+		reaped_checks = process_check_result_queue(check_result_path);
 
 	log_debug_info(DEBUGL_CHECKS, 0, "Finished reaping %d check results\n", reaped_checks);
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "reap_check_results() end\n");
@@ -62,6 +63,194 @@ int reap_check_results(void) {
 
 
 
+/******************************************************************/
+/*************** ON-DEMAND CHECK COALESCING FUNCTIONS *************/
+/******************************************************************/
+
+/*
+ * When a host or service is asked for an on-demand check while a check
+ * of it is already running, or queued to run soon enough, the request
+ * is attached to that check instead of being scheduled again. Everyone
+ * who asked is handed the result together once it comes in.
+ */
+typedef struct check_waiter {
+	int object_type;		/* HOST_CHECK or SERVICE_CHECK */
+	void *object;
+	struct check_waiter *next;
+	} check_waiter;
+
+typedef struct check_waiters {
+	unsigned int count;
+	check_waiter *list;
+	} check_waiters;
+
+static check_waiters *host_check_waiters = NULL;
+static check_waiters *service_check_waiters = NULL;
+
+
+/* returns the waiters of a host or service, allocating the tables the first time around */
+static check_waiters *get_check_waiters(int object_type, unsigned int id) {
+
+	if(object_type == HOST_CHECK) {
+		if(host_check_waiters == NULL && num_objects.hosts > 0)
+			host_check_waiters = (check_waiters *)calloc(num_objects.hosts, sizeof(check_waiters));
+		return (host_check_waiters == NULL || id >= num_objects.hosts) ? NULL : &host_check_waiters[id];
+		}
+
+	if(service_check_waiters == NULL && num_objects.services > 0)
+		service_check_waiters = (check_waiters *)calloc(num_objects.services, sizeof(check_waiters));
+	return (service_check_waiters == NULL || id >= num_objects.services) ? NULL : &service_check_waiters[id];
+	}
+
+
+static const char *check_waiter_name(check_waiter *waiter) {
+
+	if(waiter->object_type == HOST_CHECK)
+		return ((host *)waiter->object)->name;
+	return ((service *)waiter->object)->description;
+	}
+
+
+/* attaches a requester to the check of a host or service */
+static unsigned int add_check_waiter(int object_type, unsigned int id, int waiter_type, void *waiter) {
+	check_waiters *waiters = NULL;
+	check_waiter *new_waiter = NULL;
+
+	if(waiter == NULL || (waiters = get_check_waiters(object_type, id)) == NULL)
+		return 0;
+
+	if((new_waiter = (check_waiter *)malloc(sizeof(check_waiter))) == NULL)
+		return waiters->count;
+
+	new_waiter->object_type = waiter_type;
+	new_waiter->object = waiter;
+	new_waiter->next = waiters->list;
+	waiters->list = new_waiter;
+
+	return ++waiters->count;
+	}
+
+
+/* hands the result of a host or service check to everyone who was waiting for it */
+static void deliver_check_result(int object_type, unsigned int id, const char *name, int state) {
+	check_waiters *waiters = NULL;
+	check_waiter *temp_waiter = NULL;
+	check_waiter *next_waiter = NULL;
+
+	if(object_type == HOST_CHECK ? host_check_waiters == NULL : service_check_waiters == NULL)
+		return;
+	if((waiters = get_check_waiters(object_type, id)) == NULL || waiters->list == NULL)
+		return;
+
+	log_debug_info(DEBUGL_CHECKS, 1, "Result of %s check of '%s' (state=%d) handed to %u waiter(s).\n", (object_type == HOST_CHECK) ? "host" : "service", name, state, waiters->count);
+
+	for(temp_waiter = waiters->list; temp_waiter != NULL; temp_waiter = next_waiter) {
+		next_waiter = temp_waiter->next;
+		log_debug_info(DEBUGL_CHECKS, 2, "   Waiter: %s '%s'\n", (temp_waiter->object_type == HOST_CHECK) ? "host" : "service", check_waiter_name(temp_waiter));
+		free(temp_waiter);
+		}
+
+	waiters->list = NULL;
+	waiters->count = 0;
+	}
+
+
+static void free_check_waiter_table(check_waiters *table, unsigned int count) {
+	check_waiter *temp_waiter = NULL;
+	check_waiter *next_waiter = NULL;
+	unsigned int i;
+
+	for(i = 0; i < count; i++) {
+		for(temp_waiter = table[i].list; temp_waiter != NULL; temp_waiter = next_waiter) {
+			next_waiter = temp_waiter->next;
+			free(temp_waiter);
+			}
+		}
+	free(table);
+	}
+
+
+void free_check_waiters(void) {
+
+	if(host_check_waiters != NULL)
+		free_check_waiter_table(host_check_waiters, num_objects.hosts);
+	host_check_waiters = NULL;
+
+	if(service_check_waiters != NULL)
+		free_check_waiter_table(service_check_waiters, num_objects.services);
+	service_check_waiters = NULL;
+	}
+
+
+/* is a check of this host running, or queued to run no later than the given time? */
+static int host_check_pending(host *hst, time_t check_time) {
+
+	if(hst->is_executing == TRUE)
+		return TRUE;
+	if(hst->next_check_event != NULL && hst->next_check <= check_time)
+		return TRUE;
+	return FALSE;
+	}
+
+
+/* is a check of this service running, or queued to run no later than the given time? */
+static int service_check_pending(service *svc, time_t check_time) {
+
+	if(svc->is_executing == TRUE)
+		return TRUE;
+	if(svc->next_check_event != NULL && svc->next_check <= check_time)
+		return TRUE;
+	return FALSE;
+	}
+
+
+/* schedules an on-demand host check on behalf of another host or service, or joins the one already pending */
+void schedule_on_demand_host_check(host *hst, time_t check_time, int options, int waiter_type, void *waiter) {
+	unsigned int waiting = 0;
+
+	if(hst == NULL)
+		return;
+
+	/* forced checks always get their own event */
+	if(!(options & CHECK_OPTION_FORCE_EXECUTION) && host_check_pending(hst, check_time) == TRUE) {
+		waiting = add_check_waiter(HOST_CHECK, hst->id, waiter_type, waiter);
+		update_check_stats(COALESCED_HOST_CHECK_STATS, check_time);
+		log_debug_info(DEBUGL_CHECKS, 1, "On-demand check of host '%s' joins the check that is already %s (%u waiting).\n", hst->name, (hst->is_executing == TRUE) ? "running" : "queued", waiting);
+		return;
+		}
+
+	schedule_host_check(hst, check_time, options);
+
+	/* the check may not have been scheduled after all, if the last result is recent enough */
+	if(host_check_pending(hst, check_time) == TRUE)
+		add_check_waiter(HOST_CHECK, hst->id, waiter_type, waiter);
+	}
+
+
+/* schedules an on-demand service check on behalf of another service, or joins the one already pending */
+void schedule_on_demand_service_check(service *svc, time_t check_time, int options, int waiter_type, void *waiter) {
+	unsigned int waiting = 0;
+
+	if(svc == NULL)
+		return;
+
+	/* forced checks always get their own event */
+	if(!(options & CHECK_OPTION_FORCE_EXECUTION) && service_check_pending(svc, check_time) == TRUE) {
+		waiting = add_check_waiter(SERVICE_CHECK, svc->id, waiter_type, waiter);
+		update_check_stats(COALESCED_SERVICE_CHECK_STATS, check_time);
+		log_debug_info(DEBUGL_CHECKS, 1, "On-demand check of service '%s' on host '%s' joins the check that is already %s (%u waiting).\n", svc->description, svc->host_name, (svc->is_executing == TRUE) ? "running" : "queued", waiting);
+		return;
+		}
+
+	schedule_service_check(svc, check_time, options);
+
+	if(service_check_pending(svc, check_time) == TRUE)
+		add_check_waiter(SERVICE_CHECK, svc->id, waiter_type, waiter);
+	}
+
+
+
+
 /******************************************************************/
 /****************** SERVICE MONITORING FUNCTIONS ******************/
 /******************************************************************/
@@ -162,6 +351,7 @@ int run_async_service_check(service *svc, int check_options, double latency, int
 	nagios_macros mac;
 	char *raw_command = NULL;
 	char *processed_command = NULL;
+	char **argv = NULL;
 	struct timeval start_time, end_time;
 	host *temp_host = NULL;
 	double old_latency = 0.0;
@@ -246,8 +436,8 @@ int run_async_service_check(service *svc, int check_options, double latency, int
 		}
 
 	/* process any macros contained in the argument */
-	process_macros_r(&mac, raw_command, &processed_command, macro_options);
 	my_free(raw_command);
+	process_command_macros_r(&mac, svc->check_command_ptr, &processed_command, &argv, macro_options);
 	if(processed_command == NULL) {
 		clear_volatile_macros_r(&mac);
 		log_debug_info(DEBUGL_CHECKS, 0, "Processed check command for service '%s' on host '%s' was NULL - aborting.\n", svc->description, svc->host_name);
@@ -265,6 +455,7 @@ int run_async_service_check(service *svc, int check_options, double latency, int
 		clear_volatile_macros_r(&mac);
 		svc->latency = old_latency;
 		my_free(processed_command);
+		my_free(argv);
 		return ERROR;
 	}
 	init_check_result(cr);
@@ -295,6 +486,7 @@ int run_async_service_check(service *svc, int check_options, double latency, int
 		svc->latency = old_latency;
 		free_check_result(cr);
 		my_free(processed_command);
+		my_free(argv);
 		return OK;
 		}
 #endif
@@ -303,7 +495,7 @@ int run_async_service_check(service *svc, int check_options, double latency, int
 	svc->latency = old_latency;
 
 	/* paw off the check to a worker to run */
-	runchk_result = wproc_run_check(cr, processed_command, &mac);
+	runchk_result = wproc_run_check(cr, processed_command, argv, &mac);
 	if (runchk_result == ERROR) {
 		logit(NSLOG_RUNTIME_ERROR, TRUE, "Unable to run check for service '%s' on host '%s'\n", svc->description, svc->host_name);
 	}
@@ -311,6 +503,7 @@ int run_async_service_check(service *svc, int check_options, double latency, int
 		/* do the book-keeping */
 		currently_running_service_checks++;
 		svc->is_executing = TRUE;
+		update_service_orphan_deadline(svc);
 		update_check_stats((scheduled_check == TRUE) ? ACTIVE_SCHEDULED_SERVICE_CHECK_STATS : ACTIVE_ONDEMAND_SERVICE_CHECK_STATS, start_time.tv_sec);
 	}
 
@@ -382,6 +575,20 @@ static int get_service_check_return_code(service *temp_service,
 	}
 
 
+/* updates an object's short output, long output and perf data from a check result, returns TRUE if any of them changed */
+static int get_check_result_output(check_result *cr, char **short_output, char **long_output, char **perf_data) {
+	check_output parsed;
+
+	/* the result pipeline may already have parsed it */
+	if(cr->parsed_output == NULL) {
+		parse_check_output_slices(cr->output, &parsed, FALSE);
+		return update_check_output(&parsed, short_output, long_output, perf_data);
+		}
+
+	return update_check_output(cr->parsed_output, short_output, long_output, perf_data);
+	}
+
+
 /* handles asynchronous service check results */
 int handle_async_service_check_result(service *temp_service, check_result *queued_check_result) {
 	host *temp_host = NULL;
@@ -397,13 +604,20 @@ int handle_async_service_check_result(service *temp_service, check_result *queue
 	int state_was_logged = FALSE;
 	char *old_plugin_output = NULL;
 	char *temp_plugin_output = NULL;
-	char *temp_ptr = NULL;
 	servicedependency *temp_dependency = NULL;
 	service *master_service = NULL;
 	int state_changes_use_cached_state = TRUE; /* TODO - 09/23/07 move this to a global variable */
 	int flapping_check_done = FALSE;
+	int output_changed = FALSE;
+	int result_unchanged = FALSE;
+	char *parsed_long_output = NULL;
+	char *parsed_perf_data = NULL;
+	struct timeval processing_start;
+	struct timeval processing_end;
 
 
+	gettimeofday(&processing_start, NULL);
+
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "handle_async_service_check_result()\n");
 
 	/* make sure we have what we need */
@@ -442,8 +656,10 @@ int handle_async_service_check_result(service *temp_service, check_result *queue
 		temp_service->is_being_freshened = FALSE;
 
 	/* clear the execution flag if this was an active check */
-	if(queued_check_result->check_type == CHECK_TYPE_ACTIVE)
+	if(queued_check_result->check_type == CHECK_TYPE_ACTIVE) {
 		temp_service->is_executing = FALSE;
+		update_service_orphan_deadline(temp_service);
+		}
 
 	/* DISCARD INVALID FRESHNESS CHECK RESULTS */
 	/* If a services goes stale, Nagios will initiate a forced check in order to freshen it.  There is a race condition whereby a passive check
@@ -482,28 +698,25 @@ int handle_async_service_check_result(service *temp_service, check_result *queue
 	if(temp_service->plugin_output)
 		old_plugin_output = (char *)strdup(temp_service->plugin_output);
 
-	/* clear the old plugin output and perf data buffers */
-	my_free(temp_service->plugin_output);
-	my_free(temp_service->long_plugin_output);
-	my_free(temp_service->perf_data);
-
-	/* parse check output to get: (1) short output, (2) long output, (3) perf data */
-	parse_check_output(queued_check_result->output, &temp_service->plugin_output, &temp_service->long_plugin_output, &temp_service->perf_data, TRUE, FALSE);
+	/* parse check output to get: (1) short output, (2) long output, (3) perf data.
+	 * This leaves whatever didn't change alone, and replaces semicolons in
+	 * plugin output (but not performance data) with colons. */
+	output_changed = get_check_result_output(queued_check_result, &temp_service->plugin_output, &temp_service->long_plugin_output, &temp_service->perf_data);
 
 	/* make sure the plugin output isn't null */
 	if(temp_service->plugin_output == NULL)
 		temp_service->plugin_output = (char *)strdup("(No output returned from plugin)");
 
-	/* replace semicolons in plugin output (but not performance data) with colons */
-	else if((temp_ptr = temp_service->plugin_output)) {
-		while((temp_ptr = strchr(temp_ptr, ';')))
-			* temp_ptr = ':';
-		}
-
 	/* grab the return code */
+	parsed_long_output = temp_service->long_plugin_output;
+	parsed_perf_data = temp_service->perf_data;
 	temp_service->current_state = get_service_check_return_code(temp_service,
 			queued_check_result);
 
+	/* the return code may have replaced the output we parsed */
+	if(temp_service->long_plugin_output != parsed_long_output || temp_service->perf_data != parsed_perf_data || compare_strings(old_plugin_output, temp_service->plugin_output))
+		output_changed = TRUE;
+
 	log_debug_info(DEBUGL_CHECKS, 2, "Parsing check output...\n");
 	log_debug_info(DEBUGL_CHECKS, 2, "Short Output: %s\n", (temp_service->plugin_output == NULL) ? "NULL" : temp_service->plugin_output);
 	log_debug_info(DEBUGL_CHECKS, 2, "Long Output:  %s\n", (temp_service->long_plugin_output == NULL) ? "NULL" : temp_service->long_plugin_output);
@@ -545,7 +758,7 @@ int handle_async_service_check_result(service *temp_service, check_result *queue
 
 			/* set a flag to remember that we launched a check */
 			first_host_check_initiated = TRUE;
-			schedule_host_check(temp_host, current_time, CHECK_OPTION_DEPENDENCY_CHECK);
+			schedule_on_demand_host_check(temp_host, current_time, CHECK_OPTION_DEPENDENCY_CHECK, SERVICE_CHECK, temp_service);
 			}
 		}
 
@@ -684,7 +897,7 @@ int handle_async_service_check_result(service *temp_service, check_result *queue
 
 				/* else launch an async (parallel) check of the host */
 				else
-					schedule_host_check(temp_host, current_time, CHECK_OPTION_DEPENDENCY_CHECK);
+					schedule_on_demand_host_check(temp_host, current_time, CHECK_OPTION_DEPENDENCY_CHECK, SERVICE_CHECK, temp_service);
 				}
 			}
 
@@ -771,7 +984,7 @@ int handle_async_service_check_result(service *temp_service, check_result *queue
 
 			/* only run a new check if we can and have to */
 			if(execute_host_checks && (state_change == TRUE && state_changes_use_cached_state == FALSE) && temp_host->last_check + cached_host_check_horizon < current_time) {
-				schedule_host_check(temp_host, current_time, CHECK_OPTION_DEPENDENCY_CHECK);
+				schedule_on_demand_host_check(temp_host, current_time, CHECK_OPTION_DEPENDENCY_CHECK, SERVICE_CHECK, temp_service);
 				}
 			else {
 				log_debug_info(DEBUGL_CHECKS, 1, "* Using cached host state: %d\n", temp_host->current_state);
@@ -787,7 +1000,7 @@ int handle_async_service_check_result(service *temp_service, check_result *queue
 			log_debug_info(DEBUGL_CHECKS, 1, "Host is currently %s.\n", host_state_name(temp_host->current_state));
 
 			if(execute_host_checks && (state_change == TRUE && state_changes_use_cached_state == FALSE)) {
-				schedule_host_check(temp_host, current_time, CHECK_OPTION_NONE);
+				schedule_on_demand_host_check(temp_host, current_time, CHECK_OPTION_NONE, SERVICE_CHECK, temp_service);
 				}
 			/* else fake the host check, but (possibly) resend host notifications to contacts... */
 			else {
@@ -906,7 +1119,7 @@ int handle_async_service_check_result(service *temp_service, check_result *queue
 					if(temp_dependency->dependent_service_ptr == temp_service && temp_dependency->master_service_ptr != NULL) {
 						master_service = (service *)temp_dependency->master_service_ptr;
 						log_debug_info(DEBUGL_CHECKS, 2, "Predictive check of service '%s' on host '%s' queued.\n", master_service->description, master_service->host_name);
-						schedule_service_check(master_service, current_time, CHECK_OPTION_DEPENDENCY_CHECK);
+						schedule_on_demand_service_check(master_service, current_time, CHECK_OPTION_DEPENDENCY_CHECK, SERVICE_CHECK, temp_service);
 						}
 					}
 				for(list = temp_service->notify_deps; list; list = list->next) {
@@ -914,7 +1127,7 @@ int handle_async_service_check_result(service *temp_service, check_result *queue
 					if(temp_dependency->dependent_service_ptr == temp_service && temp_dependency->master_service_ptr != NULL) {
 						master_service = (service *)temp_dependency->master_service_ptr;
 						log_debug_info(DEBUGL_CHECKS, 2, "Predictive check of service '%s' on host '%s' queued.\n", master_service->description, master_service->host_name);
-						schedule_service_check(master_service, current_time, CHECK_OPTION_DEPENDENCY_CHECK);
+						schedule_on_demand_service_check(master_service, current_time, CHECK_OPTION_DEPENDENCY_CHECK, SERVICE_CHECK, temp_service);
 						}
 					}
 				}
@@ -1024,16 +1237,23 @@ int handle_async_service_check_result(service *temp_service, check_result *queue
 
 		}
 
+	/* if nothing but the check times changed, there's no news to pass on */
+	if(suppress_unchanged_results == TRUE && temp_service->has_been_checked == TRUE && temp_service->state_type == HARD_STATE && state_change == FALSE && hard_state_change == FALSE && state_was_logged == FALSE && output_changed == FALSE) {
+		log_debug_info(DEBUGL_CHECKS, 1, "Service check result is unchanged, so we'll skip status and performance data updates.\n");
+		result_unchanged = TRUE;
+		}
+
 #ifdef USE_EVENT_BROKER
 	/* send data to event broker */
-	broker_service_check(NEBTYPE_SERVICECHECK_PROCESSED, NEBFLAG_NONE, NEBATTR_NONE, temp_service, temp_service->check_type, queued_check_result->start_time, queued_check_result->finish_time, NULL, temp_service->latency, temp_service->execution_time, service_check_timeout, queued_check_result->early_timeout, queued_check_result->return_code, NULL, NULL, queued_check_result);
+	broker_service_check(NEBTYPE_SERVICECHECK_PROCESSED, NEBFLAG_NONE, (result_unchanged == TRUE) ? NEBATTR_CHECK_UNCHANGED : NEBATTR_NONE, temp_service, temp_service->check_type, queued_check_result->start_time, queued_check_result->finish_time, NULL, temp_service->latency, temp_service->execution_time, service_check_timeout, queued_check_result->early_timeout, queued_check_result->return_code, NULL, NULL, queued_check_result);
 #endif
 
 	/* set the checked flag */
 	temp_service->has_been_checked = TRUE;
 
 	/* update the current service status log */
-	update_service_status(temp_service, FALSE);
+	if(result_unchanged == FALSE)
+		update_service_status(temp_service, FALSE);
 
 	/* check to see if the service and/or associate host is flapping */
 	if(flapping_check_done == FALSE) {
@@ -1042,7 +1262,23 @@ int handle_async_service_check_result(service *temp_service, check_result *queue
 		}
 
 	/* update service performance info */
-	update_service_performance_data(temp_service);
+	if(result_unchanged == FALSE)
+		update_service_performance_data(temp_service);
+
+	/* services that depend on this one may have to be looked at differently now */
+	update_service_dependency_index(temp_service);
+
+	/* the results of this check go stale at a new time */
+	update_service_freshness_deadline(temp_service);
+
+	/* anyone who asked for an on-demand check of this service gets this result */
+	deliver_check_result(SERVICE_CHECK, temp_service->id, temp_service->description, temp_service->current_state);
+
+	/* keep track of how long active checks wait, run and take us to handle */
+	if(queued_check_result->check_type == CHECK_TYPE_ACTIVE && temp_service->check_command_ptr != NULL) {
+		gettimeofday(&processing_end, NULL);
+		update_check_timings(CHECK_TIMINGS_COMMAND, temp_service->check_command_ptr->name, temp_service->latency, temp_service->execution_time, tv_delta_f(&processing_start, &processing_end));
+		}
 
 	/* free allocated memory */
 	my_free(temp_plugin_output);
@@ -1071,6 +1307,15 @@ void schedule_service_check(service *svc, time_t check_time, int options) {
 		return;
 		}
 
+	/* regular, future checks may be moved to a less busy second */
+	if(options == CHECK_OPTION_NONE && check_time > time(NULL)) {
+		time_t smoothed = smooth_check_time(check_time, check_window(svc));
+		if(smoothed != check_time && check_time_against_period(smoothed, svc->check_period_ptr) == OK) {
+			log_debug_info(DEBUGL_CHECKS, 2, "Smoothing moved the check by %ld seconds.\n", (long)(smoothed - check_time));
+			check_time = smoothed;
+			}
+		}
+
 	/* we may have to nudge this check a bit */
 	if (options == CHECK_OPTION_DEPENDENCY_CHECK) {
 		if (svc->last_check + cached_service_check_horizon > check_time) {
@@ -1303,6 +1548,200 @@ int check_service_parents(service *svc)
 
 
 
+/*
+ * Dependency evaluation index. For every dependent object we keep the
+ * number of its dependencies whose master is currently in a state that
+ * fails them, so a dependency check doesn't have to look at every master
+ * object. The counts are updated when the state of a master changes.
+ * Dependencies with a dependency period or that inherit the dependencies
+ * of their master can't be summed up like that, so those are kept in a
+ * separate list and evaluated one by one, as before.
+ */
+struct dependency_index {
+	unsigned int failed[2];		/* failing plain dependencies, per dependency type */
+	objectlist *other_deps[2];	/* dependencies that have to be evaluated one by one */
+	objectlist *master_of;		/* plain dependencies this object is the master of */
+	int state;			/* state used for dependencies, as of the last update */
+	};
+
+static struct dependency_index *service_dependency_index = NULL;
+static struct dependency_index *host_dependency_index = NULL;
+
+#define dependency_slot(type) ((type) == NOTIFICATION_DEPENDENCY ? 0 : 1)
+
+
+/* returns the state of a service that its dependencies are checked against */
+static int service_dependency_state(service *svc) {
+
+	/* use last hard state if its currently in a soft state */
+	if(svc->state_type == SOFT_STATE && soft_state_dependencies == FALSE)
+		return svc->last_hard_state;
+	return svc->current_state;
+	}
+
+
+/* returns the state of a host that its dependencies are checked against */
+static int host_dependency_state(host *hst) {
+
+	/* use last hard state if its currently in a soft state */
+	if(hst->state_type == SOFT_STATE && soft_state_dependencies == FALSE)
+		return hst->last_hard_state;
+	return hst->current_state;
+	}
+
+
+static void free_dependency_index_entries(struct dependency_index *idx, unsigned int count) {
+	unsigned int i;
+
+	for(i = 0; i < count; i++) {
+		free_objectlist(&idx[i].other_deps[0]);
+		free_objectlist(&idx[i].other_deps[1]);
+		free_objectlist(&idx[i].master_of);
+		}
+	free(idx);
+	}
+
+
+/* builds the dependency evaluation index - must be called once retention data has been read */
+int init_dependency_index(void) {
+	service *temp_service = NULL;
+	host *temp_host = NULL;
+	objectlist *list = NULL;
+	struct dependency_index *idx = NULL;
+	int slot = 0;
+
+	free_dependency_index();
+
+	if(num_objects.services > 0 && (service_dependency_index = (struct dependency_index *)calloc(num_objects.services, sizeof(struct dependency_index))) == NULL)
+		return ERROR;
+	if(num_objects.hosts > 0 && (host_dependency_index = (struct dependency_index *)calloc(num_objects.hosts, sizeof(struct dependency_index))) == NULL) {
+		free_dependency_index();
+		return ERROR;
+		}
+
+	for(temp_service = service_list; temp_service != NULL; temp_service = temp_service->next) {
+		idx = &service_dependency_index[temp_service->id];
+		idx->state = service_dependency_state(temp_service);
+		for(slot = 0; slot < 2; slot++) {
+			for(list = slot ? temp_service->exec_deps : temp_service->notify_deps; list; list = list->next) {
+				servicedependency *temp_dependency = (servicedependency *)list->object_ptr;
+				service *master = temp_dependency->master_service_ptr;
+
+				if(master == NULL)
+					continue;
+				if(temp_dependency->dependency_period != NULL || temp_dependency->inherits_parent == TRUE) {
+					prepend_object_to_objectlist(&idx->other_deps[slot], temp_dependency);
+					continue;
+					}
+				prepend_object_to_objectlist(&service_dependency_index[master->id].master_of, temp_dependency);
+				if(flag_isset(temp_dependency->failure_options, 1 << service_dependency_state(master)))
+					idx->failed[slot]++;
+				}
+			}
+		}
+
+	for(temp_host = host_list; temp_host != NULL; temp_host = temp_host->next) {
+		idx = &host_dependency_index[temp_host->id];
+		idx->state = host_dependency_state(temp_host);
+		for(slot = 0; slot < 2; slot++) {
+			for(list = slot ? temp_host->exec_deps : temp_host->notify_deps; list; list = list->next) {
+				hostdependency *temp_dependency = (hostdependency *)list->object_ptr;
+				host *master = temp_dependency->master_host_ptr;
+
+				if(master == NULL)
+					continue;
+				if(temp_dependency->dependency_period != NULL || temp_dependency->inherits_parent == TRUE) {
+					prepend_object_to_objectlist(&idx->other_deps[slot], temp_dependency);
+					continue;
+					}
+				prepend_object_to_objectlist(&host_dependency_index[master->id].master_of, temp_dependency);
+				if(flag_isset(temp_dependency->failure_options, 1 << host_dependency_state(master)))
+					idx->failed[slot]++;
+				}
+			}
+		}
+
+	return OK;
+	}
+
+
+void free_dependency_index(void) {
+
+	if(service_dependency_index != NULL)
+		free_dependency_index_entries(service_dependency_index, num_objects.services);
+	service_dependency_index = NULL;
+
+	if(host_dependency_index != NULL)
+		free_dependency_index_entries(host_dependency_index, num_objects.hosts);
+	host_dependency_index = NULL;
+	}
+
+
+/* updates the dependency index after the state of a service may have changed */
+void update_service_dependency_index(service *svc) {
+	struct dependency_index *idx = NULL;
+	objectlist *list = NULL;
+	int old_state, new_state;
+
+	if(service_dependency_index == NULL || svc == NULL)
+		return;
+
+	idx = &service_dependency_index[svc->id];
+	new_state = service_dependency_state(svc);
+	if(idx->state == new_state)
+		return;
+	old_state = idx->state;
+	idx->state = new_state;
+
+	for(list = idx->master_of; list; list = list->next) {
+		servicedependency *temp_dependency = (servicedependency *)list->object_ptr;
+		struct dependency_index *dependent = &service_dependency_index[temp_dependency->dependent_service_ptr->id];
+		int was_failed = flag_isset(temp_dependency->failure_options, 1 << old_state) ? TRUE : FALSE;
+		int is_failed = flag_isset(temp_dependency->failure_options, 1 << new_state) ? TRUE : FALSE;
+
+		if(is_failed == was_failed)
+			continue;
+		if(is_failed == TRUE)
+			dependent->failed[dependency_slot(temp_dependency->dependency_type)]++;
+		else
+			dependent->failed[dependency_slot(temp_dependency->dependency_type)]--;
+		}
+	}
+
+
+/* updates the dependency index after the state of a host may have changed */
+void update_host_dependency_index(host *hst) {
+	struct dependency_index *idx = NULL;
+	objectlist *list = NULL;
+	int old_state, new_state;
+
+	if(host_dependency_index == NULL || hst == NULL)
+		return;
+
+	idx = &host_dependency_index[hst->id];
+	new_state = host_dependency_state(hst);
+	if(idx->state == new_state)
+		return;
+	old_state = idx->state;
+	idx->state = new_state;
+
+	for(list = idx->master_of; list; list = list->next) {
+		hostdependency *temp_dependency = (hostdependency *)list->object_ptr;
+		struct dependency_index *dependent = &host_dependency_index[temp_dependency->dependent_host_ptr->id];
+		int was_failed = flag_isset(temp_dependency->failure_options, 1 << old_state) ? TRUE : FALSE;
+		int is_failed = flag_isset(temp_dependency->failure_options, 1 << new_state) ? TRUE : FALSE;
+
+		if(is_failed == was_failed)
+			continue;
+		if(is_failed == TRUE)
+			dependent->failed[dependency_slot(temp_dependency->dependency_type)]++;
+		else
+			dependent->failed[dependency_slot(temp_dependency->dependency_type)]--;
+		}
+	}
+
+
+
 /* checks service dependencies */
 int check_service_dependencies(service *svc, int dependency_type) {
 	objectlist *list;
@@ -1312,8 +1751,15 @@ int check_service_dependencies(service *svc, int dependency_type) {
 
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "check_service_dependencies()\n");
 
+	/* with the index, plain dependencies are a single lookup and only the rest is walked */
+	if(service_dependency_index != NULL) {
+		if(service_dependency_index[svc->id].failed[dependency_slot(dependency_type)] > 0)
+			return DEPENDENCIES_FAILED;
+		list = service_dependency_index[svc->id].other_deps[dependency_slot(dependency_type)];
+		}
+
 	/* only check dependencies of the desired type */
-	if(dependency_type == NOTIFICATION_DEPENDENCY)
+	else if(dependency_type == NOTIFICATION_DEPENDENCY)
 		list = svc->notify_deps;
 	else
 		list = svc->exec_deps;
@@ -1330,13 +1776,10 @@ int check_service_dependencies(service *svc, int dependency_type) {
 		/* skip this dependency if it has a timeperiod and the current time isn't valid */
 		time(&current_time);
 		if(temp_dependency->dependency_period != NULL && check_time_against_period(current_time, temp_dependency->dependency_period_ptr) == ERROR)
-			return FALSE;
+			continue;
 
 		/* get the status to use (use last hard state if its currently in a soft state) */
-		if(temp_service->state_type == SOFT_STATE && soft_state_dependencies == FALSE)
-			state = temp_service->last_hard_state;
-		else
-			state = temp_service->current_state;
+		state = service_dependency_state(temp_service);
 
 		/* is the service we depend on in state that fails the dependency tests? */
 		if(flag_isset(temp_dependency->failure_options, 1 << state))
@@ -1354,113 +1797,163 @@ int check_service_dependencies(service *svc, int dependency_type) {
 
 
 
-/* check for services that never returned from a check... */
-void check_for_orphaned_services(void) {
-	service *temp_service = NULL;
-	time_t current_time = 0L;
-	time_t expected_time = 0L;
+/*
+ * Orphan deadlines. Only hosts and services with a check in flight
+ * can be orphaned, so rather than looking at every object each orphan
+ * check interval, the ones that are executing sit in an expiry queue,
+ * keyed on the time their results should have come back by. The
+ * deadline is dropped when the result comes in, and the orphan checks
+ * only look at the checks whose deadline has passed.
+ */
+static squeue_t *service_orphan_queue = NULL;
+static squeue_t *host_orphan_queue = NULL;
+static squeue_event **service_orphan_deadlines = NULL;
+static squeue_event **host_orphan_deadlines = NULL;
 
 
-	log_debug_info(DEBUGL_FUNCTIONS, 0, "check_for_orphaned_services()\n");
+/* determines the time at which the check results should have come in (allow 10 minutes slack time) */
+static time_t get_service_orphan_expiration(service *svc) {
+	return (time_t)(svc->next_check + svc->latency + service_check_timeout + check_reaper_interval + 600);
+	}
 
-	/* get the current time */
-	time(&current_time);
 
-	/* check all services... */
-	for(temp_service = service_list; temp_service != NULL; temp_service = temp_service->next) {
+static time_t get_host_orphan_expiration(host *hst) {
+	return (time_t)(hst->next_check + hst->latency + host_check_timeout + check_reaper_interval + 600);
+	}
 
-		/* skip services that are not currently executing */
-		if(temp_service->is_executing == FALSE)
-			continue;
 
-		/* determine the time at which the check results should have come in (allow 10 minutes slack time) */
-		expected_time = (time_t)(temp_service->next_check + temp_service->latency + service_check_timeout + check_reaper_interval + 600);
+/* arms the orphan deadline of a service that is executing, or drops it if it isn't */
+void update_service_orphan_deadline(service *svc) {
+	squeue_event **deadline;
 
-		/* this service was supposed to have executed a while ago, but for some reason the results haven't come back in... */
-		if(expected_time < current_time) {
+	if(svc == NULL)
+		return;
 
-			/* log a warning */
-			logit(NSLOG_RUNTIME_WARNING, TRUE, "Warning: The check of service '%s' on host '%s' looks like it was orphaned (results never came back; last_check=%lu; next_check=%lu).  I'm scheduling an immediate check of the service...\n", temp_service->description, temp_service->host_name, temp_service->last_check, temp_service->next_check);
+	if(service_orphan_queue == NULL) {
+		if(svc->is_executing == FALSE)
+			return;
+		if((service_orphan_queue = squeue_create(num_objects.services + 1)) == NULL)
+			return;
+		if((service_orphan_deadlines = (squeue_event **)calloc(num_objects.services + 1, sizeof(squeue_event *))) == NULL) {
+			squeue_destroy(service_orphan_queue, 0);
+			service_orphan_queue = NULL;
+			return;
+			}
+		}
 
-			log_debug_info(DEBUGL_CHECKS, 1, "Service '%s' on host '%s' was orphaned, so we're scheduling an immediate check...\n", temp_service->description, temp_service->host_name);
-			log_debug_info(DEBUGL_CHECKS, 1, "  next_check=%lu (%s); last_check=%lu (%s);\n",
-						   temp_service->next_check, ctime(&temp_service->next_check),
-						   temp_service->last_check, ctime(&temp_service->last_check));
+	deadline = &service_orphan_deadlines[svc->id];
+	if(*deadline != NULL)
+		squeue_remove(service_orphan_queue, *deadline);
+	*deadline = NULL;
 
-			/* decrement the number of running service checks */
-			if(currently_running_service_checks > 0)
-				currently_running_service_checks--;
+	/* results are overdue once the expected time has passed */
+	if(svc->is_executing == TRUE)
+		*deadline = squeue_add(service_orphan_queue, get_service_orphan_expiration(svc) + 1, svc);
+	}
 
-			/* disable the executing flag */
-			temp_service->is_executing = FALSE;
 
-			/* schedule an immediate check of the service */
-			schedule_service_check(temp_service, current_time, CHECK_OPTION_ORPHAN_CHECK);
-			}
+/* arms the orphan deadline of a host that is executing, or drops it if it isn't */
+void update_host_orphan_deadline(host *hst) {
+	squeue_event **deadline;
 
+	if(hst == NULL)
+		return;
+
+	if(host_orphan_queue == NULL) {
+		if(hst->is_executing == FALSE)
+			return;
+		if((host_orphan_queue = squeue_create(num_objects.hosts + 1)) == NULL)
+			return;
+		if((host_orphan_deadlines = (squeue_event **)calloc(num_objects.hosts + 1, sizeof(squeue_event *))) == NULL) {
+			squeue_destroy(host_orphan_queue, 0);
+			host_orphan_queue = NULL;
+			return;
+			}
 		}
 
-	return;
+	deadline = &host_orphan_deadlines[hst->id];
+	if(*deadline != NULL)
+		squeue_remove(host_orphan_queue, *deadline);
+	*deadline = NULL;
+
+	/* results are overdue once the expected time has passed */
+	if(hst->is_executing == TRUE)
+		*deadline = squeue_add(host_orphan_queue, get_host_orphan_expiration(hst) + 1, hst);
 	}
 
 
+void free_orphan_deadlines(void) {
 
-/* check freshness of service results */
-void check_service_result_freshness(void) {
+	if(service_orphan_queue != NULL)
+		squeue_destroy(service_orphan_queue, 0);
+	service_orphan_queue = NULL;
+	my_free(service_orphan_deadlines);
+
+	if(host_orphan_queue != NULL)
+		squeue_destroy(host_orphan_queue, 0);
+	host_orphan_queue = NULL;
+	my_free(host_orphan_deadlines);
+	}
+
+
+
+/* check for services that never returned from a check... */
+void check_for_orphaned_services(void) {
 	service *temp_service = NULL;
 	time_t current_time = 0L;
+	time_t expected_time = 0L;
 
 
-	log_debug_info(DEBUGL_FUNCTIONS, 0, "check_service_result_freshness()\n");
-	log_debug_info(DEBUGL_CHECKS, 1, "Checking the freshness of service check results...\n");
+	log_debug_info(DEBUGL_FUNCTIONS, 0, "check_for_orphaned_services()\n");
 
-	/* bail out if we're not supposed to be checking freshness */
-	if(check_service_freshness == FALSE) {
-		log_debug_info(DEBUGL_CHECKS, 1, "Service freshness checking is disabled.\n");
+	/* nothing has been executed yet */
+	if(service_orphan_queue == NULL)
 		return;
-		}
 
 	/* get the current time */
 	time(&current_time);
 
-	/* check all services... */
-	for(temp_service = service_list; temp_service != NULL; temp_service = temp_service->next) {
+	/* check all executing services whose deadline has passed... */
+	while((temp_service = (service *)squeue_peek(service_orphan_queue)) != NULL) {
 
-		/* skip services we shouldn't be checking for freshness */
-		if(temp_service->check_freshness == FALSE)
-			continue;
+		if(squeue_event_runtime(service_orphan_deadlines[temp_service->id])->tv_sec > current_time)
+			break;
 
-		/* skip services that are currently executing (problems here will be caught by orphaned service check) */
-		if(temp_service->is_executing == TRUE)
-			continue;
+		squeue_pop(service_orphan_queue);
+		service_orphan_deadlines[temp_service->id] = NULL;
 
-		/* skip services that have both active and passive checks disabled */
-		if(temp_service->checks_enabled == FALSE && temp_service->accept_passive_checks == FALSE)
+		/* skip services that are not currently executing */
+		if(temp_service->is_executing == FALSE)
 			continue;
 
-		/* skip services that are already being freshened */
-		if(temp_service->is_being_freshened == TRUE)
-			continue;
+		/* determine the time at which the check results should have come in (allow 10 minutes slack time) */
+		expected_time = get_service_orphan_expiration(temp_service);
 
-		/* see if the time is right... */
-		if(check_time_against_period(current_time, temp_service->check_period_ptr) == ERROR)
+		/* the service was rescheduled while its check was running, so follow the new deadline */
+		if(expected_time >= current_time) {
+			update_service_orphan_deadline(temp_service);
 			continue;
+			}
 
-		/* EXCEPTION */
-		/* don't check freshness of services without regular check intervals if we're using auto-freshness threshold */
-		if(temp_service->check_interval == 0 && temp_service->freshness_threshold == 0)
-			continue;
+		/* this service was supposed to have executed a while ago, but for some reason the results haven't come back in... */
 
-		/* the results for the last check of this service are stale! */
-		if(is_service_result_fresh(temp_service, current_time, TRUE) == FALSE) {
+		/* log a warning */
+		logit(NSLOG_RUNTIME_WARNING, TRUE, "Warning: The check of service '%s' on host '%s' looks like it was orphaned (results never came back; last_check=%lu; next_check=%lu).  I'm scheduling an immediate check of the service...\n", temp_service->description, temp_service->host_name, temp_service->last_check, temp_service->next_check);
 
-			/* set the freshen flag */
-			temp_service->is_being_freshened = TRUE;
+		log_debug_info(DEBUGL_CHECKS, 1, "Service '%s' on host '%s' was orphaned, so we're scheduling an immediate check...\n", temp_service->description, temp_service->host_name);
+		log_debug_info(DEBUGL_CHECKS, 1, "  next_check=%lu (%s); last_check=%lu (%s);\n",
+					   temp_service->next_check, ctime(&temp_service->next_check),
+					   temp_service->last_check, ctime(&temp_service->last_check));
 
-			/* schedule an immediate forced check of the service */
-			schedule_service_check(temp_service, current_time, CHECK_OPTION_FORCE_EXECUTION | CHECK_OPTION_FRESHNESS_CHECK);
-			}
+		/* decrement the number of running service checks */
+		if(currently_running_service_checks > 0)
+			currently_running_service_checks--;
+
+		/* disable the executing flag */
+		temp_service->is_executing = FALSE;
 
+		/* schedule an immediate check of the service */
+		schedule_service_check(temp_service, current_time, CHECK_OPTION_ORPHAN_CHECK);
 		}
 
 	return;
@@ -1468,20 +1961,10 @@ void check_service_result_freshness(void) {
 
 
 
-/* tests whether or not a service's check results are fresh */
-int is_service_result_fresh(service *temp_service, time_t current_time, int log_this) {
+/* calculates when the results of the last check of a service go stale */
+static time_t get_service_freshness_expiration(service *temp_service, int *threshold) {
 	int freshness_threshold = 0;
 	time_t expiration_time = 0L;
-	int days = 0;
-	int hours = 0;
-	int minutes = 0;
-	int seconds = 0;
-	int tdays = 0;
-	int thours = 0;
-	int tminutes = 0;
-	int tseconds = 0;
-
-	log_debug_info(DEBUGL_CHECKS, 2, "Checking freshness of service '%s' on host '%s'...\n", temp_service->description, temp_service->host_name);
 
 	/* use user-supplied freshness threshold or auto-calculate a freshness threshold to use? */
 	if(temp_service->freshness_threshold == 0) {
@@ -1548,6 +2031,323 @@ int is_service_result_fresh(service *temp_service, time_t current_time, int log_
 			expiration_time = event_start + freshness_threshold;
 		}
 	}
+
+	if(threshold != NULL)
+		*threshold = freshness_threshold;
+
+	return expiration_time;
+	}
+
+
+
+/* calculates when the results of the last check of a host go stale */
+static time_t get_host_freshness_expiration(host *temp_host, int *threshold) {
+	int freshness_threshold = 0;
+	time_t expiration_time = 0L;
+	double interval = 0;
+
+	/* use user-supplied freshness threshold or auto-calculate a freshness threshold to use? */
+	if(temp_host->freshness_threshold == 0) {
+		if(temp_host->state_type == HARD_STATE || temp_host->current_state == STATE_OK) {
+			interval = temp_host->check_interval;
+			}
+		else {
+			interval = temp_host->retry_interval;
+			}
+		freshness_threshold = (interval * interval_length) + temp_host->latency + additional_freshness_latency;
+		}
+	else
+		freshness_threshold = temp_host->freshness_threshold;
+
+	log_debug_info(DEBUGL_CHECKS, 2, "Freshness thresholds: host=%d, use=%d\n", temp_host->freshness_threshold, freshness_threshold);
+
+	/* calculate expiration time */
+	/*
+	 * CHANGED 11/10/05 EG:
+	 * program start is only used in expiration time calculation
+	 * if > last check AND active checks are enabled, so active checks
+	 * can become stale immediately upon program startup
+	 */
+	if(temp_host->has_been_checked == FALSE)
+		expiration_time = (time_t)(event_start + freshness_threshold);
+	/*
+	 * CHANGED 06/19/07 EG:
+	 * Per Ton's suggestion (and user requests), only use program start
+	 * time over last check if no specific threshold has been set by user.
+	 * Problems can occur if Nagios is restarted more frequently that
+	 * freshness threshold intervals (hosts never go stale).
+	 */
+	/*
+	 * CHANGED 10/07/07 EG:
+	 * Added max_host_check_spread to expiration time as suggested by
+	 * Altinity
+	 */
+	else if(temp_host->checks_enabled == TRUE && event_start > temp_host->last_check && temp_host->freshness_threshold == 0)
+		expiration_time = (time_t)(event_start + freshness_threshold + (max_host_check_spread * interval_length));
+	else
+		expiration_time = (time_t)(temp_host->last_check + freshness_threshold);
+
+	/*
+	 * If the check was last done passively, we assume it's going
+	 * to continue that way and we need to handle the fact that
+	 * Nagios might have been shut off for quite a long time. If so,
+	 * we mustn't spam freshness notifications but use event_start
+	 * instead of last_check to determine freshness expiration time.
+	 * The threshold for "long time" is determined as 61.8% of the normal
+	 * freshness threshold based on vast heuristical research (ie, "some
+	 * guy once told me the golden ratio is good for loads of stuff").
+	 */
+	if (temp_host->check_type == CHECK_TYPE_PASSIVE) {
+		if (temp_host->last_check < event_start &&
+			event_start - last_program_stop > freshness_threshold * 0.618)
+		{
+			expiration_time = event_start + freshness_threshold;
+		}
+	}
+
+
+	if(threshold != NULL)
+		*threshold = freshness_threshold;
+
+	return expiration_time;
+	}
+
+
+
+/*
+ * Freshness deadlines. Rather than looking at every host and service
+ * each freshness check interval, the ones that have freshness checking
+ * enabled sit in an expiry queue, keyed on the time the results of
+ * their last check go stale. The deadline is moved whenever a result
+ * comes in, and the freshness checks only look at the objects whose
+ * deadline has passed.
+ */
+static squeue_t *service_freshness_queue = NULL;
+static squeue_t *host_freshness_queue = NULL;
+static squeue_event **service_freshness_deadlines = NULL;
+static squeue_event **host_freshness_deadlines = NULL;
+
+
+static void set_service_freshness_deadline(service *svc, time_t when) {
+	squeue_event **deadline = &service_freshness_deadlines[svc->id];
+
+	if(*deadline != NULL)
+		squeue_remove(service_freshness_queue, *deadline);
+	*deadline = squeue_add(service_freshness_queue, when, svc);
+	}
+
+
+static void set_host_freshness_deadline(host *hst, time_t when) {
+	squeue_event **deadline = &host_freshness_deadlines[hst->id];
+
+	if(*deadline != NULL)
+		squeue_remove(host_freshness_queue, *deadline);
+	*deadline = squeue_add(host_freshness_queue, when, hst);
+	}
+
+
+/* (re)arms the freshness deadline of a service after a new result or a change of check interval */
+void update_service_freshness_deadline(service *svc) {
+
+	if(service_freshness_queue == NULL || svc == NULL)
+		return;
+
+	if(svc->check_freshness == FALSE) {
+		if(service_freshness_deadlines[svc->id] != NULL)
+			squeue_remove(service_freshness_queue, service_freshness_deadlines[svc->id]);
+		service_freshness_deadlines[svc->id] = NULL;
+		return;
+		}
+
+	/* results are stale once the expiration time has passed */
+	set_service_freshness_deadline(svc, get_service_freshness_expiration(svc, NULL) + 1);
+	}
+
+
+/* (re)arms the freshness deadline of a host after a new result or a change of check interval */
+void update_host_freshness_deadline(host *hst) {
+
+	if(host_freshness_queue == NULL || hst == NULL)
+		return;
+
+	if(hst->check_freshness == FALSE) {
+		if(host_freshness_deadlines[hst->id] != NULL)
+			squeue_remove(host_freshness_queue, host_freshness_deadlines[hst->id]);
+		host_freshness_deadlines[hst->id] = NULL;
+		return;
+		}
+
+	/* results are stale once the expiration time has passed */
+	set_host_freshness_deadline(hst, get_host_freshness_expiration(hst, NULL) + 1);
+	}
+
+
+/* arms the freshness deadlines of all services - done the first time service freshness is checked */
+static int init_service_freshness_deadlines(void) {
+	service *temp_service = NULL;
+
+	if((service_freshness_queue = squeue_create(num_objects.services + 1)) == NULL)
+		return ERROR;
+	if((service_freshness_deadlines = (squeue_event **)calloc(num_objects.services + 1, sizeof(squeue_event *))) == NULL) {
+		squeue_destroy(service_freshness_queue, 0);
+		service_freshness_queue = NULL;
+		return ERROR;
+		}
+
+	for(temp_service = service_list; temp_service != NULL; temp_service = temp_service->next)
+		update_service_freshness_deadline(temp_service);
+
+	log_debug_info(DEBUGL_CHECKS, 1, "Armed freshness deadlines for %u services.\n", squeue_size(service_freshness_queue));
+
+	return OK;
+	}
+
+
+/* arms the freshness deadlines of all hosts - done the first time host freshness is checked */
+static int init_host_freshness_deadlines(void) {
+	host *temp_host = NULL;
+
+	if((host_freshness_queue = squeue_create(num_objects.hosts + 1)) == NULL)
+		return ERROR;
+	if((host_freshness_deadlines = (squeue_event **)calloc(num_objects.hosts + 1, sizeof(squeue_event *))) == NULL) {
+		squeue_destroy(host_freshness_queue, 0);
+		host_freshness_queue = NULL;
+		return ERROR;
+		}
+
+	for(temp_host = host_list; temp_host != NULL; temp_host = temp_host->next)
+		update_host_freshness_deadline(temp_host);
+
+	log_debug_info(DEBUGL_CHECKS, 1, "Armed freshness deadlines for %u hosts.\n", squeue_size(host_freshness_queue));
+
+	return OK;
+	}
+
+
+void free_freshness_deadlines(void) {
+
+	if(service_freshness_queue != NULL)
+		squeue_destroy(service_freshness_queue, 0);
+	service_freshness_queue = NULL;
+	my_free(service_freshness_deadlines);
+
+	if(host_freshness_queue != NULL)
+		squeue_destroy(host_freshness_queue, 0);
+	host_freshness_queue = NULL;
+	my_free(host_freshness_deadlines);
+	}
+
+
+
+/* check freshness of service results */
+void check_service_result_freshness(void) {
+	service *temp_service = NULL;
+	time_t current_time = 0L;
+	time_t expiration_time = 0L;
+
+
+	log_debug_info(DEBUGL_FUNCTIONS, 0, "check_service_result_freshness()\n");
+	log_debug_info(DEBUGL_CHECKS, 1, "Checking the freshness of service check results...\n");
+
+	/* bail out if we're not supposed to be checking freshness */
+	if(check_service_freshness == FALSE) {
+		log_debug_info(DEBUGL_CHECKS, 1, "Service freshness checking is disabled.\n");
+		return;
+		}
+
+	/* the first time around, every service gets its deadline */
+	if(service_freshness_queue == NULL && init_service_freshness_deadlines() == ERROR)
+		return;
+
+	/* get the current time */
+	time(&current_time);
+
+	/* check all services whose deadline has passed... */
+	/* services that are skipped for now get a new deadline right away, so we look at them again next time */
+	while((temp_service = (service *)squeue_peek(service_freshness_queue)) != NULL) {
+
+		if(squeue_event_runtime(service_freshness_deadlines[temp_service->id])->tv_sec > current_time)
+			break;
+
+		squeue_pop(service_freshness_queue);
+		service_freshness_deadlines[temp_service->id] = NULL;
+
+		/* skip services we shouldn't be checking for freshness */
+		if(temp_service->check_freshness == FALSE)
+			continue;
+
+		/* skip services that are currently executing (problems here will be caught by orphaned service check) */
+		if(temp_service->is_executing == TRUE) {
+			set_service_freshness_deadline(temp_service, current_time + 1);
+			continue;
+			}
+
+		/* skip services that have both active and passive checks disabled */
+		if(temp_service->checks_enabled == FALSE && temp_service->accept_passive_checks == FALSE) {
+			set_service_freshness_deadline(temp_service, current_time + 1);
+			continue;
+			}
+
+		/* skip services that are already being freshened */
+		if(temp_service->is_being_freshened == TRUE) {
+			set_service_freshness_deadline(temp_service, current_time + 1);
+			continue;
+			}
+
+		/* see if the time is right... */
+		if(check_time_against_period(current_time, temp_service->check_period_ptr) == ERROR) {
+			set_service_freshness_deadline(temp_service, current_time + 1);
+			continue;
+			}
+
+		/* EXCEPTION */
+		/* don't check freshness of services without regular check intervals if we're using auto-freshness threshold */
+		/* these get a new deadline if their check interval is changed */
+		if(temp_service->check_interval == 0 && temp_service->freshness_threshold == 0)
+			continue;
+
+		/* the results for the last check of this service are stale! */
+		if(is_service_result_fresh(temp_service, current_time, TRUE) == FALSE) {
+
+			/* set the freshen flag */
+			temp_service->is_being_freshened = TRUE;
+
+			/* schedule an immediate forced check of the service */
+			schedule_service_check(temp_service, current_time, CHECK_OPTION_FORCE_EXECUTION | CHECK_OPTION_FRESHNESS_CHECK);
+
+			/* the result will arm a new deadline, but keep an eye on it until then */
+			set_service_freshness_deadline(temp_service, current_time + 1);
+			}
+
+		/* the deadline moved since it was armed (the check interval or state type changed), so follow it */
+		else {
+			expiration_time = get_service_freshness_expiration(temp_service, NULL);
+			set_service_freshness_deadline(temp_service, expiration_time + 1);
+			}
+		}
+
+	return;
+	}
+
+
+
+/* tests whether or not a service's check results are fresh */
+int is_service_result_fresh(service *temp_service, time_t current_time, int log_this) {
+	int freshness_threshold = 0;
+	time_t expiration_time = 0L;
+	int days = 0;
+	int hours = 0;
+	int minutes = 0;
+	int seconds = 0;
+	int tdays = 0;
+	int thours = 0;
+	int tminutes = 0;
+	int tseconds = 0;
+
+	log_debug_info(DEBUGL_CHECKS, 2, "Checking freshness of service '%s' on host '%s'...\n", temp_service->description, temp_service->host_name);
+
+	expiration_time = get_service_freshness_expiration(temp_service, &freshness_threshold);
+
 	log_debug_info(DEBUGL_CHECKS, 2, "HBC: %d, PS: %lu, ES: %lu, LC: %lu, CT: %lu, ET: %lu\n", temp_service->has_been_checked, (unsigned long)program_start, (unsigned long)event_start, (unsigned long)temp_service->last_check, (unsigned long)current_time, (unsigned long)expiration_time);
 
 	/* the results for the last check of this service are stale */
@@ -1596,6 +2396,15 @@ void schedule_host_check(host *hst, time_t check_time, int options) {
 		return;
 		}
 
+	/* regular, future checks may be moved to a less busy second */
+	if(options == CHECK_OPTION_NONE && check_time > time(NULL)) {
+		time_t smoothed = smooth_check_time(check_time, check_window(hst));
+		if(smoothed != check_time && check_time_against_period(smoothed, hst->check_period_ptr) == OK) {
+			log_debug_info(DEBUGL_CHECKS, 2, "Smoothing moved the check by %ld seconds.\n", (long)(smoothed - check_time));
+			check_time = smoothed;
+			}
+		}
+
 	if (options == CHECK_OPTION_DEPENDENCY_CHECK) {
 		if (hst->last_check + cached_host_check_horizon > check_time) {
 			log_debug_info(DEBUGL_CHECKS, 0, "Last check result is recent enough (%s)\n", ctime(&hst->last_check));
@@ -1713,7 +2522,12 @@ int check_host_dependencies(host *hst, int dependency_type) {
 
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "check_host_dependencies()\n");
 
-	if (dependency_type == NOTIFICATION_DEPENDENCY) {
+	/* with the index, plain dependencies are a single lookup and only the rest is walked */
+	if(host_dependency_index != NULL) {
+		if(host_dependency_index[hst->id].failed[dependency_slot(dependency_type)] > 0)
+			return DEPENDENCIES_FAILED;
+		list = host_dependency_index[hst->id].other_deps[dependency_slot(dependency_type)];
+	} else if (dependency_type == NOTIFICATION_DEPENDENCY) {
 		list = hst->notify_deps;
 	} else {
 		list = hst->exec_deps;
@@ -1730,13 +2544,10 @@ int check_host_dependencies(host *hst, int dependency_type) {
 		/* skip this dependency if it has a timeperiod and the current time isn't valid */
 		time(&current_time);
 		if(temp_dependency->dependency_period != NULL && check_time_against_period(current_time, temp_dependency->dependency_period_ptr) == ERROR)
-			return FALSE;
+			continue;
 
 		/* get the status to use (use last hard state if its currently in a soft state) */
-		if(temp_host->state_type == SOFT_STATE && soft_state_dependencies == FALSE)
-			state = temp_host->last_hard_state;
-		else
-			state = temp_host->current_state;
+		state = host_dependency_state(temp_host);
 
 		/* is the host we depend on in state that fails the dependency tests? */
 		if(flag_isset(temp_dependency->failure_options, 1 << state))
@@ -1763,42 +2574,58 @@ void check_for_orphaned_hosts(void) {
 
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "check_for_orphaned_hosts()\n");
 
+	/* nothing has been executed yet */
+	if(host_orphan_queue == NULL)
+		return;
+
 	/* get the current time */
 	time(&current_time);
 
-	/* check all hosts... */
-	for(temp_host = host_list; temp_host != NULL; temp_host = temp_host->next) {
+	/* check all executing hosts whose deadline has passed... */
+	while((temp_host = (host *)squeue_peek(host_orphan_queue)) != NULL) {
 
-		/* skip hosts that don't have a set check interval (on-demand checks are missed by the orphan logic) */
-		if(temp_host->next_check == (time_t)0L)
-			continue;
+		if(squeue_event_runtime(host_orphan_deadlines[temp_host->id])->tv_sec > current_time)
+			break;
+
+		squeue_pop(host_orphan_queue);
+		host_orphan_deadlines[temp_host->id] = NULL;
 
 		/* skip hosts that are not currently executing */
 		if(temp_host->is_executing == FALSE)
 			continue;
 
+		/* skip hosts that don't have a set check interval (on-demand checks are missed by the orphan logic) */
+		/* these are looked at again next time, in case they get one */
+		if(temp_host->next_check == (time_t)0L) {
+			host_orphan_deadlines[temp_host->id] = squeue_add(host_orphan_queue, current_time + 1, temp_host);
+			continue;
+			}
+
 		/* determine the time at which the check results should have come in (allow 10 minutes slack time) */
-		expected_time = (time_t)(temp_host->next_check + temp_host->latency + host_check_timeout + check_reaper_interval + 600);
+		expected_time = get_host_orphan_expiration(temp_host);
 
-		/* this host was supposed to have executed a while ago, but for some reason the results haven't come back in... */
-		if(expected_time < current_time) {
+		/* the host was rescheduled while its check was running, so follow the new deadline */
+		if(expected_time >= current_time) {
+			update_host_orphan_deadline(temp_host);
+			continue;
+			}
 
-			/* log a warning */
-			logit(NSLOG_RUNTIME_WARNING, TRUE, "Warning: The check of host '%s' looks like it was orphaned (results never came back).  I'm scheduling an immediate check of the host...\n", temp_host->name);
+		/* this host was supposed to have executed a while ago, but for some reason the results haven't come back in... */
 
-			log_debug_info(DEBUGL_CHECKS, 1, "Host '%s' was orphaned, so we're scheduling an immediate check...\n", temp_host->name);
+		/* log a warning */
+		logit(NSLOG_RUNTIME_WARNING, TRUE, "Warning: The check of host '%s' looks like it was orphaned (results never came back).  I'm scheduling an immediate check of the host...\n", temp_host->name);
 
-			/* decrement the number of running host checks */
-			if(currently_running_host_checks > 0)
-				currently_running_host_checks--;
+		log_debug_info(DEBUGL_CHECKS, 1, "Host '%s' was orphaned, so we're scheduling an immediate check...\n", temp_host->name);
 
-			/* disable the executing flag */
-			temp_host->is_executing = FALSE;
+		/* decrement the number of running host checks */
+		if(currently_running_host_checks > 0)
+			currently_running_host_checks--;
 
-			/* schedule an immediate check of the host */
-			schedule_host_check(temp_host, current_time, CHECK_OPTION_ORPHAN_CHECK);
-			}
+		/* disable the executing flag */
+		temp_host->is_executing = FALSE;
 
+		/* schedule an immediate check of the host */
+		schedule_host_check(temp_host, current_time, CHECK_OPTION_ORPHAN_CHECK);
 		}
 
 	return;
@@ -1810,6 +2637,7 @@ void check_for_orphaned_hosts(void) {
 void check_host_result_freshness(void) {
 	host *temp_host = NULL;
 	time_t current_time = 0L;
+	time_t expiration_time = 0L;
 
 
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "check_host_result_freshness()\n");
@@ -1821,31 +2649,50 @@ void check_host_result_freshness(void) {
 		return;
 		}
 
+	/* the first time around, every host gets its deadline */
+	if(host_freshness_queue == NULL && init_host_freshness_deadlines() == ERROR)
+		return;
+
 	/* get the current time */
 	time(&current_time);
 
-	/* check all hosts... */
-	for(temp_host = host_list; temp_host != NULL; temp_host = temp_host->next) {
+	/* check all hosts whose deadline has passed... */
+	/* hosts that are skipped for now get a new deadline right away, so we look at them again next time */
+	while((temp_host = (host *)squeue_peek(host_freshness_queue)) != NULL) {
+
+		if(squeue_event_runtime(host_freshness_deadlines[temp_host->id])->tv_sec > current_time)
+			break;
+
+		squeue_pop(host_freshness_queue);
+		host_freshness_deadlines[temp_host->id] = NULL;
 
 		/* skip hosts we shouldn't be checking for freshness */
 		if(temp_host->check_freshness == FALSE)
 			continue;
 
 		/* skip hosts that have both active and passive checks disabled */
-		if(temp_host->checks_enabled == FALSE && temp_host->accept_passive_checks == FALSE)
+		if(temp_host->checks_enabled == FALSE && temp_host->accept_passive_checks == FALSE) {
+			set_host_freshness_deadline(temp_host, current_time + 1);
 			continue;
+			}
 
 		/* skip hosts that are currently executing (problems here will be caught by orphaned host check) */
-		if(temp_host->is_executing == TRUE)
+		if(temp_host->is_executing == TRUE) {
+			set_host_freshness_deadline(temp_host, current_time + 1);
 			continue;
+			}
 
 		/* skip hosts that are already being freshened */
-		if(temp_host->is_being_freshened == TRUE)
+		if(temp_host->is_being_freshened == TRUE) {
+			set_host_freshness_deadline(temp_host, current_time + 1);
 			continue;
+			}
 
 		/* see if the time is right... */
-		if(check_time_against_period(current_time, temp_host->check_period_ptr) == ERROR)
+		if(check_time_against_period(current_time, temp_host->check_period_ptr) == ERROR) {
+			set_host_freshness_deadline(temp_host, current_time + 1);
 			continue;
+			}
 
 		/* the results for the last check of this host are stale */
 		if(is_host_result_fresh(temp_host, current_time, TRUE) == FALSE) {
@@ -1855,6 +2702,15 @@ void check_host_result_freshness(void) {
 
 			/* schedule an immediate forced check of the host */
 			schedule_host_check(temp_host, current_time, CHECK_OPTION_FORCE_EXECUTION | CHECK_OPTION_FRESHNESS_CHECK);
+
+			/* the result will arm a new deadline, but keep an eye on it until then */
+			set_host_freshness_deadline(temp_host, current_time + 1);
+			}
+
+		/* the deadline moved since it was armed (the check interval or state type changed), so follow it */
+		else {
+			expiration_time = get_host_freshness_expiration(temp_host, NULL);
+			set_host_freshness_deadline(temp_host, expiration_time + 1);
 			}
 		}
 
@@ -1875,68 +2731,10 @@ int is_host_result_fresh(host *temp_host, time_t current_time, int log_this) {
 	int thours = 0;
 	int tminutes = 0;
 	int tseconds = 0;
-	double interval = 0;
 
 	log_debug_info(DEBUGL_CHECKS, 2, "Checking freshness of host '%s'...\n", temp_host->name);
 
-	/* use user-supplied freshness threshold or auto-calculate a freshness threshold to use? */
-	if(temp_host->freshness_threshold == 0) {
-		if(temp_host->state_type == HARD_STATE || temp_host->current_state == STATE_OK) {
-			interval = temp_host->check_interval;
-			}
-		else {
-			interval = temp_host->retry_interval;
-			}
-		freshness_threshold = (interval * interval_length) + temp_host->latency + additional_freshness_latency;
-		}
-	else
-		freshness_threshold = temp_host->freshness_threshold;
-
-	log_debug_info(DEBUGL_CHECKS, 2, "Freshness thresholds: host=%d, use=%d\n", temp_host->freshness_threshold, freshness_threshold);
-
-	/* calculate expiration time */
-	/*
-	 * CHANGED 11/10/05 EG:
-	 * program start is only used in expiration time calculation
-	 * if > last check AND active checks are enabled, so active checks
-	 * can become stale immediately upon program startup
-	 */
-	if(temp_host->has_been_checked == FALSE)
-		expiration_time = (time_t)(event_start + freshness_threshold);
-	/*
-	 * CHANGED 06/19/07 EG:
-	 * Per Ton's suggestion (and user requests), only use program start
-	 * time over last check if no specific threshold has been set by user.
-	 * Problems can occur if Nagios is restarted more frequently that
-	 * freshness threshold intervals (hosts never go stale).
-	 */
-	/*
-	 * CHANGED 10/07/07 EG:
-	 * Added max_host_check_spread to expiration time as suggested by
-	 * Altinity
-	 */
-	else if(temp_host->checks_enabled == TRUE && event_start > temp_host->last_check && temp_host->freshness_threshold == 0)
-		expiration_time = (time_t)(event_start + freshness_threshold + (max_host_check_spread * interval_length));
-	else
-		expiration_time = (time_t)(temp_host->last_check + freshness_threshold);
-
-	/*
-	 * If the check was last done passively, we assume it's going
-	 * to continue that way and we need to handle the fact that
-	 * Nagios might have been shut off for quite a long time. If so,
-	 * we mustn't spam freshness notifications but use event_start
-	 * instead of last_check to determine freshness expiration time.
-	 * The threshold for "long time" is determined as 61.8% of the normal
-	 * freshness threshold based on vast heuristical research (ie, "some
-	 * guy once told me the golden ratio is good for loads of stuff").
-	 */
-	if (temp_host->check_type == CHECK_TYPE_PASSIVE) {
-		if (temp_host->last_check < event_start &&
-			event_start - last_program_stop > freshness_threshold * 0.618)
-		{
-			expiration_time = event_start + freshness_threshold;
-		}
-	}
+	expiration_time = get_host_freshness_expiration(temp_host, &freshness_threshold);
 
 	log_debug_info(DEBUGL_CHECKS, 2, "HBC: %d, PS: %lu, ES: %lu, LC: %lu, CT: %lu, ET: %lu\n", temp_host->has_been_checked, (unsigned long)program_start, (unsigned long)event_start, (unsigned long)temp_host->last_check, (unsigned long)current_time, (unsigned long)expiration_time);
 
@@ -2058,6 +2856,7 @@ int run_async_host_check(host *hst, int check_options, double latency, int sched
 	nagios_macros mac;
 	char *raw_command = NULL;
 	char *processed_command = NULL;
+	char **argv = NULL;
 	struct timeval start_time, end_time;
 	double old_latency = 0.0;
 	check_result *cr;
@@ -2153,8 +2952,8 @@ int run_async_host_check(host *hst, int check_options, double latency, int sched
 		}
 
 	/* process any macros contained in the argument */
-	process_macros_r(&mac, raw_command, &processed_command, macro_options);
 	my_free(raw_command);
+	process_command_macros_r(&mac, hst->check_command_ptr, &processed_command, &argv, macro_options);
 	if(processed_command == NULL) {
 		clear_volatile_macros_r(&mac);
 		log_debug_info(DEBUGL_CHECKS, 0, "Processed check command for host '%s' was NULL - aborting.\n", hst->name);
@@ -2169,6 +2968,8 @@ int run_async_host_check(host *hst, int check_options, double latency, int sched
 		log_debug_info(DEBUGL_CHECKS, 0, "Failed to allocate checkresult struct\n");
 		clear_volatile_macros_r(&mac);
 		clear_host_macros_r(&mac);
+		my_free(processed_command);
+		my_free(argv);
 		return ERROR;
 	}
 	init_check_result(cr);
@@ -2199,6 +3000,7 @@ int run_async_host_check(host *hst, int check_options, double latency, int sched
 		hst->latency = old_latency;
 		free_check_result(cr);
 		my_free(processed_command);
+		my_free(argv);
 		return OK;
 	}
 #endif
@@ -2206,13 +3008,14 @@ int run_async_host_check(host *hst, int check_options, double latency, int sched
 	/* reset latency (permanent value for this check will get set later) */
 	hst->latency = old_latency;
 
-	runchk_result = wproc_run_check(cr, processed_command, &mac);
+	runchk_result = wproc_run_check(cr, processed_command, argv, &mac);
 	if (runchk_result == ERROR) {
 		logit(NSLOG_RUNTIME_ERROR, TRUE, "Unable to send check for host '%s' to worker (ret=%d)\n", hst->name, runchk_result);
 	} else {
 		/* do the book-keeping */
 		currently_running_host_checks++;
 		hst->is_executing = TRUE;
+		update_host_orphan_deadline(hst);
 		update_check_stats((scheduled_check == TRUE) ? ACTIVE_SCHEDULED_HOST_CHECK_STATS : ACTIVE_ONDEMAND_HOST_CHECK_STATS, start_time.tv_sec);
 		update_check_stats(PARALLEL_HOST_CHECK_STATS, start_time.tv_sec);
 	}
@@ -2296,9 +3099,11 @@ int handle_async_host_check_result(host *temp_host, check_result *queued_check_r
 	int result = STATE_OK;
 	int reschedule_check = FALSE;
 	char *old_plugin_output = NULL;
-	char *temp_ptr = NULL;
 	struct timeval start_time_hires;
 	struct timeval end_time_hires;
+	struct timeval processing_start;
+
+	gettimeofday(&processing_start, NULL);
 
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "handle_async_host_check_result(%s ...)\n", temp_host ? temp_host->name : "(NULL host!)");
 
@@ -2371,8 +3176,10 @@ int handle_async_host_check_result(host *temp_host, check_result *queued_check_r
 	temp_host->has_been_checked = TRUE;
 
 	/* clear the execution flag if this was an active check */
-	if(queued_check_result->check_type == CHECK_TYPE_ACTIVE)
+	if(queued_check_result->check_type == CHECK_TYPE_ACTIVE) {
 		temp_host->is_executing = FALSE;
+		update_host_orphan_deadline(temp_host);
+		}
 
 	/* get the last check time */
 	temp_host->last_check = queued_check_result->start_time.tv_sec;
@@ -2389,13 +3196,10 @@ int handle_async_host_check_result(host *temp_host, check_result *queued_check_r
 	if(temp_host->plugin_output)
 		old_plugin_output = (char *)strdup(temp_host->plugin_output);
 
-	/* clear the old plugin output and perf data buffers */
-	my_free(temp_host->plugin_output);
-	my_free(temp_host->long_plugin_output);
-	my_free(temp_host->perf_data);
-
-	/* parse check output to get: (1) short output, (2) long output, (3) perf data */
-	parse_check_output(queued_check_result->output, &temp_host->plugin_output, &temp_host->long_plugin_output, &temp_host->perf_data, TRUE, FALSE);
+	/* parse check output to get: (1) short output, (2) long output, (3) perf data.
+	 * This leaves whatever didn't change alone, and replaces semicolons in
+	 * plugin output (but not performance data) with colons. */
+	get_check_result_output(queued_check_result, &temp_host->plugin_output, &temp_host->long_plugin_output, &temp_host->perf_data);
 
 	/* make sure we have some data */
 	if(temp_host->plugin_output == NULL || !strcmp(temp_host->plugin_output, "")) {
@@ -2403,12 +3207,6 @@ int handle_async_host_check_result(host *temp_host, check_result *queued_check_r
 		temp_host->plugin_output = (char *)strdup("(No output returned from host check)");
 		}
 
-	/* replace semicolons in plugin output (but not performance data) with colons */
-	if((temp_ptr = temp_host->plugin_output)) {
-		while((temp_ptr = strchr(temp_ptr, ';')))
-			* temp_ptr = ':';
-		}
-
 	log_debug_info(DEBUGL_CHECKS, 2, "Parsing check output...\n");
 	log_debug_info(DEBUGL_CHECKS, 2, "Short Output: %s\n", (temp_host->plugin_output == NULL) ? "NULL" : temp_host->plugin_output);
 	log_debug_info(DEBUGL_CHECKS, 2, "Long Output:  %s\n", (temp_host->long_plugin_output == NULL) ? "NULL" : temp_host->long_plugin_output);
@@ -2440,6 +3238,9 @@ int handle_async_host_check_result(host *temp_host, check_result *queued_check_r
 	/* process the host check result */
 	process_host_check_result(temp_host, result, old_plugin_output, CHECK_OPTION_NONE, reschedule_check, TRUE, cached_host_check_horizon);
 
+	/* anyone who asked for an on-demand check of this host gets this result */
+	deliver_check_result(HOST_CHECK, temp_host->id, temp_host->name, temp_host->current_state);
+
 	/* free memory */
 	my_free(old_plugin_output);
 
@@ -2456,10 +3257,85 @@ int handle_async_host_check_result(host *temp_host, check_result *queued_check_r
 	broker_host_check(NEBTYPE_HOSTCHECK_PROCESSED, NEBFLAG_NONE, NEBATTR_NONE, temp_host, temp_host->check_type, temp_host->current_state, temp_host->state_type, start_time_hires, end_time_hires, temp_host->check_command, temp_host->latency, temp_host->execution_time, host_check_timeout, queued_check_result->early_timeout, queued_check_result->return_code, NULL, temp_host->plugin_output, temp_host->long_plugin_output, temp_host->perf_data, NULL, queued_check_result);
 #endif
 
+	/* keep track of how long active checks wait, run and take us to handle */
+	if(queued_check_result->check_type == CHECK_TYPE_ACTIVE && temp_host->check_command_ptr != NULL)
+		update_check_timings(CHECK_TIMINGS_COMMAND, temp_host->check_command_ptr->name, temp_host->latency, temp_host->execution_time, tv_delta_f(&processing_start, &end_time_hires));
+
+	return OK;
+	}
+
+
+
+/* number of UP parents of each host, indexed by host id */
+static unsigned int *host_parents_up = NULL;
+
+
+/* builds the reachability cache from the current host states - must be called once retention data has been read */
+int init_host_reachability(void) {
+	host *temp_host = NULL;
+	hostsmember *temp_hostsmember = NULL;
+
+	free_host_reachability();
+
+	if(num_objects.hosts == 0)
+		return OK;
+
+	if((host_parents_up = (unsigned int *)calloc(num_objects.hosts, sizeof(unsigned int))) == NULL)
+		return ERROR;
+
+	/* one pass over the parent graph: every UP host counts once for each of its children */
+	for(temp_host = host_list; temp_host != NULL; temp_host = temp_host->next) {
+		if(temp_host->current_state != HOST_UP)
+			continue;
+		for(temp_hostsmember = temp_host->child_hosts; temp_hostsmember != NULL; temp_hostsmember = temp_hostsmember->next)
+			host_parents_up[temp_hostsmember->host_ptr->id]++;
+		}
+
 	return OK;
 	}
 
 
+void free_host_reachability(void) {
+
+	my_free(host_parents_up);
+	}
+
+
+/* tells the reachability cache that a host went from UP to DOWN/UNREACHABLE or back */
+void update_host_reachability(host *hst) {
+	hostsmember *temp_hostsmember = NULL;
+	unsigned int *parents_up = NULL;
+
+	if(host_parents_up == NULL || hst == NULL)
+		return;
+
+	for(temp_hostsmember = hst->child_hosts; temp_hostsmember != NULL; temp_hostsmember = temp_hostsmember->next) {
+		parents_up = &host_parents_up[temp_hostsmember->host_ptr->id];
+		if(hst->current_state == HOST_UP)
+			(*parents_up)++;
+		else if(*parents_up > 0)
+			(*parents_up)--;
+		}
+	}
+
+
+/* returns the number of parents of a host that are UP */
+static unsigned int count_parents_up(host *hst) {
+	hostsmember *temp_hostsmember = NULL;
+	unsigned int parents_up = 0;
+
+	if(host_parents_up != NULL)
+		return host_parents_up[hst->id];
+
+	/* no cache yet, so walk the parents */
+	for(temp_hostsmember = hst->parent_hosts; temp_hostsmember != NULL; temp_hostsmember = temp_hostsmember->next) {
+		if(temp_hostsmember->host_ptr->current_state == HOST_UP)
+			parents_up++;
+		}
+
+	return parents_up;
+	}
+
 
 /* processes the result of a synchronous or asynchronous host check */
 int process_host_check_result(host *hst, int new_state, char *old_plugin_output, int check_options, int reschedule_check, int use_cached_result, unsigned long check_timestamp_horizon) {
@@ -2505,6 +3381,7 @@ int process_host_check_result(host *hst, int new_state, char *old_plugin_output,
 
 			/* set the current state */
 			hst->current_state = HOST_UP;
+			update_host_reachability(hst);
 
 			/* set the state type */
 			/* set state type to HARD for passive checks and active checks that were previously in a HARD STATE */
@@ -2526,18 +3403,19 @@ int process_host_check_result(host *hst, int new_state, char *old_plugin_output,
 				parent_host = temp_hostsmember->host_ptr;
 				if(parent_host->current_state != HOST_UP) {
 					log_debug_info(DEBUGL_CHECKS, 1, "Check of parent host '%s' queued.\n", parent_host->name);
-					schedule_host_check(parent_host, current_time, CHECK_OPTION_DEPENDENCY_CHECK);
+					schedule_on_demand_host_check(parent_host, current_time, CHECK_OPTION_DEPENDENCY_CHECK, HOST_CHECK, hst);
 					}
 				}
 
 			/* propagate checks to immediate children if they are not already UP */
 			/* we do this because children may currently be UNREACHABLE, but may (as a result of this recovery) switch to UP or DOWN states */
+			/* children that already had a route through another parent aren't affected by this recovery, so they're left alone */
 			log_debug_info(DEBUGL_CHECKS, 1, "Propagating checks to child host(s)...\n");
 			for(temp_hostsmember = hst->child_hosts; temp_hostsmember != NULL; temp_hostsmember = temp_hostsmember->next) {
 				child_host = temp_hostsmember->host_ptr;
-				if(child_host->current_state != HOST_UP) {
+				if(child_host->current_state != HOST_UP && count_parents_up(child_host) == 1) {
 					log_debug_info(DEBUGL_CHECKS, 1, "Check of child host '%s' queued.\n", child_host->name);
-					schedule_host_check(child_host, current_time, CHECK_OPTION_DEPENDENCY_CHECK);
+					schedule_on_demand_host_check(child_host, current_time, CHECK_OPTION_DEPENDENCY_CHECK, HOST_CHECK, hst);
 					}
 				}
 
@@ -2649,6 +3527,7 @@ int process_host_check_result(host *hst, int new_state, char *old_plugin_output,
 			hst->current_state = new_state;
 			if(hst->check_type == CHECK_TYPE_ACTIVE || translate_passive_host_checks == TRUE)
 				hst->current_state = determine_host_reachability(hst);
+			update_host_reachability(hst);
 
 			/* reschedule a check of the host */
 			reschedule_check = TRUE;
@@ -2669,19 +3548,20 @@ int process_host_check_result(host *hst, int new_state, char *old_plugin_output,
 			for(temp_hostsmember = hst->parent_hosts; temp_hostsmember != NULL; temp_hostsmember = temp_hostsmember->next) {
 				parent_host = temp_hostsmember->host_ptr;
 				if(parent_host->current_state == HOST_UP) {
-					schedule_host_check(parent_host, current_time, CHECK_OPTION_DEPENDENCY_CHECK);
+					schedule_on_demand_host_check(parent_host, current_time, CHECK_OPTION_DEPENDENCY_CHECK, HOST_CHECK, hst);
 					log_debug_info(DEBUGL_CHECKS, 1, "Check of host '%s' queued.\n", parent_host->name);
 					}
 				}
 
 			/* propagate checks to immediate children if they are not UNREACHABLE */
 			/* we do this because we may now be blocking the route to child hosts */
+			/* children that can still be reached through another parent aren't affected, so they're left alone */
 			log_debug_info(DEBUGL_CHECKS, 1, "Propagating checks to immediate non-UNREACHABLE child hosts...\n");
 			for(temp_hostsmember = hst->child_hosts; temp_hostsmember != NULL; temp_hostsmember = temp_hostsmember->next) {
 				child_host = temp_hostsmember->host_ptr;
-				if(child_host->current_state != HOST_UNREACHABLE) {
+				if(child_host->current_state != HOST_UNREACHABLE && count_parents_up(child_host) == 0) {
 					log_debug_info(DEBUGL_CHECKS, 1, "Check of child host '%s' queued.\n", child_host->name);
-					schedule_host_check(child_host, current_time, CHECK_OPTION_NONE);
+					schedule_on_demand_host_check(child_host, current_time, CHECK_OPTION_NONE, HOST_CHECK, hst);
 					}
 				}
 
@@ -2698,7 +3578,7 @@ int process_host_check_result(host *hst, int new_state, char *old_plugin_output,
 					if(dep->dependent_host_ptr == hst && dep->master_host_ptr != NULL) {
 						master_host = (host *)dep->master_host_ptr;
 						log_debug_info(DEBUGL_CHECKS, 1, "Check of host '%s' queued.\n", master_host->name);
-						schedule_host_check(master_host, current_time, CHECK_OPTION_NONE);
+						schedule_on_demand_host_check(master_host, current_time, CHECK_OPTION_NONE, HOST_CHECK, hst);
 						}
 					}
 				for(list = hst->exec_deps; list; list = list->next) {
@@ -2706,7 +3586,7 @@ int process_host_check_result(host *hst, int new_state, char *old_plugin_output,
 					if(dep->dependent_host_ptr == hst && dep->master_host_ptr != NULL) {
 						master_host = (host *)dep->master_host_ptr;
 						log_debug_info(DEBUGL_CHECKS, 1, "Check of host '%s' queued.\n", master_host->name);
-						schedule_host_check(master_host, current_time, CHECK_OPTION_NONE);
+						schedule_on_demand_host_check(master_host, current_time, CHECK_OPTION_NONE, HOST_CHECK, hst);
 						}
 					}
 				}
@@ -2774,6 +3654,12 @@ int process_host_check_result(host *hst, int new_state, char *old_plugin_output,
 			}
 		}
 
+	/* hosts that depend on this one may have to be looked at differently now */
+	update_host_dependency_index(hst);
+
+	/* the results of this check go stale at a new time */
+	update_host_freshness_deadline(hst);
+
 	/* update host status - for both active (scheduled) and passive (non-scheduled) hosts */
 	update_host_status(hst, FALSE);
 
@@ -2882,8 +3768,6 @@ int adjust_host_check_attempt(host *hst, int is_active) {
 /* determination of the host's state based on route availability*/
 /* used only to determine difference between DOWN and UNREACHABLE states */
 int determine_host_reachability(host *hst) {
-	host *parent_host = NULL;
-	hostsmember *temp_hostsmember = NULL;
 
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "determine_host_reachability(host=%s)\n", hst ? hst->name : "(NULL host!)");
 
@@ -2908,18 +3792,10 @@ int determine_host_reachability(host *hst) {
 		return HOST_DOWN;
 		}
 
-	/* check all parent hosts to see if we're DOWN or UNREACHABLE */
-	else {
-		for(temp_hostsmember = hst->parent_hosts; temp_hostsmember != NULL; temp_hostsmember = temp_hostsmember->next) {
-			parent_host = temp_hostsmember->host_ptr;
-			log_debug_info(DEBUGL_CHECKS, 2, "   Parent '%s' is %s\n", parent_host->name, host_state_name(parent_host->current_state));
-			/* bail out as soon as we find one parent host that is UP */
-			if(parent_host->current_state == HOST_UP) {
-				/* set the current state */
-				log_debug_info(DEBUGL_CHECKS, 2, "At least one parent (%s) is up, so host is DOWN.\n", parent_host->name);
-				return HOST_DOWN;
-				}
-			}
+	/* if one or more parent hosts are UP we're DOWN, otherwise UNREACHABLE */
+	else if(count_parents_up(hst) > 0) {
+		log_debug_info(DEBUGL_CHECKS, 2, "%u parent(s) are up, so host is DOWN.\n", count_parents_up(hst));
+		return HOST_DOWN;
 		}
 
 	log_debug_info(DEBUGL_CHECKS, 2, "No parents were up, so host is UNREACHABLE.\n");
@@ -3074,145 +3950,340 @@ int handle_host_state(host *hst) {
 	}
 
 
-/* Parses raw plugin output and returns: short and long output, perf data. */
-int parse_check_output(char *buf, char **short_output, char **long_output, char **perf_data, int escape_newlines_please, int newlines_are_escaped) {
-	int current_line = 0;
-	int eof = FALSE;
-	int in_perf_data = FALSE;
-	const int dbuf_chunk = 1024;
-	dbuf long_text;
-	dbuf perf_text;
-	char *ptr = NULL;
-	int x = 0;
-	int y = 0;
+/* strip() considers these whitespace, and so do we */
+static int is_output_space(char c) {
 
-	/* Initialize output values. */
-	if (short_output)
-		*short_output = NULL;
-	if (long_output)
-		*long_output = NULL;
-	if (perf_data)
-		*perf_data = NULL;
+	return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+	}
 
-	/* No input provided or no output requested, nothing to do. */
-	if (!buf || !*buf || (!short_output && !long_output && !perf_data))
-		return OK;
+
+/* trims whitespace off a slice without touching the buffer */
+static void trim_slice(check_output_slice *s, int leading, int trailing) {
+
+	if(s->str == NULL)
+		return;
+	while(leading && s->len && is_output_space(*s->str)) {
+		s->str++;
+		s->len--;
+		}
+	while(trailing && s->len && is_output_space(s->str[s->len - 1]))
+		s->len--;
+	}
 
 
-	/* Initialize dynamic buffers (1KB chunk size). */
-	dbuf_init(&long_text, dbuf_chunk);
-	dbuf_init(&perf_text, dbuf_chunk);
+/*
+ * Splits raw plugin output into slices of buf: short output, long output
+ * and perf data. Nothing is allocated, so the slices are only good for as
+ * long as buf is. The first line of buf is nul-terminated (the rest of it
+ * is left where it was) and newlines in trailing perf data are turned
+ * into spaces, but otherwise buf is unchanged.
+ *
+ * The short output is set if the first line isn't empty, even if it ends
+ * up being empty itself. Long output and perf data are only set if they
+ * have a non-zero length. Perf data can come in two parts, one from the
+ * first line and one from after the first '|' following it. Their whole
+ * is what parse_check_output() would have returned: both parts, with a
+ * single space between them if both are set. This is safe to call from
+ * the result parsing threads.
+ */
+int parse_check_output_slices(char *buf, check_output *out, int newlines_are_escaped) {
+	check_output_slice *head_perf = &out->perf_data[0];
+	check_output_slice *tail_perf = &out->perf_data[1];
+	char *eol = NULL;
+	char *sep = NULL;
+	char *p = NULL;
+	size_t x = 0;
+	size_t y = 0;
+
+	memset(out, 0, sizeof(*out));
+
+	if(buf == NULL || *buf == '\x0')
+		return OK;
 
 	/* We should never need to worry about unescaping here again. We assume a
 	 * common internal plugin output format that is newline delimited. */
-	if (newlines_are_escaped) {
-		for (x = 0, y = 0; buf[x]; x++) {
-			if (buf[x] == '\\' && buf[x + 1] == '\\') {
+	if(newlines_are_escaped) {
+		for(x = 0, y = 0; buf[x]; x++) {
+			if(buf[x] == '\\' && buf[x + 1] == '\\') {
 				x++;
 				buf[y++] = buf[x];
 				}
-			else if (buf[x] == '\\' && buf[x + 1] == 'n') {
+			else if(buf[x] == '\\' && buf[x + 1] == 'n') {
 				x++;
 				buf[y++] = '\n';
 				}
 			else
 				buf[y++] = buf[x];
 			}
-		buf[y] = '\0';
+		buf[y] = '\x0';
 		}
 
-	/* Process each line of input. */
-	for (x = 0; !eof && buf[0]; x++) {
-
-		/* Continue on until we reach the end of a line (or input). */
-		if (buf[x] == '\n')
-			buf[x] = '\0';
-		else if (buf[x] == '\0')
-			eof = TRUE;
+	/* the first line contains short plugin output and optional perf data */
+	if((eol = strchr(buf, '\n')))
+		*eol = '\x0';
+	if(*buf) {
+		out->short_output.str = buf;
+		if((sep = strchr(buf, '|'))) {
+			out->short_output.len = sep - buf;
+			head_perf->str = sep + 1;
+			head_perf->len = strlen(sep + 1);
+			}
 		else
-			continue;
+			out->short_output.len = strlen(buf);
+		trim_slice(&out->short_output, TRUE, TRUE);
+		}
+
+	/* additional lines contain long plugin output and, once we've hit
+	 * a perf data separator, nothing but perf data */
+	if(eol) {
+		p = eol + 1;
+		out->long_output.str = p;
+		if((sep = strchr(p, '|'))) {
+			out->long_output.len = sep - p;
+			p = sep + 1;
+			/* an empty remainder of the separator line adds nothing */
+			if(*p == '\n')
+				p++;
+			tail_perf->str = p;
+			for(; *p; p++) {
+				if(*p == '\n')
+					*p = ' ';
+				}
+			tail_perf->len = p - tail_perf->str;
+			}
+		else {
+			out->long_output.len = strlen(p);
+			/* a trailing newline doesn't start another line */
+			if(out->long_output.len && p[out->long_output.len - 1] == '\n')
+				out->long_output.len--;
+			}
+		}
 
-		/* Handle this line of input. */
-		current_line++;
+	/* Trim the perf data as a whole, the way strip() would trim the two
+	 * parts joined together. */
+	trim_slice(head_perf, TRUE, FALSE);
+	trim_slice(tail_perf, FALSE, TRUE);
+	if(!head_perf->len)
+		trim_slice(tail_perf, TRUE, FALSE);
+	if(!tail_perf->len)
+		trim_slice(head_perf, FALSE, TRUE);
 
-		/* The first line contains short plugin output and optional perf data. */
-		if (current_line == 1) {
+	return OK;
+	}
 
-			/* Get the short plugin output. If buf[0] is '|', strtok() will
-			 * return buf+1 or NULL if buf[1] is '\0'. We use my_strtok()
-			 * instead which returns a pointer to '\0' in this case. */
-			if ((ptr = my_strtok(buf, "|"))) {
-				if (short_output) {
-					strip(ptr); /* Remove leading and trailing whitespace. */
-					*short_output = strdup(ptr);
-					}
 
-				/* Get the optional perf data. */
-				if ((ptr = my_strtok(NULL, "\n")))
-					dbuf_strcat(&perf_text, ptr);
-				}
+/* copies a slice into a string of its own */
+static char *slice_dup(const check_output_slice *s) {
+	char *str = NULL;
+
+	if(s->str == NULL || (str = malloc(s->len + 1)) == NULL)
+		return NULL;
+	memcpy(str, s->str, s->len);
+	str[s->len] = '\x0';
+
+	return str;
+	}
 
-			}
-		/* Additional lines contain long plugin output and optional perf data.
-		 * Once we've hit perf data, the rest of the output is perf data. */
-		else if (in_perf_data) {
-			if (perf_text.buf && *perf_text.buf)
-				dbuf_strcat(&perf_text, " ");
-			dbuf_strcat(&perf_text, buf);
 
+/* copies a slice of long output, escaping newlines and backslashes like escape_newlines() */
+static char *slice_escape(const check_output_slice *s) {
+	char *str = NULL;
+	size_t x = 0;
+	size_t y = 0;
+
+	for(x = 0; x < s->len; x++) {
+		if(s->str[x] == '\\' || s->str[x] == '\n')
+			y++;
+		}
+	if((str = malloc(s->len + y + 1)) == NULL)
+		return NULL;
+
+	for(x = 0, y = 0; x < s->len; x++) {
+		if(s->str[x] == '\\' || s->str[x] == '\n') {
+			str[y++] = '\\';
+			str[y++] = s->str[x] == '\n' ? 'n' : '\\';
 			}
-		/* Look for the perf data separator. */
-		else if (strchr(buf, '|')) {
-			in_perf_data = TRUE;
+		else
+			str[y++] = s->str[x];
+		}
+	str[y] = '\x0';
 
-			if ((ptr = my_strtok(buf, "|"))) {
+	return str;
+	}
 
-				/* Get the remaining long plugin output. */
-				if (current_line > 2)
-					dbuf_strcat(&long_text, "\n");
-				dbuf_strcat(&long_text, ptr);
 
-				/* Get the perf data. */
-				if ((ptr = my_strtok(NULL, "\n"))) {
-					if (perf_text.buf && *perf_text.buf)
-						dbuf_strcat(&perf_text, " ");
-					dbuf_strcat(&perf_text, ptr);
-					}
-				}
+/* joins the two parts of the perf data into a string of its own */
+static char *perf_data_dup(const check_output *out) {
+	const check_output_slice *head = &out->perf_data[0];
+	const check_output_slice *tail = &out->perf_data[1];
+	char *str = NULL;
+	size_t len = 0;
+
+	if(!head->len && !tail->len)
+		return NULL;
+	if((str = malloc(head->len + tail->len + 2)) == NULL)
+		return NULL;
+
+	if(head->len) {
+		memcpy(str, head->str, head->len);
+		len = head->len;
+		}
+	if(head->len && tail->len)
+		str[len++] = ' ';
+	if(tail->len) {
+		memcpy(str + len, tail->str, tail->len);
+		len += tail->len;
+		}
+	str[len] = '\x0';
+
+	return str;
+	}
+
+
+/* compares short output to what we have, which has had semicolons replaced by colons */
+static int short_output_matches(const check_output_slice *s, const char *str) {
+	size_t x = 0;
+
+	for(x = 0; x < s->len; x++, str++) {
+		if(*str != (s->str[x] == ';' ? ':' : s->str[x]))
+			return FALSE;
+		}
+
+	return *str == '\x0';
+	}
+
 
+/* compares long output to what we have, which is escaped */
+static int long_output_matches(const check_output_slice *s, const char *str) {
+	size_t x = 0;
+	char c = 0;
+
+	for(x = 0; x < s->len; x++) {
+		c = s->str[x];
+		if(c == '\\' || c == '\n') {
+			if(*str++ != '\\')
+				return FALSE;
+			c = c == '\n' ? 'n' : '\\';
 			}
-		/* Otherwise it's still just long output. */
-		else {
-			if (current_line > 2)
-				dbuf_strcat(&long_text, "\n");
-			dbuf_strcat(&long_text, buf);
+		if(*str++ != c)
+			return FALSE;
+		}
+
+	return *str == '\x0';
+	}
+
+
+/* returns what's left of str after the slice, or NULL if str doesn't start with it */
+static const char *skip_slice(const char *str, const check_output_slice *s) {
+
+	if(s->len && strncmp(str, s->str, s->len))
+		return NULL;
+
+	return str + s->len;
+	}
+
+
+/* compares perf data to what we have */
+static int perf_data_matches(const check_output *out, const char *str) {
+	const check_output_slice *head = &out->perf_data[0];
+	const check_output_slice *tail = &out->perf_data[1];
+
+	if((str = skip_slice(str, head)) == NULL)
+		return FALSE;
+	if(head->len && tail->len && *str++ != ' ')
+		return FALSE;
+	if((str = skip_slice(str, tail)) == NULL)
+		return FALSE;
+
+	return *str == '\x0';
+	}
+
+
+/*
+ * Updates an object's short output, long output and perf data from parsed
+ * plugin output. Only the strings that changed are replaced, so a check
+ * that keeps returning the same output costs no allocations at all.
+ * Long output is kept escaped and semicolons in the short output (but
+ * not in the perf data) are replaced with colons. Returns TRUE if
+ * anything changed.
+ */
+int update_check_output(const check_output *out, char **short_output, char **long_output, char **perf_data) {
+	char *temp_ptr = NULL;
+	int changed = FALSE;
+
+	if(out->short_output.str == NULL) {
+		if(*short_output != NULL)
+			changed = TRUE;
+		my_free(*short_output);
+		}
+	else if(*short_output == NULL || !short_output_matches(&out->short_output, *short_output)) {
+		changed = TRUE;
+		my_free(*short_output);
+		if((*short_output = slice_dup(&out->short_output))) {
+			for(temp_ptr = *short_output; (temp_ptr = strchr(temp_ptr, ';')); temp_ptr++)
+				*temp_ptr = ':';
 			}
+		}
+
+	if(!out->long_output.len) {
+		if(*long_output != NULL)
+			changed = TRUE;
+		my_free(*long_output);
+		}
+	else if(*long_output == NULL || !long_output_matches(&out->long_output, *long_output)) {
+		changed = TRUE;
+		my_free(*long_output);
+		*long_output = slice_escape(&out->long_output);
+		}
 
-		/* Point buf to the start of the next line. *(buf+x+1) will be a valid
-		 * memory reference on our next iteration or we are at the end of input
-		 * (eof == TRUE) and *(buf+x+1) will never be referenced. */
-		buf += x + 1;
-		x = -1; /* x will be incremented to 0 by the loop update. */
+	if(!out->perf_data[0].len && !out->perf_data[1].len) {
+		if(*perf_data != NULL)
+			changed = TRUE;
+		my_free(*perf_data);
 		}
+	else if(*perf_data == NULL || !perf_data_matches(out, *perf_data)) {
+		changed = TRUE;
+		my_free(*perf_data);
+		*perf_data = perf_data_dup(out);
+		}
+
+	return changed;
+	}
+
+
+/* Parses raw plugin output and returns: short and long output, perf data.
+ * This modifies buf and keeps no state of its own, so it's safe to call
+ * from the result parsing threads. */
+int parse_check_output(char *buf, char **short_output, char **long_output, char **perf_data, int escape_newlines_please, int newlines_are_escaped) {
+	check_output out;
+
+	/* Initialize output values. */
+	if(short_output)
+		*short_output = NULL;
+	if(long_output)
+		*long_output = NULL;
+	if(perf_data)
+		*perf_data = NULL;
+
+	/* No input provided or no output requested, nothing to do. */
+	if(!buf || !*buf || (!short_output && !long_output && !perf_data))
+		return OK;
 
-	/* Save long output. */
-	if (long_output && long_text.buf && *long_text.buf) {
+	parse_check_output_slices(buf, &out, newlines_are_escaped);
+
+	if(short_output) {
+		*short_output = slice_dup(&out.short_output);
+		}
+	if(long_output && out.long_output.len) {
 		/* Escape newlines (and backslashes) in long output if requested. */
-		if (escape_newlines_please)
-			*long_output = escape_newlines(long_text.buf);
+		if(escape_newlines_please)
+			*long_output = slice_escape(&out.long_output);
 		else
-			*long_output = strdup(long_text.buf);
+			*long_output = slice_dup(&out.long_output);
 		}
-
-	/* Save perf data. */
-	if (perf_data && perf_text.buf && *perf_text.buf) {
-		strip(perf_text.buf); /* Remove leading and trailing whitespace. */
-		*perf_data = strdup(perf_text.buf);
+	if(perf_data) {
+		*perf_data = perf_data_dup(&out);
 		}
 
-	/* free dynamic buffers */
-	dbuf_free(&long_text);
-	dbuf_free(&perf_text);
-
 	return OK;
 	}
@@ -2964,6 +2964,7 @@ int cmd_change_object_int_var(int cmd, char *args) {
 			/* modify the check interval */
 			temp_host->check_interval = dval;
 			attr = MODATTR_NORMAL_CHECK_INTERVAL;
+			update_host_freshness_deadline(temp_host);
 
 			/* schedule a host check if previous interval was 0 (checks were not regularly scheduled) */
 			if(old_dval == 0 && temp_host->checks_enabled == TRUE) {
@@ -2991,6 +2992,7 @@ int cmd_change_object_int_var(int cmd, char *args) {
 
 			temp_host->retry_interval = dval;
 			attr = MODATTR_RETRY_CHECK_INTERVAL;
+			update_host_freshness_deadline(temp_host);
 
 			break;
 
@@ -3013,6 +3015,7 @@ int cmd_change_object_int_var(int cmd, char *args) {
 			/* modify the check interval */
 			temp_service->check_interval = dval;
 			attr = MODATTR_NORMAL_CHECK_INTERVAL;
+			update_service_freshness_deadline(temp_service);
 
 			/* schedule a service check if previous interval was 0 (checks were not regularly scheduled) */
 			if(old_dval == 0 && temp_service->checks_enabled == TRUE && temp_service->check_interval != 0) {
@@ -3040,6 +3043,7 @@ int cmd_change_object_int_var(int cmd, char *args) {
 
 			temp_service->retry_interval = dval;
 			attr = MODATTR_RETRY_CHECK_INTERVAL;
+			update_service_freshness_deadline(temp_service);
 
 			break;
 
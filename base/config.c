@@ -179,6 +179,52 @@ int read_main_config_file(char *main_config_file) {
 			error = set_loadctl_options(value, strlen(value)) != OK;
 		else if(!strcmp(variable, "check_workers"))
 			num_check_workers = atoi(value);
+		else if(!strcmp(variable, "check_result_threads")) {
+			check_result_threads = atoi(value);
+			if(check_result_threads < 0 || check_result_threads > 64) {
+				asprintf(&error_message, "Illegal value for check_result_threads");
+				error = TRUE;
+				break;
+				}
+			}
+		else if(!strcmp(variable, "persistent_plugins")) {
+			my_free(persistent_plugins);
+			persistent_plugins = (char *)strdup(value);
+			}
+		else if(!strcmp(variable, "plugin_spawn_method")) {
+			if(!strcmp(value, "fork"))
+				plugin_spawn_method = RUNCMD_SPAWN_FORK;
+			else if(!strcmp(value, "posix_spawn"))
+				plugin_spawn_method = RUNCMD_SPAWN_POSIX;
+			else {
+				asprintf(&error_message, "Illegal value for plugin_spawn_method");
+				error = TRUE;
+				break;
+				}
+			}
+		else if(!strcmp(variable, "worker_selection_policy")) {
+			if(!strcmp(value, "round_robin"))
+				worker_selection_policy = WPROC_SELECT_ROUND_ROBIN;
+			else if(!strcmp(value, "least_jobs"))
+				worker_selection_policy = WPROC_SELECT_LEAST_JOBS;
+			else if(!strcmp(value, "two_choices"))
+				worker_selection_policy = WPROC_SELECT_TWO_CHOICES;
+			else if(!strcmp(value, "host_affinity"))
+				worker_selection_policy = WPROC_SELECT_HOST_AFFINITY;
+			else {
+				asprintf(&error_message, "Illegal value for worker_selection_policy");
+				error = TRUE;
+				break;
+				}
+			}
+		else if(!strcmp(variable, "worker_affinity_groups")) {
+			worker_affinity_groups = atoi(value);
+			if(worker_affinity_groups < 1) {
+				asprintf(&error_message, "Illegal value for worker_affinity_groups");
+				error = TRUE;
+				break;
+				}
+			}
 		else if(!strcmp(variable, "query_socket")) {
 			my_free(qh_socket_path);
 			qh_socket_path = nspath_absolute(value, config_file_dir);
@@ -477,6 +523,30 @@ int read_main_config_file(char *main_config_file) {
 				}
 			}
 
+		else if(!strcmp(variable, "retention_file_format")) {
+
+			if(!strcmp(value, "text"))
+				retention_file_format = RETENTION_FORMAT_TEXT;
+			else if(!strcmp(value, "binary"))
+				retention_file_format = RETENTION_FORMAT_BINARY;
+			else {
+				asprintf(&error_message, "Illegal value for retention_file_format");
+				error = TRUE;
+				break;
+				}
+			}
+
+		else if(!strcmp(variable, "retention_load_threads")) {
+
+			retention_load_threads = atoi(value);
+
+			if(retention_load_threads < 0 || retention_load_threads > 64) {
+				asprintf(&error_message, "Illegal value for retention_load_threads");
+				error = TRUE;
+				break;
+				}
+			}
+
 		else if(!strcmp(variable, "additional_freshness_latency"))
 			additional_freshness_latency = atoi(value);
 
@@ -509,6 +579,17 @@ int read_main_config_file(char *main_config_file) {
 			obsess_over_services = (atoi(value) > 0) ? TRUE : FALSE;
 			}
 
+		else if(!strcmp(variable, "suppress_unchanged_results")) {
+
+			if(strlen(value) != 1 || value[0] < '0' || value[0] > '1') {
+				asprintf(&error_message, "Illegal value for suppress_unchanged_results");
+				error = TRUE;
+				break;
+				}
+
+			suppress_unchanged_results = (atoi(value) > 0) ? TRUE : FALSE;
+			}
+
 		else if(!strcmp(variable, "obsess_over_hosts")) {
 
 			if(strlen(value) != 1 || value[0] < '0' || value[0] > '1') {
@@ -921,6 +1002,16 @@ int read_main_config_file(char *main_config_file) {
 				}
 			}
 
+		else if(!strcmp(variable, "smooth_check_scheduling")) {
+
+			smooth_check_scheduling = atoi(value);
+			if(smooth_check_scheduling < 0 || smooth_check_scheduling > 50) {
+				asprintf(&error_message, "Illegal value for smooth_check_scheduling");
+				error = TRUE;
+				break;
+				}
+			}
+
 		else if(!strcmp(variable, "status_update_interval")) {
 
 			status_update_interval = atoi(value);
@@ -931,6 +1022,17 @@ int read_main_config_file(char *main_config_file) {
 				}
 			}
 
+		else if(!strcmp(variable, "status_writer_thread")) {
+
+			if(strlen(value) != 1 || value[0] < '0' || value[0] > '1') {
+				asprintf(&error_message, "Illegal value for status_writer_thread");
+				error = TRUE;
+				break;
+				}
+
+			status_writer_thread = (atoi(value) > 0) ? TRUE : FALSE;
+			}
+
 		else if(!strcmp(variable, "time_change_threshold")) {
 
 			time_change_threshold = atoi(value);
@@ -1066,6 +1168,27 @@ int read_main_config_file(char *main_config_file) {
 			use_large_installation_tweaks = (atoi(value) > 0) ? TRUE : FALSE;
 			}
 
+		else if(!strcmp(variable, "use_timing_wheel")) {
+
+			if(strlen(value) != 1 || value[0] < '0' || value[0] > '1') {
+				asprintf(&error_message, "Illegal value for use_timing_wheel");
+				error = TRUE;
+				break;
+				}
+
+			use_timing_wheel = (atoi(value) > 0) ? TRUE : FALSE;
+			}
+
+		else if(!strcmp(variable, "event_batch_size")) {
+
+			event_batch_size = atoi(value);
+			if(event_batch_size < 1) {
+				asprintf(&error_message, "Illegal value for event_batch_size");
+				error = TRUE;
+				break;
+				}
+			}
+
 		else if(!strcmp(variable, "enable_environment_macros"))
 			enable_environment_macros = (atoi(value) > 0) ? TRUE : FALSE;
 
@@ -1098,6 +1221,14 @@ int read_main_config_file(char *main_config_file) {
 		/* BEGIN status data variables */
 		else if(!strcmp(variable, "status_file"))
 			status_file = nspath_absolute(value, config_file_dir);
+		else if(!strcmp(variable, "status_store_file")) {
+			my_free(status_store_file);
+			status_store_file = nspath_absolute(value, config_file_dir);
+			}
+		else if(!strcmp(variable, "status_index_file")) {
+			my_free(status_index_file);
+			status_index_file = nspath_absolute(value, config_file_dir);
+			}
 		else if(strstr(input, "state_retention_file=") == input)
 			retention_file = nspath_absolute(value, config_file_dir);
 		/* END status data variables */
@@ -36,6 +36,24 @@ static timed_event *current_event;
 
 static unsigned int event_count[EVENT_USER_FUNCTION + 1];
 
+/* event_execution_loop() counters, for dump_event_stats() */
+static struct {
+	unsigned long iterations; /* passes through the main loop */
+	unsigned long batches;    /* passes that ran at least one event */
+	unsigned long events;     /* events run */
+	unsigned int last_batch;  /* events run in the most recent batch */
+	unsigned int max_batch;   /* largest batch so far */
+	} loop_stats;
+
+/*
+ * Occupancy histogram for the schedule smoothing engine: the number of
+ * queued host and service check events due in each second, indexed by
+ * run_time modulo the number of slots. Checks further out than that
+ * alias onto nearer seconds, which is fine for picking a quiet slot.
+ */
+#define CHECK_SLOTS 4096
+static unsigned int check_slots[CHECK_SLOTS];
+
 /******************************************************************/
 /************ EVENT SCHEDULING/HANDLING FUNCTIONS *****************/
 /******************************************************************/
@@ -54,6 +72,9 @@ int dump_event_stats(int sd)
 		if (i == 16)
 			i = 97;
 		}
+	nsock_printf(sd, "LOOP_ITERATIONS=%lu;LOOP_BATCHES=%lu;LOOP_EVENTS=%lu;LAST_BATCH_SIZE=%u;MAX_BATCH_SIZE=%u;EVENT_BATCH_SIZE=%d;",
+	             loop_stats.iterations, loop_stats.batches, loop_stats.events,
+	             loop_stats.last_batch, loop_stats.max_batch, event_batch_size);
 	nsock_printf_nul(sd, "SQUEUE_ENTRIES=%u", squeue_size(nagios_squeue));
 
 	return OK;
@@ -69,6 +90,141 @@ static void track_events(unsigned int type, int add)
 		event_count[type] += add;
 	}
 
+static void track_check_slot(timed_event *event, int add)
+{
+	unsigned int *slot;
+
+	if (event->event_type != EVENT_SERVICE_CHECK && event->event_type != EVENT_HOST_CHECK)
+		return;
+
+	slot = &check_slots[(unsigned long)event->run_time % CHECK_SLOTS];
+	if (add > 0)
+		(*slot)++;
+	else if (*slot > 0)
+		(*slot)--;
+	}
+
+/*
+ * Returns the second in [earliest, latest] with the fewest checks
+ * queued, picking the one closest to 'preferred' on ties.
+ */
+static time_t least_loaded_slot(time_t preferred, time_t earliest, time_t latest)
+{
+	time_t t, best = preferred;
+	unsigned int load, best_load = UINT_MAX;
+
+	if (latest - earliest >= CHECK_SLOTS)
+		latest = earliest + CHECK_SLOTS - 1;
+
+	for (t = earliest; t <= latest; t++) {
+		load = check_slots[(unsigned long)t % CHECK_SLOTS];
+		if (load < best_load || (load == best_load && labs(t - preferred) < labs(best - preferred))) {
+			best = t;
+			best_load = load;
+			}
+		}
+
+	return best;
+	}
+
+/*
+ * Moves a check due at 'check_time' by up to smooth_check_scheduling
+ * percent of 'window' (its check interval) to the least busy second,
+ * never into the past. Returns check_time if smoothing is disabled.
+ */
+time_t smooth_check_time(time_t check_time, time_t window)
+{
+	time_t jitter, earliest;
+
+	if (smooth_check_scheduling <= 0)
+		return check_time;
+
+	jitter = (window * smooth_check_scheduling) / 100;
+	if (jitter > CHECK_SLOTS / 2)
+		jitter = CHECK_SLOTS / 2;
+	if (jitter <= 0)
+		return check_time;
+
+	earliest = time(NULL);
+	if (check_time - jitter > earliest)
+		earliest = check_time - jitter;
+
+	return least_loaded_slot(check_time, earliest, check_time + jitter);
+	}
+
+/*
+ * With smoothing enabled, init_timing_loop() uses this instead of the
+ * inter-check delay and interleave calculations. Checks retained from
+ * a previous run are queued first, so the rest are spread around them
+ * over their first check interval. Checks placed here get their
+ * events right away, which is what makes the histogram see them.
+ */
+static void smooth_initial_checks(time_t current_time)
+{
+	service *temp_service;
+	host *temp_host;
+	time_t next_valid_time, window, preferred;
+
+	for (temp_service = service_list; temp_service; temp_service = temp_service->next) {
+		if (temp_service->should_be_scheduled == FALSE)
+			continue;
+		if (temp_service->next_check <= current_time || temp_service->next_check - current_time >= check_window(temp_service))
+			continue;
+		temp_service->next_check_event = schedule_new_event(EVENT_SERVICE_CHECK, FALSE, temp_service->next_check, FALSE, 0, NULL, TRUE, (void *)temp_service, NULL, temp_service->check_options);
+		}
+	for (temp_host = host_list; temp_host; temp_host = temp_host->next) {
+		if (temp_host->should_be_scheduled == FALSE || temp_host->next_check <= current_time)
+			continue;
+		temp_host->next_check_event = schedule_new_event(EVENT_HOST_CHECK, FALSE, temp_host->next_check, FALSE, 0, NULL, TRUE, (void *)temp_host, NULL, temp_host->check_options);
+		}
+
+	for (temp_service = service_list; temp_service; temp_service = temp_service->next) {
+		if (temp_service->should_be_scheduled == FALSE || temp_service->next_check_event)
+			continue;
+
+		window = check_window(temp_service);
+		if (window < 1)
+			window = 1;
+		preferred = current_time + ranged_urand(0, window);
+		temp_service->next_check = least_loaded_slot(preferred, current_time, current_time + window - 1);
+		if (check_time_against_period(temp_service->next_check, temp_service->check_period_ptr) == ERROR) {
+			get_next_valid_time(temp_service->next_check, &next_valid_time, temp_service->check_period_ptr);
+			temp_service->next_check = least_loaded_slot(next_valid_time + ranged_urand(0, window), next_valid_time, next_valid_time + window - 1);
+			}
+		log_debug_info(DEBUGL_EVENTS, 2, "Smoothed check of service '%s' on host '%s' to %s", temp_service->description, temp_service->host_name, ctime(&temp_service->next_check));
+
+		if (scheduling_info.first_service_check == (time_t)0 || (temp_service->next_check < scheduling_info.first_service_check))
+			scheduling_info.first_service_check = temp_service->next_check;
+		if (temp_service->next_check > scheduling_info.last_service_check)
+			scheduling_info.last_service_check = temp_service->next_check;
+
+		temp_service->next_check_event = schedule_new_event(EVENT_SERVICE_CHECK, FALSE, temp_service->next_check, FALSE, 0, NULL, TRUE, (void *)temp_service, NULL, temp_service->check_options);
+		}
+
+	for (temp_host = host_list; temp_host; temp_host = temp_host->next) {
+		if (temp_host->should_be_scheduled == FALSE || temp_host->next_check_event)
+			continue;
+
+		window = check_window(temp_host);
+		if (window < 1)
+			window = 1;
+		preferred = current_time + ranged_urand(0, window);
+		temp_host->next_check = least_loaded_slot(preferred, current_time, current_time + window - 1);
+		if (check_time_against_period(temp_host->next_check, temp_host->check_period_ptr) == ERROR) {
+			get_next_valid_time(temp_host->next_check, &next_valid_time, temp_host->check_period_ptr);
+			temp_host->next_check = least_loaded_slot(next_valid_time + ranged_urand(0, window), next_valid_time, next_valid_time + window - 1);
+			}
+		log_debug_info(DEBUGL_EVENTS, 2, "Smoothed check of host '%s' to %s", temp_host->name, ctime(&temp_host->next_check));
+
+		if (scheduling_info.first_host_check == (time_t)0 || (temp_host->next_check < scheduling_info.first_host_check))
+			scheduling_info.first_host_check = temp_host->next_check;
+		if (temp_host->next_check > scheduling_info.last_host_check)
+			scheduling_info.last_host_check = temp_host->next_check;
+
+		temp_host->next_check_event = schedule_new_event(EVENT_HOST_CHECK, FALSE, temp_host->next_check, FALSE, 0, NULL, TRUE, (void *)temp_host, NULL, temp_host->check_options);
+		}
+	}
+
 /* initialize the event timing loop before we start monitoring */
 void init_timing_loop(void) {
 	host *temp_host = NULL;
@@ -292,6 +448,8 @@ void init_timing_loop(void) {
 
 	scheduling_info.first_service_check = (time_t)0L;
 	scheduling_info.last_service_check = (time_t)0L;
+	scheduling_info.first_host_check = (time_t)0L;
+	scheduling_info.last_host_check = (time_t)0L;
 
 	log_debug_info(DEBUGL_EVENTS, 1, "Total scheduled services: %d\n", scheduling_info.total_scheduled_services);
 	log_debug_info(DEBUGL_EVENTS, 1, "Service Interleave factor: %d\n", scheduling_info.service_interleave_factor);
@@ -306,6 +464,10 @@ void init_timing_loop(void) {
 
 	log_debug_info(DEBUGL_EVENTS, 2, "Scheduling service checks...\n");
 
+	/* the smoothing engine places (and queues) host and service checks itself */
+	if(smooth_check_scheduling > 0)
+		smooth_initial_checks(current_time);
+
 	/* determine check times for service checks (with interleaving to minimize remote load) */
 	current_interleave_block = 0;
 	for(temp_service = service_list; temp_service != NULL && scheduling_info.service_interleave_factor > 0;) {
@@ -320,6 +482,10 @@ void init_timing_loop(void) {
 				continue;
 				}
 
+			/* skip services that were placed by the smoothing engine */
+			if(temp_service->next_check_event != NULL)
+				continue;
+
 			/*
 			 * skip services that are already scheduled for the (near)
 			 * future from retention data, but reschedule ones that
@@ -403,6 +569,10 @@ void init_timing_loop(void) {
 				continue;
 			}
 
+		/* the smoothing engine may have queued it already */
+		if(temp_service->next_check_event != NULL)
+			continue;
+
 		/* create a new service check event */
 		temp_service->next_check_event = schedule_new_event(EVENT_SERVICE_CHECK, FALSE, temp_service->next_check, FALSE, 0, NULL, TRUE, (void *)temp_service, NULL, temp_service->check_options);
 		}
@@ -415,9 +585,6 @@ void init_timing_loop(void) {
 
 	log_debug_info(DEBUGL_EVENTS, 2, "Determining host scheduling parameters...\n");
 
-	scheduling_info.first_host_check = (time_t)0L;
-	scheduling_info.last_host_check = (time_t)0L;
-
 	/* default max host check spread (in minutes) */
 	scheduling_info.max_host_check_spread = max_host_check_spread;
 
@@ -493,6 +660,10 @@ void init_timing_loop(void) {
 			continue;
 			}
 
+		/* skip hosts that were placed by the smoothing engine */
+		if(temp_host->next_check_event != NULL)
+			continue;
+
 		/* skip hosts that are already scheduled for the future (from retention data), but reschedule ones that were supposed to be checked before we started */
 		if(temp_host->next_check > current_time) {
 			log_debug_info(DEBUGL_EVENTS, 2, "Host is already scheduled to be checked in the future: %s\n", ctime(&temp_host->next_check));
@@ -552,6 +723,10 @@ void init_timing_loop(void) {
 				continue;
 			}
 
+		/* the smoothing engine may have queued it already */
+		if(temp_host->next_check_event != NULL)
+			continue;
+
 		/* schedule a new host check event */
 		temp_host->next_check_event = schedule_new_event(EVENT_HOST_CHECK, FALSE, temp_host->next_check, FALSE, 0, NULL, TRUE, (void *)temp_host, NULL, temp_host->check_options);
 		}
@@ -760,7 +935,8 @@ int init_event_queue(void)
 	if(size < 4096)
 		size = 4096;
 
-	nagios_squeue = squeue_create(size);
+	nagios_squeue = squeue_create_type(use_timing_wheel ? SQUEUE_WHEEL : SQUEUE_HEAP, size);
+	memset(check_slots, 0, sizeof(check_slots));
 	return 0;
 }
 
@@ -869,8 +1045,10 @@ void add_event(squeue_t *sq, timed_event *event) {
 			  sq, event->priority, strerror(errno));
 		}
 
-	if(sq == nagios_squeue)
+	if(sq == nagios_squeue) {
 		track_events(event->event_type, +1);
+		track_check_slot(event, +1);
+		}
 
 #ifdef USE_EVENT_BROKER
 	else {
@@ -900,8 +1078,10 @@ void remove_event(squeue_t *sq, timed_event *event) {
 		      "Error: remove_event() called for %s event with NULL sq parameter\n",
 		      EVENT_TYPE_STR(event->event_type));
 
-	if(sq == nagios_squeue)
+	if(sq == nagios_squeue) {
 		track_events(event->event_type, -1);
+		track_check_slot(event, -1);
+		}
 
 	event->sq_event = NULL; /* mark this event as unscheduled */
 
@@ -1012,6 +1192,7 @@ int event_execution_loop(void) {
 	time_t current_time = 0L;
 	time_t last_status_update = 0L;
 	int poll_time_ms;
+	unsigned int batch;
 
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "event_execution_loop() start\n");
 
@@ -1028,6 +1209,8 @@ int event_execution_loop(void) {
 		if(sigshutdown == TRUE || sigrestart == TRUE)
 			break;
 
+		loop_stats.iterations++;
+
 		/* get the current time */
 		time(&current_time);
 
@@ -1102,27 +1285,58 @@ int event_execution_loop(void) {
 		if (tv_delta_msec(&now, event_runtime) > 5)
 			continue;
 
-		/* move on if we shouldn't run this event */
-		if(should_run_event(temp_event) == FALSE)
-			continue;
-
-		/* handle the event */
-		handle_timed_event(temp_event);
-
 		/*
-		 * we must remove the entry we've peeked, or
-		 * we'll keep getting the same one over and over.
-		 * This also maintains sync with broker modules.
+		 * Run every event that was due when we got back from
+		 * polling, up to event_batch_size of them, before we go
+		 * polling again. When thousands of checks are due in the
+		 * same second, this saves us the time lookups, the poll
+		 * and the status update for each and every one of them.
 		 */
-		remove_event(nagios_squeue, temp_event);
+		for (batch = 0; batch < (unsigned int)event_batch_size;) {
 
-		/* reschedule the event if necessary */
-		if(temp_event->recurring == TRUE)
-			reschedule_event(nagios_squeue, temp_event);
+			/* move on if we shouldn't run this event */
+			if(should_run_event(temp_event) == FALSE)
+				break;
 
-		/* else free memory associated with the event */
-		else
-			my_free(temp_event);
+			/* handle the event */
+			handle_timed_event(temp_event);
+
+			/*
+			 * we must remove the entry we've peeked, or
+			 * we'll keep getting the same one over and over.
+			 * This also maintains sync with broker modules.
+			 */
+			remove_event(nagios_squeue, temp_event);
+
+			/* reschedule the event if necessary */
+			if(temp_event->recurring == TRUE)
+				reschedule_event(nagios_squeue, temp_event);
+
+			/* else free memory associated with the event */
+			else
+				my_free(temp_event);
+
+			batch++;
+
+			/* the event we just ran may have asked us to stop */
+			if(sigshutdown == TRUE || sigrestart == TRUE)
+				break;
+
+			current_event = temp_event = (timed_event *)squeue_peek(nagios_squeue);
+			if(!temp_event)
+				break;
+			if(tv_delta_msec(&now, squeue_event_runtime(temp_event->sq_event)) > 5)
+				break;
+			}
+
+		if(batch) {
+			log_debug_info(DEBUGL_EVENTS, 2, "Ran %u events in one batch\n", batch);
+			loop_stats.batches++;
+			loop_stats.events += batch;
+			loop_stats.last_batch = batch;
+			if(batch > loop_stats.max_batch)
+				loop_stats.max_batch = batch;
+			}
 	}
 
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "event_execution_loop() end\n");
@@ -1334,41 +1548,79 @@ int handle_timed_event(timed_event *event) {
 
 
 
-/* The squeue internal event type, declared again here so we can manipulate the
- * scheduling queue without a malloc/free for each add/remove.
- * @todo: Refactor this to not depend so heavily on the event queue
- * implementation, doing so efficiently may require a different scheduling queue
- * data structure. */
-struct squeue_event {
-	unsigned int pos;
-	pqueue_pri_t pri;
-	struct timeval when;
-	void *data;
+/* State shared between adjust_check_scheduling() and its squeue walker. */
+struct adjust_check_scheduling_ctx {
+	time_t first_window_time;
+	struct squeue_event **events_to_reschedule;
+	struct timeval last_check_tv;
+	double threshold_msec;
+	int total_checks;
+	int adjust_scheduling;
 	};
 
+static int adjust_check_scheduling_walker(squeue_event *sq_event, void *arg) {
+	struct adjust_check_scheduling_ctx *ctx = (struct adjust_check_scheduling_ctx *)arg;
+	const struct timeval *when = squeue_event_runtime(sq_event);
+	timed_event *temp_event;
+	service *temp_service = NULL;
+	host *temp_host = NULL;
+
+	/* We need a timed_event and event data. */
+	temp_event = squeue_event_data(sq_event);
+	if (!temp_event || !temp_event->event_data)
+		return 0;
+
+	/* Skip events before our current window. */
+	if (temp_event->run_time < ctx->first_window_time)
+		return 0;
+
+	switch (temp_event->event_type) {
+		case EVENT_HOST_CHECK:
+			temp_host = temp_event->event_data;
+			/* Leave forced checks. */
+			if (temp_host->check_options & CHECK_OPTION_FORCE_EXECUTION)
+				return 0;
+			break;
+
+		case EVENT_SERVICE_CHECK:
+			temp_service = temp_event->event_data;
+			/* Leave forced checks. */
+			if (temp_service->check_options & CHECK_OPTION_FORCE_EXECUTION)
+				return 0;
+			break;
+
+		default:
+			return 0;
+		}
+
+	/* Reschedule if the last check overlap into this one. */
+	if (ctx->last_check_tv.tv_sec > 0 && tv_delta_msec(&ctx->last_check_tv, when) < ctx->threshold_msec) {
+/*		log_debug_info(DEBUGL_SCHEDULING, 2, "Rescheduling event %d: %.3fs delay.\n", ctx->total_checks, tv_delta_f(&ctx->last_check_tv, when));
+*/		ctx->adjust_scheduling = TRUE;
+		}
+
+	ctx->last_check_tv = *when;
+	ctx->events_to_reschedule[ctx->total_checks++] = sq_event;
+	return 0;
+	}
+
 /*
  * Adjusts scheduling of active, non-forced host and service checks.
  */
 void adjust_check_scheduling(void) {
-	pqueue_t *temp_pqueue; /* squeue_t is a typedef of pqueue_t. */
+	struct adjust_check_scheduling_ctx ctx;
 	struct squeue_event *sq_event;
-	struct squeue_event **events_to_reschedule;
 
 	timed_event *temp_event;
 	service *temp_service = NULL;
 	host *temp_host = NULL;
 
-	const double INTER_CHECK_RESCHEDULE_THRESHOLD = scheduling_info.service_inter_check_delay * 0.25;
 	double inter_check_delay = 0.0;
 	double new_run_time_offset = 0.0;
 
 	time_t first_window_time;
 	time_t last_window_time;
 
-	struct timeval last_check_tv = { (time_t)0, (suseconds_t)0 };
-
-	int adjust_scheduling = FALSE;
-	int total_checks = 0;
 	int i;
 
 
@@ -1380,123 +1632,56 @@ void adjust_check_scheduling(void) {
 	last_window_time = first_window_time + auto_rescheduling_window;
 
 	/* Nothing to do if the first event is after the reschedule window. */
-	sq_event = pqueue_peek(nagios_squeue);
-	temp_event = sq_event ? sq_event->data : NULL;
+	temp_event = squeue_peek(nagios_squeue);
 	if (!temp_event || temp_event->run_time > last_window_time)
 		return;
 
 
-	/* Get a sorted array of all check events to reschedule. First we need a
-	 * duplicate of nagios_squeue so we can get the events in-order without
-	 * having to remove them from the original queue. We will use
-	 * pqueue_change_priority() to move the check events in the original queue.
-	 * @note: This is horribly dependent on implementation details of squeue
-	 * and pqueue, but we don't have much choice to avoid a free/malloc of each
-	 * squeue_event from the head to last_window_time, or avoid paying the full
-	 * O(n lg n) penalty twice to drain and rebuild the queue. */
-	temp_pqueue = malloc(sizeof(*temp_pqueue));
-	if (!temp_pqueue) {
-		logit(NSLOG_RUNTIME_ERROR, TRUE, "Failed to allocate queue needed to adjust check scheduling.\n");
-		return;
-		}
-	*temp_pqueue = *nagios_squeue;
-
-	/* We need a separate copy of the underlying queue array. */
-	temp_pqueue->d = malloc(temp_pqueue->size * sizeof(void*));
-	if (!temp_pqueue->d) {
-		logit(NSLOG_RUNTIME_ERROR, TRUE, "Failed to allocate queue data needed to adjust check scheduling.\n");
-		free(temp_pqueue);
-		return;
-		}
-	memcpy(temp_pqueue->d, nagios_squeue->d, temp_pqueue->size * sizeof(void*));
-	temp_pqueue->avail = temp_pqueue->size;
-
 	/* Now allocate space for a sorted array of check events. We shouldn't need
 	 * space for all events, but we can't really calculate how many we'll need
 	 * without looking at all events. */
-	events_to_reschedule = malloc((temp_pqueue->size - 1) * sizeof(void*));
-	if (!events_to_reschedule) {
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.first_window_time = first_window_time;
+	ctx.threshold_msec = scheduling_info.service_inter_check_delay * 0.25 * 1000;
+	ctx.events_to_reschedule = malloc(squeue_size(nagios_squeue) * sizeof(void*));
+	if (!ctx.events_to_reschedule) {
 		logit(NSLOG_RUNTIME_ERROR, TRUE, "Failed to allocate memory needed to adjust check scheduling.\n");
-		pqueue_free(temp_pqueue); /* pqueue_free() to keep the events. */
 		return;
 		}
 
-	/* Now we get the events to reschedule and collect some scheduling info. */
-	while ((sq_event = pqueue_pop(temp_pqueue))) {
-
-		/* We need a timed_event and event data. */
-		temp_event = sq_event->data;
-		if (!temp_event || !temp_event->event_data)
-			continue;
-
-		/* Skip events before our current window. */
-		if (temp_event->run_time < first_window_time)
-			continue;
-		/* We're done once past the end of the window. */
-		if (temp_event->run_time > last_window_time)
-			break;
-
-		switch (temp_event->event_type) {
-			case EVENT_HOST_CHECK:
-				temp_host = temp_event->event_data;
-				/* Leave forced checks. */
-				if (temp_host->check_options & CHECK_OPTION_FORCE_EXECUTION)
-					continue;
-				break;
-
-			case EVENT_SERVICE_CHECK:
-				temp_service = temp_event->event_data;
-				/* Leave forced checks. */
-				if (temp_service->check_options & CHECK_OPTION_FORCE_EXECUTION)
-					continue;
-				break;
-
-			default:
-				continue;
-			}
-
-		/* Reschedule if the last check overlap into this one. */
-		if (last_check_tv.tv_sec > 0 && tv_delta_msec(&last_check_tv, &sq_event->when) < INTER_CHECK_RESCHEDULE_THRESHOLD * 1000) {
-/*			log_debug_info(DEBUGL_SCHEDULING, 2, "Rescheduling event %d: %.3fs delay.\n", total_checks, tv_delta_f(&last_check_tv, &sq_event->when));
-*/			adjust_scheduling = TRUE;
-			}
-
-		last_check_tv = sq_event->when;
-		events_to_reschedule[total_checks++] = sq_event;
-		}
-
-	/* Removing squeue_events from temp_pqueue invalidates the positions of
-	 * those events in nagios_squeue, so we need to fix that up before we
-	 * return or change their priorities. Start at i=1 since i=0 is unused. */
-	for (i = 1; i < (int)nagios_squeue->size; ++i) {
-		if ((sq_event = nagios_squeue->d[i]))
-			sq_event->pos = i;
+	/* Get a sorted array of all check events to reschedule, and collect some
+	 * scheduling info. We use squeue_change_priority_tv() to move the check
+	 * events afterwards, which avoids a free/malloc of each squeue_event from
+	 * the head to last_window_time. */
+	if (squeue_walk(nagios_squeue, last_window_time, adjust_check_scheduling_walker, &ctx) < 0) {
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "Failed to walk the event queue to adjust check scheduling.\n");
+		free(ctx.events_to_reschedule);
+		return;
 		}
 
 	/* No checks to reschedule, nothing to do... */
-	if (total_checks < 2 || !adjust_scheduling) {
-		log_debug_info(DEBUGL_SCHEDULING, 0, "No events need to be rescheduled (%d checks in %ds window).\n", total_checks, auto_rescheduling_window);
+	if (ctx.total_checks < 2 || !ctx.adjust_scheduling) {
+		log_debug_info(DEBUGL_SCHEDULING, 0, "No events need to be rescheduled (%d checks in %ds window).\n", ctx.total_checks, auto_rescheduling_window);
 
-		pqueue_free(temp_pqueue);
-		free(events_to_reschedule);
+		free(ctx.events_to_reschedule);
 		return;
 		}
 
 
-	inter_check_delay = auto_rescheduling_window / (double)total_checks;
+	inter_check_delay = auto_rescheduling_window / (double)ctx.total_checks;
 
-	log_debug_info(DEBUGL_SCHEDULING, 0, "Rescheduling events: %d checks in %ds window, ICD: %.3fs.\n", total_checks, auto_rescheduling_window, inter_check_delay);
+	log_debug_info(DEBUGL_SCHEDULING, 0, "Rescheduling events: %d checks in %ds window, ICD: %.3fs.\n", ctx.total_checks, auto_rescheduling_window, inter_check_delay);
 
 
 	/* Now smooth out the schedule. */
 	new_run_time_offset = inter_check_delay * 0.5;
-	for (i = 0; i < total_checks; ++i, new_run_time_offset += inter_check_delay) {
+	for (i = 0; i < ctx.total_checks; ++i, new_run_time_offset += inter_check_delay) {
 		struct timeval new_run_time;
 
 		/* All events_to_reschedule are valid squeue_events with data pointers
 		 * to timed_events for non-forced host or service checks. */
-		sq_event = events_to_reschedule[i];
-		temp_event = sq_event->data;
+		sq_event = ctx.events_to_reschedule[i];
+		temp_event = squeue_event_data(sq_event);
 
 		/* Calculate and apply a new queue 'when' time. */
 		new_run_time.tv_sec = first_window_time + (time_t)floor(new_run_time_offset);
@@ -1507,8 +1692,11 @@ void adjust_check_scheduling(void) {
 		squeue_change_priority_tv(nagios_squeue, sq_event, &new_run_time);
 
 
-		if (temp_event->run_time != new_run_time.tv_sec)
+		if (temp_event->run_time != new_run_time.tv_sec) {
+			track_check_slot(temp_event, -1);
 			temp_event->run_time = new_run_time.tv_sec;
+			track_check_slot(temp_event, +1);
+			}
 
 		switch (temp_event->event_type) {
 			case EVENT_HOST_CHECK:
@@ -1533,8 +1721,7 @@ void adjust_check_scheduling(void) {
 
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "adjust_check_scheduling() end\n");
 
-	pqueue_free(temp_pqueue);
-	free(events_to_reschedule);
+	free(ctx.events_to_reschedule);
 	return;
 	}
 
@@ -1547,7 +1734,8 @@ static void adjust_squeue_for_time_change(squeue_t **q, int delta) {
 	 * but it should be pretty rare that we have to adjust times
 	 * so we go with the well-tested codepath.
 	 */
-	sq_new = squeue_create(squeue_size(*q));
+	sq_new = squeue_create_type(squeue_type(*q), squeue_size(*q));
+	memset(check_slots, 0, sizeof(check_slots));
 	while ((event = squeue_pop(*q))) {
 		if (event->compensate_for_time_change == TRUE) {
 			if (event->timing_func) {
@@ -1565,6 +1753,7 @@ static void adjust_squeue_for_time_change(squeue_t **q, int delta) {
 		else {
 			event->sq_event = squeue_add(sq_new, event->run_time, event);
 			}
+		track_check_slot(event, +1);
 		}
 	squeue_destroy(*q, 0);
 	*q = sq_new;
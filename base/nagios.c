@@ -94,8 +94,14 @@ static void set_loadctl_defaults(void)
 		loadctl.backoff_change = loadctl.jobs_limit * 0.3;
 	if (!loadctl.rampup_change)
 		loadctl.rampup_change = loadctl.backoff_change * 0.25;
+	if (!loadctl.backoff_factor)
+		loadctl.backoff_factor = 0.7;
+	if (!loadctl.psi_limit)
+		loadctl.psi_limit = 20.0;
+	if (!loadctl.latency_limit)
+		loadctl.latency_limit = 1.0;
 	if (!loadctl.check_interval)
-		loadctl.check_interval = 60;
+		loadctl.check_interval = 10;
 	if (!loadctl.jobs_min)
 		loadctl.jobs_min = online_cpus() * 20; /* pessimistic */
 }
@@ -147,7 +153,7 @@ static int test_path_access(const char *program, int mode)
 
 static int nagios_core_worker(const char *path)
 {
-	int sd, ret;
+	int sd, ret, len;
 	char response[128];
 
 	is_worker = 1;
@@ -161,20 +167,29 @@ static int nagios_core_worker(const char *path)
 		return 1;
 	}
 
-	ret = nsock_printf_nul(sd, "@wproc register name=Core Worker %ld;pid=%ld", (long)getpid(), (long)getpid());
+	ret = nsock_printf_nul(sd, "@wproc register name=Core Worker %ld;pid=%ld;protocol=binary", (long)getpid(), (long)getpid());
 	if (ret < 0) {
 		printf("Failed to register as worker.\n");
 		return 1;
 	}
 
-	ret = read(sd, response, 3);
-	if (ret != 3) {
-		printf("Failed to read response from wproc manager\n");
-		return 1;
+	/*
+	 * jobs may follow the response right away, so we can't read
+	 * more than the nul-terminated response itself
+	 */
+	for (len = 0; len < sizeof(response) - 1; len++) {
+		if (read(sd, response + len, 1) != 1) {
+			printf("Failed to read response from wproc manager\n");
+			return 1;
+		}
+		if (!response[len])
+			break;
+	}
+	response[len] = 0;
+	if (!strcmp(response, "OK protocol=binary")) {
+		worker_set_protocol(WORKER_PROTO_BINARY);
 	}
-	if (memcmp(response, "OK", 3)) {
-		read(sd, response + 3, sizeof(response) - 4);
-		response[sizeof(response) - 2] = 0;
+	else if (strcmp(response, "OK")) {
 		printf("Failed to register with wproc manager: %s\n", response);
 		return 1;
 	}
@@ -244,6 +259,7 @@ int main(int argc, char **argv) {
 			{"use-precached-objects", no_argument, 0, 'u'},
 			{"enable-timing-point", no_argument, 0, 'T'},
 			{"worker", required_argument, 0, 'W'},
+			{"posix-spawn", no_argument, 0, 'P'},
 			{0, 0, 0, 0}
 		};
 #define getopt(argc, argv, o) getopt_long(argc, argv, o, long_options, &option_index)
@@ -299,6 +315,10 @@ int main(int argc, char **argv) {
 			case 'W':
 				worker_socket = optarg;
 				break;
+			case 'P':
+				/* workers without posix_spawn() just keep using fork() */
+				runcmd_set_spawn_method(RUNCMD_SPAWN_POSIX);
+				break;
 
 			case 'x':
 				printf("Warning: -x is deprecated and will be removed\n");
@@ -368,6 +388,7 @@ int main(int argc, char **argv) {
 		printf("  -u, --use-precached-objects  Use precached object config file\n");
 		printf("  -d, --daemon                 Starts Nagios in daemon mode, instead of as a foreground process\n");
 		printf("  -W, --worker /path/to/socket Act as a worker for an already running daemon\n");
+		printf("  --posix-spawn                Make the worker start plugins with posix_spawn()\n");
 		printf("\n");
 		printf("Visit the Nagios website at https://www.nagios.org/ for bug fixes, new\n");
 		printf("releases, online documentation, FAQs, information on subscribing to\n");
@@ -665,6 +686,7 @@ int main(int argc, char **argv) {
 			timing_point("Query handler initialized\n");
 			nerd_init();
 			timing_point("NERD initialized\n");
+			init_check_timings();
 
 			/* initialize check workers */
 			if(init_workers(num_check_workers) < 0) {
@@ -746,11 +768,15 @@ int main(int argc, char **argv) {
 			broker_program_state(NEBTYPE_PROCESS_START, NEBFLAG_NONE, NEBATTR_NONE, NULL);
 #endif
 
-			/* initialize status data unless we're starting */
+			/* initialize status data unless we're restarting */
 			if(sigrestart == FALSE) {
 				initialize_status_data(config_file);
 				timing_point("Status data initialized\n");
 				}
+			else {
+				reload_status_data();
+				timing_point("Status data reloaded\n");
+				}
 
 			/* initialize scheduled downtime data */
 			initialize_downtime_data();
@@ -762,6 +788,10 @@ int main(int argc, char **argv) {
 			read_initial_state_information();
 			timing_point("Initial state information read\n");
 
+			/* the reachability cache and dependency index need the retained states */
+			init_host_reachability();
+			init_dependency_index();
+
 			/* initialize comment data */
 			initialize_comment_data();
 			timing_point("Comment data initialized\n");
@@ -798,6 +828,9 @@ int main(int argc, char **argv) {
 			launch_command_file_worker();
 			timing_point("Command file worker launched\n");
 
+			/* watch the check result queue for new results */
+			init_check_result_spool();
+
 #ifdef USE_EVENT_BROKER
 			/* send program data to broker */
 			broker_program_state(NEBTYPE_PROCESS_EVENTLOOPSTART, NEBFLAG_NONE, NEBATTR_NONE, NULL);
@@ -819,6 +852,9 @@ int main(int argc, char **argv) {
 			 */
 			qh_deinit(qh_socket_path ? qh_socket_path : DEFAULT_QUERY_SOCKET);
 
+			/* check_result_path may change if we're restarting */
+			deinit_check_result_spool();
+
 			/* 03/01/2007 EG Moved from sighandler() to prevent FUTEX locking problems under NPTL */
 			/* 03/21/2007 EG SIGSEGV signals are still logged in sighandler() so we don't loose them */
 			/* did we catch a signal? */
@@ -854,6 +890,12 @@ int main(int argc, char **argv) {
 				}
 
 			free_worker_memory(WPROC_FORCE);
+			deinit_check_timings();
+			free_host_reachability();
+			free_dependency_index();
+			free_check_waiters();
+			free_freshness_deadlines();
+			free_orphan_deadlines();
 			/* shutdown stuff... */
 			if(sigshutdown == TRUE) {
 				iobroker_destroy(nagios_iobs, IOBROKER_CLOSE_SOCKETS);
@@ -27,6 +27,7 @@
 #include "../include/common.h"
 #include "../include/nagios.h"
 #include "../include/locations.h"
+#include "../xdata/xsddefault.h"
 
 #define STATUS_NO_DATA             0
 #define STATUS_INFO_DATA           1
@@ -37,6 +38,7 @@
 
 static char *main_config_file = NULL;
 char *status_file = NULL;
+char *status_store_file = NULL;
 static char *mrtg_variables = NULL;
 static const char *mrtg_delimiter = "\n";
 
@@ -194,6 +196,7 @@ static int display_mrtg_values(void);
 static int display_stats(void);
 static int read_config_file(void);
 static int read_status_file(void);
+static int read_status_store(void);
 
 
 int main(int argc, char **argv) {
@@ -390,8 +393,9 @@ int main(int argc, char **argv) {
 			}
 		}
 
-	/* read status file */
-	result = read_status_file();
+	/* read the status store if there is one, or else the status file */
+	if(status_store_file == NULL || (result = read_status_store()) == ERROR)
+		result = read_status_file();
 	if(result == ERROR && mrtg_mode == FALSE) {
 		printf("Error reading status file '%s': %s\n", status_file, strerror(errno));
 		return ERROR;
@@ -861,6 +865,11 @@ static int read_config_file(void) {
 				free(status_file);
 			status_file = nspath_absolute(val, main_cfg_dir);
 			}
+		else if(!strcmp(var, "status_store_file")) {
+			if(status_store_file)
+				free(status_store_file);
+			status_store_file = nspath_absolute(val, main_cfg_dir);
+			}
 
 		}
 
@@ -870,6 +879,236 @@ static int read_config_file(void) {
 	}
 
 
+/* totals up the active check stats, once they've all been read */
+static void sum_check_stats(void) {
+
+	/* 02-15-2008 exclude cached host checks from total (they were ondemand checks that never actually executed) */
+	active_host_checks_last_1min = active_scheduled_host_checks_last_1min + active_ondemand_host_checks_last_1min;
+	active_host_checks_last_5min = active_scheduled_host_checks_last_5min + active_ondemand_host_checks_last_5min;
+	active_host_checks_last_15min = active_scheduled_host_checks_last_15min + active_ondemand_host_checks_last_15min;
+
+	/* 02-15-2008 exclude cached service checks from total (they were ondemand checks that never actually executed) */
+	active_service_checks_last_1min = active_scheduled_service_checks_last_1min + active_ondemand_service_checks_last_1min;
+	active_service_checks_last_5min = active_scheduled_service_checks_last_5min + active_ondemand_service_checks_last_5min;
+	active_service_checks_last_15min = active_scheduled_service_checks_last_15min + active_ondemand_service_checks_last_15min;
+	}
+
+
+/* adds one host's status to the host stats */
+static void add_host_stats(time_t current_time, double execution_time, double latency, int check_type, int current_state, double state_change, int is_flapping, int downtime_depth, time_t last_check, int should_be_scheduled, int has_been_checked) {
+	unsigned long time_difference;
+
+	average_host_state_change = (((average_host_state_change * ((double)status_host_entries - 1.0)) + state_change) / (double)status_host_entries);
+	if(have_min_host_state_change == FALSE || min_host_state_change > state_change) {
+		have_min_host_state_change = TRUE;
+		min_host_state_change = state_change;
+		}
+	if(have_max_host_state_change == FALSE || max_host_state_change < state_change) {
+		have_max_host_state_change = TRUE;
+		max_host_state_change = state_change;
+		}
+	if(check_type == CHECK_TYPE_ACTIVE) {
+		active_host_checks++;
+		average_active_host_latency = (((average_active_host_latency * ((double)active_host_checks - 1.0)) + latency) / (double)active_host_checks);
+		if(have_min_active_host_latency == FALSE || min_active_host_latency > latency) {
+			have_min_active_host_latency = TRUE;
+			min_active_host_latency = latency;
+			}
+		if(have_max_active_host_latency == FALSE || max_active_host_latency < latency) {
+			have_max_active_host_latency = TRUE;
+			max_active_host_latency = latency;
+			}
+		average_active_host_execution_time = (((average_active_host_execution_time * ((double)active_host_checks - 1.0)) + execution_time) / (double)active_host_checks);
+		if(have_min_active_host_execution_time == FALSE || min_active_host_execution_time > execution_time) {
+			have_min_active_host_execution_time = TRUE;
+			min_active_host_execution_time = execution_time;
+			}
+		if(have_max_active_host_execution_time == FALSE || max_active_host_execution_time < execution_time) {
+			have_max_active_host_execution_time = TRUE;
+			max_active_host_execution_time = execution_time;
+			}
+		average_active_host_state_change = (((average_active_host_state_change * ((double)active_host_checks - 1.0)) + state_change) / (double)active_host_checks);
+		if(have_min_active_host_state_change == FALSE || min_active_host_state_change > state_change) {
+			have_min_active_host_state_change = TRUE;
+			min_active_host_state_change = state_change;
+			}
+		if(have_max_active_host_state_change == FALSE || max_active_host_state_change < state_change) {
+			have_max_active_host_state_change = TRUE;
+			max_active_host_state_change = state_change;
+			}
+		time_difference = current_time - last_check;
+		if(time_difference <= 3600)
+			active_hosts_checked_last_1hour++;
+		if(time_difference <= 900)
+			active_hosts_checked_last_15min++;
+		if(time_difference <= 300)
+			active_hosts_checked_last_5min++;
+		if(time_difference <= 60)
+			active_hosts_checked_last_1min++;
+		}
+	else {
+		passive_host_checks++;
+		average_passive_host_latency = (((average_passive_host_latency * ((double)passive_host_checks - 1.0)) + latency) / (double)passive_host_checks);
+		if(have_min_passive_host_latency == FALSE || min_passive_host_latency > latency) {
+			have_min_passive_host_latency = TRUE;
+			min_passive_host_latency = latency;
+			}
+		if(have_max_passive_host_latency == FALSE || max_passive_host_latency < latency) {
+			have_max_passive_host_latency = TRUE;
+			max_passive_host_latency = latency;
+			}
+		average_passive_host_state_change = (((average_passive_host_state_change * ((double)passive_host_checks - 1.0)) + state_change) / (double)passive_host_checks);
+		if(have_min_passive_host_state_change == FALSE || min_passive_host_state_change > state_change) {
+			have_min_passive_host_state_change = TRUE;
+			min_passive_host_state_change = state_change;
+			}
+		if(have_max_passive_host_state_change == FALSE || max_passive_host_state_change < state_change) {
+			have_max_passive_host_state_change = TRUE;
+			max_passive_host_state_change = state_change;
+			}
+		time_difference = current_time - last_check;
+		if(time_difference <= 3600)
+			passive_hosts_checked_last_1hour++;
+		if(time_difference <= 900)
+			passive_hosts_checked_last_15min++;
+		if(time_difference <= 300)
+			passive_hosts_checked_last_5min++;
+		if(time_difference <= 60)
+			passive_hosts_checked_last_1min++;
+		}
+	switch(current_state) {
+		case HOST_UP:
+			hosts_up++;
+			break;
+		case HOST_DOWN:
+			hosts_down++;
+			break;
+		case HOST_UNREACHABLE:
+			hosts_unreachable++;
+			break;
+		default:
+			break;
+		}
+	if(is_flapping == TRUE)
+		hosts_flapping++;
+	if(downtime_depth > 0)
+		hosts_in_downtime++;
+	if(has_been_checked == TRUE)
+		hosts_checked++;
+	if(should_be_scheduled == TRUE)
+		hosts_scheduled++;
+	}
+
+
+/* adds one service's status to the service stats */
+static void add_service_stats(time_t current_time, double execution_time, double latency, int check_type, int current_state, double state_change, int is_flapping, int downtime_depth, time_t last_check, int should_be_scheduled, int has_been_checked) {
+	unsigned long time_difference;
+
+	average_service_state_change = (((average_service_state_change * ((double)status_service_entries - 1.0)) + state_change) / (double)status_service_entries);
+	if(have_min_service_state_change == FALSE || min_service_state_change > state_change) {
+		have_min_service_state_change = TRUE;
+		min_service_state_change = state_change;
+		}
+	if(have_max_service_state_change == FALSE || max_service_state_change < state_change) {
+		have_max_service_state_change = TRUE;
+		max_service_state_change = state_change;
+		}
+	if(check_type == CHECK_TYPE_ACTIVE) {
+		active_service_checks++;
+		average_active_service_latency = (((average_active_service_latency * ((double)active_service_checks - 1.0)) + latency) / (double)active_service_checks);
+		if(have_min_active_service_latency == FALSE || min_active_service_latency > latency) {
+			have_min_active_service_latency = TRUE;
+			min_active_service_latency = latency;
+			}
+		if(have_max_active_service_latency == FALSE || max_active_service_latency < latency) {
+			have_max_active_service_latency = TRUE;
+			max_active_service_latency = latency;
+			}
+		average_active_service_execution_time = (((average_active_service_execution_time * ((double)active_service_checks - 1.0)) + execution_time) / (double)active_service_checks);
+		if(have_min_active_service_execution_time == FALSE || min_active_service_execution_time > execution_time) {
+			have_min_active_service_execution_time = TRUE;
+			min_active_service_execution_time = execution_time;
+			}
+		if(have_max_active_service_execution_time == FALSE || max_active_service_execution_time < execution_time) {
+			have_max_active_service_execution_time = TRUE;
+			max_active_service_execution_time = execution_time;
+			}
+		average_active_service_state_change = (((average_active_service_state_change * ((double)active_service_checks - 1.0)) + state_change) / (double)active_service_checks);
+		if(have_min_active_service_state_change == FALSE || min_active_service_state_change > state_change) {
+			have_min_active_service_state_change = TRUE;
+			min_active_service_state_change = state_change;
+			}
+		if(have_max_active_service_state_change == FALSE || max_active_service_state_change < state_change) {
+			have_max_active_service_state_change = TRUE;
+			max_active_service_state_change = state_change;
+			}
+		time_difference = current_time - last_check;
+		if(time_difference <= 3600)
+			active_services_checked_last_1hour++;
+		if(time_difference <= 900)
+			active_services_checked_last_15min++;
+		if(time_difference <= 300)
+			active_services_checked_last_5min++;
+		if(time_difference <= 60)
+			active_services_checked_last_1min++;
+		}
+	else {
+		passive_service_checks++;
+		average_passive_service_latency = (((average_passive_service_latency * ((double)passive_service_checks - 1.0)) + latency) / (double)passive_service_checks);
+		if(have_min_passive_service_latency == FALSE || min_passive_service_latency > latency) {
+			have_min_passive_service_latency = TRUE;
+			min_passive_service_latency = latency;
+			}
+		if(have_max_passive_service_latency == FALSE || max_passive_service_latency < latency) {
+			have_max_passive_service_latency = TRUE;
+			max_passive_service_latency = latency;
+			}
+		average_passive_service_state_change = (((average_passive_service_state_change * ((double)passive_service_checks - 1.0)) + state_change) / (double)passive_service_checks);
+		if(have_min_passive_service_state_change == FALSE || min_passive_service_state_change > state_change) {
+			have_min_passive_service_state_change = TRUE;
+			min_passive_service_state_change = state_change;
+			}
+		if(have_max_passive_service_state_change == FALSE || max_passive_service_state_change < state_change) {
+			have_max_passive_service_state_change = TRUE;
+			max_passive_service_state_change = state_change;
+			}
+		time_difference = current_time - last_check;
+		if(time_difference <= 3600)
+			passive_services_checked_last_1hour++;
+		if(time_difference <= 900)
+			passive_services_checked_last_15min++;
+		if(time_difference <= 300)
+			passive_services_checked_last_5min++;
+		if(time_difference <= 60)
+			passive_services_checked_last_1min++;
+		}
+	switch(current_state) {
+		case STATE_OK:
+			services_ok++;
+			break;
+		case STATE_WARNING:
+			services_warning++;
+			break;
+		case STATE_UNKNOWN:
+			services_unknown++;
+			break;
+		case STATE_CRITICAL:
+			services_critical++;
+			break;
+		default:
+			break;
+		}
+	if(is_flapping == TRUE)
+		services_flapping++;
+	if(downtime_depth > 0)
+		services_in_downtime++;
+	if(has_been_checked == TRUE)
+		services_checked++;
+	if(should_be_scheduled == TRUE)
+		services_scheduled++;
+	}
+
+
 static int read_status_file(void) {
 	char temp_buffer[MAX_INPUT_BUFFER];
 	FILE *fp = NULL;
@@ -878,7 +1117,6 @@ static int read_status_file(void) {
 	char *val = NULL;
 	char *temp_ptr = NULL;
 	time_t current_time;
-	unsigned long time_difference = 0L;
 
 	double execution_time = 0.0;
 	double latency = 0.0;
@@ -931,222 +1169,15 @@ static int read_status_file(void) {
 					break;
 
 				case STATUS_PROGRAM_DATA:
-					/* 02-15-2008 exclude cached host checks from total (they were ondemand checks that never actually executed) */
-					active_host_checks_last_1min = active_scheduled_host_checks_last_1min + active_ondemand_host_checks_last_1min;
-					active_host_checks_last_5min = active_scheduled_host_checks_last_5min + active_ondemand_host_checks_last_5min;
-					active_host_checks_last_15min = active_scheduled_host_checks_last_15min + active_ondemand_host_checks_last_15min;
-
-					/* 02-15-2008 exclude cached service checks from total (they were ondemand checks that never actually executed) */
-					active_service_checks_last_1min = active_scheduled_service_checks_last_1min + active_ondemand_service_checks_last_1min;
-					active_service_checks_last_5min = active_scheduled_service_checks_last_5min + active_ondemand_service_checks_last_5min;
-					active_service_checks_last_15min = active_scheduled_service_checks_last_15min + active_ondemand_service_checks_last_15min;
+					sum_check_stats();
 					break;
 
 				case STATUS_HOST_DATA:
-					average_host_state_change = (((average_host_state_change * ((double)status_host_entries - 1.0)) + state_change) / (double)status_host_entries);
-					if(have_min_host_state_change == FALSE || min_host_state_change > state_change) {
-						have_min_host_state_change = TRUE;
-						min_host_state_change = state_change;
-						}
-					if(have_max_host_state_change == FALSE || max_host_state_change < state_change) {
-						have_max_host_state_change = TRUE;
-						max_host_state_change = state_change;
-						}
-					if(check_type == CHECK_TYPE_ACTIVE) {
-						active_host_checks++;
-						average_active_host_latency = (((average_active_host_latency * ((double)active_host_checks - 1.0)) + latency) / (double)active_host_checks);
-						if(have_min_active_host_latency == FALSE || min_active_host_latency > latency) {
-							have_min_active_host_latency = TRUE;
-							min_active_host_latency = latency;
-							}
-						if(have_max_active_host_latency == FALSE || max_active_host_latency < latency) {
-							have_max_active_host_latency = TRUE;
-							max_active_host_latency = latency;
-							}
-						average_active_host_execution_time = (((average_active_host_execution_time * ((double)active_host_checks - 1.0)) + execution_time) / (double)active_host_checks);
-						if(have_min_active_host_execution_time == FALSE || min_active_host_execution_time > execution_time) {
-							have_min_active_host_execution_time = TRUE;
-							min_active_host_execution_time = execution_time;
-							}
-						if(have_max_active_host_execution_time == FALSE || max_active_host_execution_time < execution_time) {
-							have_max_active_host_execution_time = TRUE;
-							max_active_host_execution_time = execution_time;
-							}
-						average_active_host_state_change = (((average_active_host_state_change * ((double)active_host_checks - 1.0)) + state_change) / (double)active_host_checks);
-						if(have_min_active_host_state_change == FALSE || min_active_host_state_change > state_change) {
-							have_min_active_host_state_change = TRUE;
-							min_active_host_state_change = state_change;
-							}
-						if(have_max_active_host_state_change == FALSE || max_active_host_state_change < state_change) {
-							have_max_active_host_state_change = TRUE;
-							max_active_host_state_change = state_change;
-							}
-						time_difference = current_time - last_check;
-						if(time_difference <= 3600)
-							active_hosts_checked_last_1hour++;
-						if(time_difference <= 900)
-							active_hosts_checked_last_15min++;
-						if(time_difference <= 300)
-							active_hosts_checked_last_5min++;
-						if(time_difference <= 60)
-							active_hosts_checked_last_1min++;
-						}
-					else {
-						passive_host_checks++;
-						average_passive_host_latency = (((average_passive_host_latency * ((double)passive_host_checks - 1.0)) + latency) / (double)passive_host_checks);
-						if(have_min_passive_host_latency == FALSE || min_passive_host_latency > latency) {
-							have_min_passive_host_latency = TRUE;
-							min_passive_host_latency = latency;
-							}
-						if(have_max_passive_host_latency == FALSE || max_passive_host_latency < latency) {
-							have_max_passive_host_latency = TRUE;
-							max_passive_host_latency = latency;
-							}
-						average_passive_host_state_change = (((average_passive_host_state_change * ((double)passive_host_checks - 1.0)) + state_change) / (double)passive_host_checks);
-						if(have_min_passive_host_state_change == FALSE || min_passive_host_state_change > state_change) {
-							have_min_passive_host_state_change = TRUE;
-							min_passive_host_state_change = state_change;
-							}
-						if(have_max_passive_host_state_change == FALSE || max_passive_host_state_change < state_change) {
-							have_max_passive_host_state_change = TRUE;
-							max_passive_host_state_change = state_change;
-							}
-						time_difference = current_time - last_check;
-						if(time_difference <= 3600)
-							passive_hosts_checked_last_1hour++;
-						if(time_difference <= 900)
-							passive_hosts_checked_last_15min++;
-						if(time_difference <= 300)
-							passive_hosts_checked_last_5min++;
-						if(time_difference <= 60)
-							passive_hosts_checked_last_1min++;
-						}
-					switch(current_state) {
-						case HOST_UP:
-							hosts_up++;
-							break;
-						case HOST_DOWN:
-							hosts_down++;
-							break;
-						case HOST_UNREACHABLE:
-							hosts_unreachable++;
-							break;
-						default:
-							break;
-						}
-					if(is_flapping == TRUE)
-						hosts_flapping++;
-					if(downtime_depth > 0)
-						hosts_in_downtime++;
-					if(has_been_checked == TRUE)
-						hosts_checked++;
-					if(should_be_scheduled == TRUE)
-						hosts_scheduled++;
+					add_host_stats(current_time, execution_time, latency, check_type, current_state, state_change, is_flapping, downtime_depth, last_check, should_be_scheduled, has_been_checked);
 					break;
 
 				case STATUS_SERVICE_DATA:
-					average_service_state_change = (((average_service_state_change * ((double)status_service_entries - 1.0)) + state_change) / (double)status_service_entries);
-					if(have_min_service_state_change == FALSE || min_service_state_change > state_change) {
-						have_min_service_state_change = TRUE;
-						min_service_state_change = state_change;
-						}
-					if(have_max_service_state_change == FALSE || max_service_state_change < state_change) {
-						have_max_service_state_change = TRUE;
-						max_service_state_change = state_change;
-						}
-					if(check_type == CHECK_TYPE_ACTIVE) {
-						active_service_checks++;
-						average_active_service_latency = (((average_active_service_latency * ((double)active_service_checks - 1.0)) + latency) / (double)active_service_checks);
-						if(have_min_active_service_latency == FALSE || min_active_service_latency > latency) {
-							have_min_active_service_latency = TRUE;
-							min_active_service_latency = latency;
-							}
-						if(have_max_active_service_latency == FALSE || max_active_service_latency < latency) {
-							have_max_active_service_latency = TRUE;
-							max_active_service_latency = latency;
-							}
-						average_active_service_execution_time = (((average_active_service_execution_time * ((double)active_service_checks - 1.0)) + execution_time) / (double)active_service_checks);
-						if(have_min_active_service_execution_time == FALSE || min_active_service_execution_time > execution_time) {
-							have_min_active_service_execution_time = TRUE;
-							min_active_service_execution_time = execution_time;
-							}
-						if(have_max_active_service_execution_time == FALSE || max_active_service_execution_time < execution_time) {
-							have_max_active_service_execution_time = TRUE;
-							max_active_service_execution_time = execution_time;
-							}
-						average_active_service_state_change = (((average_active_service_state_change * ((double)active_service_checks - 1.0)) + state_change) / (double)active_service_checks);
-						if(have_min_active_service_state_change == FALSE || min_active_service_state_change > state_change) {
-							have_min_active_service_state_change = TRUE;
-							min_active_service_state_change = state_change;
-							}
-						if(have_max_active_service_state_change == FALSE || max_active_service_state_change < state_change) {
-							have_max_active_service_state_change = TRUE;
-							max_active_service_state_change = state_change;
-							}
-						time_difference = current_time - last_check;
-						if(time_difference <= 3600)
-							active_services_checked_last_1hour++;
-						if(time_difference <= 900)
-							active_services_checked_last_15min++;
-						if(time_difference <= 300)
-							active_services_checked_last_5min++;
-						if(time_difference <= 60)
-							active_services_checked_last_1min++;
-						}
-					else {
-						passive_service_checks++;
-						average_passive_service_latency = (((average_passive_service_latency * ((double)passive_service_checks - 1.0)) + latency) / (double)passive_service_checks);
-						if(have_min_passive_service_latency == FALSE || min_passive_service_latency > latency) {
-							have_min_passive_service_latency = TRUE;
-							min_passive_service_latency = latency;
-							}
-						if(have_max_passive_service_latency == FALSE || max_passive_service_latency < latency) {
-							have_max_passive_service_latency = TRUE;
-							max_passive_service_latency = latency;
-							}
-						average_passive_service_state_change = (((average_passive_service_state_change * ((double)passive_service_checks - 1.0)) + state_change) / (double)passive_service_checks);
-						if(have_min_passive_service_state_change == FALSE || min_passive_service_state_change > state_change) {
-							have_min_passive_service_state_change = TRUE;
-							min_passive_service_state_change = state_change;
-							}
-						if(have_max_passive_service_state_change == FALSE || max_passive_service_state_change < state_change) {
-							have_max_passive_service_state_change = TRUE;
-							max_passive_service_state_change = state_change;
-							}
-						time_difference = current_time - last_check;
-						if(time_difference <= 3600)
-							passive_services_checked_last_1hour++;
-						if(time_difference <= 900)
-							passive_services_checked_last_15min++;
-						if(time_difference <= 300)
-							passive_services_checked_last_5min++;
-						if(time_difference <= 60)
-							passive_services_checked_last_1min++;
-						}
-					switch(current_state) {
-						case STATE_OK:
-							services_ok++;
-							break;
-						case STATE_WARNING:
-							services_warning++;
-							break;
-						case STATE_UNKNOWN:
-							services_unknown++;
-							break;
-						case STATE_CRITICAL:
-							services_critical++;
-							break;
-						default:
-							break;
-						}
-					if(is_flapping == TRUE)
-						services_flapping++;
-					if(downtime_depth > 0)
-						services_in_downtime++;
-					if(has_been_checked == TRUE)
-						services_checked++;
-					if(should_be_scheduled == TRUE)
-						services_scheduled++;
+					add_service_stats(current_time, execution_time, latency, check_type, current_state, state_change, is_flapping, downtime_depth, last_check, should_be_scheduled, has_been_checked);
 					break;
 
 				default:
@@ -1339,6 +1370,69 @@ static int read_status_file(void) {
 	}
 
 
+/* reads the stats from the status store, which needs no parsing at all */
+static int read_status_store(void) {
+	struct xsd_store store;
+	struct xsd_store_header hdr;
+	struct xsd_store_host hst;
+	struct xsd_store_service svc;
+	time_t current_time;
+	unsigned int i;
+
+	if(xsd_store_open(&store, status_store_file) == ERROR)
+		return ERROR;
+	if(xsd_store_read_header(&store, &hdr) == ERROR) {
+		xsd_store_close(&store);
+		return ERROR;
+		}
+
+	time(&current_time);
+
+	status_creation_date = hdr.last_update;
+	status_version = strndup(hdr.program_version, sizeof(hdr.program_version));
+	program_start = hdr.program_start;
+	nagios_pid = hdr.nagios_pid;
+
+#define STORE_CHECK_STATS(type, name) \
+	do { \
+		name##_last_1min = hdr.check_stats[type][0]; \
+		name##_last_5min = hdr.check_stats[type][1]; \
+		name##_last_15min = hdr.check_stats[type][2]; \
+		} while(0)
+	STORE_CHECK_STATS(ACTIVE_SCHEDULED_HOST_CHECK_STATS, active_scheduled_host_checks);
+	STORE_CHECK_STATS(ACTIVE_ONDEMAND_HOST_CHECK_STATS, active_ondemand_host_checks);
+	STORE_CHECK_STATS(ACTIVE_CACHED_HOST_CHECK_STATS, active_cached_host_checks);
+	STORE_CHECK_STATS(PASSIVE_HOST_CHECK_STATS, passive_host_checks);
+	STORE_CHECK_STATS(ACTIVE_SCHEDULED_SERVICE_CHECK_STATS, active_scheduled_service_checks);
+	STORE_CHECK_STATS(ACTIVE_ONDEMAND_SERVICE_CHECK_STATS, active_ondemand_service_checks);
+	STORE_CHECK_STATS(ACTIVE_CACHED_SERVICE_CHECK_STATS, active_cached_service_checks);
+	STORE_CHECK_STATS(PASSIVE_SERVICE_CHECK_STATS, passive_service_checks);
+	STORE_CHECK_STATS(EXTERNAL_COMMAND_STATS, external_commands);
+	STORE_CHECK_STATS(PARALLEL_HOST_CHECK_STATS, parallel_host_checks);
+	STORE_CHECK_STATS(SERIAL_HOST_CHECK_STATS, serial_host_checks);
+#undef STORE_CHECK_STATS
+	sum_check_stats();
+
+	for(i = 0; i < hdr.num_hosts; i++) {
+		if(xsd_store_read_host(&store, i, &hst) == ERROR)
+			continue;
+		status_host_entries++;
+		add_host_stats(current_time, hst.execution_time, hst.latency, hst.check_type, hst.current_state, hst.percent_state_change, hst.is_flapping, hst.scheduled_downtime_depth, hst.last_check, hst.should_be_scheduled, hst.has_been_checked);
+		}
+
+	for(i = 0; i < hdr.num_services; i++) {
+		if(xsd_store_read_service(&store, i, &svc) == ERROR)
+			continue;
+		status_service_entries++;
+		add_service_stats(current_time, svc.execution_time, svc.latency, svc.check_type, svc.current_state, svc.percent_state_change, svc.is_flapping, svc.scheduled_downtime_depth, svc.last_check, svc.should_be_scheduled, svc.has_been_checked);
+		}
+
+	xsd_store_close(&store);
+
+	return OK;
+	}
+
+
 /* strip newline, carriage return, and tab characters from beginning and end of a string */
 void strip(char *buffer) {
 	register int x;
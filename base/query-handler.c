@@ -351,6 +351,11 @@ static int qh_core(int sd, char *buf, unsigned int len)
 				"load=%.2f;"
 				"backoff_limit=%.2f;backoff_change=%u;"
 				"rampup_limit=%.2f;rampup_change=%u;"
+				"backoff_factor=%.2f;"
+				"psi_cpu=%.2f;psi_memory=%.2f;psi_io=%.2f;psi_limit=%.2f;"
+				"latency=%.3f;latency_limit=%.3f;"
+				"worker_jobs=%u;worker_jobs_limit=%u;"
+				"check_interval=%lu;"
 				"nproc_limit=%u;nofile_limit=%u;"
 				"options=%u;changes=%u;",
 				loadctl.jobs_max, loadctl.jobs_min,
@@ -358,6 +363,11 @@ static int qh_core(int sd, char *buf, unsigned int len)
 				loadctl.load[0],
 				loadctl.backoff_limit, loadctl.backoff_change,
 				loadctl.rampup_limit, loadctl.rampup_change,
+				loadctl.backoff_factor,
+				loadctl.psi[0], loadctl.psi[1], loadctl.psi[2], loadctl.psi_limit,
+				loadctl.latency, loadctl.latency_limit,
+				loadctl.worker_jobs, loadctl.worker_jobs_limit,
+				(unsigned long)loadctl.check_interval,
 				loadctl.nproc_limit, loadctl.nofile_limit,
 				loadctl.options, loadctl.changes);
 		return 0;
@@ -0,0 +1,230 @@
+/*
+ * Check timing histograms
+ *
+ * This keeps track of how long checks wait to be run (latency), how
+ * long they run (execution time) and how long it takes us to handle
+ * their results (processing time). Each of those is kept as a
+ * histogram for every check command and every worker, and for all
+ * checks together, so the query handler can show percentiles and
+ * not just averages.
+ */
+
+#include "include/config.h"
+#include "include/common.h"
+#include "include/objects.h"
+#include "include/nagios.h"
+#include "lib/libnagios.h"
+
+#define TIMINGS_HASH_SIZE 1024
+
+struct check_timings {
+	int type;
+	char *name;
+	histogram *latency;
+	histogram *execution;
+	histogram *processing;
+};
+
+static const char *timings_type_name[] = { "command", "worker" };
+static struct check_timings *global_timings;
+static dkhash_table *timings_table;
+
+
+static void destroy_check_timings(struct check_timings *t)
+{
+	if (!t)
+		return;
+	histogram_destroy(t->latency);
+	histogram_destroy(t->execution);
+	histogram_destroy(t->processing);
+	free(t->name);
+	free(t);
+}
+
+static struct check_timings *create_check_timings(int type, const char *name)
+{
+	struct check_timings *t;
+
+	if (!(t = calloc(1, sizeof(*t))))
+		return NULL;
+	t->type = type;
+	t->name = strdup(name);
+	t->latency = histogram_create();
+	t->execution = histogram_create();
+	t->processing = histogram_create();
+	if (!t->name || !t->latency || !t->execution || !t->processing) {
+		destroy_check_timings(t);
+		return NULL;
+	}
+
+	return t;
+}
+
+/* histograms count microseconds */
+static inline void add_seconds(histogram *h, double secs)
+{
+	histogram_add(h, secs > 0 ? (unsigned long long)(secs * 1000000) : 0);
+}
+
+static void add_timings(struct check_timings *t, double latency, double execution_time, double processing_time)
+{
+	add_seconds(t->latency, latency);
+	add_seconds(t->execution, execution_time);
+	add_seconds(t->processing, processing_time);
+}
+
+void update_check_timings(int type, const char *name, double latency, double execution_time, double processing_time)
+{
+	struct check_timings *t;
+
+	if (!timings_table || !name)
+		return;
+
+	/* every check has a command, so that's where we count them all */
+	if (type == CHECK_TIMINGS_COMMAND)
+		add_timings(global_timings, latency, execution_time, processing_time);
+
+	if (!(t = dkhash_get(timings_table, timings_type_name[type], name))) {
+		if (!(t = create_check_timings(type, name)))
+			return;
+		dkhash_insert(timings_table, timings_type_name[type], t->name, t);
+	}
+	add_timings(t, latency, execution_time, processing_time);
+}
+
+void remove_check_timings(int type, const char *name)
+{
+	if (!timings_table || !name)
+		return;
+	destroy_check_timings(dkhash_remove(timings_table, timings_type_name[type], name));
+}
+
+
+static void print_histogram(int sd, const char *what, histogram *h)
+{
+	nsock_printf(sd, ";%s_p50=%.6f;%s_p95=%.6f;%s_p99=%.6f;%s_max=%.6f",
+	             what, (double)histogram_percentile(h, 50) / 1000000,
+	             what, (double)histogram_percentile(h, 95) / 1000000,
+	             what, (double)histogram_percentile(h, 99) / 1000000,
+	             what, (double)histogram_max(h) / 1000000);
+}
+
+static void print_timings(int sd, struct check_timings *t)
+{
+	nsock_printf(sd, "name=%s;count=%llu", t->name, histogram_count(t->latency));
+	print_histogram(sd, "latency", t->latency);
+	print_histogram(sd, "execution", t->execution);
+	print_histogram(sd, "processing", t->processing);
+	nsock_printf(sd, "\n");
+}
+
+/* dkhash walkers only get the data, so this is where they find the rest */
+static struct {
+	int sd;
+	int type;
+} timings_walk;
+
+static int print_timings_walker(void *data)
+{
+	struct check_timings *t = data;
+
+	if (t->type == timings_walk.type)
+		print_timings(timings_walk.sd, t);
+	return 0;
+}
+
+static int reset_timings_walker(void *data)
+{
+	struct check_timings *t = data;
+
+	histogram_reset(t->latency);
+	histogram_reset(t->execution);
+	histogram_reset(t->processing);
+	return 0;
+}
+
+static int destroy_timings_walker(void *data)
+{
+	destroy_check_timings(data);
+	return DKHASH_WALK_REMOVE;
+}
+
+static int timings_query_handler(int sd, char *buf, unsigned int len)
+{
+	char *space;
+	int type;
+
+	if (!*buf || !strcmp(buf, "help")) {
+		nsock_printf_nul(sd, "Check latency, execution and processing time percentiles.\n"
+			"Times are in seconds.\n"
+			"Valid commands:\n"
+			"  global           Print timings for all checks\n"
+			"  command [<name>] Print timings per check command, or for one\n"
+			"  worker [<name>]  Print timings per worker, or for one\n"
+			"  reset            Forget all timings collected so far");
+		return 0;
+	}
+
+	if ((space = memchr(buf, ' ', len)))
+		*(space++) = 0;
+
+	if (!space && !strcmp(buf, "global")) {
+		print_timings(sd, global_timings);
+		return 0;
+	}
+	if (!space && !strcmp(buf, "reset")) {
+		reset_timings_walker(global_timings);
+		dkhash_walk_data(timings_table, reset_timings_walker);
+		return 200;
+	}
+
+	if (!strcmp(buf, "command"))
+		type = CHECK_TIMINGS_COMMAND;
+	else if (!strcmp(buf, "worker"))
+		type = CHECK_TIMINGS_WORKER;
+	else
+		return 400;
+
+	if (space) {
+		struct check_timings *t = dkhash_get(timings_table, timings_type_name[type], space);
+		if (!t)
+			return 404;
+		print_timings(sd, t);
+		return 0;
+	}
+
+	timings_walk.sd = sd;
+	timings_walk.type = type;
+	dkhash_walk_data(timings_table, print_timings_walker);
+	return 0;
+}
+
+int init_check_timings(void)
+{
+	global_timings = create_check_timings(CHECK_TIMINGS_COMMAND, "global");
+	timings_table = dkhash_create(TIMINGS_HASH_SIZE);
+	if (!global_timings || !timings_table) {
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Failed to allocate check timing histograms\n");
+		deinit_check_timings();
+		return ERROR;
+	}
+
+	if (qh_register_handler("timings", "Check latency, execution and processing time histograms", 0, timings_query_handler) < 0) {
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Failed to register check timings with the query handler\n");
+		deinit_check_timings();
+		return ERROR;
+	}
+
+	return OK;
+}
+
+void deinit_check_timings(void)
+{
+	if (timings_table) {
+		dkhash_walk_data(timings_table, destroy_timings_walker);
+		dkhash_destroy(timings_table);
+		timings_table = NULL;
+	}
+	destroy_check_timings(global_timings);
+	global_timings = NULL;
+}
@@ -43,6 +43,11 @@ char *check_result_path;
 char *lock_file;
 
 int num_check_workers;
+int check_result_threads;
+char *persistent_plugins;
+int plugin_spawn_method;
+int worker_selection_policy;
+int worker_affinity_groups;
 char *qh_socket_path;
 
 char *nagios_user;
@@ -108,6 +113,8 @@ int check_service_freshness;
 int check_host_freshness;
 int auto_reschedule_checks;
 int auto_rescheduling_window;
+int smooth_check_scheduling;
+int suppress_unchanged_results;
 
 int additional_freshness_latency;
 
@@ -135,6 +142,8 @@ int use_retained_program_state;
 int use_retained_scheduling_info;
 int retention_scheduling_horizon;
 char *retention_file;
+int retention_file_format;
+int retention_load_threads;
 
 unsigned long modified_process_attributes = MODATTR_NONE;
 unsigned long modified_host_process_attributes = MODATTR_NONE;
@@ -173,6 +182,7 @@ int translate_passive_host_checks;
 int passive_host_checks_are_soft;
 
 int status_update_interval;
+int status_writer_thread;
 
 int time_change_threshold;
 
@@ -184,6 +194,8 @@ double low_host_flap_threshold;
 double high_host_flap_threshold;
 
 int use_large_installation_tweaks;
+int use_timing_wheel;
+int event_batch_size;
 int enable_environment_macros;
 int free_child_process_memory;
 int child_processes_fork_twice;
@@ -250,6 +262,11 @@ void init_main_cfg_vars(int first_time) {
 		qh_socket_path = NULL; /* disabled */
 		}
 
+	check_result_threads = DEFAULT_CHECK_RESULT_THREADS;
+	persistent_plugins = NULL;
+	plugin_spawn_method = DEFAULT_PLUGIN_SPAWN_METHOD;
+	worker_selection_policy = DEFAULT_WORKER_SELECTION_POLICY;
+	worker_affinity_groups = DEFAULT_WORKER_AFFINITY_GROUPS;
 	log_file = NULL;
 	temp_file = NULL;
 	temp_path = NULL;
@@ -317,6 +334,8 @@ void init_main_cfg_vars(int first_time) {
 	use_retained_program_state = TRUE;
 	use_retained_scheduling_info = FALSE;
 	retention_scheduling_horizon = DEFAULT_RETENTION_SCHEDULING_HORIZON;
+	retention_file_format = DEFAULT_RETENTION_FILE_FORMAT;
+	retention_load_threads = DEFAULT_RETENTION_LOAD_THREADS;
 	if(first_time) {
 		/* Not sure why this is not reset in reset_variables() */
 		retention_file = NULL;
@@ -335,6 +354,8 @@ void init_main_cfg_vars(int first_time) {
 	host_freshness_check_interval = DEFAULT_FRESHNESS_CHECK_INTERVAL;
 	auto_rescheduling_interval = DEFAULT_AUTO_RESCHEDULING_INTERVAL;
 	auto_rescheduling_window = DEFAULT_AUTO_RESCHEDULING_WINDOW;
+	smooth_check_scheduling = DEFAULT_SMOOTH_CHECK_SCHEDULING;
+	suppress_unchanged_results = DEFAULT_SUPPRESS_UNCHANGED_RESULTS;
 
 	check_orphaned_services = DEFAULT_CHECK_ORPHANED_SERVICES;
 	check_orphaned_hosts = DEFAULT_CHECK_ORPHANED_HOSTS;
@@ -350,6 +371,7 @@ void init_main_cfg_vars(int first_time) {
 	max_parallel_service_checks = DEFAULT_MAX_PARALLEL_SERVICE_CHECKS;
 
 	status_update_interval = DEFAULT_STATUS_UPDATE_INTERVAL;
+	status_writer_thread = DEFAULT_STATUS_WRITER_THREAD;
 
 	event_broker_options = BROKER_NOTHING;
 
@@ -364,6 +386,8 @@ void init_main_cfg_vars(int first_time) {
 	passive_host_checks_are_soft = DEFAULT_PASSIVE_HOST_CHECKS_SOFT;
 
 	use_large_installation_tweaks = DEFAULT_USE_LARGE_INSTALLATION_TWEAKS;
+	use_timing_wheel = DEFAULT_USE_TIMING_WHEEL;
+	event_batch_size = DEFAULT_EVENT_BATCH_SIZE;
 	enable_environment_macros = FALSE;
 	free_child_process_memory = -1;
 	child_processes_fork_twice = -1;
@@ -479,6 +503,14 @@ int set_loadctl_options(char *opts, unsigned int len)
 			loadctl.backoff_change = atoi(kv->value);
 		} else if (!strcmp(kv->key, "rampup_change")) {
 			loadctl.rampup_change = atoi(kv->value);
+		} else if (!strcmp(kv->key, "backoff_factor")) {
+			loadctl.backoff_factor = strtod(kv->value, NULL);
+		} else if (!strcmp(kv->key, "psi_limit")) {
+			loadctl.psi_limit = strtod(kv->value, NULL);
+		} else if (!strcmp(kv->key, "latency_limit")) {
+			loadctl.latency_limit = strtod(kv->value, NULL);
+		} else if (!strcmp(kv->key, "worker_jobs_limit")) {
+			loadctl.worker_jobs_limit = atoi(kv->value);
 		} else {
 			logit(NSLOG_CONFIG_ERROR, TRUE, "Error: Bad loadctl option; %s = %s\n", kv->key, kv->value);
 			return 400;
@@ -492,6 +524,9 @@ int set_loadctl_options(char *opts, unsigned int len)
 		loadctl.jobs_limit = loadctl.jobs_max;
 	if (loadctl.jobs_limit < loadctl.jobs_min)
 		loadctl.jobs_limit = loadctl.jobs_min;
+	/* backing off must shrink the limit, or we'd never recover */
+	if (loadctl.backoff_factor <= 0 || loadctl.backoff_factor >= 1)
+		loadctl.backoff_factor = 0.7;
 	kvvec_destroy(kvv, 0);
 	return 0;
 }
@@ -855,6 +890,190 @@ int get_raw_command_line(command *cmd_ptr, char *cmd, char **full_command, int m
 	}
 
 
+/* appends len bytes of str to a buffer we grow as needed */
+static int append_buf(char **buf, size_t *len, size_t *size, const char *str, size_t str_len) {
+	if(*len + str_len + 1 > *size) {
+		char *new_buf;
+		size_t new_size = (*size * 2 > *len + str_len + 1) ? *size * 2 : *len + str_len + 1;
+		if((new_buf = realloc(*buf, new_size)) == NULL)
+			return ERROR;
+		*buf = new_buf;
+		*size = new_size;
+		}
+	memcpy(*buf + *len, str, str_len);
+	*len += str_len;
+	(*buf)[*len] = '\x0';
+	return OK;
+	}
+
+
+/*
+ * Builds the argv for a command from its argv template and the values
+ * of its macros, in order. The words come out the way runcmd_cmd2strv()
+ * would split the expanded command line, so the worker can run them
+ * without looking at the command line at all. Returns NULL if a macro
+ * value would change how the command line is parsed, in which case the
+ * command has to be run the old way.
+ */
+static char **build_command_argv(command *cmd_ptr, char **values, size_t max_len) {
+	command_part *part;
+	char *words, *v, **argv;
+	size_t len = 0;
+	int x, nwords = 0, in_word = FALSE, macro = 0;
+
+	/* the words never take up more room than the expanded command line */
+	if((words = malloc(max_len + 1)) == NULL)
+		return NULL;
+
+	for(x = 0; x < cmd_ptr->num_parts; x++) {
+		part = &cmd_ptr->argv_template[x];
+
+		if(part->word_start == TRUE && in_word == TRUE) {
+			words[len++] = '\x0';
+			nwords++;
+			in_word = FALSE;
+			}
+
+		if(part->is_macro == FALSE) {
+			memcpy(words + len, part->text, strlen(part->text));
+			len += strlen(part->text);
+			in_word = TRUE;
+			continue;
+			}
+
+		v = values[macro++];
+		if(part->quoting == CMD_QUOTE_SINGLE) {
+			if(strchr(v, '\''))
+				goto shell;
+			}
+		else if(part->quoting == CMD_QUOTE_DOUBLE) {
+			if(strpbrk(v, "\"\\$`"))
+				goto shell;
+			}
+		else {
+			/* unquoted macros are split into words on whitespace */
+			for(; *v; v++) {
+				if(*v == ' ' || *v == '\t' || *v == '\r' || *v == '\n') {
+					if(in_word == TRUE) {
+						words[len++] = '\x0';
+						nwords++;
+						in_word = FALSE;
+						}
+					continue;
+					}
+				if(strchr("\\'\"|<>&;`()$*?", *v))
+					goto shell;
+				words[len++] = *v;
+				in_word = TRUE;
+				}
+			continue;
+			}
+
+		memcpy(words + len, v, strlen(v));
+		len += strlen(v);
+		in_word = TRUE;
+		}
+
+	if(in_word == TRUE) {
+		words[len++] = '\x0';
+		nwords++;
+		}
+
+	/* runcmd_open() would take VAR=value for an environment variable */
+	if(nwords == 0 || strchr(words, '='))
+		goto shell;
+
+	/* the pointers and the words go in one block, so one free() will do */
+	if((argv = malloc((nwords + 1) * sizeof(char *) + len)) == NULL)
+		goto shell;
+	v = memcpy((char *)(argv + nwords + 1), words, len);
+	for(x = 0; x < nwords; x++) {
+		argv[x] = v;
+		v += strlen(v) + 1;
+		}
+	argv[nwords] = NULL;
+
+	free(words);
+	return argv;
+
+shell:
+	free(words);
+	return NULL;
+	}
+
+
+int process_command_macros_r(nagios_macros *mac, command *cmd_ptr, char **output, char ***argv, int options) {
+	char *buf, *ptr, *delim, *value;
+	char **values = NULL;
+	int *free_values = NULL;
+	int x, nvalues = 0, in_macro = FALSE, result = OK;
+	size_t len = 0, size;
+
+	*argv = NULL;
+
+	if(cmd_ptr->argv_template == NULL)
+		return process_macros_r(mac, cmd_ptr->command_line, output, options);
+
+	/* walk the command line just like process_macros_r() does */
+	size = strlen(cmd_ptr->command_line) + 1;
+	*output = malloc(size);
+	buf = strdup(cmd_ptr->command_line);
+	values = malloc(cmd_ptr->num_parts * sizeof(char *));
+	free_values = malloc(cmd_ptr->num_parts * sizeof(int));
+	if(*output == NULL || buf == NULL || values == NULL || free_values == NULL) {
+		result = ERROR;
+		goto done;
+		}
+	**output = '\x0';
+
+	for(ptr = buf; ptr; in_macro = !in_macro) {
+		char *part = ptr;
+
+		if((delim = strchr(ptr, '$'))) {
+			*delim = '\x0';
+			ptr = delim + 1;
+			}
+		else
+			ptr = NULL;
+
+		if(in_macro == FALSE) {
+			result = append_buf(output, &len, &size, part, strlen(part));
+			}
+		else {
+			value = get_processed_macro_r(mac, part, options, &x);
+			result = append_buf(output, &len, &size, value, strlen(value));
+
+			/* "$$" is part of the literal text in the template */
+			if(*part && nvalues < cmd_ptr->num_parts) {
+				values[nvalues] = value;
+				free_values[nvalues++] = x;
+				}
+			else if(x == TRUE)
+				my_free(value);
+			}
+		if(result != OK)
+			goto done;
+		}
+
+	*argv = build_command_argv(cmd_ptr, values, len);
+
+done:
+	for(x = 0; x < nvalues; x++) {
+		if(free_values[x] == TRUE)
+			my_free(values[x]);
+		}
+	my_free(values);
+	my_free(free_values);
+	my_free(buf);
+	if(result != OK) {
+		my_free(*output);
+		*output = strdup("");
+		}
+
+	return result;
+	}
+
+
 
 /******************************************************************/
 /******************** ENVIRONMENT FUNCTIONS ***********************/
@@ -2068,6 +2287,53 @@ int drop_privileges(char *user, char *group) {
 /************************* IPC FUNCTIONS **************************/
 /******************************************************************/
 
+/*
+ * Check result spool watching.
+ *
+ * Where inotify is available we don't scan check_result_path for new
+ * files on every reaper run. Instead the kernel tells us when result
+ * files and their ok-to-go files are closed, and we queue them up and
+ * process them in batches from the main loop, through nagios_iobs.
+ * A full directory scan still happens at startup, after the kernel's
+ * event queue overflows and every max_check_result_file_age seconds,
+ * to pick up anything we missed and delete stale files.
+ *
+ * Besides the c?????? files, the directory may hold append-only
+ * "*.spool" files carrying any number of results in the same format,
+ * each one terminated by an empty line. We read complete results from
+ * where we left off as they are appended and, where the filesystem
+ * supports it, punch out what we've read so a restart doesn't read it
+ * again. Once "<name>.spool.ok" exists and everything has been read,
+ * both files are deleted.
+ */
+#define CHECK_RESULT_SPOOL_BATCH 256	/* results processed per main loop pass */
+
+struct spool_entry {
+	char *name;     /* file name, relative to check_result_path */
+	int is_spool;   /* append-only multi-result spool */
+	int queued;
+	int done;       /* the ok-to-go file for a spool exists */
+	off_t offset;   /* how much of a spool we've read */
+	struct spool_entry *next;       /* processing queue */
+	struct spool_entry *next_spool; /* known spools */
+	};
+
+static struct {
+	int fd;         /* inotify descriptor, or -1 if we're not watching */
+	int wake[2];    /* self-pipe to come back for the rest of a backlog */
+	int woken;
+	int rescan;
+	time_t last_scan;
+	struct spool_entry *head, *tail;
+	struct spool_entry *spools;
+	dkhash_table *pending;  /* names of queued result files */
+	} cr_spool = { -1, { -1, -1 } };
+
+static int is_check_result_spool_name(const char *);
+static char *spool_path(const char *, const char *);
+static struct spool_entry *find_check_result_spool(const char *, int);
+static int process_check_result_spool(struct spool_entry *, int);
+
 /* processes files in the check result queue directory */
 int process_check_result_queue(char *dirname) {
 	char file[MAX_FILENAME_LENGTH];
@@ -2114,6 +2380,17 @@ int process_check_result_queue(char *dirname) {
 		snprintf(file, sizeof(file), "%s/%s", dirname, dirfile->d_name);
 		file[sizeof(file) - 1] = '\x0';
 
+		/* read what's been appended to multi-result spools */
+		if(is_check_result_spool_name(dirfile->d_name)) {
+			struct spool_entry *sp = find_check_result_spool(dirfile->d_name, TRUE);
+			if(sp == NULL)
+				continue;
+			if(!access(spool_path(dirfile->d_name, ".ok"), F_OK))
+				sp->done = TRUE;
+			check_result_files += process_check_result_spool(sp, INT_MAX);
+			continue;
+			}
+
 		/* process this if it's a check result file... */
 		x = strlen(dirfile->d_name);
 		if(x == 7 && dirfile->d_name[0] == 'c') {
@@ -2206,13 +2483,64 @@ int process_check_result(check_result *cr)
  * elsewhere. */
 /* static char *unescape_check_result_file_output(char*); */
 
+/* sets one "var=value" field of a check result read from a file */
+static void set_check_result_var(check_result *cr, char *var, char *val) {
+	char *v1 = NULL, *v2 = NULL;
+
+	if(!strcmp(var, "host_name"))
+		cr->host_name = (char *)strdup(val);
+	else if(!strcmp(var, "service_description")) {
+		cr->service_description = (char *)strdup(val);
+		cr->object_check_type = SERVICE_CHECK;
+		}
+	else if(!strcmp(var, "check_type"))
+		cr->check_type = atoi(val);
+	else if(!strcmp(var, "check_options"))
+		cr->check_options = atoi(val);
+	else if(!strcmp(var, "scheduled_check"))
+		cr->scheduled_check = atoi(val);
+	else if(!strcmp(var, "reschedule_check"))
+		cr->reschedule_check = atoi(val);
+	else if(!strcmp(var, "latency"))
+		cr->latency = strtod(val, NULL);
+	else if(!strcmp(var, "start_time")) {
+		if((v1 = strtok(val, ".")) == NULL)
+			return;
+		if((v2 = strtok(NULL, "\n")) == NULL)
+			return;
+		cr->start_time.tv_sec = strtoul(v1, NULL, 0);
+		cr->start_time.tv_usec = strtoul(v2, NULL, 0);
+		}
+	else if(!strcmp(var, "finish_time")) {
+		if((v1 = strtok(val, ".")) == NULL)
+			return;
+		if((v2 = strtok(NULL, "\n")) == NULL)
+			return;
+		cr->finish_time.tv_sec = strtoul(v1, NULL, 0);
+		cr->finish_time.tv_usec = strtoul(v2, NULL, 0);
+		}
+	else if(!strcmp(var, "early_timeout"))
+		cr->early_timeout = atoi(val);
+	else if(!strcmp(var, "exited_ok"))
+		cr->exited_ok = atoi(val);
+	else if(!strcmp(var, "return_code"))
+		cr->return_code = atoi(val);
+	else if(!strcmp(var, "output"))
+		/* Interpolate "\\\\" and "\\n" escape sequences to the literal
+		 * characters they represent. This converts from the single line
+		 * format used to store the output in a checkresult file, to the
+		 * newline delimited format we use internally. By converting as
+		 * soon as possible after reading from the file we don't have
+		 * to worry about two different representations later. */
+		cr->output = unescape_check_result_output(val);
+	}
+
 /* reads check result(s) from a file */
 int process_check_result_file(char *fname) {
 	mmapfile *thefile = NULL;
 	char *input = NULL;
 	char *var = NULL;
 	char *val = NULL;
-	char *v1 = NULL, *v2 = NULL;
 	time_t current_time;
 	check_result cr;
 
@@ -2283,54 +2611,8 @@ int process_check_result_file(char *fname) {
 			}
 
 		/* else we have check result data */
-		else {
-			if(!strcmp(var, "host_name"))
-				cr.host_name = (char *)strdup(val);
-			else if(!strcmp(var, "service_description")) {
-				cr.service_description = (char *)strdup(val);
-				cr.object_check_type = SERVICE_CHECK;
-				}
-			else if(!strcmp(var, "check_type"))
-				cr.check_type = atoi(val);
-			else if(!strcmp(var, "check_options"))
-				cr.check_options = atoi(val);
-			else if(!strcmp(var, "scheduled_check"))
-				cr.scheduled_check = atoi(val);
-			else if(!strcmp(var, "reschedule_check"))
-				cr.reschedule_check = atoi(val);
-			else if(!strcmp(var, "latency"))
-				cr.latency = strtod(val, NULL);
-			else if(!strcmp(var, "start_time")) {
-				if((v1 = strtok(val, ".")) == NULL)
-					continue;
-				if((v2 = strtok(NULL, "\n")) == NULL)
-					continue;
-				cr.start_time.tv_sec = strtoul(v1, NULL, 0);
-				cr.start_time.tv_usec = strtoul(v2, NULL, 0);
-				}
-			else if(!strcmp(var, "finish_time")) {
-				if((v1 = strtok(val, ".")) == NULL)
-					continue;
-				if((v2 = strtok(NULL, "\n")) == NULL)
-					continue;
-				cr.finish_time.tv_sec = strtoul(v1, NULL, 0);
-				cr.finish_time.tv_usec = strtoul(v2, NULL, 0);
-				}
-			else if(!strcmp(var, "early_timeout"))
-				cr.early_timeout = atoi(val);
-			else if(!strcmp(var, "exited_ok"))
-				cr.exited_ok = atoi(val);
-			else if(!strcmp(var, "return_code"))
-				cr.return_code = atoi(val);
-			else if(!strcmp(var, "output"))
-				/* Interpolate "\\\\" and "\\n" escape sequences to the literal
-				 * characters they represent. This converts from the single line
-				 * format used to store the output in a checkresult file, to the
-				 * newline delimited format we use internally. By converting as
-				 * soon as possible after reading from the file we don't have
-				 * to worry about two different representations later. */
-				cr.output = unescape_check_result_output(val);
-			}
+		else
+			set_check_result_var(&cr, var, val);
 		}
 
 	/* do we have the minimum amount of data? */
@@ -2376,6 +2658,463 @@ int delete_check_result_file(char *fname) {
 
 
 
+static int is_check_result_file_name(const char *name) {
+	return name[0] == 'c' && strlen(name) == 7;
+	}
+
+static int is_check_result_spool_name(const char *name) {
+	size_t len = strlen(name);
+
+	return len > 6 && !strcmp(name + len - 6, ".spool");
+	}
+
+/* returns the full path of a file in the check result directory */
+static char *spool_path(const char *name, const char *suffix) {
+	static char path[MAX_FILENAME_LENGTH];
+
+	snprintf(path, sizeof(path), "%s/%s%s", check_result_path, name, suffix ? suffix : "");
+	path[sizeof(path) - 1] = '\x0';
+	return path;
+	}
+
+static void spool_enqueue(struct spool_entry *entry) {
+
+	if(entry->queued)
+		return;
+	entry->queued = TRUE;
+	entry->next = NULL;
+	if(cr_spool.tail)
+		cr_spool.tail->next = entry;
+	else
+		cr_spool.head = entry;
+	cr_spool.tail = entry;
+	}
+
+static struct spool_entry *spool_dequeue(void) {
+	struct spool_entry *entry = cr_spool.head;
+
+	if(!entry)
+		return NULL;
+	cr_spool.head = entry->next;
+	if(!cr_spool.head)
+		cr_spool.tail = NULL;
+	entry->next = NULL;
+	entry->queued = FALSE;
+	return entry;
+	}
+
+/*
+ * Queues a result file unless it's already queued. We usually hear
+ * about a file more than once (the ok-to-go file's creation and its
+ * close, or a rescan), and it must only be processed once.
+ */
+static void spool_queue_file(const char *name) {
+	struct spool_entry *entry;
+
+	if(!cr_spool.pending && !(cr_spool.pending = dkhash_create(CHECK_RESULT_SPOOL_BATCH * 4)))
+		return;
+	if(dkhash_get(cr_spool.pending, name, NULL))
+		return;
+
+	if(!(entry = calloc(1, sizeof(*entry))) || !(entry->name = strdup(name))) {
+		my_free(entry);
+		return;
+		}
+	if(dkhash_insert(cr_spool.pending, entry->name, NULL, entry) != DKHASH_OK) {
+		my_free(entry->name);
+		my_free(entry);
+		return;
+		}
+	spool_enqueue(entry);
+	}
+
+/* frees a dequeued result file entry */
+static void spool_forget_file(struct spool_entry *entry) {
+
+	dkhash_remove(cr_spool.pending, entry->name, NULL);
+	my_free(entry->name);
+	my_free(entry);
+	}
+
+static struct spool_entry *find_check_result_spool(const char *name, int create) {
+	struct spool_entry *sp;
+
+	for(sp = cr_spool.spools; sp; sp = sp->next_spool) {
+		if(!strcmp(sp->name, name))
+			return sp;
+		}
+	if(!create)
+		return NULL;
+
+	if(!(sp = calloc(1, sizeof(*sp))) || !(sp->name = strdup(name))) {
+		my_free(sp);
+		return NULL;
+		}
+	sp->is_spool = TRUE;
+	sp->next_spool = cr_spool.spools;
+	cr_spool.spools = sp;
+	return sp;
+	}
+
+static void forget_check_result_spool(struct spool_entry *sp) {
+	struct spool_entry **pp;
+
+	for(pp = &cr_spool.spools; *pp; pp = &(*pp)->next_spool) {
+		if(*pp == sp) {
+			*pp = sp->next_spool;
+			break;
+			}
+		}
+	if(sp->queued) {
+		struct spool_entry **qp, *prev = NULL;
+		for(qp = &cr_spool.head; *qp; prev = *qp, qp = &(*qp)->next) {
+			if(*qp == sp) {
+				*qp = sp->next;
+				if(cr_spool.tail == sp)
+					cr_spool.tail = prev;
+				break;
+				}
+			}
+		}
+	my_free(sp->name);
+	my_free(sp);
+	}
+
+/*
+ * Reads up to 'max' complete results from an append-only spool,
+ * starting where the previous call left off. Returns the number of
+ * results read. The spool is requeued if there might be more to read,
+ * and deleted once its ok-to-go file exists and all of it is read.
+ */
+static int process_check_result_spool(struct spool_entry *sp, int max) {
+	char *map, *p, *end, *nl, *line = NULL, *val;
+	size_t line_size = 0, len;
+	off_t consumed;
+	struct stat st;
+	check_result cr;
+	int fd, results = 0, writable = TRUE;
+
+	if((fd = open(spool_path(sp->name, NULL), O_RDWR | O_CLOEXEC)) < 0) {
+		writable = FALSE;
+		fd = open(spool_path(sp->name, NULL), O_RDONLY | O_CLOEXEC);
+		}
+	if(fd < 0) {
+		if(errno == ENOENT)
+			forget_check_result_spool(sp);
+		return 0;
+		}
+	if(fstat(fd, &st) < 0) {
+		close(fd);
+		return 0;
+		}
+	if(st.st_size <= sp->offset) {
+		close(fd);
+		if(sp->done)
+			goto finished;
+		return 0;
+		}
+
+	if((map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+		logit(NSLOG_RUNTIME_WARNING, TRUE, "Warning: Failed to map check result spool '%s': %s\n", sp->name, strerror(errno));
+		close(fd);
+		return 0;
+		}
+
+	log_debug_info(DEBUGL_CHECKS, 1, "Reading check result spool '%s' from offset %lu\n", sp->name, (unsigned long)sp->offset);
+
+	/* what we've already read may have been punched out, leaving zeroes */
+	p = map + sp->offset;
+	end = map + st.st_size;
+	while(p < end && *p == '\x0')
+		p++;
+	consumed = p - map;
+
+	init_check_result(&cr);
+	cr.engine = &nagios_spool_check_engine;
+	while(p < end && results < max) {
+		if(!(nl = memchr(p, '\n', end - p)))
+			break;
+		len = nl - p;
+
+		/* empty line indicates end of record */
+		if(!len) {
+			p = nl + 1;
+			consumed = p - map;
+			if(cr.host_name != NULL && cr.output != NULL) {
+				process_check_result(&cr);
+				results++;
+				}
+			free_check_result(&cr);
+			init_check_result(&cr);
+			cr.engine = &nagios_spool_check_engine;
+			continue;
+			}
+
+		if(len + 1 > line_size) {
+			line_size = len + 1;
+			if(!(val = realloc(line, line_size)))
+				break;
+			line = val;
+			}
+		memcpy(line, p, len);
+		line[len] = '\x0';
+		p = nl + 1;
+
+		if(line[0] == '#' || !(val = strchr(line, '=')))
+			continue;
+		*val++ = '\x0';
+		set_check_result_var(&cr, line, val);
+		}
+
+	/* the producer is done with this spool, so the last record is complete */
+	if(sp->done && p == end && results < max && cr.host_name != NULL && cr.output != NULL) {
+		process_check_result(&cr);
+		results++;
+		consumed = p - map;
+		}
+	free_check_result(&cr);
+	my_free(line);
+	munmap(map, st.st_size);
+
+	sp->offset = consumed;
+#ifdef FALLOC_FL_PUNCH_HOLE
+	if(writable && consumed > 0)
+		fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, 0, consumed);
+#endif
+	close(fd);
+
+	if(results >= max) {
+		spool_enqueue(sp);
+		return results;
+		}
+	if(!sp->done || sp->offset < st.st_size)
+		return results;
+
+finished:
+	log_debug_info(DEBUGL_CHECKS, 1, "Finished reading check result spool '%s'\n", sp->name);
+	unlink(spool_path(sp->name, NULL));
+	unlink(spool_path(sp->name, ".ok"));
+	forget_check_result_spool(sp);
+	return results;
+	}
+
+/* queues up everything in the spool directory, deleting stale files */
+static void spool_scan(void) {
+	DIR *dirp;
+	struct dirent *dirfile;
+	struct stat st;
+	struct spool_entry *sp;
+	time_t now = time(NULL);
+
+	cr_spool.rescan = FALSE;
+	cr_spool.last_scan = now;
+
+	if((dirp = opendir(check_result_path)) == NULL) {
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Could not open check result queue directory '%s' for reading.\n", check_result_path);
+		return;
+		}
+
+	while((dirfile = readdir(dirp)) != NULL) {
+		if(is_check_result_file_name(dirfile->d_name)) {
+			if(stat(spool_path(dirfile->d_name, NULL), &st) < 0 || !S_ISREG(st.st_mode))
+				continue;
+			if(st.st_mtime + max_check_result_file_age < now) {
+				delete_check_result_file(spool_path(dirfile->d_name, NULL));
+				continue;
+				}
+			if(!access(spool_path(dirfile->d_name, ".ok"), F_OK))
+				spool_queue_file(dirfile->d_name);
+			}
+		else if(is_check_result_spool_name(dirfile->d_name) && (sp = find_check_result_spool(dirfile->d_name, TRUE))) {
+			if(!access(spool_path(dirfile->d_name, ".ok"), F_OK))
+				sp->done = TRUE;
+			spool_enqueue(sp);
+			}
+		}
+
+	closedir(dirp);
+	}
+
+static void spool_wake(void) {
+
+	if(cr_spool.woken || cr_spool.wake[1] < 0)
+		return;
+	if(write(cr_spool.wake[1], "", 1) == 1)
+		cr_spool.woken = TRUE;
+	}
+
+/* processes one batch of queued results */
+static int spool_drain(void) {
+	struct spool_entry *entry;
+	int processed = 0;
+
+	while(processed < CHECK_RESULT_SPOOL_BATCH && (entry = spool_dequeue())) {
+		if(entry->is_spool)
+			processed += process_check_result_spool(entry, CHECK_RESULT_SPOOL_BATCH - processed);
+		else {
+			if(process_check_result_file(spool_path(entry->name, NULL)) == OK)
+				processed++;
+			spool_forget_file(entry);
+			}
+
+		if(sigshutdown == TRUE || sigrestart == TRUE)
+			break;
+		}
+
+	/* come back for the rest once we've polled for other input */
+	if(cr_spool.head)
+		spool_wake();
+
+	return processed;
+	}
+
+#ifdef HAVE_SYS_INOTIFY_H
+/* figures out what to do about a (possibly new) file in the spool directory */
+static void spool_note_file(const char *name) {
+	struct spool_entry *sp;
+	char *base;
+	size_t len = strlen(name);
+
+	if(len > 3 && !strcmp(name + len - 3, ".ok")) {
+		if(!(base = strndup(name, len - 3)))
+			return;
+		if(is_check_result_file_name(base)) {
+			if(!access(spool_path(base, NULL), F_OK))
+				spool_queue_file(base);
+			}
+		else if(is_check_result_spool_name(base) && (sp = find_check_result_spool(base, TRUE))) {
+			sp->done = TRUE;
+			spool_enqueue(sp);
+			}
+		free(base);
+		}
+	else if(is_check_result_file_name(name)) {
+		if(!access(spool_path(name, ".ok"), F_OK))
+			spool_queue_file(name);
+		}
+	else if(is_check_result_spool_name(name) && (sp = find_check_result_spool(name, TRUE)))
+		spool_enqueue(sp);
+	}
+
+static int spool_wakeup(int sd, int events, void *arg) {
+	char buf[64];
+
+	while(read(sd, buf, sizeof(buf)) > 0)
+		;
+	cr_spool.woken = FALSE;
+	spool_drain();
+	return 0;
+	}
+
+static int spool_input(int sd, int events, void *arg) {
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	struct inotify_event *ev;
+	ssize_t len;
+	char *p;
+
+	while((len = read(sd, buf, sizeof(buf))) > 0) {
+		for(p = buf; p < buf + len; p += sizeof(*ev) + ev->len) {
+			ev = (struct inotify_event *)p;
+			if(ev->mask & IN_Q_OVERFLOW)
+				cr_spool.rescan = TRUE;
+			else if(ev->len && !(ev->mask & IN_ISDIR))
+				spool_note_file(ev->name);
+			}
+		}
+
+	if(cr_spool.rescan)
+		spool_scan();
+	spool_drain();
+	return 0;
+	}
+#endif
+
+/* starts watching check_result_path for new check results */
+int init_check_result_spool(void) {
+#ifdef HAVE_SYS_INOTIFY_H
+	int i;
+
+	if(cr_spool.fd >= 0)
+		return OK;
+
+	if((cr_spool.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0) {
+		logit(NSLOG_RUNTIME_WARNING, TRUE, "Warning: Failed to initialize inotify, falling back to scanning the check result queue: %s\n", strerror(errno));
+		return ERROR;
+		}
+	if(inotify_add_watch(cr_spool.fd, check_result_path, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_MODIFY) < 0 || pipe(cr_spool.wake) < 0) {
+		logit(NSLOG_RUNTIME_WARNING, TRUE, "Warning: Failed to watch check result queue '%s', falling back to scanning it: %s\n", check_result_path, strerror(errno));
+		deinit_check_result_spool();
+		return ERROR;
+		}
+	for(i = 0; i < 2; i++) {
+		fcntl(cr_spool.wake[i], F_SETFL, fcntl(cr_spool.wake[i], F_GETFL) | O_NONBLOCK);
+		fcntl(cr_spool.wake[i], F_SETFD, FD_CLOEXEC);
+		}
+
+	iobroker_register(nagios_iobs, cr_spool.fd, NULL, spool_input);
+	iobroker_register(nagios_iobs, cr_spool.wake[0], NULL, spool_wakeup);
+
+	/* pick up whatever arrived while we weren't watching */
+	spool_scan();
+	if(cr_spool.head)
+		spool_wake();
+
+	log_debug_info(DEBUGL_CHECKS, 0, "Watching check result queue '%s' for new results\n", check_result_path);
+	return OK;
+#else
+	return ERROR;
+#endif
+	}
+
+void deinit_check_result_spool(void) {
+	struct spool_entry *entry;
+
+	if(cr_spool.fd >= 0) {
+		if(nagios_iobs)
+			iobroker_close(nagios_iobs, cr_spool.fd);
+		else
+			close(cr_spool.fd);
+		}
+	if(cr_spool.wake[0] >= 0) {
+		if(nagios_iobs)
+			iobroker_close(nagios_iobs, cr_spool.wake[0]);
+		else
+			close(cr_spool.wake[0]);
+		close(cr_spool.wake[1]);
+		}
+	cr_spool.fd = cr_spool.wake[0] = cr_spool.wake[1] = -1;
+	cr_spool.woken = FALSE;
+
+	while((entry = spool_dequeue())) {
+		if(!entry->is_spool)
+			spool_forget_file(entry);
+		}
+	while(cr_spool.spools)
+		forget_check_result_spool(cr_spool.spools);
+	dkhash_destroy(cr_spool.pending);
+	cr_spool.pending = NULL;
+	}
+
+/*
+ * Called by the check result reaper. Returns the number of results
+ * processed, or -1 if we're not watching the spool directory and the
+ * caller should scan it instead.
+ */
+int reap_check_result_spool(void) {
+	time_t rescan_interval = max_check_result_file_age > 60 ? max_check_result_file_age : 60;
+
+	if(cr_spool.fd < 0)
+		return -1;
+
+	if(cr_spool.rescan || cr_spool.last_scan + rescan_interval < time(NULL))
+		spool_scan();
+
+	return spool_drain();
+	}
+
+
+
+
 /* initializes a host/service check result */
 int init_check_result(check_result *info) {
 
@@ -2402,6 +3141,7 @@ int init_check_result(check_result *info) {
 	info->output = NULL;
 	info->source = NULL;
 	info->engine = NULL;
+	info->parsed_output = NULL;
 
 	return OK;
 	}
@@ -2417,11 +3157,24 @@ int free_check_result(check_result *info) {
 	my_free(info->host_name);
 	my_free(info->service_description);
 	my_free(info->output);
+	free_check_output(info->parsed_output);
+	info->parsed_output = NULL;
 
 	return OK;
 	}
 
 
+/* frees memory associated with pre-parsed plugin output */
+void free_check_output(check_output *info) {
+
+	if(info == NULL)
+		return;
+
+	/* the slices point into the result's output, which isn't ours */
+	my_free(info);
+	}
+
+
 /******************************************************************/
 /************************ STRING FUNCTIONS ************************/
 /******************************************************************/
@@ -3383,6 +4136,7 @@ void free_memory(nagios_macros *mac) {
 	my_free(command_file);
 	mac->x[MACRO_COMMANDFILE] = NULL; /* assigned from command_file */
 	my_free(log_archive_path);
+	my_free(persistent_plugins);
 
 	for (i = 0; i < MAX_USER_MACROS; i++) {
 		my_free(macro_user[i]);
@@ -3430,6 +4184,7 @@ int reset_variables(void) {
 	my_free(lock_file);
 	my_free(log_archive_path);
 	my_free(debug_file);
+	my_free(persistent_plugins);
 
 	my_free(object_cache_file);
 	my_free(object_precache_file);
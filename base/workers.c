@@ -9,6 +9,8 @@
  */
 #include "../include/config.h"
 #include <string.h>
+#include <pthread.h>
+#include <signal.h>
 #include "../include/nagios.h"
 #include "../include/workers.h"
 
@@ -22,10 +24,19 @@ struct wproc_job {
 	unsigned int type;
 	unsigned int timeout;
 	char *command;
+	char **argv; /* command split into words, if it needs no shell */
 	void *arg;
+	struct timeval sent; /* when the job was handed to the worker */
 	struct wproc_worker *wp;
 };
 
+/*
+ * Number of buckets in the per-worker latency histograms. Bucket 0
+ * counts jobs that took less than 1ms from dispatch to result, bucket
+ * n those that took less than 2^n ms, and the last bucket the rest.
+ */
+#define WPROC_LATENCY_BUCKETS 16
+
 struct wproc_list;
 
 struct wproc_worker {
@@ -33,9 +44,11 @@ struct wproc_worker {
 	int sd;     /**< communication socket */
 	pid_t pid;  /**< pid */
 	int max_jobs; /**< Max number of jobs the worker can handle */
+	int proto;    /**< WORKER_PROTO_TEXT or WORKER_PROTO_BINARY */
 	int jobs_running; /**< jobs running */
 	int jobs_started; /**< jobs started */
 	int job_index; /**< round-robin slot allocator (this wraps) */
+	unsigned int latency[WPROC_LATENCY_BUCKETS]; /**< dispatch-to-result histogram */
 	iocache *ioc;  /**< iocache for reading from worker */
 	fanout_table *jobs; /**< array of jobs */
 	struct wproc_list *wp_list;
@@ -49,6 +62,15 @@ struct wproc_list {
 
 static struct wproc_list workers = {0, 0, NULL};
 
+/*
+ * With worker_affinity_groups > 1, the general workers are split into
+ * that many groups, and all jobs for a host go to the workers of the
+ * group its name hashes to. Slow plugins on one group's hosts then
+ * can't tie up the workers of the others.
+ */
+static struct wproc_list *affinity_groups = NULL;
+static unsigned int num_affinity_groups = 0;
+
 static dkhash_table *specialized_workers;
 static struct wproc_list *to_remove = NULL;
 
@@ -125,30 +147,106 @@ void wproc_reap(int jobs, int msecs)
 	}
 }
 
+/*
+ * Reads the "some avg10" value from a /proc/pressure file, which is
+ * the percentage of the last ten seconds that some task was stalled
+ * waiting for the resource.
+ */
+static int read_psi(const char *path, double *avg10)
+{
+	char buf[256], *p;
+	int fd, len;
+
+	if ((fd = open(path, O_RDONLY)) < 0)
+		return -1;
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (len <= 0)
+		return -1;
+	buf[len] = 0;
+
+	if (strncmp(buf, "some ", 5) || !(p = strstr(buf, "avg10=")))
+		return -1;
+	*avg10 = strtod(p + 6, NULL);
+	return 0;
+}
+
+/*
+ * Samples what the load control reacts to: pressure stall information
+ * if the kernel has it (the load average otherwise), the number of
+ * jobs on the busiest worker and the check latency. Returns 1 if we
+ * should back off, -1 if we should ramp up and 0 if we're fine.
+ */
+static int loadctl_sample(struct load_control *lc)
+{
+	static const char *psi_files[3] = {
+		"/proc/pressure/cpu", "/proc/pressure/memory", "/proc/pressure/io",
+	};
+	int i, have_psi = 1, congested = 0;
+
+	for (i = 0; i < 3; i++) {
+		if (read_psi(psi_files[i], &lc->psi[i]) < 0) {
+			have_psi = 0;
+			break;
+		}
+		if (lc->psi[i] > lc->psi_limit)
+			congested = 1;
+	}
+	if (have_psi)
+		lc->options |= LOADCTL_PSI;
+	else
+		lc->options &= ~LOADCTL_PSI;
+
+	if (getloadavg(lc->load, 3) >= 0 && !have_psi && lc->load[0] > lc->backoff_limit)
+		congested = 1;
+
+	lc->worker_jobs = 0;
+	for (i = 0; i < (int)workers.len; i++) {
+		if (workers.wps[i]->jobs_running > (int)lc->worker_jobs)
+			lc->worker_jobs = workers.wps[i]->jobs_running;
+	}
+	if (lc->worker_jobs_limit && lc->worker_jobs > lc->worker_jobs_limit)
+		congested = 1;
+
+	if (congested)
+		return 1;
+
+	/*
+	 * Only ramp up if there's work waiting for it. Without pressure
+	 * information, we also want the load to be low enough.
+	 */
+	if (lc->latency < lc->latency_limit && lc->jobs_running < lc->jobs_limit)
+		return 0;
+	if (!have_psi && lc->load[0] >= lc->rampup_limit)
+		return 0;
+	return -1;
+}
+
+/*
+ * Adjusts the job limit with additive increase and multiplicative
+ * decrease, so we back off fast when the system is under pressure
+ * and creep back up while it isn't.
+ */
 int wproc_can_spawn(struct load_control *lc)
 {
-	unsigned int old = 0;
+	unsigned int old;
 	time_t now;
+	int state;
 
 	/* if no load control is enabled, we can safely run this job */
 	if (!(lc->options & LOADCTL_ENABLED))
 		return 1;
 
 	now = time(NULL);
-	if (lc->last_check + lc->check_interval > now) {
+	if (lc->last_check + lc->check_interval <= now) {
 		lc->last_check = now;
+		old = lc->jobs_limit;
 
-		if (getloadavg(lc->load, 3) < 0)
-			return lc->jobs_limit > lc->jobs_running;
-
-		if (lc->load[0] > lc->backoff_limit) {
-			old = lc->jobs_limit;
-			lc->jobs_limit -= lc->backoff_change;
-		}
-		else if (lc->load[0] < lc->rampup_limit) {
-			old = lc->jobs_limit;
-			lc->jobs_limit += lc->rampup_change;
-		}
+		state = loadctl_sample(lc);
+		if (state > 0)
+			lc->jobs_limit *= lc->backoff_factor;
+		else if (state < 0)
+			lc->jobs_limit += lc->rampup_change ? lc->rampup_change : 1;
 
 		if (lc->jobs_limit > lc->jobs_max) {
 			lc->jobs_limit = lc->jobs_max;
@@ -159,7 +257,9 @@ int wproc_can_spawn(struct load_control *lc)
 			lc->jobs_limit = lc->jobs_min;
 		}
 
-		if (old && old != lc->jobs_limit) {
+		if (old != lc->jobs_limit) {
+			lc->changes++;
+			lc->last_change = now;
 			if (lc->jobs_limit < old) {
 				logit(NSLOG_RUNTIME_WARNING, TRUE, "Warning: loadctl.jobs_limit changed from %u to %u\n", old, lc->jobs_limit);
 			} else {
@@ -214,9 +314,64 @@ static struct wproc_list *get_wproc_list(const char *cmd)
 	return wp_list ? wp_list : &workers;
 }
 
-static struct wproc_worker *get_worker(const char *cmd)
+/* the host a job is run for, if any */
+static const char *job_host_name(int type, void *arg)
+{
+	if (!arg || type == WPJOB_CALLBACK)
+		return NULL;
+	if (type == WPJOB_CHECK)
+		return ((check_result *)arg)->host_name;
+	return ((wproc_object_job *)arg)->host_name;
+}
+
+static unsigned int host_hash(const char *name)
+{
+	unsigned int h = 5381;
+
+	while (*name)
+		h = ((h << 5) + h) ^ (unsigned char)*name++;
+	return h;
+}
+
+/* (re)distributes the general workers over the affinity groups */
+static void assign_affinity_groups(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < num_affinity_groups; i++)
+		free(affinity_groups[i].wps);
+	my_free(affinity_groups);
+	num_affinity_groups = 0;
+
+	/* every group needs a worker of its own */
+	if (worker_affinity_groups < 2 || workers.len < (unsigned int)worker_affinity_groups)
+		return;
+
+	if (!(affinity_groups = calloc(worker_affinity_groups, sizeof(*affinity_groups))))
+		return;
+
+	for (i = 0; i < (unsigned int)worker_affinity_groups; i++) {
+		affinity_groups[i].wps = calloc(workers.len / worker_affinity_groups + 1, sizeof(struct wproc_worker *));
+		if (!affinity_groups[i].wps) {
+			while (i--)
+				free(affinity_groups[i].wps);
+			my_free(affinity_groups);
+			return;
+		}
+	}
+	num_affinity_groups = worker_affinity_groups;
+
+	for (i = 0; i < workers.len; i++) {
+		struct wproc_list *group = &affinity_groups[i % num_affinity_groups];
+		group->wps[group->len++] = workers.wps[i];
+	}
+}
+
+static struct wproc_worker *get_worker(const char *cmd, const char *host_name)
 {
 	struct wproc_list *wp_list;
+	struct wproc_worker *wp, *alt;
+	unsigned int i, start, hash = 0;
 
 	if (!cmd)
 		return NULL;
@@ -225,6 +380,38 @@ static struct wproc_worker *get_worker(const char *cmd)
 	if (!wp_list || !wp_list->wps || !wp_list->len)
 		return NULL;
 
+	if (host_name)
+		hash = host_hash(host_name);
+
+	/* the host's group gets the job, unless it's for a specialized worker */
+	if (wp_list == &workers && num_affinity_groups && host_name) {
+		wp_list = &affinity_groups[hash % num_affinity_groups];
+		hash /= num_affinity_groups;
+	}
+
+	switch (worker_selection_policy) {
+	case WPROC_SELECT_LEAST_JOBS:
+		/* start where we left off, so ties are spread out evenly */
+		start = wp_list->idx++;
+		wp = wp_list->wps[start % wp_list->len];
+		for (i = 1; i < wp_list->len; i++) {
+			alt = wp_list->wps[(start + i) % wp_list->len];
+			if (alt->jobs_running < wp->jobs_running)
+				wp = alt;
+		}
+		return wp;
+
+	case WPROC_SELECT_TWO_CHOICES:
+		wp = wp_list->wps[rand() % wp_list->len];
+		alt = wp_list->wps[rand() % wp_list->len];
+		return alt->jobs_running < wp->jobs_running ? alt : wp;
+
+	case WPROC_SELECT_HOST_AFFINITY:
+		if (host_name)
+			return wp_list->wps[hash % wp_list->len];
+		break;
+	}
+
 	return wp_list->wps[wp_list->idx++ % wp_list->len];
 }
 
@@ -233,7 +420,7 @@ static struct wproc_job *create_job(int type, void *arg, time_t timeout, const c
 	struct wproc_job *job;
 	struct wproc_worker *wp;
 
-	wp = get_worker(cmd);
+	wp = get_worker(cmd, job_host_name(type, arg));
 	if (!wp)
 		return NULL;
 
@@ -304,6 +491,7 @@ static void destroy_job(struct wproc_job *job)
 	}
 
 	my_free(job->command);
+	my_free(job->argv);
 	if (job->wp) {
 		fanout_remove(job->wp->jobs, job->id);
 		job->wp->jobs_running--;
@@ -345,6 +533,7 @@ static int wproc_destroy(struct wproc_worker *wp, int flags)
 	/* free all memory when either forcing or a worker called us */
 	iocache_destroy(wp->ioc);
 	wp->ioc = NULL;
+	remove_check_timings(CHECK_TIMINGS_WORKER, wp->name);
 	my_free(wp->name);
 	fanout_destroy(wp->jobs, fo_destroy_job);
 	wp->jobs = NULL;
@@ -405,6 +594,9 @@ static void remove_worker(struct wproc_worker *worker)
 	}
 	wpl->len = j;
 
+	if (wpl == &workers)
+		assign_affinity_groups();
+
 	if (!specialized_workers || wpl->len)
 		return;
 
@@ -413,12 +605,16 @@ static void remove_worker(struct wproc_worker *worker)
 }
 
 
+static void wpres_pool_stop(void);
+
 /*
  * This gets called from both parent and worker process, so
  * we must take care not to blindly shut down everything here
  */
 void free_worker_memory(int flags)
 {
+	wpres_pool_stop();
+
 	if (workers.wps) {
 		unsigned int i;
 
@@ -434,6 +630,7 @@ void free_worker_memory(int flags)
 	}
 	workers.len = 0;
 	workers.idx = 0;
+	assign_affinity_groups();
 
 	to_remove = NULL;
 	dkhash_walk_data(specialized_workers, remove_specialized);
@@ -457,10 +654,30 @@ static int str2timeval(char *str, struct timeval *tv)
 	return 0;
 }
 
-static int handle_worker_check(wproc_result *wpres, struct wproc_worker *wp, struct wproc_job *job)
+/* builds the output we hand on to the check result handlers */
+static char *wproc_check_output(wproc_result *wpres)
+{
+	char *output = NULL;
+
+	if (wpres->outstd && *wpres->outstd) {
+		output = strdup(wpres->outstd);
+	} else if (wpres->outerr) {
+		asprintf(&output, "(No output on stdout) stderr: %s", wpres->outerr);
+	}
+
+	return output;
+}
+
+/*
+ * If 'parsed' is set, the result threads have already built
+ * and parsed the output, and we take over both of them.
+ */
+static int handle_worker_check(wproc_result *wpres, struct wproc_worker *wp, struct wproc_job *job, char *output, check_output *parsed)
 {
 	int result = ERROR;
 	check_result *cr = (check_result *)job->arg;
+	struct timeval processing_start, processing_end;
+	double latency;
 
 	memcpy(&cr->rusage, &wpres->rusage, sizeof(wpres->rusage));
 	cr->start_time.tv_sec = wpres->start.tv_sec;
@@ -473,12 +690,11 @@ static int handle_worker_check(wproc_result *wpres, struct wproc_worker *wp, str
 		cr->return_code = STATE_UNKNOWN;
 	}
 
-	if (wpres->outstd && *wpres->outstd) {
-		cr->output = strdup(wpres->outstd);
-	} else if (wpres->outerr) {
-		asprintf(&cr->output, "(No output on stdout) stderr: %s", wpres->outerr);
+	if (parsed) {
+		cr->output = output;
+		cr->parsed_output = parsed;
 	} else {
-		cr->output = NULL;
+		cr->output = wproc_check_output(wpres);
 	}
 
 	cr->early_timeout = wpres->early_timeout;
@@ -486,136 +702,717 @@ static int handle_worker_check(wproc_result *wpres, struct wproc_worker *wp, str
 	cr->engine = NULL;
 	cr->source = wp->name;
 
+	/* the load control wants to know if checks are falling behind */
+	loadctl.latency = loadctl.latency * 0.9 + cr->latency * 0.1;
+
+	latency = cr->latency;
+	gettimeofday(&processing_start, NULL);
 	process_check_result(cr);
+	gettimeofday(&processing_end, NULL);
 	free_check_result(cr);
 
+	update_check_timings(CHECK_TIMINGS_WORKER, wp->name, latency,
+	                     tv_delta_f(&wpres->start, &wpres->stop),
+	                     tv_delta_f(&processing_start, &processing_end));
+
 	return result;
 }
 
+/* sets one result variable. Returns -1 if we don't handle it */
+static int set_worker_result_var(wproc_result *wpres, int code, char *value)
+{
+	switch (code) {
+	case WPRES_job_id:
+		wpres->job_id = atoi(value);
+		break;
+	case WPRES_type:
+		wpres->type = atoi(value);
+		break;
+	case WPRES_command:
+		wpres->command = value;
+		break;
+	case WPRES_timeout:
+		wpres->timeout = atoi(value);
+		break;
+	case WPRES_wait_status:
+		wpres->wait_status = atoi(value);
+		break;
+	case WPRES_start:
+		str2timeval(value, &wpres->start);
+		break;
+	case WPRES_stop:
+		str2timeval(value, &wpres->stop);
+		break;
+	case WPRES_outstd:
+		wpres->outstd = value;
+		break;
+	case WPRES_outerr:
+		wpres->outerr = value;
+		break;
+	case WPRES_exited_ok:
+		wpres->exited_ok = atoi(value);
+		break;
+	case WPRES_error_msg:
+		wpres->exited_ok = FALSE;
+		wpres->error_msg = value;
+		break;
+	case WPRES_error_code:
+		wpres->exited_ok = FALSE;
+		wpres->error_code = atoi(value);
+		break;
+	case WPRES_runtime:
+		/* ignored */
+		break;
+	case WPRES_ru_utime:
+		str2timeval(value, &wpres->rusage.ru_utime);
+		break;
+	case WPRES_ru_stime:
+		str2timeval(value, &wpres->rusage.ru_stime);
+		break;
+	case WPRES_ru_minflt:
+		wpres->rusage.ru_minflt = atoi(value);
+		break;
+	case WPRES_ru_majflt:
+		wpres->rusage.ru_majflt = atoi(value);
+		break;
+	case WPRES_ru_nswap:
+		wpres->rusage.ru_nswap = atoi(value);
+		break;
+	case WPRES_ru_inblock:
+		wpres->rusage.ru_inblock = atoi(value);
+		break;
+	case WPRES_ru_oublock:
+		wpres->rusage.ru_oublock = atoi(value);
+		break;
+	case WPRES_ru_msgsnd:
+		wpres->rusage.ru_msgsnd = atoi(value);
+		break;
+	case WPRES_ru_msgrcv:
+		wpres->rusage.ru_msgrcv = atoi(value);
+		break;
+	case WPRES_ru_nsignals:
+		wpres->rusage.ru_nsignals = atoi(value);
+		break;
+	case WPRES_ru_nvcsw:
+		wpres->rusage.ru_nsignals = atoi(value);
+		break;
+	case WPRES_ru_nivcsw:
+		wpres->rusage.ru_nsignals = atoi(value);
+		break;
+
+	default:
+		return -1;
+	}
+	return 0;
+}
+
 /*
  * parses a worker result. We do no strdup()'s here, so when
  * kvv is destroyed, all references to strings will become
- * invalid
+ * invalid.
+ * This runs in the result threads too, so it can't log. It
+ * returns the number of variables it didn't understand, and
+ * the caller gets to complain about them.
  */
 static int parse_worker_result(wproc_result *wpres, struct kvvec *kvv)
 {
-	int i;
+	int i, unknown = 0;
+
+	memset(wpres, 0, sizeof(*wpres));
+	wpres->job_id = -1;
+	wpres->type = -1;
+	wpres->response = kvv;
 
 	for (i = 0; i < kvv->kv_pairs; i++) {
 		struct wpres_key *k;
-		char *key, *value;
-		key = kvv->kv[i].key;
-		value = kvv->kv[i].value;
 
-		k = wpres_get_key(key, kvv->kv[i].key_len);
-		if (!k) {
-			logit(NSLOG_RUNTIME_WARNING, TRUE, "wproc: Unrecognized result variable: (i=%d) %s=%s\n", i, key, value);
+		/* workers that echo the whole request send our argv back */
+		if (kvv->kv[i].key_len == 3 && !strcmp(kvv->kv[i].key, "arg"))
 			continue;
-		}
-		switch (k->code) {
-		case WPRES_job_id:
-			wpres->job_id = atoi(value);
-			break;
-		case WPRES_type:
-			wpres->type = atoi(value);
-			break;
-		case WPRES_command:
-			wpres->command = value;
-			break;
-		case WPRES_timeout:
-			wpres->timeout = atoi(value);
-			break;
-		case WPRES_wait_status:
-			wpres->wait_status = atoi(value);
-			break;
-		case WPRES_start:
-			str2timeval(value, &wpres->start);
-			break;
-		case WPRES_stop:
-			str2timeval(value, &wpres->stop);
-			break;
-		case WPRES_outstd:
-			wpres->outstd = value;
-			break;
-		case WPRES_outerr:
-			wpres->outerr = value;
-			break;
-		case WPRES_exited_ok:
-			wpres->exited_ok = atoi(value);
-			break;
-		case WPRES_error_msg:
-			wpres->exited_ok = FALSE;
-			wpres->error_msg = value;
-			break;
-		case WPRES_error_code:
-			wpres->exited_ok = FALSE;
-			wpres->error_code = atoi(value);
-			break;
-		case WPRES_runtime:
-			/* ignored */
-			break;
-		case WPRES_ru_utime:
-			str2timeval(value, &wpres->rusage.ru_utime);
-			break;
-		case WPRES_ru_stime:
-			str2timeval(value, &wpres->rusage.ru_stime);
-			break;
-		case WPRES_ru_minflt:
-			wpres->rusage.ru_minflt = atoi(value);
-			break;
-		case WPRES_ru_majflt:
-			wpres->rusage.ru_majflt = atoi(value);
-			break;
-		case WPRES_ru_nswap:
-			wpres->rusage.ru_nswap = atoi(value);
-			break;
-		case WPRES_ru_inblock:
-			wpres->rusage.ru_inblock = atoi(value);
-			break;
-		case WPRES_ru_oublock:
-			wpres->rusage.ru_oublock = atoi(value);
-			break;
-		case WPRES_ru_msgsnd:
-			wpres->rusage.ru_msgsnd = atoi(value);
-			break;
-		case WPRES_ru_msgrcv:
-			wpres->rusage.ru_msgrcv = atoi(value);
-			break;
-		case WPRES_ru_nsignals:
-			wpres->rusage.ru_nsignals = atoi(value);
-			break;
-		case WPRES_ru_nvcsw:
-			wpres->rusage.ru_nsignals = atoi(value);
-			break;
-		case WPRES_ru_nivcsw:
-			wpres->rusage.ru_nsignals = atoi(value);
-			break;
 
-		default:
+		k = wpres_get_key(kvv->kv[i].key, kvv->kv[i].key_len);
+		if (!k || set_worker_result_var(wpres, k->code, kvv->kv[i].value) < 0)
+			unknown++;
+	}
+	return unknown;
+}
+
+/*
+ * Decodes a binary result frame. Like with parse_worker_result(),
+ * the strings point into 'buf'. This runs in the result threads too.
+ */
+static int decode_result_frame(wproc_result *wpres, char *buf, unsigned long size)
+{
+	struct worker_result_frame res;
+	char *str[WORKER_FRAME_NSTR];
+
+	memset(wpres, 0, sizeof(*wpres));
+	wpres->job_id = -1;
+	wpres->type = -1;
+	if (worker_decode_result(buf, size, &res, str) < 0)
+		return -1;
+
+	wpres->job_id = res.job_id;
+	wpres->type = res.type;
+	wpres->timeout = res.timeout;
+	wpres->wait_status = res.wait_status;
+	wpres->exited_ok = res.exited_ok;
+	wpres->error_code = res.error_code;
+	wpres->start.tv_sec = res.start_sec;
+	wpres->start.tv_usec = res.start_usec;
+	wpres->stop.tv_sec = res.stop_sec;
+	wpres->stop.tv_usec = res.stop_usec;
+	wpres->rusage.ru_utime.tv_sec = res.ru_utime_sec;
+	wpres->rusage.ru_utime.tv_usec = res.ru_utime_usec;
+	wpres->rusage.ru_stime.tv_sec = res.ru_stime_sec;
+	wpres->rusage.ru_stime.tv_usec = res.ru_stime_usec;
+	wpres->rusage.ru_minflt = res.ru_minflt;
+	wpres->rusage.ru_majflt = res.ru_majflt;
+	wpres->rusage.ru_inblock = res.ru_inblock;
+	wpres->rusage.ru_oublock = res.ru_oublock;
+	if (res.len[WORKER_FRAME_COMMAND])
+		wpres->command = str[WORKER_FRAME_COMMAND];
+	wpres->outstd = str[WORKER_FRAME_OUTSTD];
+	wpres->outerr = str[WORKER_FRAME_OUTERR];
+	if (res.len[WORKER_FRAME_ERROR_MSG])
+		wpres->error_msg = str[WORKER_FRAME_ERROR_MSG];
+	if (wpres->error_msg || wpres->error_code)
+		wpres->exited_ok = FALSE;
+
+	return 0;
+}
+
+static void log_unknown_result_variables(struct kvvec *kvv)
+{
+	wproc_result scratch;
+	int i;
+
+	for (i = 0; i < kvv->kv_pairs; i++) {
+		char *key = kvv->kv[i].key, *value = kvv->kv[i].value;
+		struct wpres_key *k = wpres_get_key(key, kvv->kv[i].key_len);
+
+		if (!k) {
+			logit(NSLOG_RUNTIME_WARNING, TRUE, "wproc: Unrecognized result variable: (i=%d) %s=%s\n", i, key, value);
+		} else if (set_worker_result_var(&scratch, k->code, value) < 0) {
 			logit(NSLOG_RUNTIME_WARNING, TRUE, "wproc: Recognized but unhandled result variable: %s=%s\n", key, value);
-			break;
 		}
 	}
-	return 0;
+}
+
+static void wproc_record_latency(struct wproc_worker *wp, struct wproc_job *job)
+{
+	struct timeval now;
+	int msec, bucket = 0;
+
+	gettimeofday(&now, NULL);
+	msec = tv_delta_msec(&job->sent, &now);
+	while (msec > 0 && bucket < WPROC_LATENCY_BUCKETS - 1) {
+		msec >>= 1;
+		bucket++;
+	}
+	wp->latency[bucket]++;
 }
 
 static int wproc_run_job(struct wproc_job *job, nagios_macros *mac);
 static void fo_reassign_wproc_job(void *job_)
 {
 	struct wproc_job *job = (struct wproc_job *)job_;
-	job->wp = get_worker(job->command);
+	job->wp = get_worker(job->command, job_host_name(job->type, job->arg));
 	job->id = get_job_id(job->wp);
 	/* macros aren't used right now anyways */
 	wproc_run_job(job, NULL);
 }
 
-static int handle_worker_result(int sd, int events, void *arg)
+/*
+ * Acts on a parsed worker result. For checks, 'output' and 'parsed'
+ * are what the result threads made of the plugin output, or NULL
+ * if we're not using threads.
+ */
+static void handle_worker_response(struct wproc_worker *wp, wproc_result *wpres, char *output, check_output *parsed)
 {
 	wproc_object_job *oj = NULL;
-	char *buf, *error_reason = NULL;
+	char *error_reason = NULL;
+	struct wproc_job *job;
+
+	job = get_job(wp, wpres->job_id);
+	if (!job) {
+		logit(NSLOG_RUNTIME_WARNING, TRUE, "wproc: Job with id '%d' doesn't exist on %s.\n",
+			  wpres->job_id, wp->name);
+		my_free(output);
+		free_check_output(parsed);
+		return;
+	}
+	if (wpres->type != job->type) {
+		logit(NSLOG_RUNTIME_WARNING, TRUE, "wproc: %s claims job %d is type %d, but we think it's type %d\n",
+			  wp->name, job->id, wpres->type, job->type);
+		my_free(output);
+		free_check_output(parsed);
+		return;
+	}
+	oj = (wproc_object_job *)job->arg;
+	wproc_record_latency(wp, job);
+
+	/*
+	 * ETIME ("Timer expired") doesn't really happen
+	 * on any modern systems, so we reuse it to mean
+	 * "program timed out"
+	 */
+	if (wpres->error_code == ETIME) {
+		wpres->early_timeout = TRUE;
+	}
+	if (wpres->early_timeout) {
+		asprintf(&error_reason, "timed out after %.2fs", tv_delta_f(&wpres->start, &wpres->stop));
+	}
+	else if (WIFSIGNALED(wpres->wait_status)) {
+		asprintf(&error_reason, "died by signal %d%s after %.2f seconds",
+		         WTERMSIG(wpres->wait_status),
+		         WCOREDUMP(wpres->wait_status) ? " (core dumped)" : "",
+		         tv_delta_f(&wpres->start, &wpres->stop));
+	}
+	else if (job->type != WPJOB_CHECK && WEXITSTATUS(wpres->wait_status) != 0) {
+		asprintf(&error_reason, "is a non-check helper but exited with return code %d",
+		         WEXITSTATUS(wpres->wait_status));
+	}
+	if (error_reason) {
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "wproc: %s job %d from worker %s %s",
+		      wpjob_type_name(job->type), job->id, wp->name, error_reason);
+#ifdef DEBUG
+		/* The log below could leak sensitive information, such as 
+			passwords, so only enable it if you really need it */
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "wproc:   command: %s\n", job->command);
+#endif
+		if (job->type != WPJOB_CHECK && oj) {
+			logit(NSLOG_RUNTIME_ERROR, TRUE, "wproc:   host=%s; service=%s; contact=%s\n",
+			      oj->host_name ? oj->host_name : "(none)",
+			      oj->service_description ? oj->service_description : "(none)",
+			      oj->contact_name ? oj->contact_name : "(none)");
+		} else if (oj) {
+			struct check_result *cr = (struct check_result *)job->arg;
+			logit(NSLOG_RUNTIME_ERROR, TRUE, "wproc:   host=%s; service=%s;\n",
+			      cr->host_name, cr->service_description);
+		}
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "wproc:   early_timeout=%d; exited_ok=%d; wait_status=%d; error_code=%d;\n",
+		      wpres->early_timeout, wpres->exited_ok, wpres->wait_status, wpres->error_code);
+		wproc_logdump_buffer(NSLOG_RUNTIME_ERROR, TRUE, "wproc:   stderr", wpres->outerr);
+		wproc_logdump_buffer(NSLOG_RUNTIME_ERROR, TRUE, "wproc:   stdout", wpres->outstd);
+	}
+	my_free(error_reason);
+
+	switch (job->type) {
+	case WPJOB_CHECK:
+		handle_worker_check(wpres, wp, job, output, parsed);
+		break;
+	case WPJOB_NOTIFY:
+		if (wpres->early_timeout) {
+			if (oj->service_description) {
+				logit(NSLOG_RUNTIME_WARNING, TRUE, "Warning: Notifying contact '%s' of service '%s' on host '%s' by command '%s' timed out after %.2f seconds\n",
+					  oj->contact_name, oj->service_description,
+					  oj->host_name, job->command,
+					  tv2float(&wpres->runtime));
+			} else {
+				logit(NSLOG_RUNTIME_WARNING, TRUE, "Warning: Notifying contact '%s' of host '%s' by command '%s' timed out after %.2f seconds\n",
+					  oj->contact_name, oj->host_name,
+					  job->command, tv2float(&wpres->runtime));
+			}
+		}
+		break;
+	case WPJOB_OCSP:
+		if (wpres->early_timeout) {
+			logit(NSLOG_RUNTIME_WARNING, TRUE, "Warning: OCSP command '%s' for service '%s' on host '%s' timed out after %.2f seconds\n",
+				  job->command, oj->service_description, oj->host_name,
+				  tv2float(&wpres->runtime));
+		}
+		break;
+	case WPJOB_OCHP:
+		if (wpres->early_timeout) {
+			logit(NSLOG_RUNTIME_WARNING, TRUE, "Warning: OCHP command '%s' for host '%s' timed out after %.2f seconds\n",
+				  job->command, oj->host_name, tv2float(&wpres->runtime));
+		}
+		break;
+	case WPJOB_GLOBAL_SVC_EVTHANDLER:
+		if (wpres->early_timeout) {
+			logit(NSLOG_EVENT_HANDLER | NSLOG_RUNTIME_WARNING, TRUE,
+				  "Warning: Global service event handler command '%s' timed out after %.2f seconds\n",
+				  job->command, tv2float(&wpres->runtime));
+		}
+		break;
+	case WPJOB_SVC_EVTHANDLER:
+		if (wpres->early_timeout) {
+			logit(NSLOG_EVENT_HANDLER | NSLOG_RUNTIME_WARNING, TRUE,
+				  "Warning: Service event handler command '%s' timed out after %.2f seconds\n",
+				  job->command, tv2float(&wpres->runtime));
+		}
+		break;
+	case WPJOB_GLOBAL_HOST_EVTHANDLER:
+		if (wpres->early_timeout) {
+			logit(NSLOG_EVENT_HANDLER | NSLOG_RUNTIME_WARNING, TRUE,
+				  "Warning: Global host event handler command '%s' timed out after %.2f seconds\n",
+				  job->command, tv2float(&wpres->runtime));
+		}
+		break;
+	case WPJOB_HOST_EVTHANDLER:
+		if (wpres->early_timeout) {
+			logit(NSLOG_EVENT_HANDLER | NSLOG_RUNTIME_WARNING, TRUE,
+				  "Warning: Host event handler command '%s' timed out after %.2f seconds\n",
+				  job->command, tv2float(&wpres->runtime));
+		}
+		break;
+
+	case WPJOB_CALLBACK:
+		run_job_callback(job, wpres, 0);
+		break;
+
+	case WPJOB_HOST_PERFDATA:
+	case WPJOB_SVC_PERFDATA:
+		/* these require nothing special */
+		break;
+
+	default:
+		logit(NSLOG_RUNTIME_WARNING, TRUE, "Worker %ld: Unknown jobtype: %d\n", (long)wp->pid, job->type);
+		break;
+	}
+	destroy_job(job);
+}
+
+static void handle_worker_message(struct wproc_worker *wp, char *buf, unsigned long size)
+{
+	static struct kvvec kvv = KVVEC_INITIALIZER;
+	wproc_result wpres;
+
+	if (buf2kvvec_prealloc(&kvv, buf, size, '=', '\0', KVVEC_ASSIGN) <= 0) {
+		logit(NSLOG_RUNTIME_ERROR, TRUE,
+			  "wproc: Failed to parse key/value vector from worker response with len %lu. First kv=%s",
+			  size, buf ? buf : "(NULL)");
+		return;
+	}
+
+	if (parse_worker_result(&wpres, &kvv))
+		log_unknown_result_variables(&kvv);
+	handle_worker_response(wp, &wpres, NULL, NULL);
+}
+
+static void handle_worker_frame(struct wproc_worker *wp, char *buf, unsigned long size)
+{
+	wproc_result wpres;
+
+	if (decode_result_frame(&wpres, buf, size) < 0) {
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "wproc: Failed to decode result frame with len %lu from %s\n", size, wp->name);
+		return;
+	}
+	handle_worker_response(wp, &wpres, NULL, NULL);
+}
+
+/*
+ * Result parsing threads.
+ *
+ * With check_result_threads > 0, responses read from the workers are
+ * handed to a pool of threads that do the stateless work: splitting
+ * the message into a kvvec, decoding the result variables and, for
+ * checks, splitting the plugin output into short output, long output
+ * and perfdata. Anything that touches objects (and logging) still
+ * happens in the main thread, which applies the parsed results in the
+ * order they were read, so results for one object can never overtake
+ * each other.
+ * The main thread is woken up through a pipe in the iobroker set when
+ * the oldest pending response is ready.
+ */
+struct wpres_item {
+	struct wproc_worker *wp;
+	char *buf;
+	unsigned long size;
+	struct kvvec *kvv;
+	int kv_pairs;
+	int unknown;
+	int done;
+	wproc_result wpres;
+	char *output;
+	check_output *parsed;
+	struct wpres_item *next;      /* next in the order we read them */
+	struct wpres_item *next_todo; /* next waiting for a thread */
+};
+
+static struct {
+	int threads;
+	int stop;
+	pthread_t *tids;
+	pthread_mutex_t lock;
+	pthread_cond_t todo_cond;  /* something to parse, or time to stop */
+	pthread_cond_t done_cond;  /* the oldest response is parsed */
+	struct wpres_item *todo, *todo_tail;
+	struct wpres_item *head, *tail;
+	int wake[2];
+} wpres_pool;
+
+static void wpres_item_parse(struct wpres_item *item)
+{
+	if (item->wp->proto == WORKER_PROTO_BINARY) {
+		/* there's no kvvec, but kv_pairs tells the main thread how it went */
+		item->kv_pairs = decode_result_frame(&item->wpres, item->buf, item->size) < 0 ? -1 : 1;
+	} else {
+		item->kv_pairs = buf2kvvec_prealloc(item->kvv, item->buf, item->size, '=', '\0', KVVEC_ASSIGN);
+		if (item->kv_pairs > 0)
+			item->unknown = parse_worker_result(&item->wpres, item->kvv);
+	}
+	if (item->kv_pairs <= 0 || item->wpres.type != WPJOB_CHECK)
+		return;
+
+	/* the slices point into item->output, which goes along with
+	 * them to the check result, so nothing is copied here. */
+	item->output = wproc_check_output(&item->wpres);
+	if ((item->parsed = malloc(sizeof(*item->parsed))))
+		parse_check_output_slices(item->output, item->parsed, FALSE);
+}
+
+static void wpres_item_destroy(struct wpres_item *item)
+{
+	my_free(item->output);
+	free_check_output(item->parsed);
+	if (item->kvv)
+		kvvec_destroy(item->kvv, 0);
+	free(item->buf);
+	free(item);
+}
+
+static void wpres_item_apply(struct wpres_item *item)
+{
+	if (item->kv_pairs <= 0 && item->wp->proto == WORKER_PROTO_BINARY) {
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "wproc: Failed to decode result frame with len %lu from %s\n",
+			  item->size, item->wp->name);
+	} else if (item->kv_pairs <= 0) {
+		logit(NSLOG_RUNTIME_ERROR, TRUE,
+			  "wproc: Failed to parse key/value vector from worker response with len %lu. First kv=%s",
+			  item->size, item->buf);
+	} else {
+		if (item->unknown)
+			log_unknown_result_variables(item->kvv);
+		handle_worker_response(item->wp, &item->wpres, item->output, item->parsed);
+		item->output = NULL;
+		item->parsed = NULL;
+	}
+	wpres_item_destroy(item);
+}
+
+static void *wpres_pool_thread(void *discard)
+{
+	struct wpres_item *item;
+
+	pthread_mutex_lock(&wpres_pool.lock);
+	for (;;) {
+		while (!wpres_pool.todo && !wpres_pool.stop)
+			pthread_cond_wait(&wpres_pool.todo_cond, &wpres_pool.lock);
+		if (wpres_pool.stop)
+			break;
+
+		item = wpres_pool.todo;
+		if (!(wpres_pool.todo = item->next_todo))
+			wpres_pool.todo_tail = NULL;
+		pthread_mutex_unlock(&wpres_pool.lock);
+
+		wpres_item_parse(item);
+
+		pthread_mutex_lock(&wpres_pool.lock);
+		item->done = 1;
+		if (item == wpres_pool.head) {
+			pthread_cond_signal(&wpres_pool.done_cond);
+			if (write(wpres_pool.wake[1], "", 1) < 0) {
+				/* if the pipe is full, the main thread is awake already */
+			}
+		}
+	}
+	pthread_mutex_unlock(&wpres_pool.lock);
+
+	return NULL;
+}
+
+/*
+ * Applies parsed results, oldest first, until we reach one that
+ * isn't parsed yet. If 'wait' is set, we wait for all of them.
+ */
+static void wpres_pool_apply(int wait)
+{
+	struct wpres_item *item;
+
+	for (;;) {
+		pthread_mutex_lock(&wpres_pool.lock);
+		while (wait && wpres_pool.head && !wpres_pool.head->done)
+			pthread_cond_wait(&wpres_pool.done_cond, &wpres_pool.lock);
+		item = wpres_pool.head;
+		if (!item || !item->done) {
+			pthread_mutex_unlock(&wpres_pool.lock);
+			return;
+		}
+		if (!(wpres_pool.head = item->next))
+			wpres_pool.tail = NULL;
+		pthread_mutex_unlock(&wpres_pool.lock);
+
+		wpres_item_apply(item);
+	}
+}
+
+static int wpres_pool_wakeup(int sd, int events, void *arg)
+{
+	char discard[64];
+
+	while (read(sd, discard, sizeof(discard)) > 0)
+		;
+	wpres_pool_apply(0);
+
+	return 0;
+}
+
+/* queues a worker response for parsing. Returns -1 on errors */
+static int wpres_pool_add(struct wproc_worker *wp, char *buf, unsigned long size)
+{
+	struct wpres_item *item;
+
+	if (!(item = calloc(1, sizeof(*item))))
+		return -1;
+	item->buf = malloc(size + 1);
+	if (wp->proto != WORKER_PROTO_BINARY)
+		item->kvv = kvvec_create(30);
+	if (!item->buf || (!item->kvv && wp->proto != WORKER_PROTO_BINARY)) {
+		wpres_item_destroy(item);
+		return -1;
+	}
+	memcpy(item->buf, buf, size);
+	item->buf[size] = 0;
+	item->size = size;
+	item->wp = wp;
+
+	pthread_mutex_lock(&wpres_pool.lock);
+	if (wpres_pool.tail)
+		wpres_pool.tail->next = item;
+	else
+		wpres_pool.head = item;
+	wpres_pool.tail = item;
+	if (wpres_pool.todo_tail)
+		wpres_pool.todo_tail->next_todo = item;
+	else
+		wpres_pool.todo = item;
+	wpres_pool.todo_tail = item;
+	pthread_cond_signal(&wpres_pool.todo_cond);
+	pthread_mutex_unlock(&wpres_pool.lock);
+
+	return 0;
+}
+
+static int wpres_pool_start(int threads)
+{
+	sigset_t all, old;
+	int i;
+
+	if (threads <= 0 || wpres_pool.threads)
+		return 0;
+
+	if (pipe(wpres_pool.wake) < 0) {
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "wproc: Failed to create result thread pipe: %s\n", strerror(errno));
+		return -1;
+	}
+	for (i = 0; i < 2; i++) {
+		fcntl(wpres_pool.wake[i], F_SETFL, fcntl(wpres_pool.wake[i], F_GETFL) | O_NONBLOCK);
+		fcntl(wpres_pool.wake[i], F_SETFD, FD_CLOEXEC);
+	}
+	wpres_pool.tids = calloc(threads, sizeof(pthread_t));
+	pthread_mutex_init(&wpres_pool.lock, NULL);
+	pthread_cond_init(&wpres_pool.todo_cond, NULL);
+	pthread_cond_init(&wpres_pool.done_cond, NULL);
+	wpres_pool.stop = 0;
+
+	/* signals are for the main thread only */
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	for (i = 0; wpres_pool.tids && i < threads; i++) {
+		if (pthread_create(&wpres_pool.tids[i], NULL, wpres_pool_thread, NULL))
+			break;
+	}
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	wpres_pool.threads = i;
+	if (i < threads) {
+		logit(NSLOG_RUNTIME_WARNING, TRUE, "wproc: Only started %d of %d result threads\n", i, threads);
+	}
+	if (!wpres_pool.threads) {
+		my_free(wpres_pool.tids);
+		close(wpres_pool.wake[0]);
+		close(wpres_pool.wake[1]);
+		return -1;
+	}
+	iobroker_register(nagios_iobs, wpres_pool.wake[0], NULL, wpres_pool_wakeup);
+	logit(NSLOG_INFO_MESSAGE, TRUE, "wproc: Parsing worker results in %d threads\n", wpres_pool.threads);
+
+	return 0;
+}
+
+/* stops the threads. Responses not yet applied are thrown away */
+static void wpres_pool_stop(void)
+{
+	struct wpres_item *item, *next;
+	int i;
+
+	if (!wpres_pool.threads)
+		return;
+
+	pthread_mutex_lock(&wpres_pool.lock);
+	wpres_pool.stop = 1;
+	pthread_cond_broadcast(&wpres_pool.todo_cond);
+	pthread_mutex_unlock(&wpres_pool.lock);
+	for (i = 0; i < wpres_pool.threads; i++)
+		pthread_join(wpres_pool.tids[i], NULL);
+
+	for (item = wpres_pool.head; item; item = next) {
+		next = item->next;
+		wpres_item_destroy(item);
+	}
+
+	if (nagios_iobs)
+		iobroker_close(nagios_iobs, wpres_pool.wake[0]);
+	else
+		close(wpres_pool.wake[0]);
+	close(wpres_pool.wake[1]);
+	pthread_cond_destroy(&wpres_pool.done_cond);
+	pthread_cond_destroy(&wpres_pool.todo_cond);
+	pthread_mutex_destroy(&wpres_pool.lock);
+	my_free(wpres_pool.tids);
+	memset(&wpres_pool, 0, sizeof(wpres_pool));
+}
+
+/* handles everything a worker using the binary protocol has sent us */
+static void handle_worker_frames(struct wproc_worker *wp)
+{
+	struct worker_frame frame;
+	unsigned long size;
+	char *buf;
+	int ret;
+
+	while ((ret = worker_ioc2frame(wp->ioc, &buf, &size)) > 0) {
+		memcpy(&frame, buf, sizeof(frame));
+		if (frame.kind == WORKER_FRAME_LOG) {
+			if (size > sizeof(frame) && !buf[size - 1])
+				logit(NSLOG_INFO_MESSAGE, TRUE, "wproc: %s: %s\n", wp->name, buf + sizeof(frame));
+			continue;
+		}
+
+		if (wpres_pool.threads) {
+			if (!wpres_pool_add(wp, buf, size))
+				continue;
+			/* out of memory. Keep things in order and do it here */
+			wpres_pool_apply(1);
+		}
+		handle_worker_frame(wp, buf, size);
+	}
+
+	if (ret < 0) {
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "wproc: Garbage from %s. Discarding %lu bytes of results\n",
+			  wp->name, iocache_available(wp->ioc));
+		iocache_reset(wp->ioc);
+	}
+}
+
+static int handle_worker_result(int sd, int events, void *arg)
+{
+	char *buf;
 	unsigned long size;
 	int ret;
-	static struct kvvec kvv = KVVEC_INITIALIZER;
 	struct wproc_worker *wp = (struct wproc_worker *)arg;
 
 	if(iocache_capacity(wp->ioc) == 0) {
@@ -630,6 +1427,9 @@ static int handle_worker_result(int sd, int events, void *arg)
 		return 0;
 	} else if (ret == 0) {
 		logit(NSLOG_INFO_MESSAGE, TRUE, "wproc: Socket to worker %s broken, removing", wp->name);
+		/* finish what this worker already sent us before it goes away */
+		if (wpres_pool.threads)
+			wpres_pool_apply(1);
 		wproc_num_workers_online--;
 		iobroker_unregister(nagios_iobs, sd);
 		if (workers.len <= 0) {
@@ -644,163 +1444,24 @@ static int handle_worker_result(int sd, int events, void *arg)
 		wproc_destroy(wp, 0);
 		return 0;
 	}
+	if (wp->proto == WORKER_PROTO_BINARY) {
+		handle_worker_frames(wp);
+		return 0;
+	}
 	while ((buf = worker_ioc2msg(wp->ioc, &size, 0))) {
-		struct wproc_job *job;
-		wproc_result wpres;
-
 		/* log messages are handled first */
 		if (size > 5 && !memcmp(buf, "log=", 4)) {
 			logit(NSLOG_INFO_MESSAGE, TRUE, "wproc: %s: %s\n", wp->name, buf + 4);
 			continue;
 		}
 
-		/* for everything else we need to actually parse */
-		if (buf2kvvec_prealloc(&kvv, buf, size, '=', '\0', KVVEC_ASSIGN) <= 0) {
-			logit(NSLOG_RUNTIME_ERROR, TRUE,
-				  "wproc: Failed to parse key/value vector from worker response with len %lu. First kv=%s",
-				  size, buf ? buf : "(NULL)");
-			continue;
-		}
-
-		memset(&wpres, 0, sizeof(wpres));
-		wpres.job_id = -1;
-		wpres.type = -1;
-		wpres.response = &kvv;
-		parse_worker_result(&wpres, &kvv);
-
-		job = get_job(wp, wpres.job_id);
-		if (!job) {
-			logit(NSLOG_RUNTIME_WARNING, TRUE, "wproc: Job with id '%d' doesn't exist on %s.\n",
-				  wpres.job_id, wp->name);
-			continue;
-		}
-		if (wpres.type != job->type) {
-			logit(NSLOG_RUNTIME_WARNING, TRUE, "wproc: %s claims job %d is type %d, but we think it's type %d\n",
-				  wp->name, job->id, wpres.type, job->type);
-			break;
-		}
-		oj = (wproc_object_job *)job->arg;
-
-		/*
-		 * ETIME ("Timer expired") doesn't really happen
-		 * on any modern systems, so we reuse it to mean
-		 * "program timed out"
-		 */
-		if (wpres.error_code == ETIME) {
-			wpres.early_timeout = TRUE;
-		}
-		if (wpres.early_timeout) {
-			asprintf(&error_reason, "timed out after %.2fs", tv_delta_f(&wpres.start, &wpres.stop));
-		}
-		else if (WIFSIGNALED(wpres.wait_status)) {
-			asprintf(&error_reason, "died by signal %d%s after %.2f seconds",
-			         WTERMSIG(wpres.wait_status),
-			         WCOREDUMP(wpres.wait_status) ? " (core dumped)" : "",
-			         tv_delta_f(&wpres.start, &wpres.stop));
-		}
-		else if (job->type != WPJOB_CHECK && WEXITSTATUS(wpres.wait_status) != 0) {
-			asprintf(&error_reason, "is a non-check helper but exited with return code %d",
-			         WEXITSTATUS(wpres.wait_status));
-		}
-		if (error_reason) {
-			logit(NSLOG_RUNTIME_ERROR, TRUE, "wproc: %s job %d from worker %s %s",
-			      wpjob_type_name(job->type), job->id, wp->name, error_reason);
-#ifdef DEBUG
-			/* The log below could leak sensitive information, such as 
-				passwords, so only enable it if you really need it */
-			logit(NSLOG_RUNTIME_ERROR, TRUE, "wproc:   command: %s\n", job->command);
-#endif
-			if (job->type != WPJOB_CHECK && oj) {
-				logit(NSLOG_RUNTIME_ERROR, TRUE, "wproc:   host=%s; service=%s; contact=%s\n",
-				      oj->host_name ? oj->host_name : "(none)",
-				      oj->service_description ? oj->service_description : "(none)",
-				      oj->contact_name ? oj->contact_name : "(none)");
-			} else if (oj) {
-				struct check_result *cr = (struct check_result *)job->arg;
-				logit(NSLOG_RUNTIME_ERROR, TRUE, "wproc:   host=%s; service=%s;\n",
-				      cr->host_name, cr->service_description);
-			}
-			logit(NSLOG_RUNTIME_ERROR, TRUE, "wproc:   early_timeout=%d; exited_ok=%d; wait_status=%d; error_code=%d;\n",
-			      wpres.early_timeout, wpres.exited_ok, wpres.wait_status, wpres.error_code);
-			wproc_logdump_buffer(NSLOG_RUNTIME_ERROR, TRUE, "wproc:   stderr", wpres.outerr);
-			wproc_logdump_buffer(NSLOG_RUNTIME_ERROR, TRUE, "wproc:   stdout", wpres.outstd);
-		}
-		my_free(error_reason);
-
-		switch (job->type) {
-		case WPJOB_CHECK:
-			ret = handle_worker_check(&wpres, wp, job);
-			break;
-		case WPJOB_NOTIFY:
-			if (wpres.early_timeout) {
-				if (oj->service_description) {
-					logit(NSLOG_RUNTIME_WARNING, TRUE, "Warning: Notifying contact '%s' of service '%s' on host '%s' by command '%s' timed out after %.2f seconds\n",
-						  oj->contact_name, oj->service_description,
-						  oj->host_name, job->command,
-						  tv2float(&wpres.runtime));
-				} else {
-					logit(NSLOG_RUNTIME_WARNING, TRUE, "Warning: Notifying contact '%s' of host '%s' by command '%s' timed out after %.2f seconds\n",
-						  oj->contact_name, oj->host_name,
-						  job->command, tv2float(&wpres.runtime));
-				}
-			}
-			break;
-		case WPJOB_OCSP:
-			if (wpres.early_timeout) {
-				logit(NSLOG_RUNTIME_WARNING, TRUE, "Warning: OCSP command '%s' for service '%s' on host '%s' timed out after %.2f seconds\n",
-					  job->command, oj->service_description, oj->host_name,
-					  tv2float(&wpres.runtime));
-			}
-			break;
-		case WPJOB_OCHP:
-			if (wpres.early_timeout) {
-				logit(NSLOG_RUNTIME_WARNING, TRUE, "Warning: OCHP command '%s' for host '%s' timed out after %.2f seconds\n",
-					  job->command, oj->host_name, tv2float(&wpres.runtime));
-			}
-			break;
-		case WPJOB_GLOBAL_SVC_EVTHANDLER:
-			if (wpres.early_timeout) {
-				logit(NSLOG_EVENT_HANDLER | NSLOG_RUNTIME_WARNING, TRUE,
-					  "Warning: Global service event handler command '%s' timed out after %.2f seconds\n",
-					  job->command, tv2float(&wpres.runtime));
-			}
-			break;
-		case WPJOB_SVC_EVTHANDLER:
-			if (wpres.early_timeout) {
-				logit(NSLOG_EVENT_HANDLER | NSLOG_RUNTIME_WARNING, TRUE,
-					  "Warning: Service event handler command '%s' timed out after %.2f seconds\n",
-					  job->command, tv2float(&wpres.runtime));
-			}
-			break;
-		case WPJOB_GLOBAL_HOST_EVTHANDLER:
-			if (wpres.early_timeout) {
-				logit(NSLOG_EVENT_HANDLER | NSLOG_RUNTIME_WARNING, TRUE,
-					  "Warning: Global host event handler command '%s' timed out after %.2f seconds\n",
-					  job->command, tv2float(&wpres.runtime));
-			}
-			break;
-		case WPJOB_HOST_EVTHANDLER:
-			if (wpres.early_timeout) {
-				logit(NSLOG_EVENT_HANDLER | NSLOG_RUNTIME_WARNING, TRUE,
-					  "Warning: Host event handler command '%s' timed out after %.2f seconds\n",
-					  job->command, tv2float(&wpres.runtime));
-			}
-			break;
-
-		case WPJOB_CALLBACK:
-			run_job_callback(job, &wpres, 0);
-			break;
-
-		case WPJOB_HOST_PERFDATA:
-		case WPJOB_SVC_PERFDATA:
-			/* these require nothing special */
-			break;
-
-		default:
-			logit(NSLOG_RUNTIME_WARNING, TRUE, "Worker %ld: Unknown jobtype: %d\n", (long)wp->pid, job->type);
-			break;
+		if (wpres_pool.threads) {
+			if (!wpres_pool_add(wp, buf, size))
+				continue;
+			/* out of memory. Keep things in order and do it here */
+			wpres_pool_apply(1);
 		}
-		destroy_job(job);
+		handle_worker_message(wp, buf, size);
 	}
 
 	return 0;
@@ -856,6 +1517,10 @@ static int register_worker(int sd, char *buf, unsigned int len)
 		else if (!strcmp(kv->key, "max_jobs")) {
 			worker->max_jobs = atoi(kv->value);
 		}
+		else if (!strcmp(kv->key, "protocol")) {
+			if (!strcmp(kv->value, "binary"))
+				worker->proto = WORKER_PROTO_BINARY;
+		}
 		else if (!strcmp(kv->key, "plugin")) {
 			struct wproc_list *command_handlers;
 			is_global = 0;
@@ -891,10 +1556,15 @@ static int register_worker(int sd, char *buf, unsigned int len)
 		workers.wps = realloc(workers.wps, workers.len * sizeof(struct wproc_worker *));
 		workers.wps[workers.len - 1] = worker;
 		worker->wp_list = &workers;
+		assign_affinity_groups();
 	}
 	wproc_num_workers_online++;
 	kvvec_destroy(info, 0);
-	nsock_printf_nul(sd, "OK");
+	/* workers asking for a protocol we don't know get the default */
+	if (worker->proto == WORKER_PROTO_BINARY)
+		nsock_printf_nul(sd, "OK protocol=binary");
+	else
+		nsock_printf_nul(sd, "OK");
 
 	/* signal query handler to release its iocache for this one */
 	return QH_TAKEOVER;
@@ -907,9 +1577,13 @@ static int wproc_query_handler(int sd, char *buf, unsigned int len)
 	if (!*buf || !strcmp(buf, "help")) {
 		nsock_printf_nul(sd, "Control worker processes.\n"
 			"Valid commands:\n"
-			"  wpstats              Print general job information\n"
+			"  wpstats              Print general job information, including the\n"
+			"                       number of jobs that took <1ms, <2ms, <4ms...\n"
+			"                       from dispatch to result on each worker\n"
 			"  register <options>   Register a new worker\n"
-			"                       <options> can be name, pid, max_jobs and/or plugin.\n"
+			"                       <options> can be name, pid, max_jobs, protocol\n"
+			"                       and/or plugin. protocol=binary asks to send\n"
+			"                       results as binary frames.\n"
 			"                       There can be many plugin args.");
 		return 0;
 	}
@@ -927,9 +1601,16 @@ static int wproc_query_handler(int sd, char *buf, unsigned int len)
 
 		for (i = 0; i < workers.len; i++) {
 			struct wproc_worker *wp = workers.wps[i];
-			nsock_printf(sd, "name=%s;pid=%ld;jobs_running=%u;jobs_started=%u\n",
+			unsigned int b;
+			nsock_printf(sd, "name=%s;pid=%ld;jobs_running=%u;jobs_started=%u;",
 					wp->name, (long)wp->pid,
 					wp->jobs_running, wp->jobs_started);
+			if (num_affinity_groups)
+				nsock_printf(sd, "group=%u;", i % num_affinity_groups);
+			nsock_printf(sd, "latency=");
+			for (b = 0; b < WPROC_LATENCY_BUCKETS; b++)
+				nsock_printf(sd, b ? ",%u" : "%u", wp->latency[b]);
+			nsock_printf(sd, "\n");
 		}
 		return 0;
 	}
@@ -939,9 +1620,13 @@ static int wproc_query_handler(int sd, char *buf, unsigned int len)
 
 static int spawn_core_worker(void)
 {
-	char *argvec[] = {nagios_binary_path, "--worker", qh_socket_path ? qh_socket_path : DEFAULT_QUERY_SOCKET, NULL};
+	char *argvec[] = {nagios_binary_path, "--worker", qh_socket_path ? qh_socket_path : DEFAULT_QUERY_SOCKET, NULL, NULL};
 	int ret;
 
+	/* workers don't read the config, so tell them on the command line */
+	if (plugin_spawn_method == RUNCMD_SPAWN_POSIX)
+		argvec[3] = "--posix-spawn";
+
 	if ((ret = spawn_helper(argvec)) < 0)
 		logit(NSLOG_RUNTIME_ERROR, TRUE, "wproc: Failed to launch core worker: %s\n", strerror(errno));
 	else
@@ -990,6 +1675,12 @@ int init_workers(int desired_workers)
 	}
 	wproc_num_workers_desired = desired_workers;
 
+	/* worker_affinity_groups may have changed on reload */
+	assign_affinity_groups();
+
+	if (wpres_pool_start(check_result_threads) < 0)
+		logit(NSLOG_RUNTIME_WARNING, TRUE, "wproc: Parsing worker results in the main thread\n");
+
 	if (workers_alive() == desired_workers)
 		return 0;
 
@@ -1003,6 +1694,37 @@ int init_workers(int desired_workers)
 	return 0;
 }
 
+/* is the command a plugin from the persistent_plugins list? */
+static int is_persistent_plugin(const char *cmd)
+{
+	const char *p, *next;
+	size_t len;
+
+	if (!persistent_plugins || *cmd != '/')
+		return 0;
+
+	len = strcspn(cmd, " \t");
+	for (p = persistent_plugins; *p; p = next) {
+		size_t plen;
+
+		if (!(next = strchr(p, ',')))
+			next = p + strlen(p);
+		plen = next - p;
+		if (*next)
+			next++;
+
+		while (plen && (*p == ' ' || *p == '\t')) {
+			p++;
+			plen--;
+		}
+		while (plen && (p[plen - 1] == ' ' || p[plen - 1] == '\t'))
+			plen--;
+		if (plen == len && !memcmp(p, cmd, len))
+			return 1;
+	}
+	return 0;
+}
+
 /*
  * Handles adding the command and macros to the kvvec,
  * as well as shipping the command off to a designated
@@ -1030,6 +1752,15 @@ static int wproc_run_job(struct wproc_job *job, nagios_macros *mac)
 	kvvec_addkv(&kvv, "type", (char *)mkstr("%d", job->type));
 	kvvec_addkv(&kvv, "command", job->command);
 	kvvec_addkv(&kvv, "timeout", (char *)mkstr("%u", job->timeout));
+	if (job->type == WPJOB_CHECK && is_persistent_plugin(job->command))
+		kvvec_addkv(&kvv, "persistent", "1");
+
+	/* workers exec these directly instead of parsing the command */
+	if (job->argv) {
+		char **arg;
+		for (arg = job->argv; *arg; arg++)
+			kvvec_addkv(&kvv, "arg", *arg);
+	}
 
 	/* Add the macro environment variables */
 	if(mac) {
@@ -1054,6 +1785,7 @@ static int wproc_run_job(struct wproc_job *job, nagios_macros *mac)
 		destroy_job(job);
 		result = ERROR;
 	} else {
+		gettimeofday(&job->sent, NULL);
 		wp->jobs_running++;
 		wp->jobs_started++;
 		loadctl.jobs_running++;
@@ -1124,7 +1856,7 @@ int wproc_run_host_job(int jtype, int timeout, host *hst, char *cmd, nagios_macr
 	return wproc_run_job(job, mac);
 }
 
-int wproc_run_check(check_result *cr, char *cmd, nagios_macros *mac)
+int wproc_run_check(check_result *cr, char *cmd, char **argv, nagios_macros *mac)
 {
 	struct wproc_job *job;
 	int timeout;
@@ -1135,6 +1867,10 @@ int wproc_run_check(check_result *cr, char *cmd, nagios_macros *mac)
 		timeout = host_check_timeout;
 
 	job = create_job(WPJOB_CHECK, cr, timeout, cmd);
+	if (job)
+		job->argv = argv;
+	else
+		my_free(argv);
 	return wproc_run_job(job, mac);
 }
 
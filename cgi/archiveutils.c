@@ -319,8 +319,7 @@ int read_archived_data(time_t start_time, time_t end_time,
 int read_log_file(char *filename, unsigned obj_types, unsigned state_types, 
 		unsigned log_types, au_log *log) {
 	char *input = NULL;
-	char *input2 = NULL;
-	char *temp_buffer = NULL;
+	size_t input_size = 0;
 	time_t time_stamp;
 	mmapfile *thefile = NULL;
 	int	retval = 1;
@@ -331,22 +330,14 @@ int read_log_file(char *filename, unsigned obj_types, unsigned state_types,
 
 	while(1) {
 
-		/* free memory */
-		free(input);
-		free(input2);
-		input = NULL;
-		input2 = NULL;
-
-		/* read the next line */
-		if((input = mmap_fgets(thefile)) == NULL) break;
+		/* read the next line, reusing the buffer */
+		if(mmap_getline(thefile, &input, &input_size) < 0) break;
 
 		strip(input);
 
-		if((input2 = strdup(input)) == NULL) continue;
-
-		temp_buffer = my_strtok(input2, "]");
-		time_stamp = (temp_buffer == NULL) ? (time_t)0 : 
-				(time_t)strtoul(temp_buffer + 1, NULL, 10);
+		/* the timestamp is the number after the leading '[' */
+		time_stamp = (input[0] == '\x0') ? (time_t)0 : 
+				(time_t)strtoul(input + 1, NULL, 10);
 
 		/* program starts/restarts */
 		if(strstr(input, " starting...")) {
@@ -493,7 +484,6 @@ int read_log_file(char *filename, unsigned obj_types, unsigned state_types,
 
 	/* free memory and close the file */
 	free(input);
-	free(input2);
 	mmap_fclose(thefile);
 	return retval;
 	}
@@ -505,6 +505,16 @@ int read_main_config_file(const char *filename) {
 			temp_buffer = strtok(NULL, "\x0");
 			status_file = nspath_absolute(temp_buffer, config_file_dir);
 			}
+		else if(strstr(input, "status_store_file=") == input) {
+			temp_buffer = strtok(input, "=");
+			temp_buffer = strtok(NULL, "\x0");
+			status_store_file = nspath_absolute(temp_buffer, config_file_dir);
+			}
+		else if(strstr(input, "status_index_file=") == input) {
+			temp_buffer = strtok(input, "=");
+			temp_buffer = strtok(NULL, "\x0");
+			status_index_file = nspath_absolute(temp_buffer, config_file_dir);
+			}
 
 		else if(strstr(input, "log_archive_path=") == input) {
 			temp_buffer = strtok(input, "=");
@@ -459,7 +459,8 @@ void get_history(void) {
 	char image[MAX_INPUT_BUFFER];
 	char image_alt[MAX_INPUT_BUFFER];
 	char *input = NULL;
-	char *input2 = NULL;
+	char *line_buf = NULL;
+	size_t line_size = 0;
 	char match1[MAX_INPUT_BUFFER];
 	char match2[MAX_INPUT_BUFFER];
 	int found_line = FALSE;
@@ -507,16 +508,16 @@ void get_history(void) {
 
 	while(1) {
 
-		my_free(input);
-		my_free(input2);
-
 		if(use_lifo == TRUE) {
+			my_free(input);
 			if((input = pop_lifo()) == NULL)
 				break;
 			}
 		else {
-			if((input = mmap_fgets(thefile)) == NULL)
+			/* every line of the file is read into the same buffer */
+			if(mmap_getline(thefile, &line_buf, &line_size) < 0)
 				break;
+			input = line_buf;
 			}
 
 		strip(input);
@@ -525,16 +526,13 @@ void get_history(void) {
 		strcpy(image_alt, "");
 		system_message = FALSE;
 
-		if((input2 = (char *)strdup(input)) == NULL)
-			continue;
-
 		/* service state alerts */
 		if(strstr(input, "SERVICE ALERT:")) {
 
 			history_type = SERVICE_HISTORY;
 
 			/* get host and service names */
-			temp_buffer = my_strtok(input2, "]");
+			temp_buffer = my_strtok(input, "]");
 			temp_buffer = my_strtok(NULL, ":");
 			temp_buffer = my_strtok(NULL, ";");
 			if(temp_buffer)
@@ -578,7 +576,7 @@ void get_history(void) {
 			history_type = SERVICE_FLAPPING_HISTORY;
 
 			/* get host and service names */
-			temp_buffer = my_strtok(input2, "]");
+			temp_buffer = my_strtok(input, "]");
 			temp_buffer = my_strtok(NULL, ":");
 			temp_buffer = my_strtok(NULL, ";");
 			if(temp_buffer)
@@ -610,7 +608,7 @@ void get_history(void) {
 			history_type = SERVICE_DOWNTIME_HISTORY;
 
 			/* get host and service names */
-			temp_buffer = my_strtok(input2, "]");
+			temp_buffer = my_strtok(input, "]");
 			temp_buffer = my_strtok(NULL, ":");
 			temp_buffer = my_strtok(NULL, ";");
 			if(temp_buffer)
@@ -639,7 +637,7 @@ void get_history(void) {
 			history_type = HOST_HISTORY;
 
 			/* get host name */
-			temp_buffer = my_strtok(input2, "]");
+			temp_buffer = my_strtok(input, "]");
 			temp_buffer = my_strtok(NULL, ":");
 			temp_buffer = my_strtok(NULL, ";");
 			if(temp_buffer)
@@ -673,7 +671,7 @@ void get_history(void) {
 			history_type = HOST_FLAPPING_HISTORY;
 
 			/* get host name */
-			temp_buffer = my_strtok(input2, "]");
+			temp_buffer = my_strtok(input, "]");
 			temp_buffer = my_strtok(NULL, ":");
 			temp_buffer = my_strtok(NULL, ";");
 			if(temp_buffer)
@@ -700,7 +698,7 @@ void get_history(void) {
 			history_type = HOST_DOWNTIME_HISTORY;
 
 			/* get host name */
-			temp_buffer = my_strtok(input2, "]");
+			temp_buffer = my_strtok(input, "]");
 			temp_buffer = my_strtok(NULL, ":");
 			temp_buffer = my_strtok(NULL, ";");
 			if(temp_buffer)
@@ -929,8 +927,9 @@ void get_history(void) {
 
 	printf("<HR>\n");
 
-	my_free(input);
-	my_free(input2);
+	if(use_lifo == TRUE)
+		my_free(input);
+	my_free(line_buf);
 
 	if(use_lifo == TRUE)
 		free_lifo_memory();
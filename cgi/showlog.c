@@ -264,6 +264,8 @@ int process_cgivars(void) {
 /* display the contents of the log file */
 int display_log(void) {
 	char *input = NULL;
+	char *line_buf = NULL;
+	size_t line_size = 0;
 	char image[MAX_INPUT_BUFFER];
 	char image_alt[MAX_INPUT_BUFFER];
 	time_t t;
@@ -318,14 +320,17 @@ int display_log(void) {
 
 		while(1) {
 
-			free(input);
-
 			if(use_lifo == TRUE) {
+				free(input);
 				if((input = pop_lifo()) == NULL)
 					break;
 				}
-			else if((input = mmap_fgets(thefile)) == NULL)
-				break;
+			else {
+				/* every line of the file is read into the same buffer */
+				if(mmap_getline(thefile, &line_buf, &line_size) < 0)
+					break;
+				input = line_buf;
+				}
 
 			strip(input);
 
@@ -505,7 +510,9 @@ int display_log(void) {
 		printf("</DIV></P>\n");
 		printf("<HR>\n");
 
-		free(input);
+		if(use_lifo == TRUE)
+			free(input);
+		free(line_buf);
 
 		if(use_lifo == FALSE)
 			mmap_fclose(thefile);
@@ -97,6 +97,82 @@ static const struct macro_key_code *find_macro_key(const char *name) {
 	}
 
 
+/*
+ * gets the text process_macros_r() puts in place of "$name$", which is the
+ * value of the macro, URL encoded and cleaned as the options say. the name
+ * may be modified. free_value is set if the caller must free the result.
+ */
+char *get_processed_macro_r(nagios_macros *mac, char *name, int options, int *free_value) {
+	char *selected_macro = NULL;
+	char *original_macro = NULL;
+	char *cleaned_macro = NULL;
+	int macro_options = 0;
+	int result = OK;
+
+	/* grab the macro value */
+	*free_value = FALSE;
+	result = grab_macro_value_r(mac, name, &selected_macro, &macro_options, free_value);
+	log_debug_info(DEBUGL_MACROS, 2, "  Processed '%s', Free: %d\n", name, *free_value);
+
+	if(result != OK) {
+		/* an error occurred - we couldn't parse the macro, so continue on */
+		log_debug_info(DEBUGL_MACROS, 0, " WARNING: An error occurred processing macro '%s'!\n", name);
+		if(*free_value == TRUE)
+			my_free(selected_macro);
+
+		/* an escaped $ is done by specifying two $$ next to each other */
+		if(!strcmp(name, "")) {
+			log_debug_info(DEBUGL_MACROS, 2, "  Escaped $.\n");
+			*free_value = FALSE;
+			return "$";
+			}
+
+		/* a non-macro, just some user-defined string between two $s */
+		log_debug_info(DEBUGL_MACROS, 2, "  Non-macro.\n");
+		if((selected_macro = (char *)malloc(strlen(name) + 3)) == NULL) {
+			*free_value = FALSE;
+			return "";
+			}
+		sprintf(selected_macro, "$%s$", name);
+		*free_value = TRUE;
+		return selected_macro;
+		}
+
+	if(selected_macro == NULL) {
+		*free_value = FALSE;
+		return "";
+		}
+
+	log_debug_info(DEBUGL_MACROS, 2, "  Processed '%s', Free: %d,  Cleaning options: %d\n", name, *free_value, options);
+
+	/* URL encode the macro if requested - this allocates new memory */
+	if(options & URL_ENCODE_MACRO_CHARS) {
+		original_macro = selected_macro;
+		selected_macro = get_url_encoded_string(selected_macro);
+		if(*free_value == TRUE) {
+			my_free(original_macro);
+			}
+		*free_value = TRUE;
+		}
+
+	/* some macros should sometimes be cleaned */
+	if(macro_options & options & (STRIP_ILLEGAL_MACRO_CHARS | ESCAPE_MACRO_CHARS)) {
+
+		/* clean_macro_chars() only allocates memory for non-empty strings */
+		cleaned_macro = clean_macro_chars(selected_macro, options);
+		original_macro = selected_macro;
+		selected_macro = (cleaned_macro && *original_macro) ? cleaned_macro : NULL;
+		if(*free_value == TRUE)
+			my_free(original_macro);
+		*free_value = selected_macro ? TRUE : FALSE;
+		log_debug_info(DEBUGL_MACROS, 2, "  Cleaned macro.\n");
+		return selected_macro ? selected_macro : "";
+		}
+
+	return selected_macro;
+	}
+
+
 /*
  * replace macros in notification commands with their values,
  * the thread-safe version
@@ -108,10 +184,7 @@ int process_macros_r(nagios_macros *mac, char *input_buffer, char **output_buffe
 	char *delim_ptr = NULL;
 	int in_macro = FALSE;
 	char *selected_macro = NULL;
-	char *original_macro = NULL;
-	int result = OK;
 	int free_macro = FALSE;
-	int macro_options = 0;
 
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "process_macros_r()\n");
 
@@ -162,84 +235,15 @@ int process_macros_r(nagios_macros *mac, char *input_buffer, char **output_buffe
 
 		/* looks like we're in a macro, so process it... */
 		else {
-			/* grab the macro value */
-			free_macro = FALSE;
-			result = grab_macro_value_r(mac, temp_buffer, &selected_macro, &macro_options, &free_macro);
-			log_debug_info(DEBUGL_MACROS, 2, "  Processed '%s', Free: %d\n", temp_buffer, free_macro);
-
-			/* an error occurred - we couldn't parse the macro, so continue on */
-			if(result == ERROR) {
-				log_debug_info(DEBUGL_MACROS, 0, " WARNING: An error occurred processing macro '%s'!\n", temp_buffer);
-				if(free_macro == TRUE)
-					my_free(selected_macro);
-				}
-
-			if (result == OK)
-				; /* do nothing special if things worked out ok */
-			/* an escaped $ is done by specifying two $$ next to each other */
-			else if(!strcmp(temp_buffer, "")) {
-				log_debug_info(DEBUGL_MACROS, 2, "  Escaped $.  Running output (%lu): '%s'\n", (unsigned long)strlen(*output_buffer), *output_buffer);
-				*output_buffer = (char *)realloc(*output_buffer, strlen(*output_buffer) + 2);
-				strcat(*output_buffer, "$");
-				}
-
-			/* a non-macro, just some user-defined string between two $s */
-			else {
-				log_debug_info(DEBUGL_MACROS, 2, "  Non-macro.  Running output (%lu): '%s'\n", (unsigned long)strlen(*output_buffer), *output_buffer);
-
-				/* add the plain text to the end of the already processed buffer */
-				*output_buffer = (char *)realloc(*output_buffer, strlen(*output_buffer) + strlen(temp_buffer) + 3);
-				strcat(*output_buffer, "$");
-				strcat(*output_buffer, temp_buffer);
-				strcat(*output_buffer, "$");
-				}
-
-			/* insert macro */
-			if(selected_macro != NULL) {
-				log_debug_info(DEBUGL_MACROS, 2, "  Processed '%s', Free: %d,  Cleaning options: %d\n", temp_buffer, free_macro, options);
-
-				/* URL encode the macro if requested - this allocates new memory */
-				if(options & URL_ENCODE_MACRO_CHARS) {
-					original_macro = selected_macro;
-					selected_macro = get_url_encoded_string(selected_macro);
-					if(free_macro == TRUE) {
-						my_free(original_macro);
-						}
-					free_macro = TRUE;
-					}
-
-				/* some macros should sometimes be cleaned */
-				if(macro_options & options & (STRIP_ILLEGAL_MACRO_CHARS | ESCAPE_MACRO_CHARS)) {
-					char *cleaned_macro = NULL;
-
-					/* add the (cleaned) processed macro to the end of the already processed buffer */
-					if(selected_macro != NULL && (cleaned_macro = clean_macro_chars(selected_macro, options)) != NULL) {
-						*output_buffer = (char *)realloc(*output_buffer, strlen(*output_buffer) + strlen(cleaned_macro) + 1);
-						strcat(*output_buffer, cleaned_macro);
-						if(*cleaned_macro)
-							my_free(cleaned_macro);
-
-						log_debug_info(DEBUGL_MACROS, 2, "  Cleaned macro.  Running output (%lu): '%s'\n", (unsigned long)strlen(*output_buffer), *output_buffer);
-						}
-					}
+			selected_macro = get_processed_macro_r(mac, temp_buffer, options, &free_macro);
 
-				/* others are not cleaned */
-				else {
-					/* add the processed macro to the end of the already processed buffer */
-					if(selected_macro != NULL) {
-						*output_buffer = (char *)realloc(*output_buffer, strlen(*output_buffer) + strlen(selected_macro) + 1);
-						strcat(*output_buffer, selected_macro);
-
-						log_debug_info(DEBUGL_MACROS, 2, "  Uncleaned macro.  Running output (%lu): '%s'\n", (unsigned long)strlen(*output_buffer), *output_buffer);
-						}
-					}
-
-				/* free memory if necessary (if we URL encoded the macro or we were told to do so by grab_macro_value()) */
-				if(free_macro == TRUE)
-					my_free(selected_macro);
+			/* add the processed macro to the end of the already processed buffer */
+			*output_buffer = (char *)realloc(*output_buffer, strlen(*output_buffer) + strlen(selected_macro) + 1);
+			strcat(*output_buffer, selected_macro);
+			if(free_macro == TRUE)
+				my_free(selected_macro);
 
-				log_debug_info(DEBUGL_MACROS, 2, "  Just finished macro.  Running output (%lu): '%s'\n", (unsigned long)strlen(*output_buffer), *output_buffer);
-				}
+			log_debug_info(DEBUGL_MACROS, 2, "  Just finished macro.  Running output (%lu): '%s'\n", (unsigned long)strlen(*output_buffer), *output_buffer);
 
 			in_macro = FALSE;
 			}
@@ -1611,6 +1611,181 @@ customvariablesmember *add_custom_variable_to_service(service *svc, char *varnam
 
 
 
+#ifdef NSCORE
+/* adds a part to an argv template under construction */
+static int add_command_part(command_part *parts, int *num_parts, const char *text, size_t len, int is_macro, int quoting, int *word_start) {
+	command_part *part = &parts[*num_parts];
+
+	if((part->text = malloc(len + 1)) == NULL)
+		return ERROR;
+	memcpy(part->text, text, len);
+	part->text[len] = '\x0';
+	part->is_macro = is_macro;
+	part->quoting = quoting;
+	part->word_start = *word_start;
+	*word_start = FALSE;
+	(*num_parts)++;
+
+	return OK;
+	}
+
+
+/* adds the literal text collected so far, if any or if forced, as a part */
+static int add_literal_part(command_part *parts, int *num_parts, const char *lit, size_t *lit_len, int force, int quoting, int *word_start) {
+	int result = OK;
+
+	if(*lit_len || force)
+		result = add_command_part(parts, num_parts, lit, *lit_len, FALSE, quoting, word_start);
+	*lit_len = 0;
+
+	return result;
+	}
+#endif
+
+
+/* frees the argv template of a command */
+static void free_argv_template(command *cmd) {
+	int x;
+
+	for(x = 0; x < cmd->num_parts; x++)
+		my_free(cmd->argv_template[x].text);
+	my_free(cmd->argv_template);
+	cmd->num_parts = 0;
+	}
+
+
+#ifdef NSCORE
+/*
+ * Splits a command line into words the way runcmd_cmd2strv() will split
+ * it once its macros are expanded, keeping each $MACRO$ as a part of its
+ * own. Checks can then build their argv from the macro values without
+ * having it parsed again in the worker. Commands that need a shell, or
+ * that we can't be sure about, get no template and are run as before.
+ */
+static void add_argv_template(command *cmd) {
+	command_part *parts = NULL;
+	const char *p, *end;
+	char *lit = NULL;
+	size_t len, lit_len = 0;
+	int num_parts = 0, quoting = CMD_QUOTE_NONE, word_start = TRUE, x;
+
+	len = strlen(cmd->command_line);
+
+	/* a command line can't have more parts than characters */
+	if((parts = calloc(len + 1, sizeof(*parts))) == NULL || (lit = malloc(len + 1)) == NULL)
+		goto shell;
+
+	for(p = cmd->command_line; *p; p++) {
+
+		/* macros are expanded before the command is split into words */
+		if(*p == '$') {
+			if((end = strchr(p + 1, '$')) == NULL)
+				goto shell;
+
+			/* "$$" is a dollar sign, which only single quotes keep from the shell */
+			if(end == p + 1) {
+				if(quoting != CMD_QUOTE_SINGLE)
+					goto shell;
+				lit[lit_len++] = '$';
+				}
+			else {
+				if(add_literal_part(parts, &num_parts, lit, &lit_len, FALSE, quoting, &word_start) != OK)
+					goto shell;
+				if(add_command_part(parts, &num_parts, p + 1, end - p - 1, TRUE, quoting, &word_start) != OK)
+					goto shell;
+				}
+			p = end;
+			continue;
+			}
+
+		if(quoting == CMD_QUOTE_SINGLE) {
+			if(*p == '\'') {
+				if(add_literal_part(parts, &num_parts, lit, &lit_len, TRUE, quoting, &word_start) != OK)
+					goto shell;
+				quoting = CMD_QUOTE_NONE;
+				}
+			else
+				lit[lit_len++] = *p;
+			continue;
+			}
+
+		if(quoting == CMD_QUOTE_DOUBLE) {
+			if(*p == '"') {
+				if(add_literal_part(parts, &num_parts, lit, &lit_len, TRUE, quoting, &word_start) != OK)
+					goto shell;
+				quoting = CMD_QUOTE_NONE;
+				continue;
+				}
+			/* escapes inside double quotes are too quirky to bother with */
+			if(*p == '`' || (*p == '\\' && strchr("\"\\$`", p[1])))
+				goto shell;
+			lit[lit_len++] = *p;
+			continue;
+			}
+
+		switch(*p) {
+			case ' ':
+			case '\t':
+			case '\r':
+			case '\n':
+				if(add_literal_part(parts, &num_parts, lit, &lit_len, FALSE, quoting, &word_start) != OK)
+					goto shell;
+				word_start = TRUE;
+				break;
+			case '\\':
+				/* a backslash in front of a macro escapes its first character */
+				if(p[1] == '\x0' || p[1] == '$')
+					goto shell;
+				lit[lit_len++] = *(++p);
+				break;
+			case '\'':
+				if(add_literal_part(parts, &num_parts, lit, &lit_len, FALSE, quoting, &word_start) != OK)
+					goto shell;
+				quoting = CMD_QUOTE_SINGLE;
+				break;
+			case '"':
+				if(add_literal_part(parts, &num_parts, lit, &lit_len, FALSE, quoting, &word_start) != OK)
+					goto shell;
+				quoting = CMD_QUOTE_DOUBLE;
+				break;
+			case '|': case '<': case '>': case '&': case ';':
+			case '`': case '(': case ')': case '*': case '?':
+				goto shell;
+			default:
+				lit[lit_len++] = *p;
+				break;
+			}
+		}
+
+	if(quoting != CMD_QUOTE_NONE)
+		goto shell;
+	if(add_literal_part(parts, &num_parts, lit, &lit_len, FALSE, quoting, &word_start) != OK)
+		goto shell;
+	if(num_parts == 0)
+		goto shell;
+
+	/* runcmd_open() treats VAR=value at the start as an environment variable */
+	for(x = 0; x < num_parts && (x == 0 || parts[x].word_start == FALSE); x++) {
+		if(parts[x].is_macro == FALSE && strchr(parts[x].text, '='))
+			goto shell;
+		}
+
+	my_free(lit);
+	cmd->num_parts = num_parts;
+	cmd->argv_template = realloc(parts, num_parts * sizeof(*parts));
+	if(cmd->argv_template == NULL)
+		cmd->argv_template = parts;
+	return;
+
+shell:
+	for(x = 0; x < num_parts; x++)
+		my_free(parts[x].text);
+	my_free(parts);
+	my_free(lit);
+	}
+#endif
+
+
 /* add a new command to the list in memory */
 command *add_command(char *name, char *value) {
 	command *new_command = NULL;
@@ -1630,6 +1805,9 @@ command *add_command(char *name, char *value) {
 	/* assign vars */
 	new_command->name = name;
 	new_command->command_line = value;
+#ifdef NSCORE
+	add_argv_template(new_command);
+#endif
 
 	/* add new command to hash table */
 	if(result == OK) {
@@ -1651,6 +1829,7 @@ command *add_command(char *name, char *value) {
 
 	/* handle errors */
 	if(result == ERROR) {
+		free_argv_template(new_command);
 		my_free(new_command);
 		return NULL;
 		}
@@ -2887,6 +3066,7 @@ int free_object_data(void) {
 	/**** free command memory ****/
 	for (i = 0; i < num_objects.commands; i++) {
 		command *this_command = command_ary[i];
+		free_argv_template(this_command);
 		my_free(this_command->name);
 		my_free(this_command->command_line);
 		my_free(this_command);
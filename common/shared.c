@@ -20,6 +20,8 @@ struct object_count num_objects;
 
 int process_performance_data;
 char *status_file;
+char *status_store_file;
+char *status_index_file;
 
 int nagios_pid = 0;
 int daemon_mode = FALSE;
@@ -56,6 +58,8 @@ void init_shared_cfg_vars(int first_time) {
 
 	process_performance_data = DEFAULT_PROCESS_PERFORMANCE_DATA;
 	status_file = NULL;
+	status_store_file = NULL;
+	status_index_file = NULL;
 
 	check_external_commands = DEFAULT_CHECK_EXTERNAL_COMMANDS;
 
@@ -250,51 +254,104 @@ int mmap_fclose(mmapfile * temp_mmapfile) {
 	return OK;
 	}
 
-/* gets one line of input from an mmap()'ed file */
-char *mmap_fgets(mmapfile * temp_mmapfile) {
-	char *buf = NULL;
-	unsigned long x = 0L;
-	int len = 0;
+/*
+ * gets the next line of an mmap()'ed file without copying it. The line
+ * is not NUL-terminated: *len is its length, without the newline.
+ */
+const char *mmap_next_line(mmapfile *temp_mmapfile, size_t *len) {
+	const char *start, *end, *nl;
 
-	if(temp_mmapfile == NULL)
+	if(temp_mmapfile == NULL || temp_mmapfile->current_position >= temp_mmapfile->file_size)
 		return NULL;
 
-	/* size of file is 0 bytes */
-	if(temp_mmapfile->file_size == 0L)
-		return NULL;
+	start = (const char *)temp_mmapfile->mmap_buf + temp_mmapfile->current_position;
+	end = (const char *)temp_mmapfile->mmap_buf + temp_mmapfile->file_size;
 
-	/* we've reached the end of the file */
-	if(temp_mmapfile->current_position >= temp_mmapfile->file_size)
-		return NULL;
+	/* memchr() is vectorized, so this is much faster than a byte loop */
+	if((nl = memchr(start, '\n', end - start)) != NULL) {
+		*len = nl - start;
+		temp_mmapfile->current_position += *len + 1;
+		}
+	else {
+		*len = end - start;
+		temp_mmapfile->current_position = temp_mmapfile->file_size;
+		}
 
-	/* find the end of the string (or buffer) */
-	for(x = temp_mmapfile->current_position; x < temp_mmapfile->file_size;
-	        x++) {
-		if(*((char *)(temp_mmapfile->mmap_buf) + x) == '\n') {
-			x++;
-			break;
-			}
+	temp_mmapfile->current_line++;
+
+	return start;
+	}
+
+/*
+ * copies the next line of an mmap()'ed file, without its newline, into
+ * *buf, which is grown as needed like getline(3) does. Returns the
+ * length of the line, or -1 at the end of the file.
+ */
+ssize_t mmap_getline(mmapfile *temp_mmapfile, char **buf, size_t *size) {
+	const char *line;
+	size_t len;
+	char *new_buf;
+
+	if((line = mmap_next_line(temp_mmapfile, &len)) == NULL)
+		return -1;
+
+	if(*buf == NULL || *size < len + 1) {
+		if((new_buf = (char *)realloc(*buf, len + 1)) == NULL)
+			return -1;
+		*buf = new_buf;
+		*size = len + 1;
 		}
 
-	/* calculate length of line we just read */
-	len = (int)(x - temp_mmapfile->current_position);
+	memcpy(*buf, line, len);
+	(*buf)[len] = '\x0';
+
+	return (ssize_t)len;
+	}
+
+/*
+ * splits a "var=value" line into slices. Leading and trailing white
+ * space is skipped, as strip() would. Returns FALSE if there's no '='.
+ */
+int mmap_split_var(const char *line, size_t len, const char **var, size_t *var_len, const char **val, size_t *val_len) {
+	const char *end = line + len, *eq;
+
+	while(line < end && (*line == ' ' || *line == '\t'))
+		line++;
+	while(end > line && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'))
+		end--;
+
+	if((eq = memchr(line, '=', end - line)) == NULL)
+		return FALSE;
+
+	*var = line;
+	*var_len = eq - line;
+	*val = eq + 1;
+	*val_len = end - *val;
+
+	return TRUE;
+	}
+
+/* gets one line of input from an mmap()'ed file */
+char *mmap_fgets(mmapfile * temp_mmapfile) {
+	const char *line;
+	char *buf = NULL;
+	size_t len;
+
+	if((line = mmap_next_line(temp_mmapfile, &len)) == NULL)
+		return NULL;
+
+	/* keep the newline, if there was one */
+	if(temp_mmapfile->current_position > (unsigned long)(line - (const char *)temp_mmapfile->mmap_buf) + len)
+		len++;
 
 	/* allocate memory for the new line */
 	if((buf = (char *)malloc(len + 1)) == NULL)
 		return NULL;
 
 	/* copy string to newly allocated memory and terminate the string */
-	memcpy(buf,
-	       ((char *)(temp_mmapfile->mmap_buf) +
-	        temp_mmapfile->current_position), len);
+	memcpy(buf, line, len);
 	buf[len] = '\x0';
 
-	/* update the current position */
-	temp_mmapfile->current_position = x;
-
-	/* increment the current line */
-	temp_mmapfile->current_line++;
-
 	return buf;
 	}
 
@@ -46,6 +46,19 @@ hoststatus      **hoststatus_hashlist = NULL;
 servicestatus   **servicestatus_hashlist = NULL;
 
 extern int      use_pending_states;
+
+/* hosts and services read_status_data() is limited to, if any */
+typedef struct status_filter_struct {
+	char    *host_name;
+	char    *service_description;   /* NULL for all services on the host */
+	int     type;                   /* HOST_STATUS_FILTER or SERVICE_STATUS_FILTER */
+	struct status_filter_struct *next;
+	} status_filter;
+
+#define HOST_STATUS_FILTER      1
+#define SERVICE_STATUS_FILTER   2
+
+static status_filter *status_filter_list = NULL;
 #endif
 
 
@@ -62,6 +75,12 @@ int initialize_status_data(const char *cfgfile) {
 	}
 
 
+/* rebuilds status data for the objects read on a restart */
+int reload_status_data(void) {
+	return xsddefault_reload_status_data();
+	}
+
+
 /* update all status data (aggregated dump) */
 int update_all_status_data(void) {
 	int result = OK;
@@ -111,7 +130,7 @@ int update_host_status(host *hst, int aggregated_dump) {
 		broker_host_status(NEBTYPE_HOSTSTATUS_UPDATE, NEBFLAG_NONE, NEBATTR_NONE, hst, NULL);
 #endif
 
-	return OK;
+	return xsddefault_update_host_status(hst);
 	}
 
 
@@ -125,7 +144,7 @@ int update_service_status(service *svc, int aggregated_dump) {
 		broker_service_status(NEBTYPE_SERVICESTATUS_UPDATE, NEBFLAG_NONE, NEBATTR_NONE, svc, NULL);
 #endif
 
-	return OK;
+	return xsddefault_update_service_status(svc);
 	}
 
 
@@ -395,6 +414,113 @@ int add_service_status(servicestatus *new_svcstatus) {
 
 
 
+/******************************************************************/
+/************************ FILTER FUNCTIONS ************************/
+/******************************************************************/
+
+/*
+ * A CGI that only shows a few hosts or services can say which before
+ * the status data is read, and everything else is skipped. With no
+ * filters set, everything is read.
+ */
+
+static int add_status_filter(int type, const char *host_name, const char *svc_description) {
+	status_filter *new_filter = NULL;
+
+	if(host_name == NULL)
+		return ERROR;
+
+	if((new_filter = (status_filter *)calloc(1, sizeof(status_filter))) == NULL)
+		return ERROR;
+	new_filter->type = type;
+	if((new_filter->host_name = (char *)strdup(host_name)) == NULL || (svc_description && (new_filter->service_description = (char *)strdup(svc_description)) == NULL)) {
+		my_free(new_filter->host_name);
+		my_free(new_filter);
+		return ERROR;
+		}
+
+	new_filter->next = status_filter_list;
+	status_filter_list = new_filter;
+
+	return OK;
+	}
+
+
+/* limits status data to this host (and its comments and downtime) */
+int add_hoststatus_filter(const char *host_name) {
+	return add_status_filter(HOST_STATUS_FILTER, host_name, NULL);
+	}
+
+
+/* limits status data to this service, or all services on the host if the description is NULL */
+int add_servicestatus_filter(const char *host_name, const char *svc_description) {
+	return add_status_filter(SERVICE_STATUS_FILTER, host_name, svc_description);
+	}
+
+
+/* are we limited to some hosts and services? */
+int status_filter_is_set(void) {
+	return (status_filter_list == NULL) ? FALSE : TRUE;
+	}
+
+
+/* should this host's status be read? */
+int hoststatus_filter_match(const char *host_name) {
+	status_filter *temp_filter = NULL;
+
+	if(status_filter_list == NULL)
+		return TRUE;
+	if(host_name == NULL)
+		return FALSE;
+
+	for(temp_filter = status_filter_list; temp_filter != NULL; temp_filter = temp_filter->next) {
+		if(temp_filter->type == HOST_STATUS_FILTER && !strcmp(temp_filter->host_name, host_name))
+			return TRUE;
+		}
+
+	return FALSE;
+	}
+
+
+/* should this service's status be read? */
+int servicestatus_filter_match(const char *host_name, const char *svc_description) {
+	status_filter *temp_filter = NULL;
+
+	if(status_filter_list == NULL)
+		return TRUE;
+	if(host_name == NULL || svc_description == NULL)
+		return FALSE;
+
+	for(temp_filter = status_filter_list; temp_filter != NULL; temp_filter = temp_filter->next) {
+		if(temp_filter->type != SERVICE_STATUS_FILTER || strcmp(temp_filter->host_name, host_name))
+			continue;
+		if(temp_filter->service_description == NULL || !strcmp(temp_filter->service_description, svc_description))
+			return TRUE;
+		}
+
+	return FALSE;
+	}
+
+
+/* removes all filters, so everything is read again */
+void free_status_filters(void) {
+	status_filter *this_filter = NULL;
+	status_filter *next_filter = NULL;
+
+	for(this_filter = status_filter_list; this_filter != NULL; this_filter = next_filter) {
+		next_filter = this_filter->next;
+		my_free(this_filter->host_name);
+		my_free(this_filter->service_description);
+		my_free(this_filter);
+		}
+	status_filter_list = NULL;
+
+	return;
+	}
+
+
+
+
 /******************************************************************/
 /*********************** CLEANUP FUNCTIONS ************************/
 /******************************************************************/
@@ -434,6 +560,8 @@ void free_status_data(void) {
 	hoststatus_list = NULL;
 	servicestatus_list = NULL;
 
+	free_status_filters();
+
 	return;
 	}
 
@@ -173,6 +173,8 @@
 #define NEBATTR_DOWNTIME_STOP_NORMAL          1
 #define NEBATTR_DOWNTIME_STOP_CANCELLED       2
 
+#define NEBATTR_CHECK_UNCHANGED               1         /* same hard state and output as the last check */
+
 
 
 /****** EVENT BROKER FUNCTIONS *************/
@@ -45,6 +45,8 @@ extern unsigned long next_downtime_id;
 
 extern char *object_cache_file;
 extern char *status_file;
+extern char *status_store_file;
+extern char *status_index_file;
 
 extern time_t program_start;
 extern int nagios_pid;
@@ -461,7 +463,9 @@ extern const char *cmd_error_strerror(int error_code);
 #define EXTERNAL_COMMAND_STATS               8
 #define PARALLEL_HOST_CHECK_STATS            9
 #define SERIAL_HOST_CHECK_STATS              10
-#define MAX_CHECK_STATS_TYPES                11
+#define COALESCED_HOST_CHECK_STATS           11
+#define COALESCED_SERVICE_CHECK_STATS        12
+#define MAX_CHECK_STATS_TYPES                13
 
 
 /****************** HOST CONFIG FILE READING OPTIONS ********************/
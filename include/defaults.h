@@ -18,7 +18,10 @@
 #define DEFAULT_MAX_PARALLEL_SERVICE_CHECKS 			0	/* maximum number of service checks we can have running at any given time (0=unlimited) */
 #define DEFAULT_RETENTION_UPDATE_INTERVAL			60	/* minutes between auto-save of retention data */
 #define DEFAULT_RETENTION_SCHEDULING_HORIZON    		900     /* max seconds between program restarts that we will preserve scheduling information */
+#define DEFAULT_RETENTION_FILE_FORMAT				0	/* write retention data as text */
+#define DEFAULT_RETENTION_LOAD_THREADS				0	/* decode binary retention data in one thread per cpu */
 #define DEFAULT_STATUS_UPDATE_INTERVAL				60	/* seconds between aggregated status data updates */
+#define DEFAULT_STATUS_WRITER_THREAD				1	/* write status data in a thread of its own */
 #define DEFAULT_FRESHNESS_CHECK_INTERVAL        		60      /* seconds between service result freshness checks */
 #define DEFAULT_AUTO_RESCHEDULING_INTERVAL      		30      /* seconds between host and service check rescheduling events */
 #define DEFAULT_AUTO_RESCHEDULING_WINDOW        		180     /* window of time (in seconds) for which we should reschedule host and service checks */
@@ -56,6 +59,8 @@
 #define DEFAULT_CHECK_SERVICE_FRESHNESS         		1       /* check service result freshness */
 #define DEFAULT_CHECK_HOST_FRESHNESS            		0       /* don't check host result freshness */
 #define DEFAULT_AUTO_RESCHEDULE_CHECKS          		0       /* don't auto-reschedule host and service checks */
+#define DEFAULT_SMOOTH_CHECK_SCHEDULING         		0       /* don't move rescheduled checks to less busy seconds */
+#define DEFAULT_SUPPRESS_UNCHANGED_RESULTS      		0       /* pass on every service check result, changed or not */
 #define DEFAULT_TRANSLATE_PASSIVE_HOST_CHECKS                   0       /* should we translate DOWN/UNREACHABLE passive host checks? */
 #define DEFAULT_PASSIVE_HOST_CHECKS_SOFT                        0       /* passive host checks are treated as HARD by default */
 
@@ -73,6 +78,12 @@
 #define DEFAULT_ENABLE_PREDICTIVE_SERVICE_DEPENDENCY_CHECKS	1	/* should we use predictive service dependency checks? */
 
 #define DEFAULT_USE_LARGE_INSTALLATION_TWEAKS                   0       /* don't use tweaks for large Nagios installations */
+#define DEFAULT_USE_TIMING_WHEEL                                0       /* use a binary heap for the event queue */
+#define DEFAULT_CHECK_RESULT_THREADS                            0       /* parse worker results on the main thread */
+#define DEFAULT_EVENT_BATCH_SIZE                                100     /* max number of due events to run between polls for input */
+#define DEFAULT_PLUGIN_SPAWN_METHOD                             0       /* workers fork() and exec each plugin */
+#define DEFAULT_WORKER_SELECTION_POLICY                         0       /* hand out jobs to workers round-robin */
+#define DEFAULT_WORKER_AFFINITY_GROUPS                          1       /* all hosts share all workers */
 
 #define DEFAULT_ADDITIONAL_FRESHNESS_LATENCY			15	/* seconds to be added to freshness thresholds when automatically calculated by Nagios */
 
@@ -242,6 +242,9 @@ int process_macros(char *, char **, int);
 /* thread-safe version of the above */
 int process_macros_r(nagios_macros *mac, char *, char **, int);
 
+/* gets what process_macros_r() substitutes for a single macro */
+char *get_processed_macro_r(nagios_macros *mac, char *name, int options, int *free_value);
+
 /* cleans macros characters before insertion into output string */
 char *clean_macro_chars(char *, int);
 
@@ -47,6 +47,11 @@ extern char *object_precache_file;
 extern unsigned int nofile_limit, nproc_limit, max_apps;
 
 extern int num_check_workers;
+extern int check_result_threads;
+extern char *persistent_plugins;
+extern int plugin_spawn_method;
+extern int worker_selection_policy;
+extern int worker_affinity_groups;
 extern char *qh_socket_path;
 
 extern char *nagios_user;
@@ -118,6 +123,8 @@ extern int service_freshness_check_interval;
 extern int host_freshness_check_interval;
 extern int auto_rescheduling_interval;
 extern int auto_rescheduling_window;
+extern int smooth_check_scheduling;
+extern int suppress_unchanged_results;
 
 extern int check_orphaned_services;
 extern int check_orphaned_hosts;
@@ -149,6 +156,8 @@ extern int use_retained_program_state;
 extern int use_retained_scheduling_info;
 extern int retention_scheduling_horizon;
 extern char *retention_file;
+extern int retention_file_format;
+extern int retention_load_threads;
 extern unsigned long retained_host_attribute_mask;
 extern unsigned long retained_service_attribute_mask;
 extern unsigned long retained_contact_host_attribute_mask;
@@ -160,6 +169,7 @@ extern int translate_passive_host_checks;
 extern int passive_host_checks_are_soft;
 
 extern int status_update_interval;
+extern int status_writer_thread;
 extern char *retention_file;
 
 extern int time_change_threshold;
@@ -172,6 +182,8 @@ extern double low_host_flap_threshold;
 extern double high_host_flap_threshold;
 
 extern int use_large_installation_tweaks;
+extern int use_timing_wheel;
+extern int event_batch_size;
 extern int enable_environment_macros;
 extern int free_child_process_memory;
 extern int child_processes_fork_twice;
@@ -245,8 +257,15 @@ struct load_control {
 	double load[3];      /* system load, as reported by getloadavg() */
 	float backoff_limit; /* limit we must reach before we back off */
 	float rampup_limit;  /* limit we must reach before we ramp back up */
-	unsigned int backoff_change; /* backoff by this much */
+	unsigned int backoff_change; /* no longer used; kept for old configs */
 	unsigned int rampup_change;  /* ramp up by this much */
+	float backoff_factor; /* multiply jobs_limit by this when backing off */
+	double psi[3];        /* cpu, memory and io pressure (some avg10) */
+	float psi_limit;      /* back off when any pressure is above this percentage */
+	double latency;       /* moving average of check latency */
+	float latency_limit;  /* only ramp up if checks are this late */
+	unsigned int worker_jobs;       /* jobs running on the busiest worker */
+	unsigned int worker_jobs_limit; /* back off when a worker runs more jobs than this */
 	unsigned int changes;  /* number of times we've changed settings */
 	unsigned int jobs_max;   /* upper setting for jobs_limit */
 	unsigned int jobs_limit; /* current limit */
@@ -260,6 +279,7 @@ extern struct load_control loadctl;
 
 /* options for load control */
 #define LOADCTL_ENABLED    (1 << 0)
+#define LOADCTL_PSI        (1 << 1) /* pressure stall information is available */
 
 
 	/************* MISC LENGTH/SIZE DEFINITIONS ***********/
@@ -331,6 +351,22 @@ extern struct load_control loadctl;
 
 
 
+	/*************** WORKER SELECTION POLICIES **************/
+
+#define WPROC_SELECT_ROUND_ROBIN        0       /* hand jobs to each worker in turn */
+#define WPROC_SELECT_LEAST_JOBS         1       /* pick the worker with the fewest running jobs */
+#define WPROC_SELECT_TWO_CHOICES        2       /* pick the less busy of two random workers */
+#define WPROC_SELECT_HOST_AFFINITY      3       /* run all jobs for a host on the same worker */
+
+
+
+	/*************** RETENTION FILE FORMATS *****************/
+
+#define RETENTION_FORMAT_TEXT           0       /* one "name=value" line per variable */
+#define RETENTION_FORMAT_BINARY         1       /* records keyed by object id, see xrddefault.h */
+
+
+
 	/***************** STATE CHANGE TYPES *****************/
 
 #define HOST_STATECHANGE                0
@@ -497,6 +533,7 @@ void remove_event(squeue_t *sq, timed_event *event);     		/* remove an event fr
 int event_execution_loop(void);                      		/* main monitoring/event handler loop */
 int handle_timed_event(timed_event *);		     		/* top level handler for timed events */
 void adjust_check_scheduling(void);		        	/* auto-adjusts scheduling of host and service checks */
+time_t smooth_check_time(time_t, time_t);			/* moves a check time to the least busy second within its jitter */
 void compensate_for_system_time_change(unsigned long, unsigned long);	/* attempts to compensate for a change in the system time */
 void adjust_timestamp_for_time_change(time_t, time_t, unsigned long, time_t *); /* adjusts a timestamp variable for a system time change */
 
@@ -506,9 +543,15 @@ int process_check_result_queue(char *);
 int process_check_result_file(char *);
 int process_check_result(check_result *);
 int delete_check_result_file(char *);
+int init_check_result_spool(void);
+void deinit_check_result_spool(void);
+int reap_check_result_spool(void);
 int init_check_result(check_result *);
 int free_check_result(check_result *);                  	/* frees memory associated with a host/service check result */
+void free_check_output(check_output *);				/* frees memory associated with pre-parsed plugin output */
 int parse_check_output(char *, char **, char **, char **, int, int);
+int parse_check_output_slices(char *, check_output *, int);	/* splits plugin output without copying it */
+int update_check_output(const check_output *, char **, char **, char **);	/* replaces whatever parts of an object's output changed */
 int open_command_file(void);					/* creates the external command file as a named pipe (FIFO) and opens it for reading */
 int close_command_file(void);					/* closes and deletes the external command file (FIFO) */
 
@@ -517,12 +560,22 @@ int close_command_file(void);					/* closes and deletes the external command fil
 int check_service_parents(service *svc);			/* checks service parents */
 int check_service_dependencies(service *, int);          	/* checks service dependencies */
 int check_host_dependencies(host *, int);                	/* checks host dependencies */
+int init_dependency_index(void);				/* builds the dependency evaluation index */
+void free_dependency_index(void);
+void update_service_dependency_index(service *);		/* updates the index after a service check result */
+void update_host_dependency_index(host *);			/* updates the index after a host check result */
 void check_for_orphaned_services(void);				/* checks for orphaned services */
 void check_for_orphaned_hosts(void);				/* checks for orphaned hosts */
 void check_service_result_freshness(void);              	/* checks the "freshness" of service check results */
 int is_service_result_fresh(service *, time_t, int);            /* determines if a service's check results are fresh */
 void check_host_result_freshness(void);                 	/* checks the "freshness" of host check results */
 int is_host_result_fresh(host *, time_t, int);                  /* determines if a host's check results are fresh */
+void update_service_freshness_deadline(service *);		/* re-arms the freshness deadline of a service */
+void update_host_freshness_deadline(host *);			/* re-arms the freshness deadline of a host */
+void free_freshness_deadlines(void);
+void update_service_orphan_deadline(service *);		/* arms or drops the orphan deadline of a service */
+void update_host_orphan_deadline(host *);			/* arms or drops the orphan deadline of a host */
+void free_orphan_deadlines(void);
 int my_system(char *, int, int *, double *, char **, int);         	/* executes a command via popen(), but also protects against timeouts */
 int my_system_r(nagios_macros *mac, char *, int, int *, double *, char **, int); /* thread-safe version of the above */
 
@@ -548,6 +601,9 @@ void handle_service_flap_detection_disabled(service *);		/* handles the details
 int check_host_check_viability(host *, int, int *, time_t *);
 int adjust_host_check_attempt(host *, int);
 int determine_host_reachability(host *);
+int init_host_reachability(void);				/* builds the host reachability cache */
+void free_host_reachability(void);
+void update_host_reachability(host *);				/* updates the cache after a host went from UP to not UP or back */
 int process_host_check_result(host *, int, char *, int, int, int, unsigned long);
 int perform_on_demand_host_check(host *, int *, int, int, unsigned long);
 int execute_sync_host_check(host *);
@@ -577,6 +633,15 @@ int update_check_stats(int, time_t);
 int generate_check_stats(void);
 
 
+/**** Check Timing Functions ****/
+#define CHECK_TIMINGS_COMMAND	0				/* timings per check command (and for all checks) */
+#define CHECK_TIMINGS_WORKER	1				/* timings per worker */
+int init_check_timings(void);
+void deinit_check_timings(void);
+void update_check_timings(int, const char *, double, double, double);	/* adds latency, execution and processing time, in seconds */
+void remove_check_timings(int, const char *);
+
+
 /**** Event Handler Functions ****/
 int obsessive_compulsive_service_check_processor(service *);	/* distributed monitoring craziness... */
 int obsessive_compulsive_host_check_processor(host *);		/* distributed monitoring craziness... */
@@ -645,6 +710,12 @@ int my_fdcopy(char *, char *, int);                     /* copies a named source
 /* thread-safe version of get_raw_command_line_r() */
 extern int get_raw_command_line_r(nagios_macros *mac, command *, char *, char **, int);
 
+/*
+ * process_macros_r() for a command's command line, which also splits
+ * the result into an argv, or sets it to NULL if that needs a shell
+ */
+extern int process_command_macros_r(nagios_macros *mac, command *cmd_ptr, char **output, char ***argv, int options);
+
 /*
  * given a raw command line, determine the actual command to run
  * Manipulates global_macros.argv and is thus not threadsafe
@@ -708,6 +779,9 @@ void disable_service_checks(service *);			/* disables a service check */
 void enable_service_checks(service *);			/* enables a service check */
 void schedule_service_check(service *, time_t, int);	/* schedules an immediate or delayed service check */
 void schedule_host_check(host *, time_t, int);		/* schedules an immediate or delayed host check */
+void schedule_on_demand_service_check(service *, time_t, int, int, void *);	/* schedules an on-demand service check, or joins the pending one */
+void schedule_on_demand_host_check(host *, time_t, int, int, void *);	/* schedules an on-demand host check, or joins the pending one */
+void free_check_waiters(void);
 void enable_all_notifications(void);                    /* enables notifications on a program-wide basis */
 void disable_all_notifications(void);                   /* disables notifications on a program-wide basis */
 void enable_service_notifications(service *);		/* enables service notifications */
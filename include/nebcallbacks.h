@@ -28,7 +28,7 @@
 
 /***** CALLBACK TYPES *****/
 
-#define NEBCALLBACK_NUMITEMS                          26    /* total number of callback types we have */
+#define NEBCALLBACK_NUMITEMS                          27    /* total number of callback types we have */
 
 #define NEBCALLBACK_PROCESS_DATA                      0
 #define NEBCALLBACK_TIMED_EVENT_DATA                  1
@@ -56,6 +56,7 @@
 #define NEBCALLBACK_STATE_CHANGE_DATA                 23
 #define NEBCALLBACK_CONTACT_STATUS_DATA               24
 #define NEBCALLBACK_ADAPTIVE_CONTACT_DATA             25
+#define NEBCALLBACK_SERVICE_CHECK_UNCHANGED_DATA      26    /* service check results suppressed by suppress_unchanged_results */
 
 #define nebcallback_flag(x) (1 << (x))
 
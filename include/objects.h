@@ -152,6 +152,19 @@ struct check_engine {
 	void (*clean_result)(void *);
 };
 
+/* CHECK_OUTPUT_SLICE structure - a piece of plugin output, not nul-terminated */
+typedef struct check_output_slice {
+	const char *str;
+	size_t len;
+	} check_output_slice;
+
+/* CHECK_OUTPUT structure - plugin output split up by parse_check_output_slices() */
+typedef struct check_output {
+	check_output_slice short_output;
+	check_output_slice long_output;
+	check_output_slice perf_data[2];		/* from the first line and from after the long output */
+	} check_output;
+
 /* CHECK_RESULT structure */
 typedef struct check_result {
 	int object_check_type;                          /* is this a service or a host check? */
@@ -173,6 +186,7 @@ typedef struct check_result {
 	struct rusage rusage;   			/* resource usage by this check */
 	struct check_engine *engine;                    /* where did we get this check from? */
 	const void *source;				/* engine handles this */
+	check_output *parsed_output;			/* slices of output, already parsed off the main thread, if any */
 	} check_result;
 
 
@@ -314,12 +328,27 @@ typedef struct customvariablesmember {
 	} customvariablesmember;
 
 
+/* COMMAND_PART structure - a piece of one word of a command's argv template */
+#define CMD_QUOTE_NONE          0
+#define CMD_QUOTE_SINGLE        1
+#define CMD_QUOTE_DOUBLE        2
+
+typedef struct command_part {
+	char    *text;                  /* literal text, or the name of the macro */
+	int     is_macro;
+	int     quoting;                /* CMD_QUOTE_* around this part */
+	int     word_start;             /* TRUE if this part starts a new word */
+	} command_part;
+
+
 /* COMMAND structure */
 typedef struct command {
 	unsigned int id;
 	char    *name;
 	char    *command_line;
 	struct command *next;
+	int     num_parts;
+	struct command_part *argv_template; /* NULL if the command needs a shell */
 	} command;
 
 
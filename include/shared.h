@@ -42,6 +42,9 @@ extern char *my_strsep(char **stringp, const char *delim);
 extern mmapfile *mmap_fopen(const char *filename);
 extern int mmap_fclose(mmapfile *temp_mmapfile);
 extern char *mmap_fgets(mmapfile *temp_mmapfile);
+extern const char *mmap_next_line(mmapfile *temp_mmapfile, size_t *len);
+extern ssize_t mmap_getline(mmapfile *temp_mmapfile, char **buf, size_t *size);
+extern int mmap_split_var(const char *line, size_t len, const char **var, size_t *var_len, const char **val, size_t *val_len);
 extern char *mmap_fgets_multiline(mmapfile * temp_mmapfile);
 extern void strip(char *buffer);
 extern int hashfunc(const char *name1, const char *name2, int hashslots);
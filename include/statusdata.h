@@ -172,6 +172,12 @@ typedef struct servicestatus_struct {
 /**************************** FUNCTIONS ******************************/
 
 int read_status_data(const char *, int);                /* reads all status data */
+int add_hoststatus_filter(const char *);                /* limits status data read to a host... */
+int add_servicestatus_filter(const char *, const char *);       /* ...or a service, or all services on a host */
+int status_filter_is_set(void);
+int hoststatus_filter_match(const char *);
+int servicestatus_filter_match(const char *, const char *);
+void free_status_filters(void);
 int add_host_status(hoststatus *);                      /* adds a host status entry to the list in memory */
 int add_service_status(servicestatus *);                /* adds a service status entry to the list in memory */
 
@@ -187,6 +193,7 @@ void free_status_data(void);                            /* free all memory alloc
 
 #ifndef NSCGI
 int initialize_status_data(const char *);               /* initializes status data at program start */
+int reload_status_data(void);                           /* rebuilds status data for a new object set after a restart */
 int update_all_status_data(void);                       /* updates all status data */
 int cleanup_status_data(int);                           /* cleans up status data at program termination */
 int update_program_status(int);                         /* updates program status data */
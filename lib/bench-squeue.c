@@ -0,0 +1,102 @@
+/*
+ * Compare the scheduling queue backends under a scheduler-like
+ * workload. Not run as part of "make test", since the numbers
+ * only mean something to a human. Run "make bench" for that.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <time.h>
+#include "squeue.h"
+
+#define WINDOW 300 /* seconds to spread events over */
+
+struct bench_event {
+	squeue_event *evt;
+};
+
+static double elapsed(struct timeval *start)
+{
+	struct timeval stop;
+
+	gettimeofday(&stop, NULL);
+	return (double)(stop.tv_sec - start->tv_sec) + ((double)(stop.tv_usec - start->tv_usec) / 1000000);
+}
+
+static void random_tv(struct timeval *tv, time_t base)
+{
+	tv->tv_sec = base + (rand() % WINDOW);
+	tv->tv_usec = rand() % 1000000;
+}
+
+static void report(const char *name, const char *what, unsigned int n, double secs)
+{
+	printf("  %-6s %-10s %8.1f ns/op  %10.0f ops/s\n",
+	       name, what, secs * 1000000000 / n, n / secs);
+}
+
+static void bench(int type, unsigned int n)
+{
+	const char *name = type == SQUEUE_WHEEL ? "wheel" : "heap";
+	struct bench_event *ary, *be;
+	struct timeval start, tv;
+	squeue_t *sq;
+	time_t now = time(NULL);
+	unsigned int i;
+
+	ary = calloc(n, sizeof(*ary));
+	sq = squeue_create_type(type, n);
+	if (!ary || !sq) {
+		printf("  %-6s out of memory\n", name);
+		exit(EXIT_FAILURE);
+	}
+
+	srand(n);
+	gettimeofday(&start, NULL);
+	for (i = 0; i < n; i++) {
+		random_tv(&tv, now);
+		ary[i].evt = squeue_add_tv(sq, &tv, &ary[i]);
+	}
+	report(name, "add", n, elapsed(&start));
+
+	/* run the next event and schedule it again, like a recurring check */
+	gettimeofday(&start, NULL);
+	for (i = 0; i < n; i++) {
+		be = squeue_pop(sq);
+		tv = *squeue_event_runtime(be->evt);
+		tv.tv_sec += WINDOW;
+		be->evt = squeue_add_tv(sq, &tv, be);
+	}
+	report(name, "reschedule", n, elapsed(&start));
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < n; i++) {
+		be = &ary[rand() % n];
+		random_tv(&tv, now + WINDOW);
+		squeue_change_priority_tv(sq, be->evt, &tv);
+	}
+	report(name, "change", n, elapsed(&start));
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < n; i++) {
+		squeue_remove(sq, ary[i].evt);
+	}
+	report(name, "remove", n, elapsed(&start));
+
+	squeue_destroy(sq, 0);
+	free(ary);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int sizes[] = { 10000, 100000, 1000000 };
+	unsigned int i;
+
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		printf("%u events:\n", sizes[i]);
+		bench(SQUEUE_HEAP, sizes[i]);
+		bench(SQUEUE_WHEEL, sizes[i]);
+	}
+
+	return 0;
+}
@@ -0,0 +1,111 @@
+#include <stdlib.h>
+#include <string.h>
+#include "histogram.h"
+
+#define SUB_BITS 4                  /* 2^4 buckets per power of two */
+#define SUB_BUCKETS (1 << SUB_BITS)
+#define MAX_BITS 40                 /* values are capped below 2^40 */
+#define NUM_BUCKETS ((MAX_BITS - SUB_BITS + 1) * SUB_BUCKETS)
+#define MAX_VALUE ((1ULL << MAX_BITS) - 1)
+
+struct histogram {
+	unsigned long long count;
+	unsigned long long max;
+	unsigned int buckets[NUM_BUCKETS];
+};
+
+static inline int msb(unsigned long long value)
+{
+	int bit = 0;
+
+	while (value >>= 1)
+		bit++;
+	return bit;
+}
+
+/*
+ * Values below 2 * SUB_BUCKETS get a bucket each. Above that, the
+ * most significant bit picks a group of SUB_BUCKETS buckets and the
+ * SUB_BITS bits below it pick one of them.
+ */
+static inline unsigned int bucket_index(unsigned long long value)
+{
+	int bit;
+
+	if (value < SUB_BUCKETS)
+		return value;
+	bit = msb(value);
+	return (bit - SUB_BITS + 1) * SUB_BUCKETS + ((value >> (bit - SUB_BITS)) & (SUB_BUCKETS - 1));
+}
+
+/* the highest value that ends up in bucket 'idx' */
+static inline unsigned long long bucket_high(unsigned int idx)
+{
+	unsigned int shift;
+
+	if (idx < 2 * SUB_BUCKETS)
+		return idx;
+	shift = idx / SUB_BUCKETS - 1;
+	return ((unsigned long long)(SUB_BUCKETS + idx % SUB_BUCKETS + 1) << shift) - 1;
+}
+
+histogram *histogram_create(void)
+{
+	return calloc(1, sizeof(histogram));
+}
+
+void histogram_destroy(histogram *h)
+{
+	free(h);
+}
+
+void histogram_reset(histogram *h)
+{
+	memset(h, 0, sizeof(*h));
+}
+
+void histogram_add(histogram *h, unsigned long long value)
+{
+	if (value > MAX_VALUE)
+		value = MAX_VALUE;
+	h->buckets[bucket_index(value)]++;
+	h->count++;
+	if (value > h->max)
+		h->max = value;
+}
+
+unsigned long long histogram_count(const histogram *h)
+{
+	return h->count;
+}
+
+unsigned long long histogram_max(const histogram *h)
+{
+	return h->max;
+}
+
+unsigned long long histogram_percentile(const histogram *h, double percentile)
+{
+	unsigned long long rank, seen = 0;
+	double exact;
+	unsigned int i;
+
+	if (!h->count)
+		return 0;
+	if (percentile >= 100)
+		return h->max;
+
+	/* the nearest rank of the value we're after, counting from 1 */
+	exact = percentile / 100 * h->count;
+	rank = (unsigned long long)exact;
+	if (rank < exact || !rank)
+		rank++;
+
+	for (i = 0; i < NUM_BUCKETS; i++) {
+		seen += h->buckets[i];
+		if (seen >= rank)
+			break;
+	}
+
+	return bucket_high(i) < h->max ? bucket_high(i) : h->max;
+}
@@ -0,0 +1,76 @@
+#ifndef LIBNAGIOS_HISTOGRAM_H_INCLUDED
+#define LIBNAGIOS_HISTOGRAM_H_INCLUDED
+
+/**
+ * @file histogram.h
+ * @brief Fixed-bucket histograms for timing values
+ *
+ * Values are counted in log-linear buckets, the way HDR histograms
+ * do it: every power of two is split into 16 equally wide buckets,
+ * so any value is accounted for with at most 1/16th (6.25%) error,
+ * whatever its magnitude. Values below 32 are counted exactly.
+ * Adding a value is O(1) and never allocates, and the histogram
+ * takes the same (small) amount of memory no matter how many
+ * values are added to it.
+ *
+ * The unit is up to the caller. Microseconds are a good fit for
+ * check timings, since values up to 2^40 (almost 13 days) can be
+ * told apart. Larger values are counted as that.
+ * @{
+ */
+
+struct histogram;
+typedef struct histogram histogram;
+
+/**
+ * Create a histogram
+ * @return A new histogram on success, NULL on errors
+ */
+extern histogram *histogram_create(void);
+
+/**
+ * Destroy a histogram
+ * @param h The histogram to destroy
+ */
+extern void histogram_destroy(histogram *h);
+
+/**
+ * Forget all values added to a histogram
+ * @param h The histogram to reset
+ */
+extern void histogram_reset(histogram *h);
+
+/**
+ * Add a value to a histogram
+ * @param h The histogram to add to
+ * @param value The value to add
+ */
+extern void histogram_add(histogram *h, unsigned long long value);
+
+/**
+ * Get the number of values added to a histogram
+ * @param h The histogram
+ * @return The number of values added since it was created or reset
+ */
+extern unsigned long long histogram_count(const histogram *h);
+
+/**
+ * Get the largest value added to a histogram
+ * @param h The histogram
+ * @return The largest value added, exactly. 0 if there are none.
+ */
+extern unsigned long long histogram_max(const histogram *h);
+
+/**
+ * Get the value at a percentile
+ * The result is the highest value that would have been counted in
+ * the same bucket as the value at the requested percentile, but
+ * never larger than the largest value added.
+ * @param h The histogram
+ * @param percentile The percentile, 0 to 100
+ * @return The value at the percentile. 0 if there are no values.
+ */
+extern unsigned long long histogram_percentile(const histogram *h, double percentile);
+
+/** @} */
+#endif
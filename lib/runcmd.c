@@ -25,6 +25,12 @@
 #include <errno.h>
 #include "runcmd.h"
 
+#if defined(_POSIX_SPAWN) && _POSIX_SPAWN > 0
+# include <spawn.h>
+# define HAVE_POSIX_SPAWN
+extern char **environ;
+#endif
+
 
 /** macros **/
 #ifndef WEXITSTATUS
@@ -52,6 +58,8 @@
  */
 static pid_t *pids = NULL;
 
+static int spawn_method = RUNCMD_SPAWN_FORK;
+
 /* If OPEN_MAX isn't defined, we try the sysconf syscall first.
  * If that fails, we fall back to an educated guess which is accurate
  * on Linux and some other systems. There's no guarantee that our guess is
@@ -87,6 +95,19 @@ const char *runcmd_strerror(int code)
 	return "unknown";
 }
 
+int runcmd_set_spawn_method(int method)
+{
+	switch (method) {
+	case RUNCMD_SPAWN_FORK:
+#ifdef HAVE_POSIX_SPAWN
+	case RUNCMD_SPAWN_POSIX:
+#endif
+		spawn_method = method;
+		return 0;
+	}
+	return RUNCMD_EINVAL;
+}
+
 /* yield the pid belonging to a particular file descriptor */
 pid_t runcmd_pid(int fd)
 {
@@ -328,59 +349,145 @@ void runcmd_init(void)
 static int runcmd_setenv(const char *name, const char *value);
 int update_environment(char *name, char *value, int set);
 
-/* Start running a command */
-int runcmd_open(const char *cmd, int *pfd, int *pfderr, char **env,
-		void (*iobreg)(int, int, void *), void *iobregarg)
+#ifdef HAVE_POSIX_SPAWN
+/* is the variable among the first n "name=value" strings of envp? */
+static int envp_has(char **envp, int n, const char *var)
 {
-	char **argv = NULL;
-	int argc = 0;
-	int cmd2strv_errors;
-	size_t cmdlen;
-	pid_t pid;
+	size_t len = strcspn(var, "=");
+	int i;
 
-	int i = 0;
+	for (i = 0; i < n; i++) {
+		if (!strncmp(envp[i], var, len) && envp[i][len] == '=')
+			return 1;
+	}
+	return 0;
+}
 
-	if(!pids)
-		runcmd_init();
+/*
+ * Start a command with posix_spawn(), setting up the child the
+ * same way the fork() path in runcmd_open() does. We have to build
+ * the child's environment up front, since there's no child to call
+ * setenv() in. VAR=value words come first, then the env pairs, then
+ * our own environment, and the first occurrence of a name wins.
+ * Returns the pid of the child, or -1 if the caller should fork()
+ * instead.
+ */
+static pid_t runcmd_spawn(char **argv, int argc, int assignments,
+		int *pfd, int *pfderr, char **env)
+{
+	posix_spawn_file_actions_t fa;
+	posix_spawnattr_t attr;
+	char **envp, **pairs = NULL;
+	int i, vars = 0, npairs = 0, n = 0, overrides, ret;
+	pid_t pid;
 
-	/* We can't do anything without a command, or FD arrays. */
-	if (!cmd || !*cmd || !pfd || !pfderr)
-		return RUNCMD_EINVAL;
+	/* VAR=value words in front of simple commands */
+	if (assignments) {
+		while (vars < argc && strchr(argv[vars], '='))
+			vars++;
+		/* let the fork() path complain about it */
+		if (vars == argc)
+			return -1;
+	}
 
-	cmdlen = strlen(cmd);
-	argv = calloc((cmdlen / 2) + 5, sizeof(char *));
-	if (!argv)
-		return RUNCMD_EALLOC;
+	if (env) {
+		while (env[npairs * 2] && env[npairs * 2 + 1])
+			npairs++;
+	}
+	for (i = 0; environ[i]; i++)
+		;
 
-	cmd2strv_errors = runcmd_cmd2strv(cmd, &argc, argv);
+	envp = malloc((vars + npairs + i + 1) * sizeof(char *));
+	if (!envp)
+		return -1;
+	if (npairs && !(pairs = calloc(npairs, sizeof(char *)))) {
+		free(envp);
+		return -1;
+	}
 
-	if (cmd2strv_errors == RUNCMD_EALLOC) {
-		/* We couldn't allocate the parsed argument array. */
-		free(argv);
-		return RUNCMD_EALLOC;
+	for (i = 0; i < vars; i++) {
+		if (!envp_has(envp, n, argv[i]))
+			envp[n++] = argv[i];
 	}
+	for (i = 0; i < npairs; i++) {
+		size_t klen = strlen(env[i * 2]), vlen = strlen(env[i * 2 + 1]);
 
-	if (cmd2strv_errors) {
-		/* Run complex commands via the shell. */
-		free(argv[0]);
-		argv[0] = "/bin/sh";
-		argv[1] = "-c";
-		argv[2] = strdup(cmd);
-		if (!argv[2]) {
-			free(argv);
-			return RUNCMD_EALLOC;
+		if (!(pairs[i] = malloc(klen + vlen + 2))) {
+			pid = -1;
+			goto out;
 		}
-		argv[3] = NULL;
+		memcpy(pairs[i], env[i * 2], klen);
+		pairs[i][klen] = '=';
+		memcpy(pairs[i] + klen + 1, env[i * 2 + 1], vlen + 1);
+		if (!envp_has(envp, n, pairs[i]))
+			envp[n++] = pairs[i];
 	}
+	overrides = n;
 
-	if (pipe(pfd) < 0) {
-		free(!cmd2strv_errors ? argv[0] : argv[2]);
-		free(argv);
-		return RUNCMD_EFD;
+	/* execvp() in the child would search the child's $PATH */
+	if (!strchr(argv[vars], '/') && envp_has(envp, overrides, "PATH=")) {
+		pid = -1;
+		goto out;
+	}
+
+	for (i = 0; environ[i]; i++) {
+		if (!envp_has(envp, overrides, environ[i]))
+			envp[n++] = environ[i];
+	}
+	envp[n] = NULL;
+
+	posix_spawn_file_actions_init(&fa);
+	posix_spawn_file_actions_addclose(&fa, pfd[0]);
+	if (pfd[1] != STDOUT_FILENO) {
+		posix_spawn_file_actions_adddup2(&fa, pfd[1], STDOUT_FILENO);
+		posix_spawn_file_actions_addclose(&fa, pfd[1]);
+	}
+	posix_spawn_file_actions_addclose(&fa, pfderr[0]);
+	if (pfderr[1] != STDERR_FILENO) {
+		posix_spawn_file_actions_adddup2(&fa, pfderr[1], STDERR_FILENO);
+		posix_spawn_file_actions_addclose(&fa, pfderr[1]);
+	}
+	/* the child shouldn't see the pipes of its siblings */
+	for (i = 0; i < maxfd; i++) {
+		if (pids[i] > 0)
+			posix_spawn_file_actions_addclose(&fa, i);
 	}
+
+	/* make it a process group leader, like setpgid() does */
+	posix_spawnattr_init(&attr);
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+	posix_spawnattr_setpgroup(&attr, 0);
+
+	ret = posix_spawnp(&pid, argv[vars], &fa, &attr, argv + vars, envp);
+	if (ret)
+		pid = -1;
+
+	posix_spawnattr_destroy(&attr);
+	posix_spawn_file_actions_destroy(&fa);
+
+out:
+	for (i = 0; i < npairs; i++)
+		free(pairs[i]);
+	free(pairs);
+	free(envp);
+	return pid;
+}
+#endif
+
+/*
+ * Starts argv with its stdout and stderr connected to pipes. Leading
+ * VAR=value words are moved to the environment if 'assignments' is
+ * set. argv still belongs to the caller when we return.
+ */
+static int runcmd_start(char **argv, int argc, int assignments, int *pfd,
+		int *pfderr, char **env, void (*iobreg)(int, int, void *), void *iobregarg)
+{
+	pid_t pid;
+	int i;
+
+	if (pipe(pfd) < 0)
+		return RUNCMD_EFD;
 	if (pipe(pfderr) < 0) {
-		free(!cmd2strv_errors ? argv[0] : argv[2]);
-		free(argv);
 		close(pfd[0]);
 		close(pfd[1]);
 		return RUNCMD_EFD;
@@ -388,10 +495,14 @@ int runcmd_open(const char *cmd, int *pfd, int *pfderr, char **env,
 
 	if (iobreg) iobreg(pfd[0], pfderr[0], iobregarg);
 
-	pid = fork();
+	pid = -1;
+#ifdef HAVE_POSIX_SPAWN
+	if (spawn_method == RUNCMD_SPAWN_POSIX)
+		pid = runcmd_spawn(argv, argc, assignments, pfd, pfderr, env);
+#endif
+	if (pid < 0)
+		pid = fork();
 	if (pid < 0) {
-		free(!cmd2strv_errors ? argv[0] : argv[2]);
-		free(argv);
 		close(pfd[0]);
 		close(pfd[1]);
 		close(pfderr[0]);
@@ -452,7 +563,7 @@ int runcmd_open(const char *cmd, int *pfd, int *pfderr, char **env,
 
 		/* Add VAR=value arguments from simple commands to the environment. */
 		i = 0;
-		if (!cmd2strv_errors) {
+		if (assignments) {
 			char *ev;
 			for (; i < argc && (ev = strchr(argv[i], '=')); ++i) {
 				if (*ev) *ev++ = '\0';
@@ -477,22 +588,13 @@ int runcmd_open(const char *cmd, int *pfd, int *pfderr, char **env,
 		fprintf(stderr, "execvp(%s, ...) failed. errno is %d: %s\n", argv[i], errno, strerror(errno));
 
 child_error_exit:
-		/* Free argv memory before exiting so valgrind doesn't see it as a leak. */
-		free(!cmd2strv_errors ? argv[0] : argv[2]);
-		free(argv);
 		_exit(exit_status);
 	}
 
 	/* parent picks up execution here */
-	/*
-	 * close childs file descriptors in our address space and
-	 * release the memory we used that won't get passed to the
-	 * caller.
-	 */
+	/* close childs file descriptors in our address space */
 	close(pfd[1]);
 	close(pfderr[1]);
-	free(!cmd2strv_errors ? argv[0] : argv[2]);
-	free(argv);
 
 	/* tag our file's entry in the pid-list and return it */
 	pids[pfd[0]] = pid;
@@ -500,6 +602,74 @@ child_error_exit:
 	return pfd[0];
 }
 
+/* Start running a command */
+int runcmd_open(const char *cmd, int *pfd, int *pfderr, char **env,
+		void (*iobreg)(int, int, void *), void *iobregarg)
+{
+	char **argv = NULL;
+	int argc = 0;
+	int cmd2strv_errors;
+	size_t cmdlen;
+	int ret;
+
+	if(!pids)
+		runcmd_init();
+
+	/* We can't do anything without a command, or FD arrays. */
+	if (!cmd || !*cmd || !pfd || !pfderr)
+		return RUNCMD_EINVAL;
+
+	cmdlen = strlen(cmd);
+	argv = calloc((cmdlen / 2) + 5, sizeof(char *));
+	if (!argv)
+		return RUNCMD_EALLOC;
+
+	cmd2strv_errors = runcmd_cmd2strv(cmd, &argc, argv);
+
+	if (cmd2strv_errors == RUNCMD_EALLOC) {
+		/* We couldn't allocate the parsed argument array. */
+		free(argv);
+		return RUNCMD_EALLOC;
+	}
+
+	if (cmd2strv_errors) {
+		/* Run complex commands via the shell. */
+		free(argv[0]);
+		argv[0] = "/bin/sh";
+		argv[1] = "-c";
+		argv[2] = strdup(cmd);
+		if (!argv[2]) {
+			free(argv);
+			return RUNCMD_EALLOC;
+		}
+		argv[3] = NULL;
+	}
+
+	ret = runcmd_start(argv, argc, !cmd2strv_errors, pfd, pfderr, env, iobreg, iobregarg);
+	free(!cmd2strv_errors ? argv[0] : argv[2]);
+	free(argv);
+
+	return ret;
+}
+
+/* Start running an already split up command, without a shell */
+int runcmd_open_argv(char **argv, int *pfd, int *pfderr, char **env,
+		void (*iobreg)(int, int, void *), void *iobregarg)
+{
+	int argc;
+
+	if(!pids)
+		runcmd_init();
+
+	/* argv, pfd and pfderr are declared nonnull */
+	if (!argv[0] || !*argv[0])
+		return RUNCMD_EINVAL;
+
+	for (argc = 0; argv[argc]; argc++)
+		;
+
+	return runcmd_start(argv, argc, 0, pfd, pfderr, env, iobreg, iobregarg);
+}
 
 int runcmd_close(int fd)
 {
@@ -41,6 +41,10 @@
 #define RUNCMD_EINVAL (-5)  /**< Invalid parameters */
 #define RUNCMD_EWAIT  (-6)  /**< Failed to wait() */
 
+/** How runcmd_open() starts its children */
+#define RUNCMD_SPAWN_FORK  0 /**< fork() and exec (the default) */
+#define RUNCMD_SPAWN_POSIX 1 /**< posix_spawn(), where available */
+
 /**
  * Initialize the runcmd library.
  *
@@ -51,6 +55,21 @@
  */
 extern void runcmd_init(void);
 
+/**
+ * Select how runcmd_open() starts commands
+ *
+ * With RUNCMD_SPAWN_POSIX, commands are started with posix_spawn(),
+ * which avoids copying the page tables of a large parent process
+ * the way fork() does. Pipes, process groups and the environment
+ * are set up exactly as with fork(). Commands that can't be spawned
+ * that way, or that fail to start, are retried with fork() so errors
+ * are reported the same regardless of method.
+ * @param method One of the RUNCMD_SPAWN_* values
+ * @return 0 on success, RUNCMD_EINVAL if the method is unknown or
+ * unsupported on this system
+ */
+extern int runcmd_set_spawn_method(int method);
+
 /**
  * Return pid of a command with a specific file descriptor
  * @param[in] fd stdout filedescriptor of the child to get pid from
@@ -78,6 +97,24 @@ extern int runcmd_open(const char *cmd, int *pfd, int *pfderr, char **env,
 		void (*iobreg)(int, int, void *), void *iobregarg)
 	__attribute__((__nonnull__(1, 2, 3, 5, 6)));
 
+/**
+ * Start a command from an argument vector
+ *
+ * This is runcmd_open() for callers that have already split the
+ * command into words. argv[0] is looked up in $PATH like execvp()
+ * does, and no shell is ever involved. Unlike with runcmd_open(),
+ * VAR=value words at the start of argv are not treated specially.
+ * @param[in] argv NULL-terminated argument vector of the command
+ * @param[out] pfd Child's stdout filedescriptor
+ * @param[out] pfderr Child's stderr filedescriptor
+ * @param[in] env NULL-terminated name, value, name, value... vector
+ * @param[in] iobreg The callback function to register the iobrokers for the read ends of the pipe
+ * @param[in] iobregarg The "arg" value to pass to iobroker_register()
+ */
+extern int runcmd_open_argv(char **argv, int *pfd, int *pfderr, char **env,
+		void (*iobreg)(int, int, void *), void *iobregarg)
+	__attribute__((__nonnull__(1, 2, 3, 5, 6)));
+
 /**
  * Close a command and return its exit status
  * @note Don't use this. It's a retarded way to reap children suitable
@@ -11,6 +11,13 @@
  * add(), pop() and remove() are O(lg n), although remove() is
  * impossible unless caller maintains the pointer to the scheduled
  * event.
+ *
+ * It also implements a hierarchical timing wheel for callers that
+ * schedule huge numbers of events and reschedule them often. With
+ * that backend, add() and remove() are O(1). peek() and pop() are
+ * amortized O(1) for queues where most seconds in the near future
+ * have something scheduled, which is what a busy scheduler looks
+ * like.
  */
 
 #include <stdlib.h>
@@ -26,6 +33,52 @@ struct squeue_event {
 	pqueue_pri_t pri;
 	struct timeval when;
 	void *data;
+	struct squeue_event *next, *prev; /* timing wheel slot links */
+};
+
+/*
+ * The timing wheel has SQW_LEVELS levels. Level 0 has one slot per
+ * second for the next SQW_L0_SIZE seconds. Each slot in level N
+ * covers the entire span of level N-1, so with 8 bits for level 0
+ * and 6 bits for each of the other four, the wheel can tell 2^32
+ * seconds apart. Events further away than that are parked in the
+ * last slot of the top level and re-placed as time moves on.
+ *
+ * Higher level slots are cascaded (re-placed) into lower levels
+ * as the cursor reaches them, so events only ever get run from
+ * level 0. Level 0 slots are sorted lazily, when the cursor lands
+ * on them, which keeps add() O(1) even while cascading large
+ * slots.
+ */
+#define SQW_L0_BITS 8
+#define SQW_LN_BITS 6
+#define SQW_LEVELS 5
+#define SQW_L0_SIZE (1 << SQW_L0_BITS)
+#define SQW_LN_SIZE (1 << SQW_LN_BITS)
+#define SQW_L0_MASK (SQW_L0_SIZE - 1)
+#define SQW_LN_MASK (SQW_LN_SIZE - 1)
+#define SQW_SLOTS (SQW_L0_SIZE + ((SQW_LEVELS - 1) * SQW_LN_SIZE))
+#define SQW_SHIFT(lvl) (SQW_L0_BITS + (((lvl) - 1) * SQW_LN_BITS))
+#define SQW_BASE(lvl) (SQW_L0_SIZE + (((lvl) - 1) * SQW_LN_SIZE))
+#define SQW_LEVEL(pos) ((pos) < SQW_L0_SIZE ? 0 : 1 + (((pos) - SQW_L0_SIZE) >> SQW_LN_BITS))
+#define SQW_MAX_DELTA ((1ULL << SQW_SHIFT(SQW_LEVELS)) - 1)
+
+struct sqw_slot {
+	struct squeue_event *head, *tail;
+	int unsorted;
+};
+
+struct sq_wheel {
+	unsigned int size;
+	unsigned long long now; /* the second the cursor points to */
+	unsigned int count[SQW_LEVELS]; /* events per level */
+	unsigned long long l0_map[SQW_L0_SIZE / 64]; /* non-empty level 0 slots */
+	struct sqw_slot slot[SQW_SLOTS];
+};
+
+struct squeue {
+	pqueue_t *pq;
+	struct sq_wheel *wheel;
 };
 
 /*
@@ -80,6 +133,289 @@ static void sq_set_pos(void *a, unsigned int pos)
 	((squeue_event *)a)->pos = pos;
 }
 
+static inline void sqw_map_set(struct sq_wheel *w, unsigned int idx)
+{
+	w->l0_map[idx >> 6] |= 1ULL << (idx & 63);
+}
+
+static inline void sqw_map_clear(struct sq_wheel *w, unsigned int idx)
+{
+	w->l0_map[idx >> 6] &= ~(1ULL << (idx & 63));
+}
+
+/* find the first non-empty level 0 slot at or after idx. -1 if none */
+static int sqw_map_next(struct sq_wheel *w, unsigned int idx)
+{
+	unsigned int word = idx >> 6;
+	unsigned long long bits = w->l0_map[word] & (~0ULL << (idx & 63));
+
+	while (!bits) {
+		if (++word >= sizeof(w->l0_map) / sizeof(w->l0_map[0]))
+			return -1;
+		bits = w->l0_map[word];
+	}
+
+	for (idx = word << 6; !(bits & 1); bits >>= 1)
+		idx++;
+	return idx;
+}
+
+/* stable merge of two pri-sorted singly-linked lists */
+static squeue_event *sqw_merge(squeue_event *a, squeue_event *b)
+{
+	squeue_event head, *tail = &head;
+
+	while (a && b) {
+		if (b->pri < a->pri) {
+			tail->next = b;
+			b = b->next;
+		} else {
+			tail->next = a;
+			a = a->next;
+		}
+		tail = tail->next;
+	}
+	tail->next = a ? a : b;
+	return head.next;
+}
+
+static squeue_event *sqw_msort(squeue_event *list)
+{
+	squeue_event *slow, *fast, *back;
+
+	if (!list || !list->next)
+		return list;
+
+	slow = list;
+	fast = list->next;
+	while (fast && fast->next) {
+		slow = slow->next;
+		fast = fast->next->next;
+	}
+	back = slow->next;
+	slow->next = NULL;
+
+	return sqw_merge(sqw_msort(list), sqw_msort(back));
+}
+
+static void sqw_sort(struct sqw_slot *s)
+{
+	squeue_event *evt, *prev = NULL;
+
+	s->head = sqw_msort(s->head);
+	for (evt = s->head; evt; evt = evt->next) {
+		evt->prev = prev;
+		prev = evt;
+	}
+	s->tail = prev;
+	s->unsorted = 0;
+}
+
+/*
+ * Find the event a new one with priority 'pri' should go after, by
+ * scanning backwards a few steps from the tail. NULL means it goes
+ * first. If it's further back than we're willing to look, we return
+ * the tail, and the caller appends and marks the slot for sorting.
+ */
+#define SQW_MAX_SCAN 16
+static squeue_event *sqw_find_prev(struct sqw_slot *s, pqueue_pri_t pri)
+{
+	squeue_event *cur = s->tail;
+	int i;
+
+	for (i = 0; cur && cur->pri > pri; i++, cur = cur->prev) {
+		if (i == SQW_MAX_SCAN)
+			return s->tail;
+	}
+	return cur;
+}
+
+static void sqw_place(struct sq_wheel *w, squeue_event *evt)
+{
+	unsigned long long t = (unsigned long long)evt->when.tv_sec, delta;
+	unsigned int idx, lvl = 0;
+	struct sqw_slot *s;
+	squeue_event *cur;
+
+	/* events already due go in the slot we'll run next */
+	if (t < w->now)
+		t = w->now;
+	delta = t - w->now;
+
+	if (delta < SQW_L0_SIZE) {
+		idx = t & SQW_L0_MASK;
+	} else {
+		if (delta > SQW_MAX_DELTA) {
+			delta = SQW_MAX_DELTA;
+			t = w->now + delta;
+		}
+		for (lvl = 1; lvl < SQW_LEVELS - 1; lvl++) {
+			if (delta < (1ULL << SQW_SHIFT(lvl + 1)))
+				break;
+		}
+		idx = SQW_BASE(lvl) + ((t >> SQW_SHIFT(lvl)) & SQW_LN_MASK);
+	}
+
+	evt->pos = idx;
+	s = &w->slot[idx];
+	if (!s->tail || s->tail->pri <= evt->pri) {
+		/* the common case: append, keeping the slot sorted */
+		evt->prev = s->tail;
+		evt->next = NULL;
+		if (s->tail)
+			s->tail->next = evt;
+		else
+			s->head = evt;
+		s->tail = evt;
+	} else if (idx == (w->now & SQW_L0_MASK) && !s->unsorted &&
+	           (cur = sqw_find_prev(s, evt->pri)) != s->tail) {
+		/* keep the slot we're running from sorted when it's cheap */
+		evt->prev = cur;
+		evt->next = cur ? cur->next : s->head;
+		evt->next->prev = evt;
+		if (cur)
+			cur->next = evt;
+		else
+			s->head = evt;
+	} else {
+		/* sorted when (and if) the cursor gets here */
+		evt->prev = s->tail;
+		evt->next = NULL;
+		s->tail->next = evt;
+		s->tail = evt;
+		s->unsorted = 1;
+	}
+
+	w->count[lvl]++;
+	if (!lvl)
+		sqw_map_set(w, idx);
+}
+
+static void sqw_unlink(struct sq_wheel *w, squeue_event *evt)
+{
+	struct sqw_slot *s = &w->slot[evt->pos];
+
+	if (evt->prev)
+		evt->prev->next = evt->next;
+	else
+		s->head = evt->next;
+	if (evt->next)
+		evt->next->prev = evt->prev;
+	else
+		s->tail = evt->prev;
+	evt->next = evt->prev = NULL;
+
+	w->count[SQW_LEVEL(evt->pos)]--;
+	if (!s->head) {
+		s->unsorted = 0;
+		if (evt->pos < SQW_L0_SIZE)
+			sqw_map_clear(w, evt->pos);
+	}
+}
+
+static void sqw_insert(struct sq_wheel *w, squeue_event *evt)
+{
+	/* an empty wheel can be moved anywhere, so start it here */
+	if (!w->size)
+		w->now = (unsigned long long)evt->when.tv_sec;
+	sqw_place(w, evt);
+	w->size++;
+}
+
+static void sqw_remove(struct sq_wheel *w, squeue_event *evt)
+{
+	sqw_unlink(w, evt);
+	w->size--;
+}
+
+/*
+ * Re-place the higher level slots that cover the second the cursor
+ * just moved to. Lower levels go first, and we only move up a level
+ * when the cursor has wrapped around the level below it.
+ */
+static void sqw_cascade(struct sq_wheel *w)
+{
+	unsigned int lvl, idx;
+	struct sqw_slot *s;
+	squeue_event *evt, *next;
+
+	for (lvl = 1; lvl < SQW_LEVELS; lvl++) {
+		idx = (w->now >> SQW_SHIFT(lvl)) & SQW_LN_MASK;
+		s = &w->slot[SQW_BASE(lvl) + idx];
+		evt = s->head;
+		s->head = s->tail = NULL;
+		s->unsorted = 0;
+		for (; evt; evt = next) {
+			next = evt->next;
+			w->count[lvl]--;
+			sqw_place(w, evt);
+		}
+		if (idx)
+			break;
+	}
+}
+
+/*
+ * Move the cursor to the first non-empty level 0 slot, sort it if
+ * it needs sorting and return it. The cursor only ever passes over
+ * empty slots, so late-comers that are already due can always be
+ * put in the slot it points to.
+ */
+static struct sqw_slot *sqw_settle(struct sq_wheel *w)
+{
+	struct sqw_slot *s;
+	unsigned int lvl;
+	int idx;
+
+	while (w->size) {
+		idx = sqw_map_next(w, w->now & SQW_L0_MASK);
+		if (idx >= 0) {
+			w->now += idx - (w->now & SQW_L0_MASK);
+			s = &w->slot[idx];
+			if (s->unsorted)
+				sqw_sort(s);
+			return s;
+		}
+
+		/*
+		 * Nothing more in this level 0 round. If the levels
+		 * below some level are all empty, there's nothing to
+		 * cascade until that level's next boundary, so we
+		 * can skip straight to it.
+		 */
+		for (lvl = 1; lvl < SQW_LEVELS - 1; lvl++) {
+			if (w->count[lvl - 1] || w->count[lvl])
+				break;
+		}
+		w->now = (w->now | ((1ULL << SQW_SHIFT(lvl)) - 1)) + 1;
+		sqw_cascade(w);
+	}
+
+	return NULL;
+}
+
+static squeue_event *sqw_peek(struct sq_wheel *w)
+{
+	struct sqw_slot *s = sqw_settle(w);
+	return s ? s->head : NULL;
+}
+
+static void sqw_destroy(struct sq_wheel *w, int flags)
+{
+	unsigned int i;
+	squeue_event *evt, *next;
+
+	for (i = 0; i < SQW_SLOTS; i++) {
+		for (evt = w->slot[i].head; evt; evt = next) {
+			next = evt->next;
+			if (flags & SQUEUE_FREE_DATA)
+				free(evt->data);
+			free(evt);
+		}
+	}
+	free(w);
+}
+
 const struct timeval *squeue_event_runtime(squeue_event *evt)
 {
 	if (evt)
@@ -94,12 +430,38 @@ void *squeue_event_data(squeue_event *evt)
 	return NULL;
 }
 
+squeue_t *squeue_create_type(int type, unsigned int horizon)
+{
+	squeue_t *q;
+
+	q = calloc(1, sizeof(*q));
+	if (!q)
+		return NULL;
+
+	if (type == SQUEUE_WHEEL) {
+		q->wheel = calloc(1, sizeof(*q->wheel));
+	} else {
+		if (!horizon)
+			horizon = 127; /* makes pqueue allocate 128 elements */
+		q->pq = pqueue_init(horizon, sq_cmp_pri, sq_get_pri, sq_set_pri, sq_get_pos, sq_set_pos);
+	}
+
+	if (!q->pq && !q->wheel) {
+		free(q);
+		return NULL;
+	}
+
+	return q;
+}
+
 squeue_t *squeue_create(unsigned int horizon)
 {
-	if (!horizon)
-		horizon = 127; /* makes pqueue allocate 128 elements */
+	return squeue_create_type(SQUEUE_HEAP, horizon);
+}
 
-	return pqueue_init(horizon, sq_cmp_pri, sq_get_pri, sq_set_pri, sq_get_pos, sq_set_pos);
+int squeue_type(squeue_t *q)
+{
+	return q && q->wheel ? SQUEUE_WHEEL : SQUEUE_HEAP;
 }
 
 squeue_event *squeue_add_tv(squeue_t *q, struct timeval *tv, void *data)
@@ -131,7 +493,12 @@ squeue_event *squeue_add_tv(squeue_t *q, struct timeval *tv, void *data)
 
 	evt->pri = evt_compute_pri(&evt->when);
 
-	if (!pqueue_insert(q, evt))
+	if (q->wheel) {
+		sqw_insert(q->wheel, evt);
+		return evt;
+	}
+
+	if (!pqueue_insert(q->pq, evt))
 		return evt;
 
 	free(evt);
@@ -170,6 +537,9 @@ void squeue_change_priority_tv(squeue_t *q, squeue_event *evt, struct timeval *t
 {
 	if (!q || !evt || !tv) return;
 
+	if (q->wheel)
+		sqw_remove(q->wheel, evt);
+
 	evt->when.tv_sec = tv->tv_sec;
 	if (sizeof(evt->when.tv_sec) > 4) {
 		/* Only use bottom sizeof(pqueue_pri_t)-SQ_BITS bits on 64-bit systems,
@@ -179,12 +549,23 @@ void squeue_change_priority_tv(squeue_t *q, squeue_event *evt, struct timeval *t
 	}
 	evt->when.tv_usec = tv->tv_usec;
 
-	pqueue_change_priority(q, evt_compute_pri(&evt->when), evt);
+	if (q->wheel) {
+		evt->pri = evt_compute_pri(&evt->when);
+		sqw_insert(q->wheel, evt);
+		return;
+	}
+
+	pqueue_change_priority(q->pq, evt_compute_pri(&evt->when), evt);
 }
 
 void *squeue_peek(squeue_t *q)
 {
-	squeue_event *evt = pqueue_peek(q);
+	squeue_event *evt;
+
+	if (!q)
+		return NULL;
+
+	evt = q->wheel ? sqw_peek(q->wheel) : pqueue_peek(q->pq);
 	if (evt)
 		return evt->data;
 	return NULL;
@@ -195,7 +576,15 @@ void *squeue_pop(squeue_t *q)
 	squeue_event *evt;
 	void *ptr = NULL;
 
-	evt = pqueue_pop(q);
+	if (!q)
+		return NULL;
+
+	if (q->wheel) {
+		if ((evt = sqw_peek(q->wheel)))
+			sqw_remove(q->wheel, evt);
+	} else {
+		evt = pqueue_pop(q->pq);
+	}
 	if (evt) {
 		ptr = evt->data;
 		free(evt);
@@ -205,11 +594,14 @@ void *squeue_pop(squeue_t *q)
 
 int squeue_remove(squeue_t *q, squeue_event *evt)
 {
-	int ret;
+	int ret = 0;
 
 	if (!q || !evt)
 		return -1;
-	ret = pqueue_remove(q, evt);
+	if (q->wheel)
+		sqw_remove(q->wheel, evt);
+	else
+		ret = pqueue_remove(q->pq, evt);
 	if (evt)
 		free(evt);
 
@@ -220,31 +612,135 @@ void squeue_destroy(squeue_t *q, int flags)
 {
 	unsigned int i;
 
-	if (!q || pqueue_size(q) < 1)
+	if (!q)
 		return;
 
+	if (q->wheel) {
+		sqw_destroy(q->wheel, flags);
+		free(q);
+		return;
+	}
+
 	/*
 	 * Using two separate loops is a lot faster than
 	 * doing 1 cmp+branch for every queued item
 	 */
 	if (flags & SQUEUE_FREE_DATA) {
-		for (i = 0; i < pqueue_size(q); i++) {
-			free(((squeue_event *)q->d[i + 1])->data);
-			free(q->d[i + 1]);
+		for (i = 0; i < pqueue_size(q->pq); i++) {
+			free(((squeue_event *)q->pq->d[i + 1])->data);
+			free(q->pq->d[i + 1]);
 		}
 	} else {
-		for (i = 0; i < pqueue_size(q); i++) {
-			free(q->d[i + 1]);
+		for (i = 0; i < pqueue_size(q->pq); i++) {
+			free(q->pq->d[i + 1]);
 		}
 	}
-	pqueue_free(q);
+	pqueue_free(q->pq);
+	free(q);
 }
 
 unsigned int squeue_size(squeue_t *q)
 {
 	if (!q)
 		return 0;
-	return pqueue_size(q);
+	if (q->wheel)
+		return q->wheel->size;
+	return pqueue_size(q->pq);
+}
+
+/*
+ * Walk the heap in order by popping a shallow copy of it. Popping
+ * scribbles over the positions of the shared events, so we have
+ * to restore those from the original heap afterwards.
+ */
+static int sq_heap_walk(pqueue_t *pq, pqueue_pri_t last, int (*walker)(squeue_event *, void *), void *arg)
+{
+	pqueue_t dup;
+	squeue_event *evt;
+	unsigned int i;
+
+	dup = *pq;
+	dup.d = malloc(pq->size * sizeof(void *));
+	if (!dup.d)
+		return -1;
+	memcpy(dup.d, pq->d, pq->size * sizeof(void *));
+	dup.avail = dup.size;
+
+	while ((evt = pqueue_pop(&dup))) {
+		if (evt->pri > last || walker(evt, arg))
+			break;
+	}
+
+	for (i = 1; i < pq->size; i++) {
+		if ((evt = pq->d[i]))
+			evt->pos = i;
+	}
+	free(dup.d);
+
+	return 0;
+}
+
+static int sqw_walk_cmp(const void *a_, const void *b_)
+{
+	const squeue_event *a = *(const squeue_event **)a_;
+	const squeue_event *b = *(const squeue_event **)b_;
+
+	if (a->pri == b->pri)
+		return 0;
+	return a->pri > b->pri ? 1 : -1;
+}
+
+/*
+ * Higher levels aren't sorted at all and events that are due may
+ * still sit in one of them, so we simply collect everything we
+ * need to walk and sort that. This is meant for infrequent bulk
+ * operations, not for use in tight loops.
+ */
+static int sqw_walk(struct sq_wheel *w, pqueue_pri_t last, int (*walker)(squeue_event *, void *), void *arg)
+{
+	squeue_event **ary, *evt;
+	unsigned int i, n = 0;
+
+	if (!w->size)
+		return 0;
+
+	ary = malloc(w->size * sizeof(*ary));
+	if (!ary)
+		return -1;
+
+	for (i = 0; i < SQW_SLOTS; i++) {
+		for (evt = w->slot[i].head; evt; evt = evt->next) {
+			if (evt->pri <= last)
+				ary[n++] = evt;
+		}
+	}
+	qsort(ary, n, sizeof(*ary), sqw_walk_cmp);
+
+	for (i = 0; i < n; i++) {
+		if (walker(ary[i], arg))
+			break;
+	}
+	free(ary);
+
+	return 0;
+}
+
+int squeue_walk(squeue_t *q, time_t until, int (*walker)(squeue_event *, void *), void *arg)
+{
+	struct timeval tv;
+
+	if (!q || !walker)
+		return -1;
+
+	/* the last possible priority within 'until' */
+	tv.tv_sec = until;
+	tv.tv_usec = (1 << SQ_BITS) - 1;
+	if (sizeof(tv.tv_sec) > 4)
+		tv.tv_sec &= (1ULL << ((sizeof(pqueue_pri_t) * 8) - SQ_BITS)) - 1;
+
+	if (q->wheel)
+		return sqw_walk(q->wheel, evt_compute_pri(&tv), walker, arg);
+	return sq_heap_walk(q->pq, evt_compute_pri(&tv), walker, arg);
 }
 
 int squeue_evt_when_is_after(squeue_event *evt, struct timeval *reftime) {
@@ -7,9 +7,14 @@
  * @file squeue.h
  * @brief Scheduling queue function declarations
  *
- * This library is based on the pqueue api, which implements a
- * priority queue based on a binary heap, providing O(lg n) times
- * for insert() and remove(), and O(1) time for peek().
+ * This library has two backends. The default one is based on the
+ * pqueue api, which implements a priority queue based on a binary
+ * heap, providing O(lg n) times for insert() and remove(), and O(1)
+ * time for peek().
+ * The other is a hierarchical timing wheel with one-second slots,
+ * providing O(1) insert() and remove(). Events scheduled for the
+ * same second are kept in order of their full timestamp, and events
+ * with identical timestamps are run in the order they were added.
  * @note There is no "find". Callers must maintain pointers to their
  * scheduled events if they wish to be able to remove them.
  *
@@ -21,7 +26,8 @@
  * The pqueue library can be useful on its own though, so we
  * don't block that from user view.
  */
-typedef pqueue_t squeue_t;
+struct squeue;
+typedef struct squeue squeue_t;
 struct squeue_event;
 typedef struct squeue_event squeue_event;
 
@@ -30,6 +36,12 @@ typedef struct squeue_event squeue_event;
  */
 #define SQUEUE_FREE_DATA (1 << 0) /** Call free() on all data pointers */
 
+/**
+ * Backends for squeue_create_type()
+ */
+#define SQUEUE_HEAP  0 /** Binary heap, O(lg n) add and remove */
+#define SQUEUE_WHEEL 1 /** Timing wheel, O(1) add and remove */
+
 /**
  * Get the scheduled runtime of this event
  * @param[in] evt The event to get runtime of
@@ -59,6 +71,24 @@ extern void *squeue_event_data(squeue_event *evt);
  */
 extern squeue_t *squeue_create(unsigned int size);
 
+/**
+ * Creates a scheduling queue using the given backend.
+ * squeue_create(size) is equivalent to
+ * squeue_create_type(SQUEUE_HEAP, size).
+ *
+ * @param type SQUEUE_HEAP or SQUEUE_WHEEL
+ * @param size Hint about how large this queue will get
+ * @return A pointer to a scheduling queue, or NULL on errors
+ */
+extern squeue_t *squeue_create_type(int type, unsigned int size);
+
+/**
+ * Get the backend type of a scheduling queue
+ * @param[in] q The scheduling queue to inspect
+ * @return SQUEUE_HEAP or SQUEUE_WHEEL
+ */
+extern int squeue_type(squeue_t *q);
+
 /**
  * Destroys a scheduling queue completely
  * @param[in] q The doomed queue
@@ -157,6 +187,22 @@ extern int squeue_remove(squeue_t *q, squeue_event *evt);
  */
 extern unsigned int squeue_size(squeue_t *q);
 
+/**
+ * Walks all events scheduled to run no later than 'until' in the
+ * order they will be run, without removing them from the queue.
+ * The walker must not add, remove or reschedule events in the queue
+ * it's walking, but may stash the squeue_event pointers and do so
+ * once squeue_walk() returns.
+ *
+ * @param[in] q The scheduling queue to walk
+ * @param[in] until Unix timestamp of the last second to walk
+ * @param[in] walker Callback to run for each event. Returning non-zero
+ *                   from it stops the walk
+ * @param[in] arg Argument passed as-is to walker
+ * @return 0 on success, -1 on errors
+ */
+extern int squeue_walk(squeue_t *q, time_t until, int (*walker)(squeue_event *, void *), void *arg);
+
 
 /**
  * Returns true if passed timeval is after the time for the event
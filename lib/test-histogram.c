@@ -0,0 +1,59 @@
+#include "t-utils.h"
+#include "lnag-utils.h"
+#include "histogram.c"
+
+int main(int argc, char **argv)
+{
+	histogram *h;
+	unsigned long long v, prev = 0;
+	unsigned int i, bad = 0;
+
+	t_set_colors(0);
+	t_start("histogram tests");
+
+	/* buckets must be contiguous, and every value must fit its bucket */
+	for (v = 0; v < 1 << 20; v++) {
+		unsigned int idx = bucket_index(v);
+		if (idx != prev && idx != prev + 1)
+			bad++;
+		if (v > bucket_high(idx) || (idx && v <= bucket_high(idx - 1)))
+			bad++;
+		prev = idx;
+	}
+	ok_int(bad, 0, "buckets are contiguous and cover all values");
+	ok_int(bucket_index(31), 31, "small values get a bucket each");
+	ok_int(bucket_index(MAX_VALUE), NUM_BUCKETS - 1, "largest value goes in the last bucket");
+	t_ok(bucket_high(NUM_BUCKETS - 1) == MAX_VALUE, "last bucket ends at the largest value");
+	for (bad = 0, i = 2 * SUB_BUCKETS; i < NUM_BUCKETS; i++) {
+		unsigned long long low = bucket_high(i - 1) + 1;
+		if ((bucket_high(i) - low) * SUB_BUCKETS > low)
+			bad++;
+	}
+	ok_int(bad, 0, "bucket widths stay within 1/16th of their values");
+
+	h = histogram_create();
+	t_ok(h != NULL, "histogram_create()");
+	t_ok(histogram_percentile(h, 50) == 0 && histogram_max(h) == 0, "empty histogram reports zero");
+
+	for (v = 1; v <= 1000; v++)
+		histogram_add(h, v * 1000);
+	t_ok(histogram_count(h) == 1000, "count");
+	t_ok(histogram_max(h) == 1000000, "max is exact");
+	v = histogram_percentile(h, 50);
+	t_ok(v >= 500000 && v <= 500000 + 500000 / 16, "p50 of 1..1000ms is 500ms (got %llu)", v);
+	v = histogram_percentile(h, 99);
+	t_ok(v >= 990000 && v <= 990000 + 990000 / 16, "p99 of 1..1000ms is 990ms (got %llu)", v);
+	t_ok(histogram_percentile(h, 100) == 1000000, "p100 is the max");
+	v = histogram_percentile(h, 0);
+	t_ok(v >= 1000 && v <= 1000 + 1000 / 16, "p0 is the min (got %llu)", v);
+
+	histogram_add(h, ~0ULL);
+	t_ok(histogram_max(h) == MAX_VALUE, "huge values are capped");
+
+	histogram_reset(h);
+	histogram_add(h, 7);
+	t_ok(histogram_count(h) == 1 && histogram_percentile(h, 95) == 7, "reset forgets old values");
+	histogram_destroy(h);
+
+	return t_end();
+}
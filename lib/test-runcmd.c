@@ -2,6 +2,7 @@
 #include "runcmd.c"
 #include "t-utils.h"
 #include <stdio.h>
+#include <sys/mman.h>
 
 #define BUF_SIZE 1024
 
@@ -106,39 +107,147 @@ struct {
 	{ 0, NULL, 0, { NULL, NULL, NULL }},
 };
 
+static const char *spawn_methods[] = { "fork", "posix_spawn" };
+
 /* We need an iobreg callback to pass to runcmd_open(). */
 static void stub_iobreg(int fdout, int fderr, void *arg) { }
 
+/* runs cmd, or argv if given, and returns what it printed on stdout */
+static char *run_output(const char *cmd, char **argv, char **env, int *status)
+{
+	static char out[64 * BUF_SIZE];
+	int pfd[2] = {-1, -1}, pfderr[2] = {-1, -1};
+	int stub_iobregarg = 0;
+	int fd, len = 0, ret;
+
+	if (argv)
+		fd = runcmd_open_argv(argv, pfd, pfderr, env, stub_iobreg, &stub_iobregarg);
+	else
+		fd = runcmd_open(cmd, pfd, pfderr, env, stub_iobreg, &stub_iobregarg);
+	if (fd < 0)
+		return NULL;
+	while (len < (int)sizeof(out) - 1 && (ret = read(fd, out + len, sizeof(out) - 1 - len)) > 0)
+		len += ret;
+	out[len] = 0;
+	close(pfderr[0]);
+	*status = runcmd_close(fd);
+	return out;
+}
+
+/* how many /bin/true's per second we can start and reap */
+static double spawn_rate(int count)
+{
+	struct timeval start, stop;
+	int i, status;
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < count; i++)
+		run_output("/bin/true", NULL, NULL, &status);
+	gettimeofday(&stop, NULL);
+
+	return count / ((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0);
+}
+
 int main(int argc, char **argv)
 {
-	int ret, r2;
+	int ret = 0, r2, method;
 
 	runcmd_init();
 	t_set_colors(0);
-	t_start("exec output comparison");
+	for (method = 0; method < 2; method++) {
+		/* posix_spawn() isn't available everywhere */
+		if (runcmd_set_spawn_method(method) < 0)
+			continue;
+		t_start("exec output comparison (%s)", spawn_methods[method]);
+		{
+			int i;
+			char *out = calloc(1, BUF_SIZE);
+			for (i = 0; cases[i].input != NULL; i++) {
+				memset(out, 0, BUF_SIZE);
+				int pfd[2] = {-1, -1}, pfderr[2] = {-1, -1};
+				/* We need a stub iobregarg since runcmd_open()'s prototype
+				 * declares it attribute non-null. */
+				int stub_iobregarg = 0;
+				int fd;
+				char *cmd;
+				asprintf(&cmd, ECHO_COMMAND " -n %s", cases[i].input);
+				fd = runcmd_open(cmd, pfd, pfderr, NULL, stub_iobreg, &stub_iobregarg);
+				free(cmd);
+				read(pfd[0], out, BUF_SIZE);
+				ok_str(cases[i].output, out, "Echoing a command should give expected output");
+				close(pfd[0]);
+				close(pfderr[0]);
+				close(fd);
+			}
+			free(out);
+		}
+		r2 = t_end();
+		ret = r2 ? r2 : ret;
+		t_reset();
+		t_start("child setup (%s)", spawn_methods[method]);
+		{
+			char *env[] = { "RUNCMD_TEST1", "from env", "RUNCMD_TEST2", "overridden", NULL };
+			char *out;
+			int status;
+
+			out = run_output("RUNCMD_TEST2=wins /usr/bin/env", NULL, env, &status);
+			t_ok(out && strstr(out, "RUNCMD_TEST1=from env\n"), "env pairs are exported");
+			t_ok(out && strstr(out, "RUNCMD_TEST2=wins\n") && !strstr(out, "overridden"),
+				 "VAR=value words override env pairs");
+			t_ok(out && strstr(out, "PATH="), "our own environment is passed on");
+			out = run_output("/bin/sh -c 'exit 3'", NULL, NULL, &status);
+			ok_int(status, 3, "exit status is picked up");
+			{
+				char *args[] = { ECHO_COMMAND, "-n", "two  words", "$HOME", "A=b", NULL };
+				out = run_output(NULL, args, NULL, &status);
+				ok_str(out, "two  words $HOME A=b", "argv is run as it is, without a shell");
+				args[0] = "A=b";
+				out = run_output(NULL, args, NULL, &status);
+				ok_int(status, ENOENT, "argv[0] is never a variable assignment");
+			}
+			{
+				int pfd[2] = {-1, -1}, pfderr[2] = {-1, -1};
+				int stub_iobregarg = 0, fd;
+				char c;
+				pid_t pid;
+
+				fd = runcmd_open("/bin/true", pfd, pfderr, NULL, stub_iobreg, &stub_iobregarg);
+				pid = runcmd_pid(fd);
+				/* unreaped, so it's still around to ask */
+				while (read(fd, &c, 1) > 0)
+					;
+				ok_int((int)getpgid(pid), (int)pid, "child leads its own process group");
+				close(pfderr[0]);
+				runcmd_close(fd);
+			}
+			out = run_output("/nonexistent/command", NULL, NULL, &status);
+			t_ok(out && status == ENOENT, "failing exec is reported by the child");
+		}
+		r2 = t_end();
+		ret = r2 ? r2 : ret;
+		t_reset();
+	}
+
+	t_start("spawn speed");
 	{
-		int i;
-		char *out = calloc(1, BUF_SIZE);
-		for (i = 0; cases[i].input != NULL; i++) {
-			memset(out, 0, BUF_SIZE);
-			int pfd[2] = {-1, -1}, pfderr[2] = {-1, -1};
-			/* We need a stub iobregarg since runcmd_open()'s prototype
-			 * declares it attribute non-null. */
-			int stub_iobregarg = 0;
-			int fd;
-			char *cmd;
-			asprintf(&cmd, ECHO_COMMAND " -n %s", cases[i].input);
-			fd = runcmd_open(cmd, pfd, pfderr, NULL, stub_iobreg, &stub_iobregarg);
-			free(cmd);
-			read(pfd[0], out, BUF_SIZE);
-			ok_str(cases[i].output, out, "Echoing a command should give expected output");
-			close(pfd[0]);
-			close(pfderr[0]);
-			close(fd);
+		size_t size = 64 << 20;
+		char *big;
+
+		/* look like a worker that has grown large */
+		big = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (big != MAP_FAILED)
+			memset(big, 1, size);
+		for (method = 0; method < 2; method++) {
+			if (runcmd_set_spawn_method(method) < 0)
+				continue;
+			t_diag("%s: %.0f spawns/s with %luMiB mapped", spawn_methods[method],
+				   spawn_rate(200), big != MAP_FAILED ? (unsigned long)(size >> 20) : 0UL);
 		}
-		free(out);
+		if (big != MAP_FAILED)
+			munmap(big, size);
+		runcmd_set_spawn_method(RUNCMD_SPAWN_FORK);
 	}
-	ret = t_end();
+	t_end();
 	t_reset();
 	t_start("anomaly detection");
 	{
@@ -12,23 +12,6 @@
 #include "squeue.c"
 #include "t-utils.h"
 
-static void squeue_foreach(squeue_t *q, int (*walker)(squeue_event *, void *), void *arg)
-{
-	squeue_t *dup;
-	void *e, *dup_d;
-
-	dup = squeue_create(q->size);
-	dup_d = dup->d;
-	memcpy(dup, q, sizeof(*q));
-	dup->d = dup_d;
-	memcpy(dup->d, q->d, (q->size * sizeof(void *)));
-
-	while ((e = pqueue_pop(dup))) {
-		walker(e, arg);
-	}
-	squeue_destroy(dup, 0);
-}
-
 #define t(expr, args...) \
 	do { \
 		if ((expr)) { \
@@ -44,11 +27,10 @@ typedef struct sq_test_event {
 } sq_test_event;
 
 static time_t sq_high = 0;
+static int sq_walks = 0;
 static int sq_walker(squeue_event *evt, void *arg)
 {
-	static int walks = 0;
-
-	walks++;
+	sq_walks++;
 	t(sq_high <= evt->when.tv_sec, "sq_high: %lu; evt->when: %lu\n",
 	  sq_high, evt->when.tv_sec);
 	sq_high = (unsigned long)evt->when.tv_sec;
@@ -56,6 +38,11 @@ static int sq_walker(squeue_event *evt, void *arg)
 	return 0;
 }
 
+static int sq_valid(squeue_t *sq)
+{
+	return sq->pq ? pqueue_is_valid(sq->pq) : 1;
+}
+
 #define EVT_ARY 65101
 static int sq_test_random(squeue_t *sq)
 {
@@ -73,7 +60,7 @@ static int sq_test_random(squeue_t *sq)
 		t(squeue_size(sq) == i + 1 + size);
 	}
 
-	t(pqueue_is_valid(sq));
+	t(sq_valid(sq));
 
 	/*
 	 * make sure we pop events in increasing "priority",
@@ -87,20 +74,94 @@ static int sq_test_random(squeue_t *sq)
 		max = *d;
 		t(squeue_size(sq) == size + (EVT_ARY - i - 1));
 	}
-	t(pqueue_is_valid(sq));
+	t(sq_valid(sq));
 
 	return 0;
 }
 
-int main(int argc, char **argv)
+/*
+ * Spread events over a few years so the timing wheel has to
+ * cascade them through all its levels on the way out.
+ */
+#define SPREAD_ARY 20011
+static void sq_test_spread(squeue_t *sq)
+{
+	unsigned long i;
+	sq_test_event *ary, *x;
+	struct timeval tv;
+	time_t now = time(NULL);
+	pqueue_pri_t max = 0;
+	int ok = 1;
+
+	ary = calloc(SPREAD_ARY, sizeof(*ary));
+	for (i = 0; i < SPREAD_ARY; i++) {
+		tv.tv_sec = now + (rand() % (1 << (i % 27)));
+		tv.tv_usec = rand() % 1000000;
+		ary[i].id = i;
+		ary[i].evt = squeue_add_tv(sq, &tv, &ary[i]);
+	}
+	t(squeue_size(sq) == SPREAD_ARY);
+
+	/* every other event gets removed or rescheduled */
+	for (i = 0; i < SPREAD_ARY; i += 2) {
+		if (i % 4) {
+			squeue_remove(sq, ary[i].evt);
+			ary[i].evt = NULL;
+			continue;
+		}
+		tv.tv_sec = now + (rand() % 600);
+		tv.tv_usec = rand() % 1000000;
+		squeue_change_priority_tv(sq, ary[i].evt, &tv);
+	}
+	t(squeue_size(sq) == SPREAD_ARY - (SPREAD_ARY / 4) - 1,
+	  "size: %u\n", squeue_size(sq));
+
+	sq_high = 0;
+	sq_walks = 0;
+	squeue_walk(sq, now + 600, sq_walker, NULL);
+	t(sq_walks > 0 && (unsigned int)sq_walks < squeue_size(sq));
+
+	for (i = 0; (x = squeue_peek(sq)); i++) {
+		ok &= max <= x->evt->pri;
+		max = x->evt->pri;
+		ok &= squeue_pop(sq) == x;
+		x->evt = NULL;
+	}
+	t(ok, "popping spread events in order");
+	t(i == SPREAD_ARY - (SPREAD_ARY / 4) - 1);
+	t(squeue_size(sq) == 0);
+	free(ary);
+}
+
+/*
+ * With the timing wheel, events with identical timestamps must come
+ * out in the order they went in. The binary heap makes no such promise.
+ */
+static void sq_test_fifo(squeue_t *sq)
+{
+	sq_test_event ary[100];
+	struct timeval tv;
+	unsigned int i;
+	int ok = 1;
+
+	tv.tv_sec = time(NULL) + 2;
+	tv.tv_usec = 500;
+	for (i = 0; i < ARRAY_SIZE(ary); i++) {
+		ary[i].id = i;
+		ary[i].evt = squeue_add_tv(sq, &tv, &ary[i]);
+	}
+	for (i = 0; i < ARRAY_SIZE(ary); i++) {
+		ok &= squeue_pop(sq) == &ary[i];
+	}
+	t(ok, "identical timestamps pop in FIFO order");
+}
+
+static void sq_test(int type)
 {
 	squeue_t *sq;
 	struct timeval tv;
 	sq_test_event a, b, c, d, *x;
 
-	t_set_colors(0);
-	t_start("squeue tests");
-
 	a.id = 1;
 	b.id = 2;
 	c.id = 3;
@@ -109,7 +170,8 @@ int main(int argc, char **argv)
 	gettimeofday(&tv, NULL);
 	/* Order in is a, b, c, d, but we should get b, c, d, a out. */
 	srand(tv.tv_usec ^ tv.tv_sec);
-	t((sq = squeue_create(1024)) != NULL);
+	t((sq = squeue_create_type(type, 1024)) != NULL);
+	t(squeue_type(sq) == type);
 	t(squeue_size(sq) == 0);
 
 	/* we fill and empty the squeue completely once before testing */
@@ -170,10 +232,32 @@ int main(int argc, char **argv)
 	t(squeue_remove(NULL, NULL) == -1);
 	t(squeue_remove(NULL, a.evt) == -1);
 
-	squeue_foreach(sq, sq_walker, NULL);
+	sq_high = 0;
+	sq_walks = 0;
+	t(squeue_walk(sq, time(NULL) + 10, sq_walker, NULL) == 0);
+	t(sq_walks == 2, "sq_walks: %d\n", sq_walks);
+	t(squeue_size(sq) == 2);
 
 	/* clean up to prevent false valgrind positives */
 	squeue_destroy(sq, 0);
 
+	t((sq = squeue_create_type(type, 0)) != NULL);
+	if (type == SQUEUE_WHEEL)
+		sq_test_fifo(sq);
+	sq_test_spread(sq);
+	squeue_destroy(sq, 0);
+}
+
+int main(int argc, char **argv)
+{
+	t_set_colors(0);
+
+	t_start("squeue tests, binary heap");
+	sq_test(SQUEUE_HEAP);
+	t_end();
+
+	t_start("squeue tests, timing wheel");
+	sq_test(SQUEUE_WHEEL);
+
 	return t_end();
 }
@@ -0,0 +1,142 @@
+#define _GNU_SOURCE 1
+#include <stdio.h>
+#include "worker.c"
+#include "t-utils.h"
+
+static child_process cp;
+static struct pplugin_proc proc;
+
+/* feeds a persistent plugin response to the parser */
+static int parse(const char *resp, unsigned long len)
+{
+	free(cp.outstd.buf);
+	free(cp.outerr.buf);
+	memset(&cp, 0, sizeof(cp));
+	free(proc.buf);
+	memset(&proc, 0, sizeof(proc));
+
+	proc.cp = &cp;
+	proc.buf = malloc(len + 1);
+	memcpy(proc.buf, resp, len);
+	proc.len = len;
+
+	return pplugin_parse_response(&proc);
+}
+#define parse_str(s) parse(s, strlen(s))
+
+/* hands data to an iocache the way it gets it from a worker */
+static void feed(iocache *ioc, char *buf, unsigned long len)
+{
+	int pfd[2];
+
+	if (pipe(pfd) < 0)
+		return;
+	write(pfd[1], buf, len);
+	close(pfd[1]);
+	iocache_read(ioc, pfd[0]);
+	close(pfd[0]);
+}
+
+/* builds a result frame and feeds it to an iocache in pieces */
+static void test_result_frames(void)
+{
+	struct worker_result_frame res, out;
+	char *str[WORKER_FRAME_NSTR] = { "/bin/true", "OK - fine|x=1", "", NULL };
+	char *got[WORKER_FRAME_NSTR];
+	char *buf, *frame, *copy;
+	unsigned long size, fsize;
+	iocache *ioc;
+	int i;
+
+	memset(&res, 0, sizeof(res));
+	res.job_id = 17;
+	res.type = 3;
+	res.wait_status = 2 << 8;
+	res.stop_sec = 1234567890;
+	res.stop_usec = 999999;
+	for (i = 0; i < WORKER_FRAME_NSTR; i++)
+		res.len[i] = str[i] ? strlen(str[i]) : 0;
+	buf = build_result_frame(&res, str, &size);
+	copy = malloc(size);
+	memcpy(copy, buf, size);
+
+	ioc = iocache_create(32);
+	feed(ioc, copy, 10);
+	ok_int(worker_ioc2frame(ioc, &frame, &fsize), 0, "partial header needs more data");
+	feed(ioc, copy + 10, 20);
+	ok_int(worker_ioc2frame(ioc, &frame, &fsize), 0, "partial frame needs more data");
+	ok_int((int)iocache_size(ioc), (int)size, "iocache grows to fit the frame");
+	feed(ioc, copy + 30, size - 30);
+	ok_int(worker_ioc2frame(ioc, &frame, &fsize), 1, "complete frame is found");
+	ok_int((int)fsize, (int)size, "frame size");
+	ok_int(worker_ioc2frame(ioc, &frame, &fsize), 0, "nothing left after the frame");
+
+	ok_int(worker_decode_result(frame, fsize, &out, got), 0, "frame decodes");
+	t_ok(out.job_id == 17 && out.type == 3 && out.wait_status == 2 << 8, "numbers survive");
+	t_ok(out.stop_sec == 1234567890 && out.stop_usec == 999999, "times survive");
+	t_ok(!strcmp(got[WORKER_FRAME_COMMAND], "/bin/true"), "command");
+	t_ok(!strcmp(got[WORKER_FRAME_OUTSTD], "OK - fine|x=1"), "stdout");
+	t_ok(!*got[WORKER_FRAME_OUTERR] && !*got[WORKER_FRAME_ERROR_MSG], "empty strings");
+	t_ok(got[WORKER_FRAME_OUTSTD] > frame && got[WORKER_FRAME_OUTSTD] < frame + fsize,
+	     "strings point into the frame");
+
+	ok_int(worker_decode_result(copy, size - 1, &out, got), -1, "short frame is rejected");
+	memcpy(&res, copy, sizeof(res));
+	res.len[WORKER_FRAME_OUTSTD] += 100;
+	memcpy(copy, &res, sizeof(res));
+	ok_int(worker_decode_result(copy, size, &out, got), -1, "oversized string is rejected");
+
+	iocache_reset(ioc);
+	feed(ioc, "log=garbage\0\1\0\0\0", 16);
+	ok_int(worker_ioc2frame(ioc, &frame, &fsize), -1, "text messages aren't frames");
+
+	iocache_destroy(ioc);
+	free(copy);
+}
+
+int main(int argc, char **argv)
+{
+	char *big;
+	int hdrlen;
+
+	t_set_colors(0);
+	t_start("persistent plugin response parsing");
+
+	ok_int(parse_str("2 5 3\nhelloerr"), 0, "complete response");
+	ok_int(cp.ret, 2 << 8, "exit code is reported like wait() does");
+	t_ok(cp.outstd.len == 5 && !strcmp(cp.outstd.buf, "hello"), "stdout");
+	t_ok(cp.outerr.len == 3 && !strcmp(cp.outerr.buf, "err"), "stderr");
+	ok_int(parse_str("0 0 0\n"), 0, "response without output");
+	t_ok(cp.outstd.len == 0 && !*cp.outstd.buf, "empty stdout");
+
+	ok_int(parse_str("0 5"), 1, "header without newline needs more data");
+	ok_int(parse_str("0 5 3\nhel"), 1, "truncated output needs more data");
+	ok_int(parse_str("0 5 3\nhelloer"), 1, "truncated stderr needs more data");
+	ok_int(parse_str("0 1 0\nxy"), -1, "trailing data is garbage");
+	ok_int(parse_str("256 0 0\n"), -1, "exit code out of range");
+	ok_int(parse_str("0 1 0 1\nx"), -1, "extra header field");
+	ok_int(parse_str("0 abc 0\n"), -1, "non-numeric length");
+	ok_int(parse_str("00000000000000000000000000000000000000000000000000000000000000000"), -1,
+	       "long header without newline");
+
+	/* lengths are checked before we wait for the output to arrive */
+	ok_int(parse_str("0 999999999 0\n"), -1, "oversized stdout length");
+	ok_int(parse_str("0 0 999999999\n"), -1, "oversized stderr length");
+	ok_int(parse_str("0 -1 0\n"), -1, "negative length");
+	ok_int(parse_str("0 18446744073709551615 1\n"), -1, "lengths that would overflow");
+
+	big = malloc(PPLUGIN_MAX_OUTPUT + 64);
+	hdrlen = sprintf(big, "0 %d 0\n", PPLUGIN_MAX_OUTPUT);
+	memset(big + hdrlen, 'x', PPLUGIN_MAX_OUTPUT);
+	ok_int(parse(big, hdrlen + PPLUGIN_MAX_OUTPUT), 0, "largest allowed output");
+	ok_int((int)cp.outstd.len, PPLUGIN_MAX_OUTPUT, "largest allowed output is all there");
+	hdrlen = sprintf(big, "0 %d 0\n", PPLUGIN_MAX_OUTPUT + 1);
+	ok_int(parse(big, hdrlen + 10), -1, "one byte more is rejected");
+	free(big);
+
+	t_end();
+	t_start("binary result frames");
+	test_result_frames();
+
+	return t_end();
+}
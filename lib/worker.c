@@ -15,6 +15,13 @@
 #define PAIR_SEP 0 /**< pair separator for buf2kvvec() and kvvec2buf() */
 #define KV_SEP '=' /**< key/value separator for buf2kvvec() and kvvec2buf() */
 
+#define PPLUGIN_MAX_PROCS 4 /**< persistent plugin instances per plugin */
+#define PPLUGIN_ENV "NAGIOS_PLUGIN_PERSISTENT" /**< set for persistent plugins */
+#define PPLUGIN_MAX_OUTPUT (64 * 1024) /**< most stdout or stderr we take from a persistent plugin */
+
+struct pplugin;
+struct pplugin_proc;
+
 struct execution_information {
 	squeue_event *sq_event;
 	pid_t pid;
@@ -23,18 +30,48 @@ struct execution_information {
 	struct timeval stop;
 	float runtime;
 	struct rusage rusage;
+	int persistent; /**< master asked for a persistent plugin */
+	char **argv; /**< command already split up by the master, or NULL */
+	int argc;
+	struct pplugin_proc *pproc; /**< persistent plugin instance running this job */
+};
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/* one running instance of a persistent plugin */
+struct pplugin_proc {
+	pid_t pid;
+	int sd;      /**< plugin's stdin and stdout */
+	char *buf;   /**< response read so far */
+	unsigned long len;
+	child_process *cp; /**< job it's working on, or NULL if idle */
+	struct pplugin *pp;
+	struct pplugin_proc *next;
+};
+
+struct pplugin {
+	char *path;
+	unsigned int nprocs;
+	struct pplugin_proc *procs;
+	struct pplugin *next;
 };
 
 static iobroker_set *iobs;
 static squeue_t *sq;
 static unsigned int started, running_jobs, timeouts, reapable;
 static int master_sd;
+static int worker_proto = WORKER_PROTO_TEXT;
 static int parent_pid;
 static fanout_table *ptab;
+static struct pplugin *pplugins;
 
 static void exit_worker(int code, const char *msg)
 {
 	child_process *cp;
+	struct pplugin *pp;
+	struct pplugin_proc *proc;
 	int discard;
 #ifdef HAVE_SIGACTION
 	struct sigaction sig_action;
@@ -62,12 +99,21 @@ static void exit_worker(int code, const char *msg)
 	signal(SIGSEGV, SIG_IGN);
 #endif
 	kill(0, SIGTERM);
+	for (pp = pplugins; pp; pp = pp->next) {
+		for (proc = pp->procs; proc; proc = proc->next)
+			(void)kill(-proc->pid, SIGTERM);
+	}
 	while (waitpid(-1, &discard, WNOHANG) > 0)
 		; /* do nothing */
 	sleep(1);
 	while ((cp = (child_process *)squeue_pop(sq))) {
 		/* kill all processes in the child's process group */
-		(void)kill(-cp->ei->pid, SIGKILL);
+		if (cp->ei->pid)
+			(void)kill(-cp->ei->pid, SIGKILL);
+	}
+	for (pp = pplugins; pp; pp = pp->next) {
+		for (proc = pp->procs; proc; proc = proc->next)
+			(void)kill(-proc->pid, SIGKILL);
 	}
 	sleep(1);
 	while (waitpid(-1, &discard, WNOHANG) > 0)
@@ -86,19 +132,24 @@ __attribute__((__format__(__printf__, 1, 2)))
 static void wlog(const char *fmt, ...)
 {
 #define LOG_KEY_LEN 4
-	static char lmsg[8192] = "log=";
-	int len;
+	static char lmsg[8192];
+	int len, hdrlen;
 	va_list ap;
 
+	if (worker_proto == WORKER_PROTO_BINARY)
+		hdrlen = sizeof(struct worker_frame);
+	else
+		hdrlen = LOG_KEY_LEN; /* log= */
+
 	va_start(ap, fmt);
-	len = vsnprintf(lmsg + LOG_KEY_LEN, sizeof(lmsg) - LOG_KEY_LEN - MSG_DELIM_LEN, fmt, ap);
+	len = vsnprintf(lmsg + hdrlen, sizeof(lmsg) - hdrlen - MSG_DELIM_LEN, fmt, ap);
 	va_end(ap);
 	if (len < 0) {
 		/* We can't send what we can't print. */
 		return;
 	}
 
-	len += LOG_KEY_LEN; /* log= */
+	len += hdrlen;
 	if (len > sizeof(lmsg) - MSG_DELIM_LEN - 1) {
 		/* A truncated log is better than no log or buffer overflows. */
 		len = sizeof(lmsg) - MSG_DELIM_LEN - 1;
@@ -107,8 +158,14 @@ static void wlog(const char *fmt, ...)
 	/* Add the kv pair separator and the message delimiter. */
 	lmsg[len] = 0;
 	len++;
-	memcpy(lmsg + len, MSG_DELIM, MSG_DELIM_LEN);
-	len += MSG_DELIM_LEN;
+	if (worker_proto == WORKER_PROTO_BINARY) {
+		struct worker_frame frame = { WORKER_FRAME_MAGIC, WORKER_FRAME_LOG, len };
+		memcpy(lmsg, &frame, sizeof(frame));
+	} else {
+		memcpy(lmsg, "log=", LOG_KEY_LEN);
+		memcpy(lmsg + len, MSG_DELIM, MSG_DELIM_LEN);
+		len += MSG_DELIM_LEN;
+	}
 
 	if (write(master_sd, lmsg, len) < 0 && errno == EPIPE) {
 		/* Master has died or abandoned us, so exit. */
@@ -116,6 +173,117 @@ static void wlog(const char *fmt, ...)
 	}
 }
 
+void worker_set_protocol(int proto)
+{
+	worker_proto = proto;
+}
+
+/* finds a value in a job request, which is short enough to just scan */
+static char *request_value(struct kvvec *kvv, const char *key)
+{
+	int i;
+
+	for (i = 0; kvv && i < kvv->kv_pairs; i++) {
+		if (!strcmp(kvv->kv[i].key, key))
+			return kvv->kv[i].value;
+	}
+	return NULL;
+}
+
+/*
+ * Builds a binary result frame in a buffer that's reused for the
+ * next one. The caller fills in the numbers and the string lengths.
+ */
+static char *build_result_frame(struct worker_result_frame *res, char **str, unsigned long *size)
+{
+	static char *buf;
+	static unsigned long bufsize;
+	unsigned long len = sizeof(*res);
+	char *ptr;
+	int i;
+
+	for (i = 0; i < WORKER_FRAME_NSTR; i++) {
+		if (!str[i])
+			res->len[i] = 0;
+		len += res->len[i] + 1;
+	}
+	if (len > bufsize) {
+		if (!(ptr = realloc(buf, len)))
+			return NULL;
+		buf = ptr;
+		bufsize = len;
+	}
+
+	res->frame.magic = WORKER_FRAME_MAGIC;
+	res->frame.kind = WORKER_FRAME_RESULT;
+	res->frame.size = len;
+	memcpy(buf, res, sizeof(*res));
+	ptr = buf + sizeof(*res);
+	for (i = 0; i < WORKER_FRAME_NSTR; i++) {
+		if (res->len[i])
+			memcpy(ptr, str[i], res->len[i]);
+		ptr += res->len[i];
+		*ptr++ = 0;
+	}
+
+	*size = len;
+	return buf;
+}
+
+static int send_result_frame(struct worker_result_frame *res, char **str)
+{
+	unsigned long size;
+	char *buf;
+
+	if (!(buf = build_result_frame(res, str, &size)))
+		return -1;
+	return nwrite(master_sd, buf, size, NULL);
+}
+
+int worker_ioc2frame(iocache *ioc, char **frame, unsigned long *size)
+{
+	struct worker_frame hdr;
+	char *buf;
+
+	if (!(buf = iocache_use_size(ioc, sizeof(hdr))))
+		return 0;
+	memcpy(&hdr, buf, sizeof(hdr));
+	iocache_unuse_size(ioc, sizeof(hdr));
+
+	if (hdr.magic != WORKER_FRAME_MAGIC || hdr.size < sizeof(hdr) || hdr.size > WORKER_FRAME_MAX)
+		return -1;
+
+	if (hdr.size > iocache_size(ioc) && iocache_resize(ioc, hdr.size) < 0)
+		return -1;
+	if (!(buf = iocache_use_size(ioc, hdr.size)))
+		return 0;
+
+	*frame = buf;
+	*size = hdr.size;
+	return 1;
+}
+
+int worker_decode_result(char *buf, unsigned long size, struct worker_result_frame *res, char **str)
+{
+	unsigned long offset = sizeof(*res);
+	int i;
+
+	if (size < sizeof(*res))
+		return -1;
+	memcpy(res, buf, sizeof(*res));
+	if (res->frame.kind != WORKER_FRAME_RESULT || res->frame.size != size)
+		return -1;
+
+	for (i = 0; i < WORKER_FRAME_NSTR; i++) {
+		if (res->len[i] >= size - offset || buf[offset + res->len[i]])
+			return -1;
+		str[i] = buf + offset;
+		offset += res->len[i] + 1;
+	}
+
+	return 0;
+}
+
 __attribute__((__format__(__printf__, 3, 4)))
 static void job_error(child_process *cp, struct kvvec *kvv, const char *fmt, ...)
 {
@@ -138,6 +306,31 @@ static void job_error(child_process *cp, struct kvvec *kvv, const char *fmt, ...
 	}
 	msg[len] = 0;
 
+	if (worker_proto == WORKER_PROTO_BINARY) {
+		struct worker_result_frame res;
+		char *str[WORKER_FRAME_NSTR] = { NULL }, *value;
+
+		memset(&res, 0, sizeof(res));
+		if (cp)
+			res.job_id = cp->id;
+		else if ((value = request_value(kvv, "job_id")))
+			res.job_id = atoi(value);
+		else
+			res.job_id = -1;
+		res.type = (value = request_value(kvv, "type")) ? atoi(value) : -1;
+		if ((str[WORKER_FRAME_COMMAND] = request_value(kvv, "command")))
+			res.len[WORKER_FRAME_COMMAND] = strlen(str[WORKER_FRAME_COMMAND]);
+		str[WORKER_FRAME_ERROR_MSG] = msg;
+		res.len[WORKER_FRAME_ERROR_MSG] = len;
+
+		if (send_result_frame(&res, str) < 0 && errno == EPIPE) {
+			/* Master has died or abandoned us, so exit. */
+			exit_worker(1, "Failed to send job error frame to master");
+		}
+		kvvec_destroy(kvv, 0);
+		return;
+	}
+
 	if (cp) {
 		kvvec_addkv(kvv, "job_id", mkstr("%d", cp->id));
 	}
@@ -215,6 +408,7 @@ int worker_buf2kvvec_prealloc(struct kvvec *kvv, char *buf, unsigned long len, i
 
 /* forward declaration */
 static void gather_output(child_process *cp, iobuf *io, int final);
+static void pplugin_kill_job(child_process *cp, int reason);
 
 static void destroy_job(child_process *cp)
 {
@@ -239,6 +433,12 @@ static void destroy_job(child_process *cp)
 	if(NULL != cp->env) kvvec_destroy(cp->env, KVVEC_FREE_ALL);
 	kvvec_destroy(cp->request, KVVEC_FREE_ALL);
 	free(cp->cmd);
+	if (cp->ei->argv) {
+		int i;
+		for (i = 0; i < cp->ei->argc; i++)
+			free(cp->ei->argv[i]);
+		free(cp->ei->argv);
+	}
 
 	free(cp->ei);
 	free(cp);
@@ -254,6 +454,50 @@ static void destroy_job(child_process *cp)
 		} \
 	} while (0)
 
+/* sends the result of a job as a binary frame */
+static int finish_job_binary(child_process *cp, int reason)
+{
+	struct worker_result_frame res;
+	struct rusage *ru = &cp->ei->rusage;
+	char *str[WORKER_FRAME_NSTR], *type;
+
+	memset(&res, 0, sizeof(res));
+	res.job_id = cp->id;
+	res.type = (type = request_value(cp->request, "type")) ? atoi(type) : -1;
+	res.timeout = cp->timeout;
+	res.wait_status = cp->ret;
+	res.start_sec = cp->ei->start.tv_sec;
+	res.start_usec = cp->ei->start.tv_usec;
+	res.stop_sec = cp->ei->stop.tv_sec;
+	res.stop_usec = cp->ei->stop.tv_usec;
+	if (!reason) {
+		res.exited_ok = 1;
+		res.ru_utime_sec = ru->ru_utime.tv_sec;
+		res.ru_utime_usec = ru->ru_utime.tv_usec;
+		res.ru_stime_sec = ru->ru_stime.tv_sec;
+		res.ru_stime_usec = ru->ru_stime.tv_usec;
+		res.ru_minflt = ru->ru_minflt;
+		res.ru_majflt = ru->ru_majflt;
+		res.ru_inblock = ru->ru_inblock;
+		res.ru_oublock = ru->ru_oublock;
+	} else {
+		res.error_code = reason;
+	}
+
+	str[WORKER_FRAME_COMMAND] = cp->cmd;
+	res.len[WORKER_FRAME_COMMAND] = strlen(cp->cmd);
+	str[WORKER_FRAME_OUTSTD] = cp->outstd.buf;
+	res.len[WORKER_FRAME_OUTSTD] = cp->outstd.len;
+	str[WORKER_FRAME_OUTERR] = cp->outerr.buf;
+	res.len[WORKER_FRAME_OUTERR] = cp->outerr.len;
+	str[WORKER_FRAME_ERROR_MSG] = NULL;
+
+	if (send_result_frame(&res, str) < 0 && errno == EPIPE)
+		exit_worker(1, "Failed to send result frame to master");
+
+	return 0;
+}
+
 int finish_job(child_process *cp, int reason)
 {
 	static struct kvvec resp = KVVEC_INITIALIZER;
@@ -274,12 +518,6 @@ int finish_job(child_process *cp, int reason)
 	strip_nul_bytes(cp->outstd);
 	strip_nul_bytes(cp->outerr);
 
-	/* how many key/value pairs do we need? */
-	if (kvvec_init(&resp, 12 + cp->request->kv_pairs) == NULL) {
-		/* what the hell do we do now? */
-		exit_worker(1, "Failed to init response key/value vector");
-	}
-
 	gettimeofday(&cp->ei->stop, NULL);
 
 	if (running_jobs != squeue_size(sq)) {
@@ -289,6 +527,15 @@ int finish_job(child_process *cp, int reason)
 			 started, running_jobs, started - running_jobs);
 	}
 
+	if (worker_proto == WORKER_PROTO_BINARY)
+		return finish_job_binary(cp, reason);
+
+	/* how many key/value pairs do we need? */
+	if (kvvec_init(&resp, 12 + cp->request->kv_pairs) == NULL) {
+		/* what the hell do we do now? */
+		exit_worker(1, "Failed to init response key/value vector");
+	}
+
 	cp->ei->runtime = tv_delta_f(&cp->ei->start, &cp->ei->stop);
 
 	/*
@@ -297,10 +544,16 @@ int finish_job(child_process *cp, int reason)
 	 */
 	for (i = 0; i < cp->request->kv_pairs; i++) {
 		struct key_value *kv = &cp->request->kv[i];
-		/* skip environment macros */
+		/* skip environment macros and our own instructions */
 		if (kv->key_len == 3 && !strcmp(kv->key, "env")) {
 			continue;
 		}
+		if (kv->key_len == 10 && !strcmp(kv->key, "persistent")) {
+			continue;
+		}
+		if (kv->key_len == 3 && !strcmp(kv->key, "arg")) {
+			continue;
+		}
 		kvvec_addkv_wlen(&resp, kv->key, kv->key_len, kv->value, kv->value_len);
 	}
 	kvvec_addkv(&resp, "wait_status", mkstr("%d", cp->ret));
@@ -378,6 +631,11 @@ static void kill_job(child_process *cp, int reason)
 	int ret, status, reaped = 0;
 	int pid = cp ? cp->ei->pid : 0;
 
+	if (cp && cp->ei->pproc) {
+		pplugin_kill_job(cp, reason);
+		return;
+	}
+
 	/*
 	 * first attempt at reaping, so see if we just failed to
 	 * notice that things were going wrong her
@@ -575,14 +833,344 @@ char **env_from_kvvec(struct kvvec *kvv_env) {
 	return env;
 }
 
+/*
+ * Persistent plugins
+ *
+ * A fork() and an exec() per check is where a busy worker spends
+ * most of its time. Plugins written for it can instead be kept
+ * running and handed one job at a time over a pipe. We do that for
+ * jobs where the master added "persistent=1" to the request, as
+ * long as the command line can be run without a shell and starts
+ * with the absolute path to the plugin. Everything
+ * else, and anything that goes wrong while starting an instance,
+ * takes the normal runcmd_open() path, so a persistent plugin must
+ * also work when run the normal way.
+ *
+ * Instances are started without arguments and with
+ * NAGIOS_PLUGIN_PERSISTENT=1 in the environment. Each job is written
+ * to the plugin's stdin as "<length>\n" followed by that many bytes
+ * of nul-separated key=value pairs:
+ *   timeout=<seconds>
+ *   arg=<argument>         once per argument, argv[0] excluded
+ *   <NAME>=<value>         environment macros, if any
+ * The plugin answers on stdout with
+ *   "<exit code> <stdout length> <stderr length>\n"
+ * followed by the plugin's stdout and stderr output, and then waits
+ * for the next job. It should exit when stdin is closed. Responses
+ * with more than PPLUGIN_MAX_OUTPUT bytes of either are garbage.
+ * Instances that die, time out or send garbage are killed, and later
+ * jobs get a fresh one. We keep at most PPLUGIN_MAX_PROCS instances
+ * of each plugin. When they're all busy, the job is run the normal
+ * way rather than waiting in line behind a slow one.
+ */
+static struct pplugin *pplugin_get(const char *path)
+{
+	struct pplugin *pp;
+
+	for (pp = pplugins; pp; pp = pp->next) {
+		if (!strcmp(pp->path, path))
+			return pp;
+	}
+
+	if (!(pp = calloc(1, sizeof(*pp))))
+		return NULL;
+	if (!(pp->path = strdup(path))) {
+		free(pp);
+		return NULL;
+	}
+	pp->next = pplugins;
+	pplugins = pp;
+	return pp;
+}
+
+static int pplugin_read(int fd, int events, void *proc_);
+
+/*
+ * We talk to instances over a socket rather than pipes, so we can
+ * use MSG_NOSIGNAL and not get killed by SIGPIPE if one dies.
+ */
+static struct pplugin_proc *pplugin_spawn(struct pplugin *pp)
+{
+	struct pplugin_proc *proc;
+	int sv[2];
+	pid_t pid;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0)
+		return NULL;
+
+	pid = fork();
+	if (!pid) {
+		int devnull;
+
+		setpgid(0, 0);
+		dup2(sv[1], STDIN_FILENO);
+		dup2(sv[1], STDOUT_FILENO);
+		if ((devnull = open("/dev/null", O_WRONLY)) >= 0)
+			dup2(devnull, STDERR_FILENO);
+		close(sv[0]);
+		close(sv[1]);
+		setenv(PPLUGIN_ENV, "1", 1);
+		execl(pp->path, pp->path, (char *)NULL);
+		_exit(127);
+	}
+	close(sv[1]);
+
+	if (pid < 0 || !(proc = calloc(1, sizeof(*proc)))) {
+		if (pid > 0)
+			kill(pid, SIGKILL);
+		close(sv[0]);
+		return NULL;
+	}
+
+	fcntl(sv[0], F_SETFD, FD_CLOEXEC);
+	proc->pid = pid;
+	proc->sd = sv[0];
+	proc->pp = pp;
+	if (iobroker_register(iobs, proc->sd, proc, pplugin_read) < 0) {
+		wlog("Failed to register iobroker for persistent plugin %s", pp->path);
+		kill(pid, SIGKILL);
+		close(proc->sd);
+		free(proc);
+		return NULL;
+	}
+	proc->next = pp->procs;
+	pp->procs = proc;
+	pp->nprocs++;
+
+	return proc;
+}
+
+/* kills an instance. The job it was running, if any, is the caller's */
+static void pplugin_destroy_proc(struct pplugin_proc *proc)
+{
+	struct pplugin *pp = proc->pp;
+	struct pplugin_proc **link;
+
+	for (link = &pp->procs; *link; link = &(*link)->next) {
+		if (*link == proc) {
+			*link = proc->next;
+			pp->nprocs--;
+			break;
+		}
+	}
+
+	/* it's in a process group of its own, like all our children */
+	kill(-proc->pid, SIGKILL);
+	iobroker_close(iobs, proc->sd);
+	if (proc->cp)
+		proc->cp->ei->pproc = NULL;
+	free(proc->buf);
+	free(proc);
+}
+
+static int pplugin_sendall(int sd, const char *buf, unsigned long len)
+{
+	while (len) {
+		ssize_t sent = send(sd, buf, len, MSG_NOSIGNAL);
+		if (sent < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		buf += sent;
+		len -= sent;
+	}
+	return 0;
+}
+
+static int pplugin_send(struct pplugin_proc *proc, struct kvvec_buf *req)
+{
+	char hdr[32];
+	int len;
+
+	len = snprintf(hdr, sizeof(hdr), "%lu\n", req->buflen);
+	if (pplugin_sendall(proc->sd, hdr, len) < 0)
+		return -1;
+	return pplugin_sendall(proc->sd, req->buf, req->buflen);
+}
+
+/* parses a complete response. Returns 1 if we need more data, -1 on errors */
+static int pplugin_parse_response(struct pplugin_proc *proc)
+{
+	child_process *cp = proc->cp;
+	unsigned long outlen, errlen, hdrlen;
+	char *nl, *ptr;
+	int code;
+
+	if (!(nl = memchr(proc->buf, '\n', proc->len)))
+		return proc->len > 64 ? -1 : 1;
+	*nl = 0;
+	code = (int)strtol(proc->buf, &ptr, 10);
+	outlen = strtoul(ptr, &ptr, 10);
+	errlen = strtoul(ptr, &ptr, 10);
+	*nl = '\n';
+	if (ptr != nl || code < 0 || code > 255)
+		return -1;
+	if (outlen > PPLUGIN_MAX_OUTPUT || errlen > PPLUGIN_MAX_OUTPUT)
+		return -1;
+
+	hdrlen = (unsigned long)(nl - proc->buf) + 1;
+	if (proc->len < hdrlen + outlen + errlen)
+		return 1;
+	if (proc->len > hdrlen + outlen + errlen)
+		return -1; /* nothing was asked for */
+
+	cp->outstd.buf = malloc(outlen + 1);
+	cp->outerr.buf = malloc(errlen + 1);
+	if (!cp->outstd.buf || !cp->outerr.buf)
+		return -1;
+	memcpy(cp->outstd.buf, nl + 1, outlen);
+	cp->outstd.buf[outlen] = 0;
+	cp->outstd.len = outlen;
+	memcpy(cp->outerr.buf, nl + 1 + outlen, errlen);
+	cp->outerr.buf[errlen] = 0;
+	cp->outerr.len = errlen;
+	cp->ret = code << 8; /* what wait() would have said */
+
+	return 0;
+}
+
+static int pplugin_read(int fd, int events, void *proc_)
+{
+	struct pplugin_proc *proc = (struct pplugin_proc *)proc_;
+	child_process *cp = proc->cp;
+	char buf[4096];
+	int rd, ret = -1;
+
+	rd = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+	if (rd < 0 && (errno == EAGAIN || errno == EINTR))
+		return 0;
+
+	if (rd > 0 && cp) {
+		char *nbuf = realloc(proc->buf, proc->len + rd);
+		if (nbuf) {
+			proc->buf = nbuf;
+			memcpy(proc->buf + proc->len, buf, rd);
+			proc->len += rd;
+			ret = pplugin_parse_response(proc);
+		}
+	}
+
+	if (ret > 0)
+		return 0;
+
+	if (!ret) {
+		proc->cp = NULL;
+		proc->len = 0;
+		cp->ei->pproc = NULL;
+		finish_job(cp, 0);
+		destroy_job(cp);
+	} else {
+		if (rd > 0)
+			wlog("Bad response from persistent plugin %s (pid=%ld)", proc->pp->path, (long)proc->pid);
+		else
+			wlog("Persistent plugin %s (pid=%ld) went away", proc->pp->path, (long)proc->pid);
+		pplugin_destroy_proc(proc);
+		if (cp) {
+			finish_job(cp, EPIPE);
+			destroy_job(cp);
+		}
+	}
+
+	return 0;
+}
+
+/* timeouts. The instance is killed, since we can't tell it to stop */
+static void pplugin_kill_job(child_process *cp, int reason)
+{
+	struct pplugin_proc *proc = cp->ei->pproc;
+
+	wlog("job %d: Killing persistent plugin %s (pid=%ld)", cp->id, proc->pp->path, (long)proc->pid);
+	pplugin_destroy_proc(proc);
+	finish_job(cp, reason);
+	destroy_job(cp);
+}
+
+/*
+ * Hands a job to an idle persistent plugin instance. Returns -1
+ * if it has to be run the normal way.
+ */
+static int pplugin_run(child_process *cp)
+{
+	struct kvvec *kvv;
+	struct kvvec_buf *kvvb;
+	struct pplugin *pp;
+	struct pplugin_proc *proc;
+	char **argv;
+	int argc = 0, i, ret;
+
+	if (!(argv = calloc((strlen(cp->cmd) / 2) + 5, sizeof(char *))))
+		return -1;
+	ret = runcmd_cmd2strv(cp->cmd, &argc, argv);
+	if (ret || argc < 1 || *argv[0] != '/' || strchr(argv[0], '=')) {
+		if (ret != RUNCMD_EINVAL && ret != RUNCMD_EALLOC && argc > 0)
+			free(argv[0]);
+		free(argv);
+		return -1;
+	}
+
+	proc = NULL;
+	if ((pp = pplugin_get(argv[0]))) {
+		for (proc = pp->procs; proc; proc = proc->next) {
+			if (!proc->cp)
+				break;
+		}
+		if (!proc && pp->nprocs < PPLUGIN_MAX_PROCS)
+			proc = pplugin_spawn(pp);
+	}
+	if (!proc || !(kvv = kvvec_create(argc + (cp->env ? cp->env->kv_pairs : 0)))) {
+		free(argv[0]);
+		free(argv);
+		return -1;
+	}
+
+	kvvec_addkv(kvv, "timeout", (char *)mkstr("%u", cp->timeout));
+	for (i = 1; i < argc; i++)
+		kvvec_addkv(kvv, "arg", argv[i]);
+	for (i = 0; cp->env && i < cp->env->kv_pairs; i++) {
+		struct key_value *kv = &cp->env->kv[i];
+		kvvec_addkv_wlen(kvv, kv->key, kv->key_len, kv->value, kv->value_len);
+	}
+	kvvb = kvvec2buf(kvv, KV_SEP, PAIR_SEP, 0);
+	kvvec_destroy(kvv, 0);
+	free(argv[0]);
+	free(argv);
+	if (!kvvb)
+		return -1;
+
+	ret = pplugin_send(proc, kvvb);
+	free(kvvb->buf);
+	free(kvvb);
+	if (ret < 0) {
+		wlog("Failed to send job %d to persistent plugin %s (pid=%ld)", cp->id, pp->path, (long)proc->pid);
+		pplugin_destroy_proc(proc);
+		return -1;
+	}
+
+	proc->cp = cp;
+	proc->len = 0;
+	cp->ei->pproc = proc;
+	cp->outstd.fd = cp->outerr.fd = -1;
+
+	return 0;
+}
+
 int start_cmd(child_process *cp)
 {
 	int pfd[2] = {-1, -1}, pfderr[2] = {-1, -1};
+	char **env;
+
+	if (cp->ei->persistent && !pplugin_run(cp))
+		return 0;
 
-	char **env = env_from_kvvec(cp->env);
+	env = env_from_kvvec(cp->env);
 
-	cp->outstd.fd = runcmd_open(cp->cmd, pfd, pfderr, env, 
-			cmd_iobroker_register, cp);
+	if (cp->ei->argv)
+		cp->outstd.fd = runcmd_open_argv(cp->ei->argv, pfd, pfderr, env,
+				cmd_iobroker_register, cp);
+	else
+		cp->outstd.fd = runcmd_open(cp->cmd, pfd, pfderr, env, 
+				cmd_iobroker_register, cp);
 	my_free(env);
 	if (cp->outstd.fd < 0) {
 		return -1;
@@ -646,6 +1234,19 @@ static child_process *parse_command_kvvec(struct kvvec *kvv)
 			cp->env = buf2kvvec(value, strlen(value), '=', '\n', KVVEC_COPY);
 			continue;
 		}
+		if (!strcmp(key, "persistent")) {
+			cp->ei->persistent = !!atoi(value);
+			continue;
+		}
+		if (!strcmp(key, "arg")) {
+			char **argv = realloc(cp->ei->argv, (cp->ei->argc + 2) * sizeof(char *));
+			if (!argv)
+				continue;
+			cp->ei->argv = argv;
+			argv[cp->ei->argc++] = strdup(value);
+			argv[cp->ei->argc] = NULL;
+			continue;
+		}
 	}
 
 	/* jobs without a timeout get a default of 60 seconds. */
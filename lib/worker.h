@@ -7,6 +7,7 @@
 #include <sys/wait.h>
 #include <sys/time.h>
 #include <sys/resource.h>
+#include <stdint.h>
 #include "libnagios.h"
 
 /**
@@ -22,6 +23,62 @@
 #define ETIME ETIMEDOUT
 #endif
 
+/**
+ * @name Worker protocols
+ * Workers send their results as key/value vectors by default. Workers
+ * that add "protocol=binary" to their registration, and get "OK
+ * protocol=binary" back, send binary frames instead. Jobs are always
+ * sent to workers as key/value vectors.
+ * @{
+ */
+#define WORKER_PROTO_TEXT   0 /**< key/value vectors delimited by MSG_DELIM */
+#define WORKER_PROTO_BINARY 1 /**< length-prefixed binary frames */
+/** @} */
+
+#define WORKER_FRAME_MAGIC  0x4e574246 /**< first four bytes of each frame */
+#define WORKER_FRAME_LOG    1 /**< a nul-terminated log message follows the header */
+#define WORKER_FRAME_RESULT 2 /**< the frame is a struct worker_result_frame */
+#define WORKER_FRAME_MAX    (64 * 1024 * 1024) /**< larger frames are garbage */
+
+/**
+ * Header of a binary frame. Workers always talk to the master over
+ * a local socket, so all numbers are in host byte order.
+ */
+struct worker_frame {
+	uint32_t magic; /**< WORKER_FRAME_MAGIC */
+	uint32_t kind;  /**< WORKER_FRAME_LOG or WORKER_FRAME_RESULT */
+	uint32_t size;  /**< size of the whole frame, header included */
+};
+
+/** Indexes of the strings in a result frame, in the order they're sent */
+enum {
+	WORKER_FRAME_COMMAND,
+	WORKER_FRAME_OUTSTD,
+	WORKER_FRAME_OUTERR,
+	WORKER_FRAME_ERROR_MSG,
+	WORKER_FRAME_NSTR
+};
+
+/**
+ * A job result in binary form. The strings follow the numbers, each
+ * one nul-terminated, so the master can use them where they are.
+ */
+struct worker_result_frame {
+	struct worker_frame frame;
+	int32_t job_id;
+	int32_t type;
+	int32_t timeout;
+	int32_t wait_status;
+	int32_t error_code;  /**< set if the job couldn't run to completion */
+	int32_t exited_ok;
+	int64_t start_sec, start_usec;
+	int64_t stop_sec, stop_usec;
+	int64_t ru_utime_sec, ru_utime_usec;
+	int64_t ru_stime_sec, ru_stime_usec;
+	int64_t ru_minflt, ru_majflt, ru_inblock, ru_oublock;
+	uint32_t len[WORKER_FRAME_NSTR]; /**< string lengths, nul excluded */
+};
+
 typedef struct iobuf {
 	int fd;
 	unsigned int len;
@@ -108,6 +165,34 @@ extern int send_kvvec(int sd, struct kvvec *kvv)
  */
 extern char *worker_ioc2msg(iocache *ioc, unsigned long *size, int flags);
 
+/**
+ * Grab a binary frame from an iocache buffer. The iocache is grown
+ * if the frame won't fit in it.
+ * @param[in] ioc The io cache
+ * @param[out] frame Set to the start of the frame
+ * @param[out] size Set to the size of the frame
+ * @return 1 if a frame was found, 0 if more data is needed and -1
+ * if the data in the iocache isn't a frame
+ */
+extern int worker_ioc2frame(iocache *ioc, char **frame, unsigned long *size);
+
+/**
+ * Decode a binary result frame without copying anything
+ * @param[in] buf The frame, as found by worker_ioc2frame()
+ * @param[in] size Size of the frame
+ * @param[out] res The numbers from the frame
+ * @param[out] str Pointers to the WORKER_FRAME_NSTR strings in 'buf'
+ * @return 0 on success, -1 if the frame is malformed
+ */
+extern int worker_decode_result(char *buf, unsigned long size, struct worker_result_frame *res, char **str);
+
+/**
+ * Set the protocol a worker uses to send results and log messages
+ * to the master. Must be called before enter_worker().
+ * @param[in] proto WORKER_PROTO_TEXT or WORKER_PROTO_BINARY
+ */
+extern void worker_set_protocol(int proto);
+
 /**
  * Parse a worker message to a preallocated key/value vector
  *
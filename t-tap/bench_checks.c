@@ -0,0 +1,167 @@
+/*****************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*
+*****************************************************************************/
+
+/*
+ * Compare the cost of turning plugin output into an object's short
+ * output, long output and perf data: parse_check_output(), which
+ * copies everything on every check, against parse_check_output_slices()
+ * plus update_check_output(), which only copies what changed. Not run
+ * as part of "make test", since the numbers only mean something to a
+ * human. Run "make bench" for that.
+ */
+#define NSCORE 1
+#include "config.h"
+#include "comments.h"
+#include "common.h"
+#include "statusdata.h"
+#include "downtime.h"
+#include "macros.h"
+#include "nagios.h"
+#include "broker.h"
+#include "perfdata.h"
+#include "../lib/lnag-utils.h"
+#include "stub_sehandlers.c"
+#include "stub_comments.c"
+#include "stub_perfdata.c"
+#include "stub_downtime.c"
+#include "stub_notifications.c"
+#include "stub_logging.c"
+#include "stub_broker.c"
+#include "stub_macros.c"
+#include "stub_workers.c"
+#include "stub_events.c"
+#include "stub_statusdata.c"
+#include "stub_flapping.c"
+#include "stub_nebmods.c"
+#include "stub_netutils.c"
+#include "stub_commands.c"
+#include "stub_xodtemplate.c"
+#include "stub_timings.c"
+
+#define ROUNDS 2000
+
+int date_format;
+
+/* count allocations by getting in front of the C library's allocator */
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+static unsigned long allocs;
+
+void *malloc(size_t size) {
+	allocs++;
+	return __libc_malloc(size);
+	}
+void *calloc(size_t nmemb, size_t size) {
+	allocs++;
+	return __libc_calloc(nmemb, size);
+	}
+void *realloc(void *ptr, size_t size) {
+	allocs++;
+	return __libc_realloc(ptr, size);
+	}
+
+static double elapsed(struct timeval *start) {
+	struct timeval stop;
+
+	gettimeofday(&stop, NULL);
+	return (double)(stop.tv_sec - start->tv_sec) + ((double)(stop.tv_usec - start->tv_usec) / 1000000);
+	}
+
+static void report(const char *what, unsigned long n, unsigned long allocations, double secs) {
+	printf("  %-22s %8.1f allocs/check  %10.1f us/check\n",
+	       what, (double)allocations / n, secs * 1000000 / n);
+	}
+
+/* builds plugin output of about 'size' bytes: a status line with perf data,
+ * lines of long output and a few more lines of perf data */
+static char *make_output(size_t size) {
+	char *buf = NULL;
+	size_t len = 0;
+	int line = 0;
+
+	buf = __libc_malloc(size + 128);
+	len = sprintf(buf, "DISK OK - free space: / 3326 MB (56%%); | /=2643MB;5948;5958;0;5968\n");
+	while(len < size * 3 / 4)
+		len += sprintf(buf + len, "%d: /dev/sda%d mounted on /mnt/%d is %d%% full\n", line, line % 8, line, line % 100), line++;
+	len += sprintf(buf + len, "all disks checked | ");
+	while(len < size)
+		len += sprintf(buf + len, "/mnt/%d=%dMB;5948;5958;0;5968\n", line, line), line++;
+
+	return buf;
+	}
+
+static void bench(size_t size) {
+	char *output = make_output(size);
+	size_t len = strlen(output);
+	char *buf = __libc_malloc(len + 1);
+	char *short_output = NULL, *long_output = NULL, *perf_data = NULL;
+	check_output parsed;
+	struct timeval start;
+	unsigned long before;
+	int i;
+
+	printf("%lu byte output, %d checks:\n", (unsigned long)len, ROUNDS);
+
+	/* what the check result handlers used to do on every check */
+	before = allocs;
+	gettimeofday(&start, NULL);
+	for(i = 0; i < ROUNDS; i++) {
+		memcpy(buf, output, len + 1);
+		my_free(short_output);
+		my_free(long_output);
+		my_free(perf_data);
+		parse_check_output(buf, &short_output, &long_output, &perf_data, TRUE, FALSE);
+		}
+	report("copy everything", ROUNDS, allocs - before, elapsed(&start));
+
+	/* the same output over and over */
+	before = allocs;
+	gettimeofday(&start, NULL);
+	for(i = 0; i < ROUNDS; i++) {
+		memcpy(buf, output, len + 1);
+		parse_check_output_slices(buf, &parsed, FALSE);
+		update_check_output(&parsed, &short_output, &long_output, &perf_data);
+		}
+	report("slices, steady output", ROUNDS, allocs - before, elapsed(&start));
+
+	/* perf data that changes every time, the rest doesn't */
+	before = allocs;
+	gettimeofday(&start, NULL);
+	for(i = 0; i < ROUNDS; i++) {
+		memcpy(buf, output, len + 1);
+		buf[len - 2] = '0' + i % 10;
+		parse_check_output_slices(buf, &parsed, FALSE);
+		update_check_output(&parsed, &short_output, &long_output, &perf_data);
+		}
+	report("slices, new perf data", ROUNDS, allocs - before, elapsed(&start));
+
+	my_free(short_output);
+	my_free(long_output);
+	my_free(perf_data);
+	free(buf);
+	free(output);
+	}
+
+int main(int argc, char **argv) {
+
+	bench(4 * 1024);
+	bench(64 * 1024);
+
+	return EXIT_SUCCESS;
+	}
@@ -10,4 +10,6 @@ void check_for_orphaned_services(void) {}
 void check_service_result_freshness(void) {}
 int run_scheduled_host_check(host *hst, int check_options, double latency) { return OK; }
 void check_host_result_freshness(void) {}
+void update_service_freshness_deadline(service *svc) {}
+void update_host_freshness_deadline(host *hst) {}
 void check_for_orphaned_hosts(void) {}
@@ -2,3 +2,5 @@
 int iobroker_get_num_fds(iobroker_set *iobs) { return 1; }
 int iobroker_poll(iobroker_set *iobs, int timeout) { return 0; }
 const char *iobroker_strerror(int error) { return ""; }
+int iobroker_register(iobroker_set *iobs, int sd, void *arg, int (*handler)(int, int, void *)) { return 0; }
+int iobroker_close(iobroker_set *iobs, int sd) { return 0; }
@@ -5,6 +5,7 @@ int init_macros(void) { return OK; }
 int grab_host_macros_r(nagios_macros *mac, host *hst) { return OK; }
 int grab_service_macros_r(nagios_macros *mac, service *svc) { return OK; }
 int process_macros_r(nagios_macros *mac, char *input_buffer, char **output_buffer, int options) { return OK; }
+char *get_processed_macro_r(nagios_macros *mac, char *name, int options, int *free_value) { return NULL; }
 int clear_volatile_macros_r(nagios_macros *mac) { return OK; }
 int clear_host_macros_r(nagios_macros *mac) { return OK; }
 int free_macrox_names(void) { return OK; }
@@ -1,2 +1,4 @@
 int update_host_performance_data(host *hst) {}
+#ifndef TEST_CHECKS_C
 int update_service_performance_data(service *svc) { return OK; }
+#endif
@@ -1,5 +1,7 @@
 /* Stub for common/statusdata.c */
+#ifndef TEST_CHECKS_C
 int update_service_status(service *svc, int aggregated_dump) {}
+#endif
 int update_host_status(host *hst, int aggregated_dump) { return OK; }
 #if !(defined(TEST_CHECKS_C) || defined(TEST_EVENTS_C))
 int update_program_status(int aggregated_dump) {}
@@ -1,4 +1,4 @@
 /* Stub file for routines from macros.c */
-int wproc_run_check(check_result *cr, char *cmd, nagios_macros *mac) { return OK; }
+int wproc_run_check(check_result *cr, char *cmd, char **argv, nagios_macros *mac) { return OK; }
 int wproc_can_spawn(struct load_control *lc) { return 1; }
 void wproc_reap(int jobs, int msecs) {}
@@ -0,0 +1,190 @@
+/*****************************************************************************
+ *
+ * test_check_result_spool.c - Test check result spool watching
+ *
+ * Program: Nagios Core Testing
+ * License: GPL
+ *
+ * Description:
+ *
+ * Tests that check result files and multi-result spools dropped into
+ * check_result_path are picked up through inotify, only once their
+ * ok-to-go files exist, and that each result is processed only once.
+ *
+ * License:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *****************************************************************************/
+
+#include "../include/config.h"
+#include "../include/common.h"
+#include "../include/objects.h"
+#include "../include/comments.h"
+#include "../include/downtime.h"
+#include "../include/statusdata.h"
+#include "../include/macros.h"
+#include "../include/nagios.h"
+#include "../include/sretention.h"
+#include "../include/perfdata.h"
+#include "../include/broker.h"
+#include "../include/nebmods.h"
+#include "../include/nebmodules.h"
+#include "tap.h"
+#include "stub_downtime.c"
+
+static int host_results = 0;
+static int files_processed = 0;
+
+/* Dummy functions */
+void logit(int data_type, int display, const char *fmt, ...) {}
+int my_sendall(int s, char *buf, int *len, int timeout) { return 0; }
+void free_comment_data(void) {}
+int write_to_log(char *buffer, unsigned long data_type, time_t *timestamp) { return 0; }
+int log_debug_info(int level, int verbosity, const char *fmt, ...) {
+	/* logged once every time a result file is read */
+	if(!strncmp(fmt, "Processing check result file", 28))
+		files_processed++;
+	return 0;
+	}
+
+int neb_free_callback_list(void) { return 0; }
+void broker_program_status(int type, int flags, int attr, struct timeval *timestamp) {}
+int neb_deinit_modules(void) { return 0; }
+void broker_program_state(int type, int flags, int attr, struct timeval *timestamp) {}
+void broker_comment_data(int type, int flags, int attr, int comment_type, int entry_type, char *host_name, char *svc_description, time_t entry_time, char *author_name, char *comment_data, int persistent, int source, int expires, time_t expire_time, unsigned long comment_id, struct timeval *timestamp) {}
+int neb_unload_all_modules(int flags, int reason) { return 0; }
+int neb_add_module(char *filename, char *args, int should_be_loaded) { return 0; }
+void broker_system_command(int type, int flags, int attr, struct timeval start_time, struct timeval end_time, double exectime, int timeout, int early_timeout, int retcode, char *cmd, char *output, struct timeval *timestamp) {}
+
+timed_event *schedule_new_event(int event_type, int high_priority, time_t run_time, int recurring, unsigned long event_interval, void *timing_func, int compensate_for_time_change, void *event_data, void *event_args, int event_options) { return NULL; }
+int my_tcp_connect(char *host_name, int port, int *sd, int timeout) { return 0; }
+int my_recvall(int s, char *buf, int *len, int timeout) { return 0; }
+int neb_free_module_list(void) { return 0; }
+int close_command_file(void) { return 0; }
+int close_log_file(void) { return 0; }
+int fix_log_file_owner(uid_t uid, gid_t gid) { return 0; }
+int handle_async_service_check_result(service *temp_service, check_result *queued_check_result) { return 0; }
+int handle_async_host_check_result(host *temp_host, check_result *queued_check_result) {
+	host_results++;
+	return 0;
+	}
+
+#define HOST_RESULT \
+	"### Nagios Host Check Result ###\n" \
+	"host_name=host1\n" \
+	"check_type=1\n" \
+	"return_code=0\n" \
+	"output=PING OK\n" \
+	"\n"
+
+static char *spool_file(const char *name) {
+	static char path[MAX_FILENAME_LENGTH];
+
+	snprintf(path, sizeof(path), "%s/%s", check_result_path, name);
+	return path;
+	}
+
+static void write_spool_file(const char *name, const char *contents, int flags) {
+	int fd;
+
+	if((fd = open(spool_file(name), O_WRONLY | O_CREAT | flags, 0644)) < 0)
+		return;
+	if(write(fd, contents, strlen(contents)) < 0)
+		diag("Failed to write '%s': %s", name, strerror(errno));
+	close(fd);
+	}
+
+static int spool_file_exists(const char *name) {
+	return access(spool_file(name), F_OK) == 0;
+	}
+
+/* lets the spool read whatever the kernel told it */
+static void poll_spool(void) {
+	int i;
+
+	for(i = 0; i < 5; i++)
+		iobroker_poll(nagios_iobs, 20);
+	}
+
+int main(int argc, char **argv) {
+	char dir[] = "/tmp/nagios-spool-XXXXXX";
+	int result;
+
+	plan_tests(15);
+
+	reset_variables();
+
+	config_file = strdup("smallconfig/nagios.cfg");
+	result = read_main_config_file(config_file);
+	ok(result == OK, "Read main configuration file okay - if fails, use nagios -v to check");
+
+	result = read_all_object_data(config_file);
+	ok(result == OK, "Read all object config files");
+
+	result = pre_flight_check();
+	ok(result == OK, "Preflight check okay");
+
+	ok(mkdtemp(dir) != NULL, "Created a check result directory");
+	my_free(check_result_path);
+	check_result_path = strdup(dir);
+	nagios_iobs = iobroker_create();
+
+	skip_start(init_check_result_spool() != OK, 11, "Not watching the check result directory (no inotify?)");
+
+	/* a result file isn't touched before its ok-to-go file exists */
+	write_spool_file("c000001", HOST_RESULT, O_TRUNC);
+	poll_spool();
+	ok(files_processed == 0, "Result file without an ok-to-go file is left alone");
+	ok(spool_file_exists("c000001"), "Result file without an ok-to-go file is still there");
+
+	/* creating and closing the ok-to-go file are separate events */
+	write_spool_file("c000001.ok", "", O_TRUNC);
+	poll_spool();
+	ok(files_processed == 1, "Result file read once after its ok-to-go file was written (read %d times)", files_processed);
+	ok(host_results == 1, "Host check result processed");
+	ok(!spool_file_exists("c000001") && !spool_file_exists("c000001.ok"), "Result file and ok-to-go file deleted");
+
+	/* an ok-to-go file created early only lets the file through once */
+	write_spool_file("c000002.ok", "", O_TRUNC);
+	write_spool_file("c000002", HOST_RESULT, O_TRUNC);
+	poll_spool();
+	ok(files_processed == 2, "Result file with an early ok-to-go file read once (read %d times in all)", files_processed);
+	ok(host_results == 2, "Its host check result processed");
+
+	/* spools are read as they grow, and deleted once they're done */
+	write_spool_file("results.spool", HOST_RESULT HOST_RESULT, O_TRUNC);
+	poll_spool();
+	ok(host_results == 4, "Both results in the spool processed (%d in all)", host_results);
+	write_spool_file("results.spool", HOST_RESULT, O_APPEND);
+	poll_spool();
+	ok(host_results == 5, "Result appended to the spool processed, earlier ones not repeated (%d in all)", host_results);
+	write_spool_file("results.spool.ok", "", O_TRUNC);
+	poll_spool();
+	ok(!spool_file_exists("results.spool") && !spool_file_exists("results.spool.ok"), "Finished spool and its ok-to-go file deleted");
+	ok(host_results == 5, "No results repeated when the spool finished");
+
+	skip_end;
+
+	deinit_check_result_spool();
+	iobroker_destroy(nagios_iobs, IOBROKER_CLOSE_SOCKETS);
+	nagios_iobs = NULL;
+	rmdir(dir);
+
+	cleanup();
+
+	my_free(config_file);
+
+	return exit_status();
+	}
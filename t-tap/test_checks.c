@@ -45,6 +45,7 @@
 #include "stub_netutils.c"
 #include "stub_commands.c"
 #include "stub_xodtemplate.c"
+#include "stub_timings.c"
 
 int date_format;
 
@@ -54,6 +55,22 @@ host *host1 = NULL;
 int found_log_rechecking_host_when_service_wobbles = 0;
 int found_log_run_async_host_check = 0;
 check_result *tmp_check_result;
+int service_check_broker_attr = -1;
+int service_status_updates = 0;
+int service_perfdata_updates = 0;
+
+int broker_service_check(int type, int flags, int attr, service *svc, int check_type, struct timeval start_time, struct timeval end_time, char *cmd, double latency, double exectime, int timeout, int early_timeout, int retcode, char *cmdline, struct timeval *timestamp, check_result *cr) {
+	service_check_broker_attr = attr;
+	return OK;
+	}
+int update_service_status(service *svc, int aggregated_dump) {
+	service_status_updates++;
+	return OK;
+	}
+int update_service_performance_data(service *svc) {
+	service_perfdata_updates++;
+	return OK;
+	}
 
 void setup_check_result(int check_type) {
 	struct timeval start_time, finish_time;
@@ -62,7 +79,7 @@ void setup_check_result(int check_type) {
 	finish_time.tv_sec = 1234567891L;
 	finish_time.tv_usec = 0L;
 
-	tmp_check_result = (check_result *)malloc(sizeof(check_result));
+	tmp_check_result = (check_result *)calloc(1, sizeof(check_result));
 	tmp_check_result->check_type = check_type;
 	tmp_check_result->check_options = 0;
 	tmp_check_result->scheduled_check = TRUE;
@@ -420,6 +437,340 @@ void run_service_check_tests(int check_type, time_t when) {
 
 	}
 
+void run_unchanged_result_tests(time_t when) {
+
+	setup_objects(when);
+	host1->current_state = HOST_UP;
+	svc1->current_state = STATE_OK;
+	svc1->last_hard_state = STATE_OK;
+	svc1->state_type = HARD_STATE;
+	svc1->has_been_checked = TRUE;
+	suppress_unchanged_results = TRUE;
+	service_status_updates = service_perfdata_updates = 0;
+
+	setup_check_result(SERVICE_CHECK_ACTIVE);
+	handle_async_service_check_result(svc1, tmp_check_result);
+	ok(service_check_broker_attr == NEBATTR_NONE && service_status_updates == 1 && service_perfdata_updates == 1, "result with new output is passed on");
+
+	setup_check_result(SERVICE_CHECK_ACTIVE);
+	tmp_check_result->start_time.tv_sec += 300;
+	handle_async_service_check_result(svc1, tmp_check_result);
+	ok(service_check_broker_attr == NEBATTR_CHECK_UNCHANGED, "unchanged result only goes to modules that want it");
+	ok(service_status_updates == 1 && service_perfdata_updates == 1, "unchanged result skips status and perfdata updates");
+	ok(svc1->last_check == 1234567890 + 300, "unchanged result still updates the check time") || diag("last_check=%lu", svc1->last_check);
+
+	setup_check_result(SERVICE_CHECK_ACTIVE);
+	tmp_check_result->return_code = STATE_WARNING;
+	handle_async_service_check_result(svc1, tmp_check_result);
+	ok(service_check_broker_attr == NEBATTR_NONE && service_status_updates == 2, "state change with the same output is passed on");
+
+	suppress_unchanged_results = FALSE;
+	setup_check_result(SERVICE_CHECK_ACTIVE);
+	handle_async_service_check_result(svc1, tmp_check_result);
+	setup_check_result(SERVICE_CHECK_ACTIVE);
+	handle_async_service_check_result(svc1, tmp_check_result);
+	ok(service_check_broker_attr == NEBATTR_NONE && service_status_updates == 4, "nothing is suppressed unless asked to");
+	}
+
+static host *add_reachability_host(int id, const char *name, int state) {
+	host *hst = (host *)calloc(1, sizeof(host));
+
+	hst->id = id;
+	hst->name = strdup(name);
+	hst->current_state = state;
+	hst->check_type = CHECK_TYPE_ACTIVE;
+	hst->next = host_list;
+	host_list = hst;
+	num_objects.hosts++;
+	return hst;
+	}
+
+static void link_reachability_hosts(host *parent, host *child) {
+	hostsmember *temp_hostsmember = NULL;
+
+	temp_hostsmember = (hostsmember *)calloc(1, sizeof(hostsmember));
+	temp_hostsmember->host_ptr = parent;
+	temp_hostsmember->next = child->parent_hosts;
+	child->parent_hosts = temp_hostsmember;
+
+	temp_hostsmember = (hostsmember *)calloc(1, sizeof(hostsmember));
+	temp_hostsmember->host_ptr = child;
+	temp_hostsmember->next = parent->child_hosts;
+	parent->child_hosts = temp_hostsmember;
+	}
+
+void run_reachability_tests(void) {
+	host *router, *backup, *single, *dual;
+
+	router = add_reachability_host(0, "router", HOST_UP);
+	backup = add_reachability_host(1, "backup", HOST_DOWN);
+	single = add_reachability_host(2, "single", HOST_DOWN);
+	dual = add_reachability_host(3, "dual", HOST_DOWN);
+	link_reachability_hosts(router, single);
+	link_reachability_hosts(router, dual);
+	link_reachability_hosts(backup, dual);
+
+	ok(determine_host_reachability(single) == HOST_DOWN, "host with an UP parent is DOWN without a cache");
+	ok(init_host_reachability() == OK, "reachability cache built");
+	ok(determine_host_reachability(single) == HOST_DOWN && determine_host_reachability(dual) == HOST_DOWN, "hosts with an UP parent are DOWN");
+	ok(determine_host_reachability(router) == HOST_UP, "UP host needs no translation");
+
+	router->current_state = HOST_DOWN;
+	update_host_reachability(router);
+	ok(determine_host_reachability(single) == HOST_UNREACHABLE, "host whose only parent went down is UNREACHABLE");
+	ok(determine_host_reachability(dual) == HOST_UNREACHABLE, "host whose parents are all down is UNREACHABLE");
+
+	backup->current_state = HOST_UP;
+	update_host_reachability(backup);
+	ok(determine_host_reachability(single) == HOST_UNREACHABLE, "recovery of another host doesn't make a host reachable");
+	ok(determine_host_reachability(dual) == HOST_DOWN, "host with a recovered second parent is DOWN");
+
+	router->current_state = HOST_UP;
+	update_host_reachability(router);
+	ok(determine_host_reachability(single) == HOST_DOWN, "host whose parent recovered is DOWN again");
+
+	free_host_reachability();
+	}
+
+static service *add_dependency_service(int id, const char *description, int state) {
+	service *svc = (service *)calloc(1, sizeof(service));
+
+	svc->id = id;
+	svc->host_name = strdup("Host1");
+	svc->description = strdup(description);
+	svc->current_state = svc->last_hard_state = state;
+	svc->state_type = HARD_STATE;
+	svc->next = service_list;
+	service_list = svc;
+	num_objects.services++;
+	return svc;
+	}
+
+static servicedependency *add_test_service_dependency(service *dependent, service *master, int inherits_parent) {
+	servicedependency *dep = (servicedependency *)calloc(1, sizeof(servicedependency));
+
+	dep->dependent_service_ptr = dependent;
+	dep->master_service_ptr = master;
+	dep->dependency_type = EXECUTION_DEPENDENCY;
+	dep->inherits_parent = inherits_parent;
+	dep->failure_options = OPT_CRITICAL | OPT_UNKNOWN;
+	prepend_object_to_objectlist(&dependent->exec_deps, dep);
+	return dep;
+	}
+
+void run_dependency_index_tests(void) {
+	service *master1, *master2, *grandmaster, *dependent;
+	int saved_soft_state_dependencies = soft_state_dependencies;
+
+	soft_state_dependencies = FALSE;
+	service_list = NULL;
+	num_objects.services = 0;
+	grandmaster = add_dependency_service(0, "grandmaster", STATE_OK);
+	master1 = add_dependency_service(1, "master1", STATE_OK);
+	master2 = add_dependency_service(2, "master2", STATE_OK);
+	dependent = add_dependency_service(3, "dependent", STATE_OK);
+	add_test_service_dependency(dependent, master1, FALSE);
+	add_test_service_dependency(dependent, master2, TRUE);
+	add_test_service_dependency(master2, grandmaster, FALSE);
+
+	ok(init_dependency_index() == OK, "dependency index built");
+	ok(check_service_dependencies(dependent, EXECUTION_DEPENDENCY) == DEPENDENCIES_OK, "dependencies OK while all masters are OK");
+
+	master1->current_state = master1->last_hard_state = STATE_CRITICAL;
+	update_service_dependency_index(master1);
+	ok(check_service_dependencies(dependent, EXECUTION_DEPENDENCY) == DEPENDENCIES_FAILED, "failing master fails the dependency");
+	ok(check_service_dependencies(dependent, NOTIFICATION_DEPENDENCY) == DEPENDENCIES_OK, "other dependency type isn't affected");
+
+	master1->current_state = master1->last_hard_state = STATE_OK;
+	update_service_dependency_index(master1);
+	ok(check_service_dependencies(dependent, EXECUTION_DEPENDENCY) == DEPENDENCIES_OK, "recovered master no longer fails the dependency");
+
+	master1->current_state = STATE_CRITICAL;
+	master1->state_type = SOFT_STATE;
+	update_service_dependency_index(master1);
+	ok(check_service_dependencies(dependent, EXECUTION_DEPENDENCY) == DEPENDENCIES_OK, "soft problem state doesn't fail the dependency");
+
+	grandmaster->current_state = grandmaster->last_hard_state = STATE_UNKNOWN;
+	update_service_dependency_index(grandmaster);
+	ok(check_service_dependencies(master2, EXECUTION_DEPENDENCY) == DEPENDENCIES_FAILED, "failing grandmaster fails its direct dependent");
+	ok(check_service_dependencies(dependent, EXECUTION_DEPENDENCY) == DEPENDENCIES_FAILED, "inherited dependency fails too");
+
+	free_dependency_index();
+	ok(check_service_dependencies(dependent, EXECUTION_DEPENDENCY) == DEPENDENCIES_FAILED, "same answer without the index");
+
+	soft_state_dependencies = saved_soft_state_dependencies;
+	}
+
+static int coalesced_checks(int check_type) {
+	int i, total = 0;
+
+	for(i = 0; i < CHECK_STATS_BUCKETS; i++)
+		total += check_statistics[check_type].bucket[i];
+	return total;
+	}
+
+void run_coalescing_tests(time_t when) {
+	host *hst;
+
+	setup_objects(when);
+	hst = host1;
+	hst->id = 0;
+	hst->checks_enabled = TRUE;
+	hst->next_check_event = NULL;
+	hst->last_check = 0;
+	num_objects.hosts = 1;
+	program_start = when;
+	init_check_stats();
+
+	schedule_on_demand_host_check(hst, when, CHECK_OPTION_NONE, SERVICE_CHECK, svc1);
+	ok(hst->next_check_event != NULL, "first on-demand request schedules a check");
+	ok(coalesced_checks(COALESCED_HOST_CHECK_STATS) == 0, "first request isn't coalesced");
+
+	schedule_on_demand_host_check(hst, when, CHECK_OPTION_NONE, SERVICE_CHECK, svc2);
+	ok(coalesced_checks(COALESCED_HOST_CHECK_STATS) == 1, "second request joins the queued check");
+
+	free(hst->next_check_event);
+	hst->next_check_event = NULL;
+	hst->is_executing = TRUE;
+	schedule_on_demand_host_check(hst, when, CHECK_OPTION_DEPENDENCY_CHECK, SERVICE_CHECK, svc1);
+	ok(hst->next_check_event == NULL && coalesced_checks(COALESCED_HOST_CHECK_STATS) == 2, "request joins the running check instead of queueing another");
+
+	schedule_on_demand_host_check(hst, when, CHECK_OPTION_FORCE_EXECUTION, SERVICE_CHECK, svc1);
+	ok(hst->next_check_event != NULL && coalesced_checks(COALESCED_HOST_CHECK_STATS) == 2, "forced checks are never coalesced");
+
+	free(hst->next_check_event);
+	hst->next_check_event = NULL;
+	hst->is_executing = FALSE;
+	free_check_waiters();
+	num_objects.hosts = 0;
+	}
+
+void run_freshness_tests(time_t when) {
+	service *fresh, *stale, *unchecked;
+
+	service_list = NULL;
+	num_objects.services = 0;
+	fresh = add_dependency_service(0, "fresh", STATE_OK);
+	stale = add_dependency_service(1, "stale", STATE_OK);
+	unchecked = add_dependency_service(2, "no freshness checks", STATE_OK);
+	fresh->check_freshness = stale->check_freshness = TRUE;
+	fresh->checks_enabled = stale->checks_enabled = unchecked->checks_enabled = TRUE;
+	fresh->has_been_checked = stale->has_been_checked = unchecked->has_been_checked = TRUE;
+	fresh->freshness_threshold = stale->freshness_threshold = unchecked->freshness_threshold = 60;
+	fresh->last_check = when - 10;
+	stale->last_check = unchecked->last_check = when - 120;
+	check_service_freshness = TRUE;
+	event_start = when - 1000;
+
+	check_service_result_freshness();
+	ok(stale->is_being_freshened == TRUE, "stale service is freshened");
+	ok(fresh->is_being_freshened == FALSE, "fresh service is left alone");
+	ok(unchecked->is_being_freshened == FALSE, "service without freshness checks is left alone");
+
+	fresh->last_check = when - 120;
+	update_service_freshness_deadline(fresh);
+	stale->is_being_freshened = FALSE;
+	stale->last_check = when;
+	update_service_freshness_deadline(stale);
+	check_service_result_freshness();
+	ok(fresh->is_being_freshened == TRUE, "re-armed deadline that passed is found");
+	ok(stale->is_being_freshened == FALSE, "new result moves the deadline");
+
+	free_freshness_deadlines();
+	check_service_freshness = FALSE;
+	}
+
+void run_orphan_tests(time_t when) {
+	service *lost, *running, *moved;
+
+	service_list = NULL;
+	num_objects.services = 0;
+	lost = add_dependency_service(0, "lost", STATE_OK);
+	running = add_dependency_service(1, "running", STATE_OK);
+	moved = add_dependency_service(2, "rescheduled", STATE_OK);
+	lost->next_check = moved->next_check = when - 1000;
+	running->next_check = when;
+	lost->is_executing = running->is_executing = moved->is_executing = TRUE;
+	update_service_orphan_deadline(lost);
+	update_service_orphan_deadline(running);
+	update_service_orphan_deadline(moved);
+	moved->next_check = when;
+
+	check_for_orphaned_services();
+	ok(lost->is_executing == FALSE, "check whose results never came back is orphaned");
+	ok(running->is_executing == TRUE, "check still in flight is left alone");
+	ok(moved->is_executing == TRUE, "deadline follows a rescheduled check");
+
+	running->next_check = when - 1000;
+	running->is_executing = FALSE;
+	update_service_orphan_deadline(running);
+	moved->next_check = when - 1000;
+	update_service_orphan_deadline(moved);
+	check_for_orphaned_services();
+	ok(moved->is_executing == FALSE, "re-armed deadline that passed is found");
+
+	free_orphan_deadlines();
+	}
+
+void run_check_output_tests(void) {
+	char *short_output = NULL, *long_output = NULL, *perf_data = NULL;
+	char *old_short, *old_long, *old_perf;
+	check_output parsed;
+	char buf[256];
+
+	strcpy(buf, " OK - fine |a=1;2;3\nline two\nline three|b=2\nc=3\n");
+	parse_check_output(buf, &short_output, &long_output, &perf_data, TRUE, FALSE);
+	ok(strcmp(short_output, "OK - fine") == 0, "short output split off") || diag("short_output=%s", short_output);
+	ok(strcmp(long_output, "line two\\nline three") == 0, "long output escaped") || diag("long_output=%s", long_output);
+	ok(strcmp(perf_data, "a=1;2;3 b=2 c=3") == 0, "perf data joined") || diag("perf_data=%s", perf_data);
+	ok(strcmp(buf, " OK - fine |a=1;2;3") == 0, "first line of input left in place") || diag("buf=%s", buf);
+	my_free(short_output);
+	my_free(long_output);
+	my_free(perf_data);
+
+	strcpy(buf, "|a=1");
+	parse_check_output(buf, &short_output, &long_output, &perf_data, TRUE, FALSE);
+	ok(short_output && !*short_output && long_output == NULL, "empty short output before perf data");
+	ok(perf_data && strcmp(perf_data, "a=1") == 0, "perf data without short output") || diag("perf_data=%s", perf_data);
+	my_free(short_output);
+	my_free(perf_data);
+
+	strcpy(buf, "\nlong only");
+	parse_check_output(buf, &short_output, &long_output, &perf_data, TRUE, FALSE);
+	ok(short_output == NULL && perf_data == NULL, "no short output from empty first line");
+	ok(long_output && strcmp(long_output, "long only") == 0, "long output after empty first line") || diag("long_output=%s", long_output);
+	my_free(long_output);
+
+	strcpy(buf, "OK; fine|a=1\\nline two\\\\ok|b=2");
+	parse_check_output_slices(buf, &parsed, TRUE);
+	ok(parsed.short_output.len == 8 && !strncmp(parsed.short_output.str, "OK; fine", 8), "short output slice") || diag("short_output=%.*s", (int)parsed.short_output.len, parsed.short_output.str);
+	ok(parsed.long_output.len == 11 && !strncmp(parsed.long_output.str, "line two\\ok", 11), "long output slice unescaped");
+	update_check_output(&parsed, &short_output, &long_output, &perf_data);
+	ok(short_output && strcmp(short_output, "OK: fine") == 0, "semicolons replaced in short output") || diag("short_output=%s", short_output);
+	ok(long_output && strcmp(long_output, "line two\\\\ok") == 0, "long output escaped again") || diag("long_output=%s", long_output);
+	ok(perf_data && strcmp(perf_data, "a=1 b=2") == 0, "perf data from both slices") || diag("perf_data=%s", perf_data);
+
+	old_short = short_output;
+	old_long = long_output;
+	old_perf = perf_data;
+	strcpy(buf, "OK; fine|a=1\\nline two\\\\ok|b=2");
+	parse_check_output_slices(buf, &parsed, TRUE);
+	ok(update_check_output(&parsed, &short_output, &long_output, &perf_data) == FALSE, "unchanged output reported as such");
+	ok(short_output == old_short && long_output == old_long && perf_data == old_perf, "unchanged output isn't copied again");
+
+	strcpy(buf, "OK; fine|a=1\\nline two\\\\ok|b=3");
+	parse_check_output_slices(buf, &parsed, TRUE);
+	ok(update_check_output(&parsed, &short_output, &long_output, &perf_data) == TRUE, "changed output reported as such");
+	ok(short_output == old_short && long_output == old_long, "only the changed output is replaced");
+	ok(perf_data && strcmp(perf_data, "a=1 b=3") == 0, "changed perf data updated") || diag("perf_data=%s", perf_data);
+
+	strcpy(buf, "OK");
+	parse_check_output_slices(buf, &parsed, FALSE);
+	update_check_output(&parsed, &short_output, &long_output, &perf_data);
+	ok(strcmp(short_output, "OK") == 0 && long_output == NULL && perf_data == NULL, "output that went away is freed");
+	my_free(short_output);
+	}
+
 int
 main(int argc, char **argv) {
 	time_t now = 0L;
@@ -427,12 +778,19 @@ main(int argc, char **argv) {
 	accept_passive_host_checks = TRUE;
 	accept_passive_service_checks = TRUE;
 
-	plan_tests(92);
+	plan_tests(149);
 
 	time(&now);
 
 	run_service_check_tests(SERVICE_CHECK_ACTIVE, now);
 	run_service_check_tests(SERVICE_CHECK_PASSIVE, now);
+	run_unchanged_result_tests(now);
+	run_check_output_tests();
+	run_reachability_tests();
+	run_dependency_index_tests();
+	run_coalescing_tests(now);
+	run_freshness_tests(now);
+	run_orphan_tests(now);
 
 	return exit_status();
 	}
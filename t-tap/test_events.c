@@ -44,6 +44,7 @@
 #include "stub_perfdata.c"
 #include "stub_nsock.c"
 #include "stub_iobroker.c"
+#include "stub_timings.c"
 
 int perform_scheduled_host_check(host *temp_host, int int1, double double1) {
 	time_t now = 0L;
@@ -242,7 +243,7 @@ main(int argc, char **argv) {
 	read_object_config_data(main_config_file, READ_ALL_OBJECT_DATA);
 	pre_flight_check();
 
-	plan_tests(11);
+	plan_tests(14);
 
 	interval_length = 60;
 
@@ -318,6 +319,30 @@ main(int argc, char **argv) {
 			|| diag("next_check - now: %ld", host1->next_check - now);
 	ok(svc3->next_check == now + 300, "svc3 rescheduled ahead - normal interval");
 
+	/* Checks due in the same second get spread out when smoothing */
+	squeue_destroy(nagios_squeue, 0);
+	init_event_queue();
+	smooth_check_scheduling = 10;
+	svc1->next_check_event = svc2->next_check_event = svc3->next_check_event = NULL;
+	host1->next_check_event = NULL;
+	svc1->current_state = svc2->current_state = svc3->current_state = STATE_OK;
+	svc1->check_interval = svc2->check_interval = svc3->check_interval = 5;
+	svc1->checks_enabled = svc2->checks_enabled = svc3->checks_enabled = TRUE;
+	time(&now);
+	schedule_service_check(svc1, now + 300, CHECK_OPTION_NONE);
+	schedule_service_check(svc2, now + 300, CHECK_OPTION_NONE);
+	schedule_service_check(svc3, now + 300, CHECK_OPTION_NONE);
+	ok(svc1->next_check != svc2->next_check && svc1->next_check != svc3->next_check && svc2->next_check != svc3->next_check,
+			"smoothing puts checks due at the same time in different seconds")
+			|| diag("next_checks - now: %ld %ld %ld", svc1->next_check - now, svc2->next_check - now, svc3->next_check - now);
+	ok(labs(svc1->next_check - (now + 300)) <= 30 && labs(svc2->next_check - (now + 300)) <= 30 && labs(svc3->next_check - (now + 300)) <= 30,
+			"smoothed checks stay within 10%% of their check interval");
+	host1->checks_enabled = TRUE;
+	schedule_host_check(host1, now + 300, CHECK_OPTION_FORCE_EXECUTION);
+	ok(host1->next_check == now + 300, "forced checks are not smoothed")
+			|| diag("next_check - now: %ld", host1->next_check - now);
+	smooth_check_scheduling = 0;
+
 	return exit_status();
 	}
 
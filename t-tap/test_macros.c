@@ -195,6 +195,39 @@ void test_escaping(nagios_macros *mac) {
 			URL_ENCODE_MACRO_CHARS);
 }
 
+void test_command_argv(nagios_macros *mac) {
+	unsigned int ocount[NUM_OBJECT_SKIPLISTS] = { 0 };
+	command *cmd;
+	char *output, **argv;
+
+	ocount[COMMAND_SKIPLIST] = 8;
+	create_object_tables(ocount);
+
+	/* shell syntax gets no template, and is run through the shell */
+	cmd = add_command(strdup("pipe"), strdup("/bin/echo $HOSTNAME$ | cat"));
+	ok(cmd && cmd->argv_template == NULL, "commands with pipes need a shell");
+	cmd = add_command(strdup("unquoted_dollar"), strdup("/bin/echo $$HOME"));
+	ok(cmd && cmd->argv_template == NULL, "unquoted $$ needs a shell");
+
+	cmd = add_command(strdup("quoted"), strdup("/bin/echo -n \"x $HOSTNAME$\" 'y$$'"));
+	ok(cmd && cmd->argv_template != NULL, "quoted macros get a template");
+	process_command_macros_r(mac, cmd, &output, &argv, 0);
+	ok(!strcmp(output, "/bin/echo -n \"x name'&%\" 'y$'"), "command line is still expanded");
+	ok(argv && !strcmp(argv[0], "/bin/echo") && !strcmp(argv[1], "-n") &&
+	   !strcmp(argv[2], "x name'&%") && !strcmp(argv[3], "y$") && !argv[4],
+	   "double-quoted macro values are kept in one word");
+	my_free(output);
+	my_free(argv);
+
+	/* a quote in an unquoted macro value would change the parsing */
+	cmd = add_command(strdup("unquoted"), strdup("/bin/echo $HOSTNAME$"));
+	process_command_macros_r(mac, cmd, &output, &argv, 0);
+	ok(argv == NULL && !strcmp(output, "/bin/echo name'&%"),
+	   "macro values with shell syntax fall back to the command line");
+	my_free(output);
+	my_free(argv);
+}
+
 /*****************************************************************************/
 /*                             Main function                                 */
 /*****************************************************************************/
@@ -202,7 +235,7 @@ void test_escaping(nagios_macros *mac) {
 int main(void) {
 	nagios_macros *mac;
 
-	plan_tests(9);
+	plan_tests(15);
 
 	reset_variables();
 	init_environment();
@@ -211,6 +244,7 @@ int main(void) {
 	mac = setup_macro_object();
 
 	test_escaping(mac);
+	test_command_argv(mac);
 
 	cleanup();
 	free(mac);
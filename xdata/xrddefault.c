@@ -33,6 +33,11 @@
 #include "../include/comments.h"
 #include "../include/downtime.h"
 #include "xrddefault.h"
+#include <pthread.h>
+#include <signal.h>
+
+static int xrddefault_save_binary_state_information(void);
+static int xrddefault_read_binary_state_information(int *);
 
 
 /******************************************************************/
@@ -78,6 +83,62 @@ int xrddefault_cleanup_retention_data(void) {
 /**************** DEFAULT STATE OUTPUT FUNCTION *******************/
 /******************************************************************/
 
+/* opens a safe temp file for the retention data */
+static FILE *xrddefault_open_temp_file(char **tmp_file, int *fd) {
+	FILE *fp;
+
+	asprintf(tmp_file, "%sXXXXXX", temp_file);
+	if(*tmp_file == NULL)
+		return NULL;
+	if((*fd = mkstemp(*tmp_file)) == -1)
+		return NULL;
+
+	log_debug_info(DEBUGL_RETENTIONDATA, 2, "Writing retention data to temp file '%s'\n", *tmp_file);
+
+	fp = (FILE *)fdopen(*fd, "w");
+	if(fp == NULL) {
+
+		close(*fd);
+		unlink(*tmp_file);
+
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Could not open temp state retention file '%s' for writing!\n", *tmp_file);
+		}
+
+	return fp;
+	}
+
+
+/* closes the temp file and moves it over the retention file */
+static int xrddefault_commit_temp_file(FILE *fp, int fd, char *tmp_file, int result) {
+
+	fflush(fp);
+	fsync(fd);
+	if(fclose(fp) != 0)
+		result = ERROR;
+
+	/* save/close was successful */
+	if(result == OK) {
+
+		/* move the temp file to the retention file (overwrite the old retention file) */
+		if(my_rename(tmp_file, retention_file)) {
+			unlink(tmp_file);
+			logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Unable to update retention file '%s': %s", retention_file, strerror(errno));
+			result = ERROR;
+			}
+		}
+
+	/* a problem occurred saving the file */
+	else {
+
+		/* remove temp file and log an error */
+		unlink(tmp_file);
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Unable to save retention file: %s", strerror(errno));
+		}
+
+	return result;
+	}
+
+
 int xrddefault_save_state_information(void) {
 	char *tmp_file = NULL;
 	customvariablesmember *temp_customvariablesmember = NULL;
@@ -108,25 +169,12 @@ int xrddefault_save_state_information(void) {
 		return ERROR;
 		}
 
-	/* open a safe temp file for output */
-	asprintf(&tmp_file, "%sXXXXXX", temp_file);
-	if(tmp_file == NULL)
-		return ERROR;
-	if((fd = mkstemp(tmp_file)) == -1)
-		return ERROR;
-
-	log_debug_info(DEBUGL_RETENTIONDATA, 2, "Writing retention data to temp file '%s'\n", tmp_file);
-
-	fp = (FILE *)fdopen(fd, "w");
-	if(fp == NULL) {
-
-		close(fd);
-		unlink(tmp_file);
-
-		logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Could not open temp state retention file '%s' for writing!\n", tmp_file);
+	if(retention_file_format == RETENTION_FORMAT_BINARY)
+		return xrddefault_save_binary_state_information();
 
+	/* open a safe temp file for output */
+	if((fp = xrddefault_open_temp_file(&tmp_file, &fd)) == NULL) {
 		my_free(tmp_file);
-
 		return ERROR;
 		}
 
@@ -398,40 +446,206 @@ int xrddefault_save_state_information(void) {
 		fprintf(fp, "}\n");
 		}
 
-	fflush(fp);
-	fsync(fd);
-	result = fclose(fp);
+	result = xrddefault_commit_temp_file(fp, fd, tmp_file, OK);
 
-	/* save/close was successful */
-	if(result == 0) {
+	/* free memory */
+	my_free(tmp_file);
 
-		result = OK;
+	return result;
+	}
+
+
+
+
+/******************************************************************/
+/************* HELPERS SHARED BY TEXT AND BINARY INPUT ************/
+/******************************************************************/
+
+/* finishes up a host once all its retained variables are set */
+static void xrddefault_finish_host(host *temp_host, int was_flapping) {
+	customvariablesmember *temp_customvariablesmember = NULL;
+	int allow_flapstart_notification = TRUE;
+
+	/* adjust modified attributes if necessary */
+	if(temp_host->retain_nonstatus_information == FALSE)
+		temp_host->modified_attributes = MODATTR_NONE;
+
+	/* adjust modified attributes if no custom variables have been changed */
+	if(temp_host->modified_attributes & MODATTR_CUSTOM_VARIABLE) {
+		for(temp_customvariablesmember = temp_host->custom_variables; temp_customvariablesmember != NULL; temp_customvariablesmember = temp_customvariablesmember->next) {
+			if(temp_customvariablesmember->has_been_modified == TRUE)
+				break;
 
-		/* move the temp file to the retention file (overwrite the old retention file) */
-		if(my_rename(tmp_file, retention_file)) {
-			unlink(tmp_file);
-			logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Unable to update retention file '%s': %s", retention_file, strerror(errno));
-			result = ERROR;
 			}
+		if(temp_customvariablesmember == NULL)
+			temp_host->modified_attributes -= MODATTR_CUSTOM_VARIABLE;
 		}
 
-	/* a problem occurred saving the file */
+	/* calculate next possible notification time */
+	if(temp_host->current_state != HOST_UP && temp_host->last_notification != (time_t)0)
+		temp_host->next_notification = get_next_host_notification_time(temp_host, temp_host->last_notification);
+
+	/* ADDED 01/23/2009 adjust current check attempts if host in hard problem state (max attempts may have changed in config since restart) */
+	if(temp_host->current_state != HOST_UP && temp_host->state_type == HARD_STATE)
+		temp_host->current_attempt = temp_host->max_attempts;
+
+
+	/* ADDED 02/20/08 assume same flapping state if large install tweaks enabled */
+	if(use_large_installation_tweaks == TRUE) {
+		temp_host->is_flapping = was_flapping;
+		}
+	/* else use normal startup flap detection logic */
 	else {
+		/* host was flapping before program started */
+		/* 11/10/07 don't allow flapping notifications to go out */
+		if(was_flapping == TRUE)
+			allow_flapstart_notification = FALSE;
+		else
+			/* flapstart notifications are okay */
+			allow_flapstart_notification = TRUE;
 
-		result = ERROR;
+		/* check for flapping */
+		check_for_host_flapping(temp_host, FALSE, FALSE, allow_flapstart_notification);
 
-		/* remove temp file and log an error */
-		unlink(tmp_file);
-		logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Unable to save retention file: %s", strerror(errno));
+		/* host was flapping before and isn't now, so clear recovery check variable if host isn't flapping now */
+		if(was_flapping == TRUE && temp_host->is_flapping == FALSE)
+			temp_host->check_flapping_recovery_notification = FALSE;
 		}
 
-	/* free memory */
-	my_free(tmp_file);
+	/* handle new vars added in 2.x */
+	if(temp_host->last_hard_state_change == (time_t)0)
+		temp_host->last_hard_state_change = temp_host->last_state_change;
 
-	return result;
+	/* update host status */
+	update_host_status(temp_host, FALSE);
+	}
+
+
+/* finishes up a service once all its retained variables are set */
+static void xrddefault_finish_service(service *temp_service, int was_flapping) {
+	customvariablesmember *temp_customvariablesmember = NULL;
+	int allow_flapstart_notification = TRUE;
+
+	/* adjust modified attributes if necessary */
+	if(temp_service->retain_nonstatus_information == FALSE)
+		temp_service->modified_attributes = MODATTR_NONE;
+
+	/* adjust modified attributes if no custom variables have been changed */
+	if(temp_service->modified_attributes & MODATTR_CUSTOM_VARIABLE) {
+		for(temp_customvariablesmember = temp_service->custom_variables; temp_customvariablesmember != NULL; temp_customvariablesmember = temp_customvariablesmember->next) {
+			if(temp_customvariablesmember->has_been_modified == TRUE)
+				break;
+
+			}
+		if(temp_customvariablesmember == NULL)
+			temp_service->modified_attributes -= MODATTR_CUSTOM_VARIABLE;
+		}
+
+	/* calculate next possible notification time */
+	if(temp_service->current_state != STATE_OK && temp_service->last_notification != (time_t)0)
+		temp_service->next_notification = get_next_service_notification_time(temp_service, temp_service->last_notification);
+
+	/* fix old vars */
+	if(temp_service->has_been_checked == FALSE && temp_service->state_type == SOFT_STATE)
+		temp_service->state_type = HARD_STATE;
+
+	/* ADDED 01/23/2009 adjust current check attempt if service is in hard problem state (max attempts may have changed in config since restart) */
+	if(temp_service->current_state != STATE_OK && temp_service->state_type == HARD_STATE)
+		temp_service->current_attempt = temp_service->max_attempts;
+
+
+	/* ADDED 02/20/08 assume same flapping state if large install tweaks enabled */
+	if(use_large_installation_tweaks == TRUE) {
+		temp_service->is_flapping = was_flapping;
+		}
+	/* else use normal startup flap detection logic */
+	else {
+		/* service was flapping before program started */
+		/* 11/10/07 don't allow flapping notifications to go out */
+		if(was_flapping == TRUE)
+			allow_flapstart_notification = FALSE;
+		else
+			/* flapstart notifications are okay */
+			allow_flapstart_notification = TRUE;
+
+		/* check for flapping */
+		check_for_service_flapping(temp_service, FALSE, allow_flapstart_notification);
+
+		/* service was flapping before and isn't now, so clear recovery check variable if service isn't flapping now */
+		if(was_flapping == TRUE && temp_service->is_flapping == FALSE)
+			temp_service->check_flapping_recovery_notification = FALSE;
+		}
+
+	/* handle new vars added in 2.x */
+	if(temp_service->last_hard_state_change == (time_t)0)
+		temp_service->last_hard_state_change = temp_service->last_state_change;
+
+	/* update service status */
+	update_service_status(temp_service, FALSE);
 	}
 
 
+/* finishes up a contact once all its retained variables are set */
+static void xrddefault_finish_contact(contact *temp_contact) {
+	customvariablesmember *temp_customvariablesmember = NULL;
+
+	/* adjust modified attributes if necessary */
+	if(temp_contact->retain_nonstatus_information == FALSE)
+		temp_contact->modified_attributes = MODATTR_NONE;
+
+	/* adjust modified attributes if no custom variables have been changed */
+	if(temp_contact->modified_attributes & MODATTR_CUSTOM_VARIABLE) {
+		for(temp_customvariablesmember = temp_contact->custom_variables; temp_customvariablesmember != NULL; temp_customvariablesmember = temp_customvariablesmember->next) {
+			if(temp_customvariablesmember->has_been_modified == TRUE)
+				break;
+
+			}
+		if(temp_customvariablesmember == NULL)
+			temp_contact->modified_attributes -= MODATTR_CUSTOM_VARIABLE;
+		}
+
+	/* update contact status */
+	update_contact_status(temp_contact, FALSE);
+	}
+
+
+/* adds a retained comment, and deletes it again if it shouldn't have survived the restart */
+static void xrddefault_add_comment(int type, int entry_type, char *host_name, char *service_description, time_t entry_time, char *author, char *comment_data, unsigned long comment_id, int persistent, int expires, time_t expire_time, int source) {
+	host *temp_host = NULL;
+	service *temp_service = NULL;
+	int remove_comment = FALSE;
+	int ack = FALSE;
+
+	/* add the comment */
+	add_comment(type, entry_type, host_name, service_description, entry_time, author, comment_data, comment_id, persistent, expires, expire_time, source);
+
+	/* delete the comment if necessary */
+	/* it seems a bit backwards to add and then immediately delete the comment, but its necessary to track comment deletions in the event broker */
+	remove_comment = FALSE;
+	/* host no longer exists */
+	if((temp_host = find_host(host_name)) == NULL)
+		remove_comment = TRUE;
+	/* service no longer exists */
+	else if(type == SERVICE_COMMENT && (temp_service = find_service(host_name, service_description)) == NULL)
+		remove_comment = TRUE;
+	/* acknowledgement comments get deleted if they're not persistent and the original problem is no longer acknowledged */
+	else if(entry_type == ACKNOWLEDGEMENT_COMMENT) {
+		ack = FALSE;
+		if(type == HOST_COMMENT)
+			ack = temp_host->problem_has_been_acknowledged;
+		else
+			ack = temp_service->problem_has_been_acknowledged;
+		if(ack == FALSE && persistent == FALSE)
+			remove_comment = TRUE;
+		}
+	/* non-persistent comments don't last past restarts UNLESS they're acks (see above) */
+	else if(persistent == FALSE && (sigrestart == FALSE || entry_type == DOWNTIME_COMMENT))
+		remove_comment = TRUE;
+
+	if(remove_comment == TRUE)
+		delete_comment(type, comment_id);
+	}
+
 
 
 /******************************************************************/
@@ -485,15 +699,14 @@ int xrddefault_read_state_information(void) {
 	unsigned long contact_service_attribute_mask = 0L;
 	unsigned long process_host_attribute_mask = 0L;
 	unsigned long process_service_attribute_mask = 0L;
-	int remove_comment = FALSE;
-	int ack = FALSE;
 	int was_flapping = FALSE;
-	int allow_flapstart_notification = TRUE;
 	struct timeval tv[2];
 	double runtime[2];
 	int found_directive = FALSE;
 	int is_in_effect = FALSE;
 	int start_notification_sent = FALSE;
+	int is_binary = FALSE;
+	int result = OK;
 
 
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "xrddefault_read_state_information() start\n");
@@ -506,6 +719,11 @@ int xrddefault_read_state_information(void) {
 		return ERROR;
 		}
 
+	/* binary retention files are read by a reader of their own */
+	result = xrddefault_read_binary_state_information(&is_binary);
+	if(is_binary == TRUE)
+		return result;
+
 	if(test_scheduling == TRUE)
 		gettimeofday(&tv[0], NULL);
 
@@ -581,65 +799,11 @@ int xrddefault_read_state_information(void) {
 
 				case XRDDEFAULT_HOSTSTATUS_DATA:
 
-					if(temp_host != NULL) {
-
-						/* adjust modified attributes if necessary */
-						if(temp_host->retain_nonstatus_information == FALSE)
-							temp_host->modified_attributes = MODATTR_NONE;
-
-						/* adjust modified attributes if no custom variables have been changed */
-						if(temp_host->modified_attributes & MODATTR_CUSTOM_VARIABLE) {
-							for(temp_customvariablesmember = temp_host->custom_variables; temp_customvariablesmember != NULL; temp_customvariablesmember = temp_customvariablesmember->next) {
-								if(temp_customvariablesmember->has_been_modified == TRUE)
-									break;
-
-								}
-							if(temp_customvariablesmember == NULL)
-								temp_host->modified_attributes -= MODATTR_CUSTOM_VARIABLE;
-							}
-
-						/* calculate next possible notification time */
-						if(temp_host->current_state != HOST_UP && temp_host->last_notification != (time_t)0)
-							temp_host->next_notification = get_next_host_notification_time(temp_host, temp_host->last_notification);
-
-						/* ADDED 01/23/2009 adjust current check attempts if host in hard problem state (max attempts may have changed in config since restart) */
-						if(temp_host->current_state != HOST_UP && temp_host->state_type == HARD_STATE)
-							temp_host->current_attempt = temp_host->max_attempts;
-
-
-						/* ADDED 02/20/08 assume same flapping state if large install tweaks enabled */
-						if(use_large_installation_tweaks == TRUE) {
-							temp_host->is_flapping = was_flapping;
-							}
-						/* else use normal startup flap detection logic */
-						else {
-							/* host was flapping before program started */
-							/* 11/10/07 don't allow flapping notifications to go out */
-							if(was_flapping == TRUE)
-								allow_flapstart_notification = FALSE;
-							else
-								/* flapstart notifications are okay */
-								allow_flapstart_notification = TRUE;
-
-							/* check for flapping */
-							check_for_host_flapping(temp_host, FALSE, FALSE, allow_flapstart_notification);
-
-							/* host was flapping before and isn't now, so clear recovery check variable if host isn't flapping now */
-							if(was_flapping == TRUE && temp_host->is_flapping == FALSE)
-								temp_host->check_flapping_recovery_notification = FALSE;
-							}
-
-						/* handle new vars added in 2.x */
-						if(temp_host->last_hard_state_change == (time_t)0)
-							temp_host->last_hard_state_change = temp_host->last_state_change;
-
-						/* update host status */
-						update_host_status(temp_host, FALSE);
-						}
+					if(temp_host != NULL)
+						xrddefault_finish_host(temp_host, was_flapping);
 
 					/* reset vars */
 					was_flapping = FALSE;
-					allow_flapstart_notification = TRUE;
 
 					my_free(host_name);
 					host_name = NULL;
@@ -648,69 +812,11 @@ int xrddefault_read_state_information(void) {
 
 				case XRDDEFAULT_SERVICESTATUS_DATA:
 
-					if(temp_service != NULL) {
-
-						/* adjust modified attributes if necessary */
-						if(temp_service->retain_nonstatus_information == FALSE)
-							temp_service->modified_attributes = MODATTR_NONE;
-
-						/* adjust modified attributes if no custom variables have been changed */
-						if(temp_service->modified_attributes & MODATTR_CUSTOM_VARIABLE) {
-							for(temp_customvariablesmember = temp_service->custom_variables; temp_customvariablesmember != NULL; temp_customvariablesmember = temp_customvariablesmember->next) {
-								if(temp_customvariablesmember->has_been_modified == TRUE)
-									break;
-
-								}
-							if(temp_customvariablesmember == NULL)
-								temp_service->modified_attributes -= MODATTR_CUSTOM_VARIABLE;
-							}
-
-						/* calculate next possible notification time */
-						if(temp_service->current_state != STATE_OK && temp_service->last_notification != (time_t)0)
-							temp_service->next_notification = get_next_service_notification_time(temp_service, temp_service->last_notification);
-
-						/* fix old vars */
-						if(temp_service->has_been_checked == FALSE && temp_service->state_type == SOFT_STATE)
-							temp_service->state_type = HARD_STATE;
-
-						/* ADDED 01/23/2009 adjust current check attempt if service is in hard problem state (max attempts may have changed in config since restart) */
-						if(temp_service->current_state != STATE_OK && temp_service->state_type == HARD_STATE)
-							temp_service->current_attempt = temp_service->max_attempts;
-
-
-						/* ADDED 02/20/08 assume same flapping state if large install tweaks enabled */
-						if(use_large_installation_tweaks == TRUE) {
-							temp_service->is_flapping = was_flapping;
-							}
-						/* else use normal startup flap detection logic */
-						else {
-							/* service was flapping before program started */
-							/* 11/10/07 don't allow flapping notifications to go out */
-							if(was_flapping == TRUE)
-								allow_flapstart_notification = FALSE;
-							else
-								/* flapstart notifications are okay */
-								allow_flapstart_notification = TRUE;
-
-							/* check for flapping */
-							check_for_service_flapping(temp_service, FALSE, allow_flapstart_notification);
-
-							/* service was flapping before and isn't now, so clear recovery check variable if service isn't flapping now */
-							if(was_flapping == TRUE && temp_service->is_flapping == FALSE)
-								temp_service->check_flapping_recovery_notification = FALSE;
-							}
-
-						/* handle new vars added in 2.x */
-						if(temp_service->last_hard_state_change == (time_t)0)
-							temp_service->last_hard_state_change = temp_service->last_state_change;
-
-						/* update service status */
-						update_service_status(temp_service, FALSE);
-						}
+					if(temp_service != NULL)
+						xrddefault_finish_service(temp_service, was_flapping);
 
 					/* reset vars */
 					was_flapping = FALSE;
-					allow_flapstart_notification = TRUE;
 
 					my_free(host_name);
 					my_free(service_description);
@@ -719,26 +825,8 @@ int xrddefault_read_state_information(void) {
 
 				case XRDDEFAULT_CONTACTSTATUS_DATA:
 
-					if(temp_contact != NULL) {
-
-						/* adjust modified attributes if necessary */
-						if(temp_contact->retain_nonstatus_information == FALSE)
-							temp_contact->modified_attributes = MODATTR_NONE;
-
-						/* adjust modified attributes if no custom variables have been changed */
-						if(temp_contact->modified_attributes & MODATTR_CUSTOM_VARIABLE) {
-							for(temp_customvariablesmember = temp_contact->custom_variables; temp_customvariablesmember != NULL; temp_customvariablesmember = temp_customvariablesmember->next) {
-								if(temp_customvariablesmember->has_been_modified == TRUE)
-									break;
-
-								}
-							if(temp_customvariablesmember == NULL)
-								temp_contact->modified_attributes -= MODATTR_CUSTOM_VARIABLE;
-							}
-
-						/* update contact status */
-						update_contact_status(temp_contact, FALSE);
-						}
+					if(temp_contact != NULL)
+						xrddefault_finish_contact(temp_contact);
 
 					my_free(contact_name);
 					temp_contact = NULL;
@@ -748,33 +836,7 @@ int xrddefault_read_state_information(void) {
 				case XRDDEFAULT_SERVICECOMMENT_DATA:
 
 					/* add the comment */
-					add_comment((data_type == XRDDEFAULT_HOSTCOMMENT_DATA) ? HOST_COMMENT : SERVICE_COMMENT, entry_type, host_name, service_description, entry_time, author, comment_data, comment_id, persistent, expires, expire_time, source);
-
-					/* delete the comment if necessary */
-					/* it seems a bit backwards to add and then immediately delete the comment, but its necessary to track comment deletions in the event broker */
-					remove_comment = FALSE;
-					/* host no longer exists */
-					if((temp_host = find_host(host_name)) == NULL)
-						remove_comment = TRUE;
-					/* service no longer exists */
-					else if(data_type == XRDDEFAULT_SERVICECOMMENT_DATA && (temp_service = find_service(host_name, service_description)) == NULL)
-						remove_comment = TRUE;
-					/* acknowledgement comments get deleted if they're not persistent and the original problem is no longer acknowledged */
-					else if(entry_type == ACKNOWLEDGEMENT_COMMENT) {
-						ack = FALSE;
-						if(data_type == XRDDEFAULT_HOSTCOMMENT_DATA)
-							ack = temp_host->problem_has_been_acknowledged;
-						else
-							ack = temp_service->problem_has_been_acknowledged;
-						if(ack == FALSE && persistent == FALSE)
-							remove_comment = TRUE;
-						}
-					/* non-persistent comments don't last past restarts UNLESS they're acks (see above) */
-					else if(persistent == FALSE && (sigrestart == FALSE || entry_type == DOWNTIME_COMMENT))
-						remove_comment = TRUE;
-
-					if(remove_comment == TRUE)
-						delete_comment((data_type == XRDDEFAULT_HOSTCOMMENT_DATA) ? HOST_COMMENT : SERVICE_COMMENT, comment_id);
+					xrddefault_add_comment((data_type == XRDDEFAULT_HOSTCOMMENT_DATA) ? HOST_COMMENT : SERVICE_COMMENT, entry_type, host_name, service_description, entry_time, author, comment_data, comment_id, persistent, expires, expire_time, source);
 
 					/* free temp memory */
 					my_free(host_name);
@@ -1710,3 +1772,1617 @@ int xrddefault_read_state_information(void) {
 
 	return OK;
 	}
+
+
+
+
+/******************************************************************/
+/******************* BINARY RETENTION FORMAT **********************/
+/******************************************************************/
+
+#define XRD_PAD(len) (((len) + 7) & ~(size_t)7)
+
+/* records per chunk handed to a decoding thread */
+#define XRD_CHUNK_RECORDS 1024
+
+/* the record being built by the binary writer */
+struct xrd_buf {
+	char *buf;
+	size_t len;
+	size_t size;
+	int error;
+	};
+
+/* a decoded field, pointing into the mapped file */
+struct xrd_value {
+	unsigned int key;
+	int64_t i;
+	double d;
+	const char *s;      /* strings, and custom variable names */
+	const char *s2;     /* custom variable values */
+	const char *hist;
+	unsigned int count; /* state history entries */
+	int modified;       /* custom variable has been modified */
+	int ok;             /* command or timeperiod still exists */
+	customvariablesmember *cvar;
+	};
+
+/* a decoded record */
+struct xrd_entry {
+	const struct xrd_record *rec;
+	void *object;       /* host, service or contact, NULL if it's gone */
+	struct xrd_value *values;
+	unsigned int num_values;
+	int error;
+	};
+
+static struct {
+	struct xrd_entry *entries;
+	unsigned int num_entries;
+	unsigned int next_chunk;
+	} xrd_load;
+
+
+/* makes room for len more bytes in the record being built */
+static char *xrd_reserve(struct xrd_buf *b, size_t len) {
+	char *buf;
+	size_t size;
+
+	if(b->len + len > b->size) {
+		for(size = b->size ? b->size : 4096; size < b->len + len; size *= 2);
+		if((buf = realloc(b->buf, size)) == NULL) {
+			b->error = TRUE;
+			return NULL;
+			}
+		b->buf = buf;
+		b->size = size;
+		}
+
+	buf = b->buf + b->len;
+	memset(buf, 0, len);
+	b->len += len;
+
+	return buf;
+	}
+
+
+static void xrd_begin(struct xrd_buf *b, int type, unsigned int id) {
+	struct xrd_record *rec;
+
+	b->len = 0;
+	if((rec = (struct xrd_record *)xrd_reserve(b, sizeof(*rec))) == NULL)
+		return;
+	rec->type = type;
+	rec->id = id;
+	}
+
+
+/* adds a field to the record being built, returning where its value goes */
+static char *xrd_field(struct xrd_buf *b, int key, int kind, size_t len) {
+	struct xrd_field *field;
+	char *p;
+
+	if((p = xrd_reserve(b, sizeof(*field) + XRD_PAD(len))) == NULL)
+		return NULL;
+	field = (struct xrd_field *)p;
+	field->key = key;
+	field->kind = kind;
+	field->len = len;
+	((struct xrd_record *)b->buf)->fields++;
+
+	return p + sizeof(*field);
+	}
+
+
+static void xrd_put(struct xrd_buf *b, int key, int kind, const void *val, size_t len) {
+	char *p;
+
+	if((p = xrd_field(b, key, kind, len)) != NULL)
+		memcpy(p, val, len);
+	}
+
+
+static void xrd_int(struct xrd_buf *b, int key, long long val) {
+	int64_t i = val;
+	xrd_put(b, key, XRD_INT, &i, sizeof(i));
+	}
+
+
+static void xrd_dbl(struct xrd_buf *b, int key, double val) {
+	xrd_put(b, key, XRD_DBL, &val, sizeof(val));
+	}
+
+
+static void xrd_str(struct xrd_buf *b, int key, const char *val) {
+	if(val == NULL)
+		val = "";
+	xrd_put(b, key, XRD_STR, val, strlen(val) + 1);
+	}
+
+
+/* state history is stored oldest first, like in the text format */
+static void xrd_hist(struct xrd_buf *b, int *state_history, int index) {
+	int32_t hist[MAX_STATE_HISTORY_ENTRIES];
+	int x;
+
+	for(x = 0; x < MAX_STATE_HISTORY_ENTRIES; x++)
+		hist[x] = state_history[(x + index) % MAX_STATE_HISTORY_ENTRIES];
+	xrd_put(b, XRD_STATE_HISTORY, XRD_HIST, hist, sizeof(hist));
+	}
+
+
+static void xrd_cvars(struct xrd_buf *b, customvariablesmember *cvars) {
+	customvariablesmember *temp_customvariablesmember;
+	const char *value;
+	size_t name_len, value_len;
+	int32_t modified;
+	char *p;
+
+	for(temp_customvariablesmember = cvars; temp_customvariablesmember != NULL; temp_customvariablesmember = temp_customvariablesmember->next) {
+		if(temp_customvariablesmember->variable_name == NULL)
+			continue;
+		value = (temp_customvariablesmember->variable_value == NULL) ? "" : temp_customvariablesmember->variable_value;
+		name_len = strlen(temp_customvariablesmember->variable_name) + 1;
+		value_len = strlen(value) + 1;
+		if((p = xrd_field(b, XRD_CUSTOM_VARIABLE, XRD_CVAR, sizeof(modified) + name_len + value_len)) == NULL)
+			return;
+		modified = temp_customvariablesmember->has_been_modified;
+		memcpy(p, &modified, sizeof(modified));
+		memcpy(p + sizeof(modified), temp_customvariablesmember->variable_name, name_len);
+		memcpy(p + sizeof(modified) + name_len, value, value_len);
+		}
+	}
+
+
+/* writes out the finished record */
+static int xrd_end(struct xrd_buf *b, FILE *fp, struct xrd_binary_header *hdr) {
+
+	if(b->error == TRUE)
+		return ERROR;
+
+	((struct xrd_record *)b->buf)->size = b->len;
+	hdr->num_records++;
+	hdr->records_size += b->len;
+
+	return (fwrite(b->buf, b->len, 1, fp) == 1) ? OK : ERROR;
+	}
+
+
+static int xrddefault_save_binary_state_information(void) {
+	struct xrd_binary_header hdr;
+	struct xrd_buf b = { NULL, 0, 0, FALSE };
+	char *tmp_file = NULL;
+	FILE *fp = NULL;
+	host *temp_host = NULL;
+	service *temp_service = NULL;
+	contact *temp_contact = NULL;
+	nagios_comment *temp_comment = NULL;
+	scheduled_downtime *temp_downtime = NULL;
+	int result = OK;
+	int fd = 0;
+
+	if((fp = xrddefault_open_temp_file(&tmp_file, &fd)) == NULL) {
+		my_free(tmp_file);
+		return ERROR;
+		}
+
+	/* the header is written again once we know how much follows it */
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = XRD_BINARY_MAGIC;
+	hdr.version = XRD_BINARY_VERSION;
+	hdr.header_size = sizeof(hdr);
+	hdr.created = (int64_t)time(NULL);
+	if(fwrite(&hdr, sizeof(hdr), 1, fp) != 1)
+		result = ERROR;
+
+	/* file info */
+	xrd_begin(&b, XRDDEFAULT_INFO_DATA, 0);
+	xrd_str(&b, XRD_VERSION, PROGRAM_VERSION);
+	xrd_int(&b, XRD_LAST_UPDATE_CHECK, last_update_check);
+	xrd_int(&b, XRD_UPDATE_AVAILABLE, update_available);
+	xrd_int(&b, XRD_UPDATE_UID, update_uid);
+	xrd_str(&b, XRD_LAST_VERSION, last_program_version);
+	xrd_str(&b, XRD_NEW_VERSION, new_program_version);
+	if(result == OK)
+		result = xrd_end(&b, fp, &hdr);
+
+	/* program state information */
+	xrd_begin(&b, XRDDEFAULT_PROGRAMSTATUS_DATA, 0);
+	xrd_int(&b, XRD_MODIFIED_HOST_PROCESS_ATTRIBUTES, modified_host_process_attributes & ~retained_process_host_attribute_mask);
+	xrd_int(&b, XRD_MODIFIED_SERVICE_PROCESS_ATTRIBUTES, modified_service_process_attributes & ~retained_process_service_attribute_mask);
+	xrd_int(&b, XRD_ENABLE_NOTIFICATIONS, enable_notifications);
+	xrd_int(&b, XRD_ACTIVE_SERVICE_CHECKS_ENABLED, execute_service_checks);
+	xrd_int(&b, XRD_PASSIVE_SERVICE_CHECKS_ENABLED, accept_passive_service_checks);
+	xrd_int(&b, XRD_ACTIVE_HOST_CHECKS_ENABLED, execute_host_checks);
+	xrd_int(&b, XRD_PASSIVE_HOST_CHECKS_ENABLED, accept_passive_host_checks);
+	xrd_int(&b, XRD_ENABLE_EVENT_HANDLERS, enable_event_handlers);
+	xrd_int(&b, XRD_OBSESS_OVER_SERVICES, obsess_over_services);
+	xrd_int(&b, XRD_OBSESS_OVER_HOSTS, obsess_over_hosts);
+	xrd_int(&b, XRD_CHECK_SERVICE_FRESHNESS, check_service_freshness);
+	xrd_int(&b, XRD_CHECK_HOST_FRESHNESS, check_host_freshness);
+	xrd_int(&b, XRD_ENABLE_FLAP_DETECTION, enable_flap_detection);
+	xrd_int(&b, XRD_PROCESS_PERFORMANCE_DATA_GLOBAL, process_performance_data);
+	xrd_str(&b, XRD_GLOBAL_HOST_EVENT_HANDLER, global_host_event_handler);
+	xrd_str(&b, XRD_GLOBAL_SERVICE_EVENT_HANDLER, global_service_event_handler);
+	xrd_int(&b, XRD_NEXT_COMMENT_ID, next_comment_id);
+	xrd_int(&b, XRD_NEXT_DOWNTIME_ID, next_downtime_id);
+	xrd_int(&b, XRD_NEXT_EVENT_ID, next_event_id);
+	xrd_int(&b, XRD_NEXT_PROBLEM_ID, next_problem_id);
+	xrd_int(&b, XRD_NEXT_NOTIFICATION_ID, next_notification_id);
+	if(result == OK)
+		result = xrd_end(&b, fp, &hdr);
+
+	/* host state information */
+	for(temp_host = host_list; temp_host != NULL && result == OK; temp_host = temp_host->next) {
+
+		xrd_begin(&b, XRDDEFAULT_HOSTSTATUS_DATA, temp_host->id);
+		xrd_str(&b, XRD_HOST_NAME, temp_host->name);
+		xrd_int(&b, XRD_MODIFIED_ATTRIBUTES, temp_host->modified_attributes & ~retained_host_attribute_mask);
+		xrd_str(&b, XRD_CHECK_COMMAND, temp_host->check_command);
+		xrd_str(&b, XRD_CHECK_PERIOD, temp_host->check_period);
+		xrd_str(&b, XRD_NOTIFICATION_PERIOD, temp_host->notification_period);
+		xrd_str(&b, XRD_EVENT_HANDLER, temp_host->event_handler);
+		xrd_int(&b, XRD_HAS_BEEN_CHECKED, temp_host->has_been_checked);
+		xrd_dbl(&b, XRD_CHECK_EXECUTION_TIME, temp_host->execution_time);
+		xrd_dbl(&b, XRD_CHECK_LATENCY, temp_host->latency);
+		xrd_int(&b, XRD_CHECK_TYPE, temp_host->check_type);
+		xrd_int(&b, XRD_CURRENT_STATE, temp_host->current_state);
+		xrd_int(&b, XRD_LAST_STATE, temp_host->last_state);
+		xrd_int(&b, XRD_LAST_HARD_STATE, temp_host->last_hard_state);
+		xrd_int(&b, XRD_LAST_EVENT_ID, temp_host->last_event_id);
+		xrd_int(&b, XRD_CURRENT_EVENT_ID, temp_host->current_event_id);
+		xrd_int(&b, XRD_CURRENT_PROBLEM_ID, temp_host->current_problem_id);
+		xrd_int(&b, XRD_LAST_PROBLEM_ID, temp_host->last_problem_id);
+		xrd_str(&b, XRD_PLUGIN_OUTPUT, temp_host->plugin_output);
+		xrd_str(&b, XRD_LONG_PLUGIN_OUTPUT, temp_host->long_plugin_output);
+		xrd_str(&b, XRD_PERFORMANCE_DATA, temp_host->perf_data);
+		xrd_int(&b, XRD_LAST_CHECK, temp_host->last_check);
+		xrd_int(&b, XRD_NEXT_CHECK, temp_host->next_check);
+		xrd_int(&b, XRD_CHECK_OPTIONS, temp_host->check_options);
+		xrd_int(&b, XRD_CURRENT_ATTEMPT, temp_host->current_attempt);
+		xrd_int(&b, XRD_MAX_ATTEMPTS, temp_host->max_attempts);
+		xrd_dbl(&b, XRD_CHECK_INTERVAL, temp_host->check_interval);
+		xrd_dbl(&b, XRD_RETRY_INTERVAL, temp_host->retry_interval);
+		xrd_int(&b, XRD_STATE_TYPE, temp_host->state_type);
+		xrd_int(&b, XRD_LAST_STATE_CHANGE, temp_host->last_state_change);
+		xrd_int(&b, XRD_LAST_HARD_STATE_CHANGE, temp_host->last_hard_state_change);
+		xrd_int(&b, XRD_LAST_TIME_UP, temp_host->last_time_up);
+		xrd_int(&b, XRD_LAST_TIME_DOWN, temp_host->last_time_down);
+		xrd_int(&b, XRD_LAST_TIME_UNREACHABLE, temp_host->last_time_unreachable);
+		xrd_int(&b, XRD_NOTIFIED_ON, temp_host->notified_on & (OPT_DOWN | OPT_UNREACHABLE));
+		xrd_int(&b, XRD_LAST_NOTIFICATION, temp_host->last_notification);
+		xrd_int(&b, XRD_CURRENT_NOTIFICATION_NUMBER, temp_host->current_notification_number);
+		xrd_int(&b, XRD_CURRENT_NOTIFICATION_ID, temp_host->current_notification_id);
+		xrd_int(&b, XRD_NOTIFICATIONS_ENABLED, temp_host->notifications_enabled);
+		xrd_int(&b, XRD_PROBLEM_HAS_BEEN_ACKNOWLEDGED, temp_host->problem_has_been_acknowledged);
+		xrd_int(&b, XRD_ACKNOWLEDGEMENT_TYPE, temp_host->acknowledgement_type);
+		xrd_int(&b, XRD_ACTIVE_CHECKS_ENABLED, temp_host->checks_enabled);
+		xrd_int(&b, XRD_PASSIVE_CHECKS_ENABLED, temp_host->accept_passive_checks);
+		xrd_int(&b, XRD_EVENT_HANDLER_ENABLED, temp_host->event_handler_enabled);
+		xrd_int(&b, XRD_FLAP_DETECTION_ENABLED, temp_host->flap_detection_enabled);
+		xrd_int(&b, XRD_PROCESS_PERFORMANCE_DATA, temp_host->process_performance_data);
+		xrd_int(&b, XRD_OBSESS, temp_host->obsess);
+		xrd_int(&b, XRD_IS_FLAPPING, temp_host->is_flapping);
+		xrd_dbl(&b, XRD_PERCENT_STATE_CHANGE, temp_host->percent_state_change);
+		xrd_int(&b, XRD_CHECK_FLAPPING_RECOVERY_NOTIFICATION, temp_host->check_flapping_recovery_notification);
+		xrd_hist(&b, temp_host->state_history, temp_host->state_history_index);
+		xrd_cvars(&b, temp_host->custom_variables);
+		result = xrd_end(&b, fp, &hdr);
+		}
+
+	/* service state information */
+	for(temp_service = service_list; temp_service != NULL && result == OK; temp_service = temp_service->next) {
+
+		xrd_begin(&b, XRDDEFAULT_SERVICESTATUS_DATA, temp_service->id);
+		xrd_str(&b, XRD_HOST_NAME, temp_service->host_name);
+		xrd_str(&b, XRD_SERVICE_DESCRIPTION, temp_service->description);
+		xrd_int(&b, XRD_MODIFIED_ATTRIBUTES, temp_service->modified_attributes & ~retained_service_attribute_mask);
+		xrd_str(&b, XRD_CHECK_COMMAND, temp_service->check_command);
+		xrd_str(&b, XRD_CHECK_PERIOD, temp_service->check_period);
+		xrd_str(&b, XRD_NOTIFICATION_PERIOD, temp_service->notification_period);
+		xrd_str(&b, XRD_EVENT_HANDLER, temp_service->event_handler);
+		xrd_int(&b, XRD_HAS_BEEN_CHECKED, temp_service->has_been_checked);
+		xrd_dbl(&b, XRD_CHECK_EXECUTION_TIME, temp_service->execution_time);
+		xrd_dbl(&b, XRD_CHECK_LATENCY, temp_service->latency);
+		xrd_int(&b, XRD_CHECK_TYPE, temp_service->check_type);
+		xrd_int(&b, XRD_CURRENT_STATE, temp_service->current_state);
+		xrd_int(&b, XRD_LAST_STATE, temp_service->last_state);
+		xrd_int(&b, XRD_LAST_HARD_STATE, temp_service->last_hard_state);
+		xrd_int(&b, XRD_LAST_EVENT_ID, temp_service->last_event_id);
+		xrd_int(&b, XRD_CURRENT_EVENT_ID, temp_service->current_event_id);
+		xrd_int(&b, XRD_CURRENT_PROBLEM_ID, temp_service->current_problem_id);
+		xrd_int(&b, XRD_LAST_PROBLEM_ID, temp_service->last_problem_id);
+		xrd_int(&b, XRD_CURRENT_ATTEMPT, temp_service->current_attempt);
+		xrd_int(&b, XRD_MAX_ATTEMPTS, temp_service->max_attempts);
+		xrd_dbl(&b, XRD_CHECK_INTERVAL, temp_service->check_interval);
+		xrd_dbl(&b, XRD_RETRY_INTERVAL, temp_service->retry_interval);
+		xrd_int(&b, XRD_STATE_TYPE, temp_service->state_type);
+		xrd_int(&b, XRD_LAST_STATE_CHANGE, temp_service->last_state_change);
+		xrd_int(&b, XRD_LAST_HARD_STATE_CHANGE, temp_service->last_hard_state_change);
+		xrd_int(&b, XRD_LAST_TIME_OK, temp_service->last_time_ok);
+		xrd_int(&b, XRD_LAST_TIME_WARNING, temp_service->last_time_warning);
+		xrd_int(&b, XRD_LAST_TIME_UNKNOWN, temp_service->last_time_unknown);
+		xrd_int(&b, XRD_LAST_TIME_CRITICAL, temp_service->last_time_critical);
+		xrd_str(&b, XRD_PLUGIN_OUTPUT, temp_service->plugin_output);
+		xrd_str(&b, XRD_LONG_PLUGIN_OUTPUT, temp_service->long_plugin_output);
+		xrd_str(&b, XRD_PERFORMANCE_DATA, temp_service->perf_data);
+		xrd_int(&b, XRD_LAST_CHECK, temp_service->last_check);
+		xrd_int(&b, XRD_NEXT_CHECK, temp_service->next_check);
+		xrd_int(&b, XRD_CHECK_OPTIONS, temp_service->check_options);
+		xrd_int(&b, XRD_NOTIFIED_ON, temp_service->notified_on & (OPT_UNKNOWN | OPT_WARNING | OPT_CRITICAL));
+		xrd_int(&b, XRD_CURRENT_NOTIFICATION_NUMBER, temp_service->current_notification_number);
+		xrd_int(&b, XRD_CURRENT_NOTIFICATION_ID, temp_service->current_notification_id);
+		xrd_int(&b, XRD_LAST_NOTIFICATION, temp_service->last_notification);
+		xrd_int(&b, XRD_NOTIFICATIONS_ENABLED, temp_service->notifications_enabled);
+		xrd_int(&b, XRD_ACTIVE_CHECKS_ENABLED, temp_service->checks_enabled);
+		xrd_int(&b, XRD_PASSIVE_CHECKS_ENABLED, temp_service->accept_passive_checks);
+		xrd_int(&b, XRD_EVENT_HANDLER_ENABLED, temp_service->event_handler_enabled);
+		xrd_int(&b, XRD_PROBLEM_HAS_BEEN_ACKNOWLEDGED, temp_service->problem_has_been_acknowledged);
+		xrd_int(&b, XRD_ACKNOWLEDGEMENT_TYPE, temp_service->acknowledgement_type);
+		xrd_int(&b, XRD_FLAP_DETECTION_ENABLED, temp_service->flap_detection_enabled);
+		xrd_int(&b, XRD_PROCESS_PERFORMANCE_DATA, temp_service->process_performance_data);
+		xrd_int(&b, XRD_OBSESS, temp_service->obsess);
+		xrd_int(&b, XRD_IS_FLAPPING, temp_service->is_flapping);
+		xrd_dbl(&b, XRD_PERCENT_STATE_CHANGE, temp_service->percent_state_change);
+		xrd_int(&b, XRD_CHECK_FLAPPING_RECOVERY_NOTIFICATION, temp_service->check_flapping_recovery_notification);
+		xrd_hist(&b, temp_service->state_history, temp_service->state_history_index);
+		xrd_cvars(&b, temp_service->custom_variables);
+		result = xrd_end(&b, fp, &hdr);
+		}
+
+	/* contact state information */
+	for(temp_contact = contact_list; temp_contact != NULL && result == OK; temp_contact = temp_contact->next) {
+
+		xrd_begin(&b, XRDDEFAULT_CONTACTSTATUS_DATA, temp_contact->id);
+		xrd_str(&b, XRD_CONTACT_NAME, temp_contact->name);
+		xrd_int(&b, XRD_MODIFIED_ATTRIBUTES, temp_contact->modified_attributes);
+		xrd_int(&b, XRD_MODIFIED_HOST_ATTRIBUTES, temp_contact->modified_host_attributes & ~retained_contact_host_attribute_mask);
+		xrd_int(&b, XRD_MODIFIED_SERVICE_ATTRIBUTES, temp_contact->modified_service_attributes & ~retained_contact_service_attribute_mask);
+		xrd_str(&b, XRD_HOST_NOTIFICATION_PERIOD, temp_contact->host_notification_period);
+		xrd_str(&b, XRD_SERVICE_NOTIFICATION_PERIOD, temp_contact->service_notification_period);
+		xrd_int(&b, XRD_LAST_HOST_NOTIFICATION, temp_contact->last_host_notification);
+		xrd_int(&b, XRD_LAST_SERVICE_NOTIFICATION, temp_contact->last_service_notification);
+		xrd_int(&b, XRD_HOST_NOTIFICATIONS_ENABLED, temp_contact->host_notifications_enabled);
+		xrd_int(&b, XRD_SERVICE_NOTIFICATIONS_ENABLED, temp_contact->service_notifications_enabled);
+		xrd_cvars(&b, temp_contact->custom_variables);
+		result = xrd_end(&b, fp, &hdr);
+		}
+
+	/* comments */
+	for(temp_comment = comment_list; temp_comment != NULL && result == OK; temp_comment = temp_comment->next) {
+
+		xrd_begin(&b, (temp_comment->comment_type == HOST_COMMENT) ? XRDDEFAULT_HOSTCOMMENT_DATA : XRDDEFAULT_SERVICECOMMENT_DATA, 0);
+		xrd_str(&b, XRD_HOST_NAME, temp_comment->host_name);
+		if(temp_comment->comment_type == SERVICE_COMMENT)
+			xrd_str(&b, XRD_SERVICE_DESCRIPTION, temp_comment->service_description);
+		xrd_int(&b, XRD_ENTRY_TYPE, temp_comment->entry_type);
+		xrd_int(&b, XRD_COMMENT_ID, temp_comment->comment_id);
+		xrd_int(&b, XRD_SOURCE, temp_comment->source);
+		xrd_int(&b, XRD_PERSISTENT, temp_comment->persistent);
+		xrd_int(&b, XRD_ENTRY_TIME, temp_comment->entry_time);
+		xrd_int(&b, XRD_EXPIRES, temp_comment->expires);
+		xrd_int(&b, XRD_EXPIRE_TIME, temp_comment->expire_time);
+		xrd_str(&b, XRD_AUTHOR, temp_comment->author);
+		xrd_str(&b, XRD_COMMENT_DATA, temp_comment->comment_data);
+		result = xrd_end(&b, fp, &hdr);
+		}
+
+	/* downtime */
+	for(temp_downtime = scheduled_downtime_list; temp_downtime != NULL && result == OK; temp_downtime = temp_downtime->next) {
+
+		xrd_begin(&b, (temp_downtime->type == HOST_DOWNTIME) ? XRDDEFAULT_HOSTDOWNTIME_DATA : XRDDEFAULT_SERVICEDOWNTIME_DATA, 0);
+		xrd_str(&b, XRD_HOST_NAME, temp_downtime->host_name);
+		if(temp_downtime->type == SERVICE_DOWNTIME)
+			xrd_str(&b, XRD_SERVICE_DESCRIPTION, temp_downtime->service_description);
+		xrd_int(&b, XRD_COMMENT_ID, temp_downtime->comment_id);
+		xrd_int(&b, XRD_DOWNTIME_ID, temp_downtime->downtime_id);
+		xrd_int(&b, XRD_ENTRY_TIME, temp_downtime->entry_time);
+		xrd_int(&b, XRD_START_TIME, temp_downtime->start_time);
+		xrd_int(&b, XRD_FLEX_DOWNTIME_START, temp_downtime->flex_downtime_start);
+		xrd_int(&b, XRD_END_TIME, temp_downtime->end_time);
+		xrd_int(&b, XRD_TRIGGERED_BY, temp_downtime->triggered_by);
+		xrd_int(&b, XRD_FIXED, temp_downtime->fixed);
+		xrd_int(&b, XRD_DURATION, temp_downtime->duration);
+		xrd_int(&b, XRD_IS_IN_EFFECT, temp_downtime->is_in_effect);
+		xrd_int(&b, XRD_START_NOTIFICATION_SENT, temp_downtime->start_notification_sent);
+		xrd_str(&b, XRD_AUTHOR, temp_downtime->author);
+		xrd_str(&b, XRD_COMMENT_DATA, temp_downtime->comment);
+		result = xrd_end(&b, fp, &hdr);
+		}
+
+	my_free(b.buf);
+
+	/* now we know what the header should say */
+	if(result == OK && (fseek(fp, 0L, SEEK_SET) != 0 || fwrite(&hdr, sizeof(hdr), 1, fp) != 1))
+		result = ERROR;
+
+	result = xrddefault_commit_temp_file(fp, fd, tmp_file, result);
+	my_free(tmp_file);
+
+	return result;
+	}
+
+
+/* checks that the command a command line starts with still exists */
+static int xrd_command_exists(const char *cmd) {
+	command *temp_command;
+	char *name, *bang;
+
+	/* my_strtok() isn't safe to use in the decoding threads */
+	if((name = strdup(cmd)) == NULL)
+		return FALSE;
+	if((bang = strchr(name, '!')) != NULL)
+		*bang = 0;
+	temp_command = find_command(name);
+	free(name);
+
+	return (temp_command != NULL) ? TRUE : FALSE;
+	}
+
+
+/*
+ * Decodes the fields of a record and looks up everything the record
+ * refers to. This runs in the decoding threads, so it must only read
+ * the objects and never change them.
+ */
+static void xrd_decode_entry(struct xrd_entry *e) {
+	const char *p = (const char *)e->rec + sizeof(struct xrd_record);
+	const char *end = (const char *)e->rec + e->rec->size;
+	const char *host_name = NULL, *service_description = NULL, *contact_name = NULL;
+	const struct xrd_field *field;
+	customvariablesmember *cvars = NULL, *temp_customvariablesmember;
+	struct xrd_value *v;
+	const char *data;
+	host *temp_host;
+	service *temp_service;
+	contact *temp_contact;
+	int32_t modified;
+	unsigned int x;
+
+	for(x = 0; x < e->rec->fields; x++) {
+
+		if((size_t)(end - p) < sizeof(*field)) {
+			e->error = TRUE;
+			return;
+			}
+		field = (const struct xrd_field *)p;
+		data = p + sizeof(*field);
+		if(XRD_PAD((size_t)field->len) > (size_t)(end - data)) {
+			e->error = TRUE;
+			return;
+			}
+		p = data + XRD_PAD((size_t)field->len);
+
+		v = &e->values[e->num_values];
+		memset(v, 0, sizeof(*v));
+		v->key = field->key;
+
+		switch(field->kind) {
+
+			case XRD_INT:
+				if(field->len != sizeof(int64_t))
+					continue;
+				memcpy(&v->i, data, sizeof(v->i));
+				v->d = (double)v->i;
+				break;
+
+			case XRD_DBL:
+				if(field->len != sizeof(double))
+					continue;
+				memcpy(&v->d, data, sizeof(v->d));
+				v->i = (int64_t)v->d;
+				break;
+
+			case XRD_STR:
+				if(field->len == 0 || data[field->len - 1] != 0)
+					continue;
+				v->s = data;
+				break;
+
+			case XRD_HIST:
+				v->hist = data;
+				v->count = field->len / sizeof(int32_t);
+				if(v->count > MAX_STATE_HISTORY_ENTRIES)
+					v->count = MAX_STATE_HISTORY_ENTRIES;
+				break;
+
+			case XRD_CVAR:
+				if(field->len < sizeof(int32_t) + 2 || data[field->len - 1] != 0)
+					continue;
+				memcpy(&modified, data, sizeof(modified));
+				v->modified = modified;
+				v->s = data + sizeof(int32_t);
+				v->s2 = v->s + strlen(v->s) + 1;
+				if(v->s2 >= data + field->len)
+					continue;
+				break;
+
+			/* a kind of field from a later schema */
+			default:
+				continue;
+			}
+
+		if(v->s != NULL && v->key == XRD_HOST_NAME)
+			host_name = v->s;
+		else if(v->s != NULL && v->key == XRD_SERVICE_DESCRIPTION)
+			service_description = v->s;
+		else if(v->s != NULL && v->key == XRD_CONTACT_NAME)
+			contact_name = v->s;
+
+		e->num_values++;
+		}
+
+	/* find the object by id, unless the config changed under us */
+	switch(e->rec->type) {
+
+		case XRDDEFAULT_HOSTSTATUS_DATA:
+			if(host_name == NULL)
+				break;
+			if(e->rec->id < num_objects.hosts && !strcmp(host_ary[e->rec->id]->name, host_name))
+				temp_host = host_ary[e->rec->id];
+			else
+				temp_host = find_host(host_name);
+			if(temp_host != NULL)
+				cvars = temp_host->custom_variables;
+			e->object = temp_host;
+			break;
+
+		case XRDDEFAULT_SERVICESTATUS_DATA:
+			if(host_name == NULL || service_description == NULL)
+				break;
+			if(e->rec->id < num_objects.services && !strcmp(service_ary[e->rec->id]->host_name, host_name) && !strcmp(service_ary[e->rec->id]->description, service_description))
+				temp_service = service_ary[e->rec->id];
+			else
+				temp_service = find_service(host_name, service_description);
+			if(temp_service != NULL)
+				cvars = temp_service->custom_variables;
+			e->object = temp_service;
+			break;
+
+		case XRDDEFAULT_CONTACTSTATUS_DATA:
+			if(contact_name == NULL)
+				break;
+			if(e->rec->id < num_objects.contacts && !strcmp(contact_ary[e->rec->id]->name, contact_name))
+				temp_contact = contact_ary[e->rec->id];
+			else
+				temp_contact = find_contact(contact_name);
+			if(temp_contact != NULL)
+				cvars = temp_contact->custom_variables;
+			e->object = temp_contact;
+			break;
+
+		default:
+			break;
+		}
+
+	/* make sure the commands and timeperiods still exist */
+	for(x = 0; x < e->num_values; x++) {
+
+		v = &e->values[x];
+		if(v->s == NULL)
+			continue;
+
+		switch(v->key) {
+
+			case XRD_CHECK_COMMAND:
+			case XRD_EVENT_HANDLER:
+			case XRD_GLOBAL_HOST_EVENT_HANDLER:
+			case XRD_GLOBAL_SERVICE_EVENT_HANDLER:
+				v->ok = xrd_command_exists(v->s);
+				break;
+
+			case XRD_CHECK_PERIOD:
+			case XRD_NOTIFICATION_PERIOD:
+			case XRD_HOST_NOTIFICATION_PERIOD:
+			case XRD_SERVICE_NOTIFICATION_PERIOD:
+				v->ok = (find_timeperiod(v->s) != NULL) ? TRUE : FALSE;
+				break;
+
+			case XRD_CUSTOM_VARIABLE:
+				for(temp_customvariablesmember = cvars; temp_customvariablesmember != NULL; temp_customvariablesmember = temp_customvariablesmember->next) {
+					if(!strcmp(v->s, temp_customvariablesmember->variable_name)) {
+						v->cvar = temp_customvariablesmember;
+						break;
+						}
+					}
+				break;
+
+			default:
+				break;
+			}
+		}
+	}
+
+
+/* decodes chunks of records until there are none left */
+static void *xrd_decode_thread(void *discard) {
+	unsigned int start, x;
+
+	while((start = __sync_fetch_and_add(&xrd_load.next_chunk, XRD_CHUNK_RECORDS)) < xrd_load.num_entries) {
+		for(x = start; x < start + XRD_CHUNK_RECORDS && x < xrd_load.num_entries; x++)
+			xrd_decode_entry(&xrd_load.entries[x]);
+		}
+
+	return NULL;
+	}
+
+
+/* decodes all records, in as many threads as we're allowed to use */
+static void xrd_decode_all(void) {
+	pthread_t *tids = NULL;
+	sigset_t all, old;
+	int threads, started = 0;
+
+	if((threads = retention_load_threads) == 0)
+		threads = online_cpus();
+	if((unsigned int)threads > xrd_load.num_entries / XRD_CHUNK_RECORDS + 1)
+		threads = xrd_load.num_entries / XRD_CHUNK_RECORDS + 1;
+
+	/* the main thread decodes too, so start one less */
+	if(threads > 1 && (tids = calloc(threads - 1, sizeof(pthread_t))) != NULL) {
+
+		/* signals are for the main thread only */
+		sigfillset(&all);
+		pthread_sigmask(SIG_SETMASK, &all, &old);
+		for(started = 0; started < threads - 1; started++) {
+			if(pthread_create(&tids[started], NULL, xrd_decode_thread, NULL))
+				break;
+			}
+		pthread_sigmask(SIG_SETMASK, &old, NULL);
+		}
+
+	log_debug_info(DEBUGL_RETENTIONDATA, 1, "Decoding %u retention records in %d threads\n", xrd_load.num_entries, started + 1);
+
+	xrd_decode_thread(NULL);
+
+	while(started > 0)
+		pthread_join(tids[--started], NULL);
+	my_free(tids);
+	}
+
+
+static void xrd_apply_info(struct xrd_entry *e) {
+	struct xrd_value *v;
+	unsigned int x;
+
+	for(x = 0; x < e->num_values; x++) {
+		v = &e->values[x];
+		switch(v->key) {
+			case XRD_VERSION:
+				/* initialize last version in case we're reading a file without it */
+				if(v->s != NULL && last_program_version == NULL)
+					last_program_version = (char *)strdup(v->s);
+				break;
+			case XRD_LAST_UPDATE_CHECK:
+				last_update_check = (time_t)v->i;
+				break;
+			case XRD_UPDATE_AVAILABLE:
+				update_available = (int)v->i;
+				break;
+			case XRD_UPDATE_UID:
+				update_uid = (unsigned long)v->i;
+				break;
+			case XRD_LAST_VERSION:
+				if(v->s != NULL) {
+					my_free(last_program_version);
+					last_program_version = (char *)strdup(v->s);
+					}
+				break;
+			case XRD_NEW_VERSION:
+				if(v->s != NULL) {
+					my_free(new_program_version);
+					new_program_version = (char *)strdup(v->s);
+					}
+				break;
+			default:
+				break;
+			}
+		}
+	}
+
+
+/* replaces a string if it was retained and is still valid */
+static void xrd_apply_string(char **dest, struct xrd_value *v) {
+	char *temp_ptr;
+
+	if(v->s == NULL || (temp_ptr = (char *)strdup(v->s)) == NULL)
+		return;
+	my_free(*dest);
+	*dest = temp_ptr;
+	}
+
+
+static void xrd_apply_custom_variable(struct xrd_value *v) {
+
+	if(v->cvar == NULL || v->modified <= 0 || *v->s2 == 0)
+		return;
+	my_free(v->cvar->variable_value);
+	v->cvar->variable_value = (char *)strdup(v->s2);
+	v->cvar->has_been_modified = TRUE;
+	}
+
+
+static void xrd_apply_program(struct xrd_entry *e) {
+	struct xrd_value *v;
+	unsigned int x;
+
+	for(x = 0; x < e->num_values; x++) {
+		v = &e->values[x];
+
+		if(v->key == XRD_MODIFIED_HOST_PROCESS_ATTRIBUTES) {
+			modified_host_process_attributes = (unsigned long)v->i & ~retained_process_host_attribute_mask;
+			continue;
+			}
+		if(v->key == XRD_MODIFIED_SERVICE_PROCESS_ATTRIBUTES) {
+			modified_service_process_attributes = (unsigned long)v->i & ~retained_process_service_attribute_mask;
+			continue;
+			}
+		if(use_retained_program_state == FALSE)
+			continue;
+
+		switch(v->key) {
+			case XRD_ENABLE_NOTIFICATIONS:
+				if(modified_host_process_attributes & MODATTR_NOTIFICATIONS_ENABLED)
+					enable_notifications = (v->i > 0) ? TRUE : FALSE;
+				break;
+			case XRD_ACTIVE_SERVICE_CHECKS_ENABLED:
+				if(modified_service_process_attributes & MODATTR_ACTIVE_CHECKS_ENABLED)
+					execute_service_checks = (v->i > 0) ? TRUE : FALSE;
+				break;
+			case XRD_PASSIVE_SERVICE_CHECKS_ENABLED:
+				if(modified_service_process_attributes & MODATTR_PASSIVE_CHECKS_ENABLED)
+					accept_passive_service_checks = (v->i > 0) ? TRUE : FALSE;
+				break;
+			case XRD_ACTIVE_HOST_CHECKS_ENABLED:
+				if(modified_host_process_attributes & MODATTR_ACTIVE_CHECKS_ENABLED)
+					execute_host_checks = (v->i > 0) ? TRUE : FALSE;
+				break;
+			case XRD_PASSIVE_HOST_CHECKS_ENABLED:
+				if(modified_host_process_attributes & MODATTR_PASSIVE_CHECKS_ENABLED)
+					accept_passive_host_checks = (v->i > 0) ? TRUE : FALSE;
+				break;
+			case XRD_ENABLE_EVENT_HANDLERS:
+				if(modified_host_process_attributes & MODATTR_EVENT_HANDLER_ENABLED)
+					enable_event_handlers = (v->i > 0) ? TRUE : FALSE;
+				break;
+			case XRD_OBSESS_OVER_SERVICES:
+				if(modified_service_process_attributes & MODATTR_OBSESSIVE_HANDLER_ENABLED)
+					obsess_over_services = (v->i > 0) ? TRUE : FALSE;
+				break;
+			case XRD_OBSESS_OVER_HOSTS:
+				if(modified_host_process_attributes & MODATTR_OBSESSIVE_HANDLER_ENABLED)
+					obsess_over_hosts = (v->i > 0) ? TRUE : FALSE;
+				break;
+			case XRD_CHECK_SERVICE_FRESHNESS:
+				if(modified_service_process_attributes & MODATTR_FRESHNESS_CHECKS_ENABLED)
+					check_service_freshness = (v->i > 0) ? TRUE : FALSE;
+				break;
+			case XRD_CHECK_HOST_FRESHNESS:
+				if(modified_host_process_attributes & MODATTR_FRESHNESS_CHECKS_ENABLED)
+					check_host_freshness = (v->i > 0) ? TRUE : FALSE;
+				break;
+			case XRD_ENABLE_FLAP_DETECTION:
+				if(modified_host_process_attributes & MODATTR_FLAP_DETECTION_ENABLED)
+					enable_flap_detection = (v->i > 0) ? TRUE : FALSE;
+				break;
+			case XRD_PROCESS_PERFORMANCE_DATA_GLOBAL:
+				if(modified_host_process_attributes & MODATTR_PERFORMANCE_DATA_ENABLED)
+					process_performance_data = (v->i > 0) ? TRUE : FALSE;
+				break;
+			case XRD_GLOBAL_HOST_EVENT_HANDLER:
+				if(modified_host_process_attributes & MODATTR_EVENT_HANDLER_COMMAND && v->ok == TRUE)
+					xrd_apply_string(&global_host_event_handler, v);
+				break;
+			case XRD_GLOBAL_SERVICE_EVENT_HANDLER:
+				if(modified_service_process_attributes & MODATTR_EVENT_HANDLER_COMMAND && v->ok == TRUE)
+					xrd_apply_string(&global_service_event_handler, v);
+				break;
+			case XRD_NEXT_COMMENT_ID:
+				next_comment_id = (unsigned long)v->i;
+				break;
+			case XRD_NEXT_DOWNTIME_ID:
+				next_downtime_id = (unsigned long)v->i;
+				break;
+			case XRD_NEXT_EVENT_ID:
+				next_event_id = (unsigned long)v->i;
+				break;
+			case XRD_NEXT_PROBLEM_ID:
+				next_problem_id = (unsigned long)v->i;
+				break;
+			case XRD_NEXT_NOTIFICATION_ID:
+				next_notification_id = (unsigned long)v->i;
+				break;
+			default:
+				break;
+			}
+		}
+
+	/* adjust modified attributes if necessary */
+	if(use_retained_program_state == FALSE) {
+		modified_host_process_attributes = MODATTR_NONE;
+		modified_service_process_attributes = MODATTR_NONE;
+		}
+	}
+
+
+static void xrd_apply_host(struct xrd_entry *e, int scheduling_info_is_ok) {
+	host *temp_host = e->object;
+	struct xrd_value *v;
+	int was_flapping = FALSE;
+	unsigned int x, y;
+	int32_t state;
+
+	for(x = 0; x < e->num_values; x++) {
+		v = &e->values[x];
+
+		if(v->key == XRD_MODIFIED_ATTRIBUTES) {
+			temp_host->modified_attributes = (unsigned long)v->i & ~retained_host_attribute_mask;
+			continue;
+			}
+
+		if(temp_host->retain_status_information == TRUE) {
+			switch(v->key) {
+				case XRD_HAS_BEEN_CHECKED:
+					temp_host->has_been_checked = (v->i > 0) ? TRUE : FALSE;
+					break;
+				case XRD_CHECK_EXECUTION_TIME:
+					temp_host->execution_time = v->d;
+					break;
+				case XRD_CHECK_LATENCY:
+					temp_host->latency = v->d;
+					break;
+				case XRD_CHECK_TYPE:
+					temp_host->check_type = (int)v->i;
+					break;
+				case XRD_CURRENT_STATE:
+					temp_host->current_state = (int)v->i;
+					break;
+				case XRD_LAST_STATE:
+					temp_host->last_state = (int)v->i;
+					break;
+				case XRD_LAST_HARD_STATE:
+					temp_host->last_hard_state = (int)v->i;
+					break;
+				case XRD_PLUGIN_OUTPUT:
+					xrd_apply_string(&temp_host->plugin_output, v);
+					break;
+				case XRD_LONG_PLUGIN_OUTPUT:
+					xrd_apply_string(&temp_host->long_plugin_output, v);
+					break;
+				case XRD_PERFORMANCE_DATA:
+					xrd_apply_string(&temp_host->perf_data, v);
+					break;
+				case XRD_LAST_CHECK:
+					temp_host->last_check = (time_t)v->i;
+					break;
+				case XRD_NEXT_CHECK:
+					if(use_retained_scheduling_info == TRUE && scheduling_info_is_ok == TRUE)
+						temp_host->next_check = (time_t)v->i;
+					break;
+				case XRD_CHECK_OPTIONS:
+					if(use_retained_scheduling_info == TRUE && scheduling_info_is_ok == TRUE)
+						temp_host->check_options = (int)v->i;
+					break;
+				case XRD_CURRENT_ATTEMPT:
+					temp_host->current_attempt = (int)v->i;
+					break;
+				case XRD_CURRENT_EVENT_ID:
+					temp_host->current_event_id = (unsigned long)v->i;
+					break;
+				case XRD_LAST_EVENT_ID:
+					temp_host->last_event_id = (unsigned long)v->i;
+					break;
+				case XRD_CURRENT_PROBLEM_ID:
+					temp_host->current_problem_id = (unsigned long)v->i;
+					break;
+				case XRD_LAST_PROBLEM_ID:
+					temp_host->last_problem_id = (unsigned long)v->i;
+					break;
+				case XRD_STATE_TYPE:
+					temp_host->state_type = (int)v->i;
+					break;
+				case XRD_LAST_STATE_CHANGE:
+					temp_host->last_state_change = (time_t)v->i;
+					break;
+				case XRD_LAST_HARD_STATE_CHANGE:
+					temp_host->last_hard_state_change = (time_t)v->i;
+					break;
+				case XRD_LAST_TIME_UP:
+					temp_host->last_time_up = (time_t)v->i;
+					break;
+				case XRD_LAST_TIME_DOWN:
+					temp_host->last_time_down = (time_t)v->i;
+					break;
+				case XRD_LAST_TIME_UNREACHABLE:
+					temp_host->last_time_unreachable = (time_t)v->i;
+					break;
+				case XRD_NOTIFIED_ON:
+					temp_host->notified_on |= (unsigned int)v->i & (OPT_DOWN | OPT_UNREACHABLE);
+					break;
+				case XRD_LAST_NOTIFICATION:
+					temp_host->last_notification = (time_t)v->i;
+					break;
+				case XRD_CURRENT_NOTIFICATION_NUMBER:
+					temp_host->current_notification_number = (int)v->i;
+					break;
+				case XRD_CURRENT_NOTIFICATION_ID:
+					temp_host->current_notification_id = (unsigned long)v->i;
+					break;
+				case XRD_IS_FLAPPING:
+					was_flapping = (int)v->i;
+					break;
+				case XRD_PERCENT_STATE_CHANGE:
+					temp_host->percent_state_change = v->d;
+					break;
+				case XRD_CHECK_FLAPPING_RECOVERY_NOTIFICATION:
+					temp_host->check_flapping_recovery_notification = (int)v->i;
+					break;
+				case XRD_STATE_HISTORY:
+					for(y = 0; y < v->count; y++) {
+						memcpy(&state, v->hist + y * sizeof(state), sizeof(state));
+						temp_host->state_history[y] = state;
+						}
+					temp_host->state_history_index = 0;
+					break;
+				default:
+					break;
+				}
+			}
+
+		if(temp_host->retain_nonstatus_information == TRUE) {
+			switch(v->key) {
+				case XRD_PROBLEM_HAS_BEEN_ACKNOWLEDGED:
+					temp_host->problem_has_been_acknowledged = (v->i > 0) ? TRUE : FALSE;
+					break;
+				case XRD_ACKNOWLEDGEMENT_TYPE:
+					temp_host->acknowledgement_type = (int)v->i;
+					break;
+				case XRD_NOTIFICATIONS_ENABLED:
+					if(temp_host->modified_attributes & MODATTR_NOTIFICATIONS_ENABLED)
+						temp_host->notifications_enabled = (v->i > 0) ? TRUE : FALSE;
+					break;
+				case XRD_ACTIVE_CHECKS_ENABLED:
+					if(temp_host->modified_attributes & MODATTR_ACTIVE_CHECKS_ENABLED)
+						temp_host->checks_enabled = (v->i > 0) ? TRUE : FALSE;
+					break;
+				case XRD_PASSIVE_CHECKS_ENABLED:
+					if(temp_host->modified_attributes & MODATTR_PASSIVE_CHECKS_ENABLED)
+						temp_host->accept_passive_checks = (v->i > 0) ? TRUE : FALSE;
+					break;
+				case XRD_EVENT_HANDLER_ENABLED:
+					if(temp_host->modified_attributes & MODATTR_EVENT_HANDLER_ENABLED)
+						temp_host->event_handler_enabled = (v->i > 0) ? TRUE : FALSE;
+					break;
+				case XRD_FLAP_DETECTION_ENABLED:
+					if(temp_host->modified_attributes & MODATTR_FLAP_DETECTION_ENABLED)
+						temp_host->flap_detection_enabled = (v->i > 0) ? TRUE : FALSE;
+					break;
+				case XRD_PROCESS_PERFORMANCE_DATA:
+					if(temp_host->modified_attributes & MODATTR_PERFORMANCE_DATA_ENABLED)
+						temp_host->process_performance_data = (v->i > 0) ? TRUE : FALSE;
+					break;
+				case XRD_OBSESS:
+					if(temp_host->modified_attributes & MODATTR_OBSESSIVE_HANDLER_ENABLED)
+						temp_host->obsess = (v->i > 0) ? TRUE : FALSE;
+					break;
+				case XRD_CHECK_COMMAND:
+					if(temp_host->modified_attributes & MODATTR_CHECK_COMMAND) {
+						if(v->ok == TRUE)
+							xrd_apply_string(&temp_host->check_command, v);
+						else
+							temp_host->modified_attributes -= MODATTR_CHECK_COMMAND;
+						}
+					break;
+				case XRD_CHECK_PERIOD:
+					if(temp_host->modified_attributes & MODATTR_CHECK_TIMEPERIOD) {
+						if(v->ok == TRUE)
+							xrd_apply_string(&temp_host->check_period, v);
+						else
+							temp_host->modified_attributes -= MODATTR_CHECK_TIMEPERIOD;
+						}
+					break;
+				case XRD_NOTIFICATION_PERIOD:
+					if(temp_host->modified_attributes & MODATTR_NOTIFICATION_TIMEPERIOD) {
+						if(v->ok == TRUE)
+							xrd_apply_string(&temp_host->notification_period, v);
+						else
+							temp_host->modified_attributes -= MODATTR_NOTIFICATION_TIMEPERIOD;
+						}
+					break;
+				case XRD_EVENT_HANDLER:
+					if(temp_host->modified_attributes & MODATTR_EVENT_HANDLER_COMMAND) {
+						if(v->ok == TRUE)
+							xrd_apply_string(&temp_host->event_handler, v);
+						else
+							temp_host->modified_attributes -= MODATTR_EVENT_HANDLER_COMMAND;
+						}
+					break;
+				case XRD_CHECK_INTERVAL:
+					if(temp_host->modified_attributes & MODATTR_NORMAL_CHECK_INTERVAL && v->d >= 0)
+						temp_host->check_interval = v->d;
+					break;
+				case XRD_RETRY_INTERVAL:
+					if(temp_host->modified_attributes & MODATTR_RETRY_CHECK_INTERVAL && v->d >= 0)
+						temp_host->retry_interval = v->d;
+					break;
+				case XRD_MAX_ATTEMPTS:
+					if(temp_host->modified_attributes & MODATTR_MAX_CHECK_ATTEMPTS && v->i >= 1) {
+
+						temp_host->max_attempts = (int)v->i;
+
+						/* adjust current attempt number if in a hard state */
+						if(temp_host->state_type == HARD_STATE && temp_host->current_state != HOST_UP && temp_host->current_attempt > 1)
+							temp_host->current_attempt = temp_host->max_attempts;
+						}
+					break;
+				case XRD_CUSTOM_VARIABLE:
+					if(temp_host->modified_attributes & MODATTR_CUSTOM_VARIABLE)
+						xrd_apply_custom_variable(v);
+					break;
+				default:
+					break;
+				}
+			}
+		}
+
+	xrddefault_finish_host(temp_host, was_flapping);
+	}
+
+
+static void xrd_apply_service(struct xrd_entry *e, int scheduling_info_is_ok) {
+	service *temp_service = e->object;
+	struct xrd_value *v;
+	int was_flapping = FALSE;
+	unsigned int x, y;
+	int32_t state;
+
+	for(x = 0; x < e->num_values; x++) {
+		v = &e->values[x];
+
+		if(v->key == XRD_MODIFIED_ATTRIBUTES) {
+			temp_service->modified_attributes = (unsigned long)v->i & ~retained_service_attribute_mask;
+			continue;
+			}
+
+		if(temp_service->retain_status_information == TRUE) {
+			switch(v->key) {
+				case XRD_HAS_BEEN_CHECKED:
+					temp_service->has_been_checked = (v->i > 0) ? TRUE : FALSE;
+					break;
+				case XRD_CHECK_EXECUTION_TIME:
+					temp_service->execution_time = v->d;
+					break;
+				case XRD_CHECK_LATENCY:
+					temp_service->latency = v->d;
+					break;
+				case XRD_CHECK_TYPE:
+					temp_service->check_type = (int)v->i;
+					break;
+				case XRD_CURRENT_STATE:
+					temp_service->current_state = (int)v->i;
+					break;
+				case XRD_LAST_STATE:
+					temp_service->last_state = (int)v->i;
+					break;
+				case XRD_LAST_HARD_STATE:
+					temp_service->last_hard_state = (int)v->i;
+					break;
+				case XRD_CURRENT_ATTEMPT:
+					temp_service->current_attempt = (int)v->i;
+					break;
+				case XRD_CURRENT_EVENT_ID:
+					temp_service->current_event_id = (unsigned long)v->i;
+					break;
+				case XRD_LAST_EVENT_ID:
+					temp_service->last_event_id = (unsigned long)v->i;
+					break;
+				case XRD_CURRENT_PROBLEM_ID:
+					temp_service->current_problem_id = (unsigned long)v->i;
+					break;
+				case XRD_LAST_PROBLEM_ID:
+					temp_service->last_problem_id = (unsigned long)v->i;
+					break;
+				case XRD_STATE_TYPE:
+					temp_service->state_type = (int)v->i;
+					break;
+				case XRD_LAST_STATE_CHANGE:
+					temp_service->last_state_change = (time_t)v->i;
+					break;
+				case XRD_LAST_HARD_STATE_CHANGE:
+					temp_service->last_hard_state_change = (time_t)v->i;
+					break;
+				case XRD_LAST_TIME_OK:
+					temp_service->last_time_ok = (time_t)v->i;
+					break;
+				case XRD_LAST_TIME_WARNING:
+					temp_service->last_time_warning = (time_t)v->i;
+					break;
+				case XRD_LAST_TIME_UNKNOWN:
+					temp_service->last_time_unknown = (time_t)v->i;
+					break;
+				case XRD_LAST_TIME_CRITICAL:
+					temp_service->last_time_critical = (time_t)v->i;
+					break;
+				case XRD_PLUGIN_OUTPUT:
+					xrd_apply_string(&temp_service->plugin_output, v);
+					break;
+				case XRD_LONG_PLUGIN_OUTPUT:
+					xrd_apply_string(&temp_service->long_plugin_output, v);
+					break;
+				case XRD_PERFORMANCE_DATA:
+					xrd_apply_string(&temp_service->perf_data, v);
+					break;
+				case XRD_LAST_CHECK:
+					temp_service->last_check = (time_t)v->i;
+					break;
+				case XRD_NEXT_CHECK:
+					if(use_retained_scheduling_info == TRUE && scheduling_info_is_ok == TRUE)
+						temp_service->next_check = (time_t)v->i;
+					break;
+				case XRD_CHECK_OPTIONS:
+					if(use_retained_scheduling_info == TRUE && scheduling_info_is_ok == TRUE)
+						temp_service->check_options = (int)v->i;
+					break;
+				case XRD_NOTIFIED_ON:
+					temp_service->notified_on |= (unsigned int)v->i & (OPT_UNKNOWN | OPT_WARNING | OPT_CRITICAL);
+					break;
+				case XRD_CURRENT_NOTIFICATION_NUMBER:
+					temp_service->current_notification_number = (int)v->i;
+					break;
+				case XRD_CURRENT_NOTIFICATION_ID:
+					temp_service->current_notification_id = (unsigned long)v->i;
+					break;
+				case XRD_LAST_NOTIFICATION:
+					temp_service->last_notification = (time_t)v->i;
+					break;
+				case XRD_IS_FLAPPING:
+					was_flapping = (int)v->i;
+					break;
+				case XRD_PERCENT_STATE_CHANGE:
+					temp_service->percent_state_change = v->d;
+					break;
+				case XRD_CHECK_FLAPPING_RECOVERY_NOTIFICATION:
+					temp_service->check_flapping_recovery_notification = (int)v->i;
+					break;
+				case XRD_STATE_HISTORY:
+					for(y = 0; y < v->count; y++) {
+						memcpy(&state, v->hist + y * sizeof(state), sizeof(state));
+						temp_service->state_history[y] = state;
+						}
+					temp_service->state_history_index = 0;
+					break;
+				default:
+					break;
+				}
+			}
+
+		if(temp_service->retain_nonstatus_information == TRUE) {
+			switch(v->key) {
+				case XRD_PROBLEM_HAS_BEEN_ACKNOWLEDGED:
+					temp_service->problem_has_been_acknowledged = (v->i > 0) ? TRUE : FALSE;
+					break;
+				case XRD_ACKNOWLEDGEMENT_TYPE:
+					temp_service->acknowledgement_type = (int)v->i;
+					break;
+				case XRD_NOTIFICATIONS_ENABLED:
+					if(temp_service->modified_attributes & MODATTR_NOTIFICATIONS_ENABLED)
+						temp_service->notifications_enabled = (v->i > 0) ? TRUE : FALSE;
+					break;
+				case XRD_ACTIVE_CHECKS_ENABLED:
+					if(temp_service->modified_attributes & MODATTR_ACTIVE_CHECKS_ENABLED)
+						temp_service->checks_enabled = (v->i > 0) ? TRUE : FALSE;
+					break;
+				case XRD_PASSIVE_CHECKS_ENABLED:
+					if(temp_service->modified_attributes & MODATTR_PASSIVE_CHECKS_ENABLED)
+						temp_service->accept_passive_checks = (v->i > 0) ? TRUE : FALSE;
+					break;
+				case XRD_EVENT_HANDLER_ENABLED:
+					if(temp_service->modified_attributes & MODATTR_EVENT_HANDLER_ENABLED)
+						temp_service->event_handler_enabled = (v->i > 0) ? TRUE : FALSE;
+					break;
+				case XRD_FLAP_DETECTION_ENABLED:
+					if(temp_service->modified_attributes & MODATTR_FLAP_DETECTION_ENABLED)
+						temp_service->flap_detection_enabled = (v->i > 0) ? TRUE : FALSE;
+					break;
+				case XRD_PROCESS_PERFORMANCE_DATA:
+					if(temp_service->modified_attributes & MODATTR_PERFORMANCE_DATA_ENABLED)
+						temp_service->process_performance_data = (v->i > 0) ? TRUE : FALSE;
+					break;
+				case XRD_OBSESS:
+					if(temp_service->modified_attributes & MODATTR_OBSESSIVE_HANDLER_ENABLED)
+						temp_service->obsess = (v->i > 0) ? TRUE : FALSE;
+					break;
+				case XRD_CHECK_COMMAND:
+					if(temp_service->modified_attributes & MODATTR_CHECK_COMMAND) {
+						if(v->ok == TRUE)
+							xrd_apply_string(&temp_service->check_command, v);
+						else
+							temp_service->modified_attributes -= MODATTR_CHECK_COMMAND;
+						}
+					break;
+				case XRD_CHECK_PERIOD:
+					if(temp_service->modified_attributes & MODATTR_CHECK_TIMEPERIOD) {
+						if(v->ok == TRUE)
+							xrd_apply_string(&temp_service->check_period, v);
+						else
+							temp_service->modified_attributes -= MODATTR_CHECK_TIMEPERIOD;
+						}
+					break;
+				case XRD_NOTIFICATION_PERIOD:
+					if(temp_service->modified_attributes & MODATTR_NOTIFICATION_TIMEPERIOD) {
+						if(v->ok == TRUE)
+							xrd_apply_string(&temp_service->notification_period, v);
+						else
+							temp_service->modified_attributes -= MODATTR_NOTIFICATION_TIMEPERIOD;
+						}
+					break;
+				case XRD_EVENT_HANDLER:
+					if(temp_service->modified_attributes & MODATTR_EVENT_HANDLER_COMMAND) {
+						if(v->ok == TRUE)
+							xrd_apply_string(&temp_service->event_handler, v);
+						else
+							temp_service->modified_attributes -= MODATTR_EVENT_HANDLER_COMMAND;
+						}
+					break;
+				case XRD_CHECK_INTERVAL:
+					if(temp_service->modified_attributes & MODATTR_NORMAL_CHECK_INTERVAL && v->d >= 0)
+						temp_service->check_interval = v->d;
+					break;
+				case XRD_RETRY_INTERVAL:
+					if(temp_service->modified_attributes & MODATTR_RETRY_CHECK_INTERVAL && v->d >= 0)
+						temp_service->retry_interval = v->d;
+					break;
+				case XRD_MAX_ATTEMPTS:
+					if(temp_service->modified_attributes & MODATTR_MAX_CHECK_ATTEMPTS && v->i >= 1) {
+
+						temp_service->max_attempts = (int)v->i;
+
+						/* adjust current attempt number if in a hard state */
+						if(temp_service->state_type == HARD_STATE && temp_service->current_state != STATE_OK && temp_service->current_attempt > 1)
+							temp_service->current_attempt = temp_service->max_attempts;
+						}
+					break;
+				case XRD_CUSTOM_VARIABLE:
+					if(temp_service->modified_attributes & MODATTR_CUSTOM_VARIABLE)
+						xrd_apply_custom_variable(v);
+					break;
+				default:
+					break;
+				}
+			}
+		}
+
+	xrddefault_finish_service(temp_service, was_flapping);
+	}
+
+
+static void xrd_apply_contact(struct xrd_entry *e) {
+	contact *temp_contact = e->object;
+	struct xrd_value *v;
+	unsigned int x;
+
+	for(x = 0; x < e->num_values; x++) {
+		v = &e->values[x];
+
+		switch(v->key) {
+			case XRD_MODIFIED_ATTRIBUTES:
+				temp_contact->modified_attributes = (unsigned long)v->i;
+				continue;
+			case XRD_MODIFIED_HOST_ATTRIBUTES:
+				temp_contact->modified_host_attributes = (unsigned long)v->i & ~retained_contact_host_attribute_mask;
+				continue;
+			case XRD_MODIFIED_SERVICE_ATTRIBUTES:
+				temp_contact->modified_service_attributes = (unsigned long)v->i & ~retained_contact_service_attribute_mask;
+				continue;
+			default:
+				break;
+			}
+
+		if(temp_contact->retain_status_information == TRUE) {
+			if(v->key == XRD_LAST_HOST_NOTIFICATION)
+				temp_contact->last_host_notification = (time_t)v->i;
+			else if(v->key == XRD_LAST_SERVICE_NOTIFICATION)
+				temp_contact->last_service_notification = (time_t)v->i;
+			}
+
+		if(temp_contact->retain_nonstatus_information == TRUE) {
+			switch(v->key) {
+				case XRD_HOST_NOTIFICATION_PERIOD:
+					if(temp_contact->modified_host_attributes & MODATTR_NOTIFICATION_TIMEPERIOD) {
+						if(v->ok == TRUE)
+							xrd_apply_string(&temp_contact->host_notification_period, v);
+						else
+							temp_contact->modified_host_attributes -= MODATTR_NOTIFICATION_TIMEPERIOD;
+						}
+					break;
+				case XRD_SERVICE_NOTIFICATION_PERIOD:
+					if(temp_contact->modified_service_attributes & MODATTR_NOTIFICATION_TIMEPERIOD) {
+						if(v->ok == TRUE)
+							xrd_apply_string(&temp_contact->service_notification_period, v);
+						else
+							temp_contact->modified_service_attributes -= MODATTR_NOTIFICATION_TIMEPERIOD;
+						}
+					break;
+				case XRD_HOST_NOTIFICATIONS_ENABLED:
+					if(temp_contact->modified_host_attributes & MODATTR_NOTIFICATIONS_ENABLED)
+						temp_contact->host_notifications_enabled = (v->i > 0) ? TRUE : FALSE;
+					break;
+				case XRD_SERVICE_NOTIFICATIONS_ENABLED:
+					if(temp_contact->modified_service_attributes & MODATTR_NOTIFICATIONS_ENABLED)
+						temp_contact->service_notifications_enabled = (v->i > 0) ? TRUE : FALSE;
+					break;
+				case XRD_CUSTOM_VARIABLE:
+					if(temp_contact->modified_attributes & MODATTR_CUSTOM_VARIABLE)
+						xrd_apply_custom_variable(v);
+					break;
+				default:
+					break;
+				}
+			}
+		}
+
+	xrddefault_finish_contact(temp_contact);
+	}
+
+
+/* adds a retained comment or downtime */
+static void xrd_apply_comment_or_downtime(struct xrd_entry *e) {
+	char *host_name = NULL, *service_description = NULL, *author = NULL, *comment_data = NULL;
+	unsigned long comment_id = 0, downtime_id = 0, triggered_by = 0, duration = 0;
+	time_t entry_time = 0, expire_time = 0, start_time = 0, flex_downtime_start = 0, end_time = 0;
+	int entry_type = USER_COMMENT, source = COMMENTSOURCE_INTERNAL;
+	int persistent = FALSE, expires = FALSE, fixed = FALSE;
+	int is_in_effect = FALSE, start_notification_sent = FALSE;
+	struct xrd_value *v;
+	unsigned int x;
+
+	for(x = 0; x < e->num_values; x++) {
+		v = &e->values[x];
+		switch(v->key) {
+			case XRD_HOST_NAME:
+				host_name = (char *)v->s;
+				break;
+			case XRD_SERVICE_DESCRIPTION:
+				service_description = (char *)v->s;
+				break;
+			case XRD_AUTHOR:
+				author = (char *)v->s;
+				break;
+			case XRD_COMMENT_DATA:
+				comment_data = (char *)v->s;
+				break;
+			case XRD_ENTRY_TYPE:
+				entry_type = (int)v->i;
+				break;
+			case XRD_COMMENT_ID:
+				comment_id = (unsigned long)v->i;
+				break;
+			case XRD_SOURCE:
+				source = (int)v->i;
+				break;
+			case XRD_PERSISTENT:
+				persistent = (v->i > 0) ? TRUE : FALSE;
+				break;
+			case XRD_ENTRY_TIME:
+				entry_time = (time_t)v->i;
+				break;
+			case XRD_EXPIRES:
+				expires = (v->i > 0) ? TRUE : FALSE;
+				break;
+			case XRD_EXPIRE_TIME:
+				expire_time = (time_t)v->i;
+				break;
+			case XRD_DOWNTIME_ID:
+				downtime_id = (unsigned long)v->i;
+				break;
+			case XRD_START_TIME:
+				start_time = (time_t)v->i;
+				break;
+			case XRD_FLEX_DOWNTIME_START:
+				flex_downtime_start = (time_t)v->i;
+				break;
+			case XRD_END_TIME:
+				end_time = (time_t)v->i;
+				break;
+			case XRD_TRIGGERED_BY:
+				triggered_by = (unsigned long)v->i;
+				break;
+			case XRD_FIXED:
+				fixed = (v->i > 0) ? TRUE : FALSE;
+				break;
+			case XRD_DURATION:
+				duration = (unsigned long)v->i;
+				break;
+			case XRD_IS_IN_EFFECT:
+				is_in_effect = (v->i > 0) ? TRUE : FALSE;
+				break;
+			case XRD_START_NOTIFICATION_SENT:
+				start_notification_sent = (v->i > 0) ? TRUE : FALSE;
+				break;
+			default:
+				break;
+			}
+		}
+
+	switch(e->rec->type) {
+
+		case XRDDEFAULT_HOSTCOMMENT_DATA:
+			xrddefault_add_comment(HOST_COMMENT, entry_type, host_name, NULL, entry_time, author, comment_data, comment_id, persistent, expires, expire_time, source);
+			break;
+
+		case XRDDEFAULT_SERVICECOMMENT_DATA:
+			xrddefault_add_comment(SERVICE_COMMENT, entry_type, host_name, service_description, entry_time, author, comment_data, comment_id, persistent, expires, expire_time, source);
+			break;
+
+		case XRDDEFAULT_HOSTDOWNTIME_DATA:
+			add_host_downtime(host_name, entry_time, author, comment_data, start_time, flex_downtime_start, end_time, fixed, triggered_by, duration, downtime_id, is_in_effect, start_notification_sent);
+			register_downtime(HOST_DOWNTIME, downtime_id);
+			break;
+
+		case XRDDEFAULT_SERVICEDOWNTIME_DATA:
+			add_service_downtime(host_name, service_description, entry_time, author, comment_data, start_time, flex_downtime_start, end_time, fixed, triggered_by, duration, downtime_id, is_in_effect, start_notification_sent);
+			register_downtime(SERVICE_DOWNTIME, downtime_id);
+			break;
+
+		default:
+			break;
+		}
+	}
+
+
+/*
+ * Reads a binary retention file. Records are decoded in parallel
+ * chunks, then applied to the objects in file order by the main
+ * thread. Sets *is_binary to FALSE, and does nothing else, if the
+ * retention file isn't a binary one.
+ */
+static int xrddefault_read_binary_state_information(int *is_binary) {
+	struct xrd_binary_header hdr;
+	struct xrd_value *values = NULL;
+	struct xrd_entry *e;
+	struct stat st;
+	char *map = NULL;
+	size_t offset, num_values = 0;
+	time_t current_time;
+	struct timeval tv[3];
+	double runtime[3];
+	int scheduling_info_is_ok = FALSE;
+	unsigned int x, corrupt = 0;
+	int result = OK;
+	int fd;
+
+	*is_binary = FALSE;
+
+	if((fd = open(retention_file, O_RDONLY)) < 0)
+		return ERROR;
+	if(fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(hdr) || read(fd, &hdr, sizeof(hdr)) != sizeof(hdr) || hdr.magic != XRD_BINARY_MAGIC) {
+		close(fd);
+		return OK;
+		}
+	*is_binary = TRUE;
+
+	if(hdr.version > XRD_BINARY_VERSION || hdr.header_size < sizeof(hdr) || hdr.header_size + hdr.records_size != (uint64_t)st.st_size || hdr.num_records > hdr.records_size / sizeof(struct xrd_record)) {
+		close(fd);
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Retention file '%s' is %s!\n", retention_file, (hdr.version > XRD_BINARY_VERSION) ? "from a newer version of Nagios" : "truncated or corrupt");
+		return ERROR;
+		}
+
+	if(test_scheduling == TRUE)
+		gettimeofday(&tv[0], NULL);
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED) {
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Unable to map retention file '%s': %s\n", retention_file, strerror(errno));
+		return ERROR;
+		}
+
+	/* find all the records, so the threads can split them up between them */
+	memset(&xrd_load, 0, sizeof(xrd_load));
+	if((xrd_load.entries = calloc(hdr.num_records ? hdr.num_records : 1, sizeof(struct xrd_entry))) == NULL)
+		result = ERROR;
+	for(offset = hdr.header_size; result == OK && xrd_load.num_entries < hdr.num_records; xrd_load.num_entries++) {
+		e = &xrd_load.entries[xrd_load.num_entries];
+		e->rec = (const struct xrd_record *)(map + offset);
+		if(st.st_size - offset < sizeof(struct xrd_record) || e->rec->size < sizeof(struct xrd_record) || e->rec->size % 8 || e->rec->size > st.st_size - offset) {
+			logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Retention file '%s' is truncated or corrupt!\n", retention_file);
+			result = ERROR;
+			break;
+			}
+		offset += e->rec->size;
+		num_values += e->rec->fields;
+		}
+	if(result == OK && (values = calloc(num_values ? num_values : 1, sizeof(struct xrd_value))) == NULL)
+		result = ERROR;
+
+	if(result == OK) {
+
+		for(num_values = 0, x = 0; x < xrd_load.num_entries; x++) {
+			xrd_load.entries[x].values = values + num_values;
+			num_values += xrd_load.entries[x].rec->fields;
+			}
+
+		xrd_decode_all();
+
+		if(test_scheduling == TRUE)
+			gettimeofday(&tv[1], NULL);
+
+		/* scheduling info is only any good if we weren't stopped for too long */
+		time(&current_time);
+		if(current_time - (time_t)hdr.created < retention_scheduling_horizon)
+			scheduling_info_is_ok = TRUE;
+		last_program_stop = (time_t)hdr.created;
+
+		/* Big speedup when reading retention.dat in bulk */
+		defer_downtime_sorting = 1;
+		defer_comment_sorting = 1;
+
+		/* apply everything in a single pass, in the order it was saved */
+		for(x = 0; x < xrd_load.num_entries; x++) {
+
+			e = &xrd_load.entries[x];
+			if(e->error == TRUE) {
+				corrupt++;
+				continue;
+				}
+
+			switch(e->rec->type) {
+				case XRDDEFAULT_INFO_DATA:
+					xrd_apply_info(e);
+					break;
+				case XRDDEFAULT_PROGRAMSTATUS_DATA:
+					xrd_apply_program(e);
+					break;
+				case XRDDEFAULT_HOSTSTATUS_DATA:
+					if(e->object != NULL)
+						xrd_apply_host(e, scheduling_info_is_ok);
+					break;
+				case XRDDEFAULT_SERVICESTATUS_DATA:
+					if(e->object != NULL)
+						xrd_apply_service(e, scheduling_info_is_ok);
+					break;
+				case XRDDEFAULT_CONTACTSTATUS_DATA:
+					if(e->object != NULL)
+						xrd_apply_contact(e);
+					break;
+				case XRDDEFAULT_HOSTCOMMENT_DATA:
+				case XRDDEFAULT_SERVICECOMMENT_DATA:
+				case XRDDEFAULT_HOSTDOWNTIME_DATA:
+				case XRDDEFAULT_SERVICEDOWNTIME_DATA:
+					xrd_apply_comment_or_downtime(e);
+					break;
+				default:
+					break;
+				}
+			}
+
+		if(corrupt > 0)
+			logit(NSLOG_RUNTIME_WARNING, TRUE, "Warning: Skipped %u corrupt records in retention file '%s'\n", corrupt, retention_file);
+
+		if(sort_downtime() != OK || sort_comments() != OK)
+			result = ERROR;
+		}
+
+	/* free memory and unmap the file */
+	my_free(values);
+	my_free(xrd_load.entries);
+	munmap(map, st.st_size);
+
+	if(test_scheduling == TRUE && result == OK) {
+		gettimeofday(&tv[2], NULL);
+
+		runtime[0] = (double)((double)(tv[1].tv_sec - tv[0].tv_sec) + (double)((tv[1].tv_usec - tv[0].tv_usec) / 1000.0) / 1000.0);
+		runtime[1] = (double)((double)(tv[2].tv_sec - tv[1].tv_sec) + (double)((tv[2].tv_usec - tv[1].tv_usec) / 1000.0) / 1000.0);
+		runtime[2] = (double)((double)(tv[2].tv_sec - tv[0].tv_sec) + (double)((tv[2].tv_usec - tv[0].tv_usec) / 1000.0) / 1000.0);
+
+		printf("RETENTION DATA TIMES\n");
+		printf("----------------------------------\n");
+		printf("Read and Decode:      %.6lf sec\n", runtime[0]);
+		printf("Apply:                %.6lf sec\n", runtime[1]);
+		printf("                      ============\n");
+		printf("TOTAL:                %.6lf sec\n", runtime[2]);
+		printf("\n\n");
+		}
+
+	return result;
+	}
@@ -23,6 +23,8 @@
 #ifndef NAGIOS_XRDDEFAULT_H_INCLUDED
 #define NAGIOS_XRDDEFAULT_H_INCLUDED
 
+#include <stdint.h>
+
 
 #define XRDDEFAULT_NO_DATA               0
 #define XRDDEFAULT_INFO_DATA             1
@@ -35,6 +37,177 @@
 #define XRDDEFAULT_HOSTDOWNTIME_DATA     8
 #define XRDDEFAULT_SERVICEDOWNTIME_DATA  9
 
+
+/*
+ * Binary retention file layout. The file is a header followed by
+ * records, one per object, comment or downtime. Each record is a
+ * struct xrd_record followed by its fields, and each field is a
+ * struct xrd_field followed by its value. Records and fields are
+ * padded to 8 bytes. Hosts, services and contacts are stored under
+ * their object id, and their names are kept in the record so they
+ * can still be found if the ids changed with the config.
+ *
+ * Field keys are never renumbered or reused, so new fields can be
+ * added without changing the schema version; readers skip keys they
+ * don't know. The schema version only changes if the layout does.
+ */
+#define XRD_BINARY_MAGIC    0x5244524e  /* "NRDR", little-endian */
+#define XRD_BINARY_VERSION  1
+
+struct xrd_binary_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t header_size;
+	uint32_t num_records;
+	uint64_t records_size;
+	int64_t created;
+	};
+
+struct xrd_record {
+	uint16_t type;      /* XRDDEFAULT_*_DATA */
+	uint16_t fields;
+	uint32_t size;      /* including this header and padding */
+	uint32_t id;        /* object id for hosts, services and contacts */
+	uint32_t reserved;
+	};
+
+#define XRD_INT   1     /* int64_t */
+#define XRD_DBL   2     /* double */
+#define XRD_STR   3     /* nul-terminated string */
+#define XRD_HIST  4     /* int32_t[MAX_STATE_HISTORY_ENTRIES], oldest first */
+#define XRD_CVAR  5     /* int32_t has_been_modified, then name and value strings */
+
+struct xrd_field {
+	uint16_t key;
+	uint16_t kind;
+	uint32_t len;       /* of the value, without padding */
+	};
+
+/*
+ * Every key has an explicit value, as the values are what's stored in
+ * the file. New keys take the next unused value; retired keys stay
+ * here as comments so their values aren't handed out again.
+ */
+enum xrd_key {
+	/* info */
+	XRD_VERSION = 1,
+	XRD_LAST_UPDATE_CHECK = 2,
+	XRD_UPDATE_AVAILABLE = 3,
+	XRD_UPDATE_UID = 4,
+	XRD_LAST_VERSION = 5,
+	XRD_NEW_VERSION = 6,
+
+	/* program */
+	XRD_MODIFIED_HOST_PROCESS_ATTRIBUTES = 7,
+	XRD_MODIFIED_SERVICE_PROCESS_ATTRIBUTES = 8,
+	XRD_ENABLE_NOTIFICATIONS = 9,
+	XRD_ACTIVE_SERVICE_CHECKS_ENABLED = 10,
+	XRD_PASSIVE_SERVICE_CHECKS_ENABLED = 11,
+	XRD_ACTIVE_HOST_CHECKS_ENABLED = 12,
+	XRD_PASSIVE_HOST_CHECKS_ENABLED = 13,
+	XRD_ENABLE_EVENT_HANDLERS = 14,
+	XRD_OBSESS_OVER_SERVICES = 15,
+	XRD_OBSESS_OVER_HOSTS = 16,
+	XRD_CHECK_SERVICE_FRESHNESS = 17,
+	XRD_CHECK_HOST_FRESHNESS = 18,
+	XRD_ENABLE_FLAP_DETECTION = 19,
+	XRD_PROCESS_PERFORMANCE_DATA_GLOBAL = 20,
+	XRD_GLOBAL_HOST_EVENT_HANDLER = 21,
+	XRD_GLOBAL_SERVICE_EVENT_HANDLER = 22,
+	XRD_NEXT_COMMENT_ID = 23,
+	XRD_NEXT_DOWNTIME_ID = 24,
+	XRD_NEXT_EVENT_ID = 25,
+	XRD_NEXT_PROBLEM_ID = 26,
+	XRD_NEXT_NOTIFICATION_ID = 27,
+
+	/* hosts, services and contacts */
+	XRD_HOST_NAME = 28,
+	XRD_SERVICE_DESCRIPTION = 29,
+	XRD_CONTACT_NAME = 30,
+	XRD_MODIFIED_ATTRIBUTES = 31,
+	XRD_CHECK_COMMAND = 32,
+	XRD_CHECK_PERIOD = 33,
+	XRD_NOTIFICATION_PERIOD = 34,
+	XRD_EVENT_HANDLER = 35,
+	XRD_HAS_BEEN_CHECKED = 36,
+	XRD_CHECK_EXECUTION_TIME = 37,
+	XRD_CHECK_LATENCY = 38,
+	XRD_CHECK_TYPE = 39,
+	XRD_CURRENT_STATE = 40,
+	XRD_LAST_STATE = 41,
+	XRD_LAST_HARD_STATE = 42,
+	XRD_LAST_EVENT_ID = 43,
+	XRD_CURRENT_EVENT_ID = 44,
+	XRD_CURRENT_PROBLEM_ID = 45,
+	XRD_LAST_PROBLEM_ID = 46,
+	XRD_PLUGIN_OUTPUT = 47,
+	XRD_LONG_PLUGIN_OUTPUT = 48,
+	XRD_PERFORMANCE_DATA = 49,
+	XRD_LAST_CHECK = 50,
+	XRD_NEXT_CHECK = 51,
+	XRD_CHECK_OPTIONS = 52,
+	XRD_CURRENT_ATTEMPT = 53,
+	XRD_MAX_ATTEMPTS = 54,
+	XRD_CHECK_INTERVAL = 55,
+	XRD_RETRY_INTERVAL = 56,
+	XRD_STATE_TYPE = 57,
+	XRD_LAST_STATE_CHANGE = 58,
+	XRD_LAST_HARD_STATE_CHANGE = 59,
+	XRD_LAST_TIME_UP = 60,
+	XRD_LAST_TIME_DOWN = 61,
+	XRD_LAST_TIME_UNREACHABLE = 62,
+	XRD_LAST_TIME_OK = 63,
+	XRD_LAST_TIME_WARNING = 64,
+	XRD_LAST_TIME_UNKNOWN = 65,
+	XRD_LAST_TIME_CRITICAL = 66,
+	XRD_NOTIFIED_ON = 67,
+	XRD_LAST_NOTIFICATION = 68,
+	XRD_CURRENT_NOTIFICATION_NUMBER = 69,
+	XRD_CURRENT_NOTIFICATION_ID = 70,
+	XRD_NOTIFICATIONS_ENABLED = 71,
+	XRD_PROBLEM_HAS_BEEN_ACKNOWLEDGED = 72,
+	XRD_ACKNOWLEDGEMENT_TYPE = 73,
+	XRD_ACTIVE_CHECKS_ENABLED = 74,
+	XRD_PASSIVE_CHECKS_ENABLED = 75,
+	XRD_EVENT_HANDLER_ENABLED = 76,
+	XRD_FLAP_DETECTION_ENABLED = 77,
+	XRD_PROCESS_PERFORMANCE_DATA = 78,
+	XRD_OBSESS = 79,
+	XRD_IS_FLAPPING = 80,
+	XRD_PERCENT_STATE_CHANGE = 81,
+	XRD_CHECK_FLAPPING_RECOVERY_NOTIFICATION = 82,
+	XRD_STATE_HISTORY = 83,
+	XRD_CUSTOM_VARIABLE = 84,
+	XRD_MODIFIED_HOST_ATTRIBUTES = 85,
+	XRD_MODIFIED_SERVICE_ATTRIBUTES = 86,
+	XRD_HOST_NOTIFICATION_PERIOD = 87,
+	XRD_SERVICE_NOTIFICATION_PERIOD = 88,
+	XRD_LAST_HOST_NOTIFICATION = 89,
+	XRD_LAST_SERVICE_NOTIFICATION = 90,
+	XRD_HOST_NOTIFICATIONS_ENABLED = 91,
+	XRD_SERVICE_NOTIFICATIONS_ENABLED = 92,
+
+	/* comments and downtime */
+	XRD_ENTRY_TYPE = 93,
+	XRD_COMMENT_ID = 94,
+	XRD_SOURCE = 95,
+	XRD_PERSISTENT = 96,
+	XRD_ENTRY_TIME = 97,
+	XRD_EXPIRES = 98,
+	XRD_EXPIRE_TIME = 99,
+	XRD_AUTHOR = 100,
+	XRD_COMMENT_DATA = 101,
+	XRD_DOWNTIME_ID = 102,
+	XRD_START_TIME = 103,
+	XRD_FLEX_DOWNTIME_START = 104,
+	XRD_END_TIME = 105,
+	XRD_TRIGGERED_BY = 106,
+	XRD_FIXED = 107,
+	XRD_DURATION = 108,
+	XRD_IS_IN_EFFECT = 109,
+	XRD_START_NOTIFICATION_SENT = 110,
+	};
+
 int xrddefault_initialize_retention_data(const char *);
 int xrddefault_cleanup_retention_data(void);
 int xrddefault_save_state_information(void);        /* saves all host and service state information */
@@ -33,6 +33,8 @@
 #include "xsddefault.h"
 
 #ifdef NSCORE
+#include <pthread.h>
+#include <signal.h>
 #include "../include/nagios.h"
 #endif
 
@@ -64,6 +66,12 @@ int program_stats[MAX_CHECK_STATS_TYPES][3];
 /********************* INIT/CLEANUP FUNCTIONS *********************/
 /******************************************************************/
 
+static int reap_status_writer(int);
+static void free_status_snapshot(void);
+static int open_status_store(void);
+static void close_status_store(void);
+static void sync_status_store(int);
+
 
 /* initialize status data */
 int xsddefault_initialize_status_data(const char *cfgfile) {
@@ -83,10 +91,27 @@ int xsddefault_initialize_status_data(const char *cfgfile) {
 	if((mac->x[MACRO_STATUSDATAFILE] = (char *)strdup(status_file)))
 		strip(mac->x[MACRO_STATUSDATAFILE]);
 
+	/* a writer still busy from before a restart would put it back */
+	reap_status_writer(TRUE);
+
 	/* delete the old status log (it might not exist) */
 	if(status_file)
 		unlink(status_file);
 
+	/* build the status store for the objects we have */
+	close_status_store();
+	open_status_store();
+
+	return OK;
+	}
+
+
+/* rebuild the status store after a restart, as the objects may have changed */
+int xsddefault_reload_status_data(void) {
+
+	close_status_store();
+	open_status_store();
+
 	return OK;
 	}
 
@@ -94,7 +119,16 @@ int xsddefault_initialize_status_data(const char *cfgfile) {
 /* cleanup status data before terminating */
 int xsddefault_cleanup_status_data(int delete_status_data) {
 
-	/* delete the status log */
+	/* let the last dump finish */
+	reap_status_writer(TRUE);
+	free_status_snapshot();
+	close_status_store();
+
+	/* delete the status store and status log */
+	if(delete_status_data == TRUE && status_store_file)
+		unlink(status_store_file);
+	if(delete_status_data == TRUE && status_index_file)
+		unlink(status_index_file);
 	if(delete_status_data == TRUE && status_file) {
 		if(unlink(status_file))
 			return ERROR;
@@ -102,6 +136,8 @@ int xsddefault_cleanup_status_data(int delete_status_data) {
 
 	/* free memory */
 	my_free(status_file);
+	my_free(status_store_file);
+	my_free(status_index_file);
 
 	return OK;
 	}
@@ -111,59 +147,531 @@ int xsddefault_cleanup_status_data(int delete_status_data) {
 /****************** STATUS DATA OUTPUT FUNCTIONS ******************/
 /******************************************************************/
 
-/* write all status data to file */
-int xsddefault_save_status_data(void) {
-	char *tmp_log = NULL;
-	customvariablesmember *temp_customvariablesmember = NULL;
+/*
+ * Status data is written in two steps. The main thread copies the
+ * status fields of everything that goes into the status file into a
+ * snapshot, which is cheap, and a writer thread formats the snapshot
+ * and moves it into place, which isn't. All strings are copied into
+ * one arena, so the writer never looks at the objects, and can finish
+ * even if they're freed on a restart. The snapshot buffers are kept
+ * between dumps, so once they've grown to size nothing is allocated.
+ */
+typedef size_t sd_str; /* offset into the snapshot string arena, 0 is "" */
+
+struct sd_customvar {
+	sd_str name;
+	sd_str value;
+	int has_been_modified;
+	};
+
+struct sd_host {
+	sd_str name, check_command, check_period, notification_period, event_handler;
+	sd_str plugin_output, long_plugin_output, perf_data;
+	unsigned long modified_attributes;
+	unsigned long last_event_id, current_event_id, current_problem_id, last_problem_id;
+	unsigned long current_notification_id;
+	double check_interval, retry_interval, execution_time, latency, percent_state_change;
+	time_t last_check, next_check, last_state_change, last_hard_state_change;
+	time_t last_time_up, last_time_down, last_time_unreachable;
+	time_t last_notification, next_notification;
+	int has_been_checked, should_be_scheduled, check_type, current_state, last_hard_state;
+	int check_options, current_attempt, max_attempts, state_type;
+	int no_more_notifications, current_notification_number, notifications_enabled;
+	int problem_has_been_acknowledged, acknowledgement_type;
+	int checks_enabled, accept_passive_checks, event_handler_enabled, flap_detection_enabled;
+	int process_performance_data, obsess, is_flapping, scheduled_downtime_depth;
+	unsigned int customvars, num_customvars;
+	};
+
+struct sd_service {
+	sd_str host_name, description, check_command, check_period, notification_period, event_handler;
+	sd_str plugin_output, long_plugin_output, perf_data;
+	unsigned long modified_attributes;
+	unsigned long last_event_id, current_event_id, current_problem_id, last_problem_id;
+	unsigned long current_notification_id;
+	double check_interval, retry_interval, execution_time, latency, percent_state_change;
+	time_t last_check, next_check, last_state_change, last_hard_state_change;
+	time_t last_time_ok, last_time_warning, last_time_unknown, last_time_critical;
+	time_t last_notification, next_notification;
+	int has_been_checked, should_be_scheduled, check_type, current_state, last_hard_state;
+	int check_options, current_attempt, max_attempts, state_type;
+	int no_more_notifications, current_notification_number, notifications_enabled;
+	int problem_has_been_acknowledged, acknowledgement_type;
+	int checks_enabled, accept_passive_checks, event_handler_enabled, flap_detection_enabled;
+	int process_performance_data, obsess, is_flapping, scheduled_downtime_depth;
+	unsigned int customvars, num_customvars;
+	};
+
+struct sd_contact {
+	sd_str name, host_notification_period, service_notification_period;
+	unsigned long modified_attributes, modified_host_attributes, modified_service_attributes;
+	time_t last_host_notification, last_service_notification;
+	int host_notifications_enabled, service_notifications_enabled;
+	unsigned int customvars, num_customvars;
+	};
+
+struct sd_comment {
+	sd_str host_name, service_description, author, comment_data;
+	unsigned long comment_id;
+	time_t entry_time, expire_time;
+	int comment_type, entry_type, source, persistent, expires;
+	};
+
+struct sd_downtime {
+	sd_str host_name, service_description, author, comment;
+	unsigned long downtime_id, comment_id, triggered_by, duration;
+	time_t entry_time, start_time, flex_downtime_start, end_time;
+	int type, fixed, is_in_effect, start_notification_sent;
+	};
+
+struct sd_array {
+	void *items;
+	unsigned int len, size;
+	};
+
+static struct status_snapshot {
+	time_t created;
+	sd_str status_file, temp_file, index_file;
+
+	/* info and program status */
+	time_t last_update_check, program_start, last_log_rotation;
+	int update_available;
+	sd_str last_version, new_version;
+	unsigned long modified_host_attributes, modified_service_attributes;
+	int nagios_pid, daemon_mode;
+	int enable_notifications, execute_service_checks, accept_passive_service_checks;
+	int execute_host_checks, accept_passive_host_checks, enable_event_handlers;
+	int obsess_over_services, obsess_over_hosts, check_service_freshness, check_host_freshness;
+	int enable_flap_detection, process_performance_data;
+	sd_str global_host_event_handler, global_service_event_handler;
+	unsigned long next_comment_id, next_downtime_id, next_event_id, next_problem_id, next_notification_id;
+	int check_stats[MAX_CHECK_STATS_TYPES][3];
+
+	struct sd_array hosts, services, contacts, comments, downtimes, customvars;
+
+	char *strings;
+	size_t strings_len, strings_size;
+
+	/* set by the writer for the main thread to log */
+	char *tmp_log;
+	char *tmp_index;
+	int error;
+	int copy_pending;
+	char error_msg[1024];
+	} snapshot;
+
+static struct {
+	pthread_t tid;
+	pthread_mutex_t lock;
+	int running; /* a writer has been started and not yet reaped */
+	int done;    /* the writer is done with the snapshot */
+	} status_writer = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+#define SD(off) (snapshot.strings + (off))
+
+
+/* copies a string into the snapshot arena */
+static sd_str sd_strdup(const char *str) {
+	size_t len;
+	sd_str off;
+
+	if(str == NULL || *str == 0)
+		return 0;
+
+	len = strlen(str) + 1;
+	if(snapshot.strings_len + len > snapshot.strings_size) {
+		size_t size = snapshot.strings_size ? snapshot.strings_size : 64 * 1024;
+		char *strings;
+
+		while(size < snapshot.strings_len + len)
+			size *= 2;
+		if((strings = realloc(snapshot.strings, size)) == NULL) {
+			snapshot.error = TRUE;
+			return 0;
+			}
+		snapshot.strings = strings;
+		snapshot.strings_size = size;
+		}
+
+	off = snapshot.strings_len;
+	memcpy(snapshot.strings + off, str, len);
+	snapshot.strings_len += len;
+	return off;
+	}
+
+
+/* returns the next free slot of a snapshot array, or NULL if it can't grow */
+static void *sd_next(struct sd_array *a, size_t item_size) {
+
+	if(a->len >= a->size) {
+		unsigned int size = a->size ? a->size * 2 : 256;
+		void *items;
+
+		if((items = realloc(a->items, size * item_size)) == NULL) {
+			snapshot.error = TRUE;
+			return NULL;
+			}
+		a->items = items;
+		a->size = size;
+		}
+
+	return (char *)a->items + item_size * a->len++;
+	}
+
+
+static unsigned int sd_copy_customvars(customvariablesmember *cvm, unsigned int *first) {
+	struct sd_customvar *cv;
+	unsigned int num = 0;
+
+	*first = snapshot.customvars.len;
+	for(; cvm != NULL; cvm = cvm->next) {
+		if(cvm->variable_name == NULL)
+			continue;
+		if((cv = sd_next(&snapshot.customvars, sizeof(*cv))) == NULL)
+			break;
+		cv->name = sd_strdup(cvm->variable_name);
+		cv->value = sd_strdup(cvm->variable_value);
+		cv->has_been_modified = cvm->has_been_modified;
+		num++;
+		}
+
+	return num;
+	}
+
+
+/* copies everything that goes into the status file - runs on the main thread */
+static int take_status_snapshot(void) {
 	host *temp_host = NULL;
 	service *temp_service = NULL;
 	contact *temp_contact = NULL;
 	nagios_comment *temp_comment = NULL;
 	scheduled_downtime *temp_downtime = NULL;
-	time_t current_time;
-	int fd = 0;
-	FILE *fp = NULL;
-	int result = OK;
+	struct sd_host *h;
+	struct sd_service *s;
+	struct sd_contact *c;
+	struct sd_comment *cm;
+	struct sd_downtime *dt;
+	int x;
+
+	snapshot.hosts.len = snapshot.services.len = snapshot.contacts.len = 0;
+	snapshot.comments.len = snapshot.downtimes.len = snapshot.customvars.len = 0;
+	snapshot.strings_len = 0;
+	snapshot.error = FALSE;
+	snapshot.copy_pending = FALSE;
+	*snapshot.error_msg = 0;
+
+	/* offset 0 is the empty string */
+	if(snapshot.strings == NULL && (snapshot.strings = malloc(64 * 1024)) != NULL)
+		snapshot.strings_size = 64 * 1024;
+	if(snapshot.strings == NULL)
+		return ERROR;
+	*snapshot.strings = 0;
+	snapshot.strings_len = 1;
 
-	log_debug_info(DEBUGL_FUNCTIONS, 0, "save_status_data()\n");
+	time(&snapshot.created);
+	snapshot.status_file = sd_strdup(status_file);
+	snapshot.temp_file = sd_strdup(temp_file);
+	snapshot.index_file = sd_strdup(status_index_file);
 
-	/* users may not want us to write status data */
-	if(!status_file || !strcmp(status_file, "/dev/null"))
-		return OK;
+	/* generate check statistics */
+	generate_check_stats();
 
-	asprintf(&tmp_log, "%sXXXXXX", temp_file);
-	if(tmp_log == NULL)
-		return ERROR;
+	snapshot.last_update_check = last_update_check;
+	snapshot.update_available = update_available;
+	snapshot.last_version = sd_strdup(last_program_version);
+	snapshot.new_version = sd_strdup(new_program_version);
+
+	snapshot.modified_host_attributes = modified_host_process_attributes;
+	snapshot.modified_service_attributes = modified_service_process_attributes;
+	snapshot.nagios_pid = nagios_pid;
+	snapshot.daemon_mode = daemon_mode;
+	snapshot.program_start = program_start;
+	snapshot.last_log_rotation = last_log_rotation;
+	snapshot.enable_notifications = enable_notifications;
+	snapshot.execute_service_checks = execute_service_checks;
+	snapshot.accept_passive_service_checks = accept_passive_service_checks;
+	snapshot.execute_host_checks = execute_host_checks;
+	snapshot.accept_passive_host_checks = accept_passive_host_checks;
+	snapshot.enable_event_handlers = enable_event_handlers;
+	snapshot.obsess_over_services = obsess_over_services;
+	snapshot.obsess_over_hosts = obsess_over_hosts;
+	snapshot.check_service_freshness = check_service_freshness;
+	snapshot.check_host_freshness = check_host_freshness;
+	snapshot.enable_flap_detection = enable_flap_detection;
+	snapshot.process_performance_data = process_performance_data;
+	snapshot.global_host_event_handler = sd_strdup(global_host_event_handler);
+	snapshot.global_service_event_handler = sd_strdup(global_service_event_handler);
+	snapshot.next_comment_id = next_comment_id;
+	snapshot.next_downtime_id = next_downtime_id;
+	snapshot.next_event_id = next_event_id;
+	snapshot.next_problem_id = next_problem_id;
+	snapshot.next_notification_id = next_notification_id;
+	for(x = 0; x < MAX_CHECK_STATS_TYPES; x++) {
+		snapshot.check_stats[x][0] = check_statistics[x].minute_stats[0];
+		snapshot.check_stats[x][1] = check_statistics[x].minute_stats[1];
+		snapshot.check_stats[x][2] = check_statistics[x].minute_stats[2];
+		}
 
-	log_debug_info(DEBUGL_STATUSDATA, 2, "Writing status data to temp file '%s'\n", tmp_log);
+	for(temp_host = host_list; temp_host != NULL; temp_host = temp_host->next) {
+		if((h = sd_next(&snapshot.hosts, sizeof(*h))) == NULL)
+			return ERROR;
+		h->name = sd_strdup(temp_host->name);
+		h->modified_attributes = temp_host->modified_attributes;
+		h->check_command = sd_strdup(temp_host->check_command);
+		h->check_period = sd_strdup(temp_host->check_period);
+		h->notification_period = sd_strdup(temp_host->notification_period);
+		h->check_interval = temp_host->check_interval;
+		h->retry_interval = temp_host->retry_interval;
+		h->event_handler = sd_strdup(temp_host->event_handler);
+		h->has_been_checked = temp_host->has_been_checked;
+		h->should_be_scheduled = temp_host->should_be_scheduled;
+		h->execution_time = temp_host->execution_time;
+		h->latency = temp_host->latency;
+		h->check_type = temp_host->check_type;
+		h->current_state = temp_host->current_state;
+		h->last_hard_state = temp_host->last_hard_state;
+		h->last_event_id = temp_host->last_event_id;
+		h->current_event_id = temp_host->current_event_id;
+		h->current_problem_id = temp_host->current_problem_id;
+		h->last_problem_id = temp_host->last_problem_id;
+		h->plugin_output = sd_strdup(temp_host->plugin_output);
+		h->long_plugin_output = sd_strdup(temp_host->long_plugin_output);
+		h->perf_data = sd_strdup(temp_host->perf_data);
+		h->last_check = temp_host->last_check;
+		h->next_check = temp_host->next_check;
+		h->check_options = temp_host->check_options;
+		h->current_attempt = temp_host->current_attempt;
+		h->max_attempts = temp_host->max_attempts;
+		h->state_type = temp_host->state_type;
+		h->last_state_change = temp_host->last_state_change;
+		h->last_hard_state_change = temp_host->last_hard_state_change;
+		h->last_time_up = temp_host->last_time_up;
+		h->last_time_down = temp_host->last_time_down;
+		h->last_time_unreachable = temp_host->last_time_unreachable;
+		h->last_notification = temp_host->last_notification;
+		h->next_notification = temp_host->next_notification;
+		h->no_more_notifications = temp_host->no_more_notifications;
+		h->current_notification_number = temp_host->current_notification_number;
+		h->current_notification_id = temp_host->current_notification_id;
+		h->notifications_enabled = temp_host->notifications_enabled;
+		h->problem_has_been_acknowledged = temp_host->problem_has_been_acknowledged;
+		h->acknowledgement_type = temp_host->acknowledgement_type;
+		h->checks_enabled = temp_host->checks_enabled;
+		h->accept_passive_checks = temp_host->accept_passive_checks;
+		h->event_handler_enabled = temp_host->event_handler_enabled;
+		h->flap_detection_enabled = temp_host->flap_detection_enabled;
+		h->process_performance_data = temp_host->process_performance_data;
+		h->obsess = temp_host->obsess;
+		h->is_flapping = temp_host->is_flapping;
+		h->percent_state_change = temp_host->percent_state_change;
+		h->scheduled_downtime_depth = temp_host->scheduled_downtime_depth;
+		h->num_customvars = sd_copy_customvars(temp_host->custom_variables, &h->customvars);
+		}
 
-	if((fd = mkstemp(tmp_log)) == -1) {
+	for(temp_service = service_list; temp_service != NULL; temp_service = temp_service->next) {
+		if((s = sd_next(&snapshot.services, sizeof(*s))) == NULL)
+			return ERROR;
+		s->host_name = sd_strdup(temp_service->host_name);
+		s->description = sd_strdup(temp_service->description);
+		s->modified_attributes = temp_service->modified_attributes;
+		s->check_command = sd_strdup(temp_service->check_command);
+		s->check_period = sd_strdup(temp_service->check_period);
+		s->notification_period = sd_strdup(temp_service->notification_period);
+		s->check_interval = temp_service->check_interval;
+		s->retry_interval = temp_service->retry_interval;
+		s->event_handler = sd_strdup(temp_service->event_handler);
+		s->has_been_checked = temp_service->has_been_checked;
+		s->should_be_scheduled = temp_service->should_be_scheduled;
+		s->execution_time = temp_service->execution_time;
+		s->latency = temp_service->latency;
+		s->check_type = temp_service->check_type;
+		s->current_state = temp_service->current_state;
+		s->last_hard_state = temp_service->last_hard_state;
+		s->last_event_id = temp_service->last_event_id;
+		s->current_event_id = temp_service->current_event_id;
+		s->current_problem_id = temp_service->current_problem_id;
+		s->last_problem_id = temp_service->last_problem_id;
+		s->current_attempt = temp_service->current_attempt;
+		s->max_attempts = temp_service->max_attempts;
+		s->state_type = temp_service->state_type;
+		s->last_state_change = temp_service->last_state_change;
+		s->last_hard_state_change = temp_service->last_hard_state_change;
+		s->last_time_ok = temp_service->last_time_ok;
+		s->last_time_warning = temp_service->last_time_warning;
+		s->last_time_unknown = temp_service->last_time_unknown;
+		s->last_time_critical = temp_service->last_time_critical;
+		s->plugin_output = sd_strdup(temp_service->plugin_output);
+		s->long_plugin_output = sd_strdup(temp_service->long_plugin_output);
+		s->perf_data = sd_strdup(temp_service->perf_data);
+		s->last_check = temp_service->last_check;
+		s->next_check = temp_service->next_check;
+		s->check_options = temp_service->check_options;
+		s->current_notification_number = temp_service->current_notification_number;
+		s->current_notification_id = temp_service->current_notification_id;
+		s->last_notification = temp_service->last_notification;
+		s->next_notification = temp_service->next_notification;
+		s->no_more_notifications = temp_service->no_more_notifications;
+		s->notifications_enabled = temp_service->notifications_enabled;
+		s->checks_enabled = temp_service->checks_enabled;
+		s->accept_passive_checks = temp_service->accept_passive_checks;
+		s->event_handler_enabled = temp_service->event_handler_enabled;
+		s->problem_has_been_acknowledged = temp_service->problem_has_been_acknowledged;
+		s->acknowledgement_type = temp_service->acknowledgement_type;
+		s->flap_detection_enabled = temp_service->flap_detection_enabled;
+		s->process_performance_data = temp_service->process_performance_data;
+		s->obsess = temp_service->obsess;
+		s->is_flapping = temp_service->is_flapping;
+		s->percent_state_change = temp_service->percent_state_change;
+		s->scheduled_downtime_depth = temp_service->scheduled_downtime_depth;
+		s->num_customvars = sd_copy_customvars(temp_service->custom_variables, &s->customvars);
+		}
 
-		/* log an error */
-		logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Unable to create temp file '%s' for writing status data: %s\n", tmp_log, strerror(errno));
+	for(temp_contact = contact_list; temp_contact != NULL; temp_contact = temp_contact->next) {
+		if((c = sd_next(&snapshot.contacts, sizeof(*c))) == NULL)
+			return ERROR;
+		c->name = sd_strdup(temp_contact->name);
+		c->modified_attributes = temp_contact->modified_attributes;
+		c->modified_host_attributes = temp_contact->modified_host_attributes;
+		c->modified_service_attributes = temp_contact->modified_service_attributes;
+		c->host_notification_period = sd_strdup(temp_contact->host_notification_period);
+		c->service_notification_period = sd_strdup(temp_contact->service_notification_period);
+		c->last_host_notification = temp_contact->last_host_notification;
+		c->last_service_notification = temp_contact->last_service_notification;
+		c->host_notifications_enabled = temp_contact->host_notifications_enabled;
+		c->service_notifications_enabled = temp_contact->service_notifications_enabled;
+		c->num_customvars = sd_copy_customvars(temp_contact->custom_variables, &c->customvars);
+		}
 
-		/* free memory */
-		my_free(tmp_log);
+	for(temp_comment = comment_list; temp_comment != NULL; temp_comment = temp_comment->next) {
+		if((cm = sd_next(&snapshot.comments, sizeof(*cm))) == NULL)
+			return ERROR;
+		cm->comment_type = temp_comment->comment_type;
+		cm->host_name = sd_strdup(temp_comment->host_name);
+		cm->service_description = sd_strdup(temp_comment->service_description);
+		cm->entry_type = temp_comment->entry_type;
+		cm->comment_id = temp_comment->comment_id;
+		cm->source = temp_comment->source;
+		cm->persistent = temp_comment->persistent;
+		cm->entry_time = temp_comment->entry_time;
+		cm->expires = temp_comment->expires;
+		cm->expire_time = temp_comment->expire_time;
+		cm->author = sd_strdup(temp_comment->author);
+		cm->comment_data = sd_strdup(temp_comment->comment_data);
+		}
 
-		return ERROR;
+	for(temp_downtime = scheduled_downtime_list; temp_downtime != NULL; temp_downtime = temp_downtime->next) {
+		if((dt = sd_next(&snapshot.downtimes, sizeof(*dt))) == NULL)
+			return ERROR;
+		dt->type = temp_downtime->type;
+		dt->host_name = sd_strdup(temp_downtime->host_name);
+		dt->service_description = sd_strdup(temp_downtime->service_description);
+		dt->downtime_id = temp_downtime->downtime_id;
+		dt->comment_id = temp_downtime->comment_id;
+		dt->entry_time = temp_downtime->entry_time;
+		dt->start_time = temp_downtime->start_time;
+		dt->flex_downtime_start = temp_downtime->flex_downtime_start;
+		dt->end_time = temp_downtime->end_time;
+		dt->triggered_by = temp_downtime->triggered_by;
+		dt->fixed = temp_downtime->fixed;
+		dt->duration = temp_downtime->duration;
+		dt->is_in_effect = temp_downtime->is_in_effect;
+		dt->start_notification_sent = temp_downtime->start_notification_sent;
+		dt->author = sd_strdup(temp_downtime->author);
+		dt->comment = sd_strdup(temp_downtime->comment);
 		}
-	fp = (FILE *)fdopen(fd, "w");
-	if(fp == NULL) {
 
+	/* something didn't fit */
+	if(snapshot.error == TRUE)
+		return ERROR;
+
+	return OK;
+	}
+
+
+static void write_customvars(FILE *fp, unsigned int first, unsigned int num) {
+	struct sd_customvar *cv = (struct sd_customvar *)snapshot.customvars.items + first;
+
+	for(; num > 0; num--, cv++)
+		fprintf(fp, "\t_%s=%d;%s\n", SD(cv->name), cv->has_been_modified, SD(cv->value));
+	}
+
+
+/*
+ * The status index gives the offset of each host and service block in
+ * the status file, so CGIs that want just a few of them can seek to
+ * them. It's written next to its final name and moved into place after
+ * the status file, so an index never describes a newer status file.
+ * It's optional, so failing to write it isn't an error.
+ */
+static FILE *open_status_index(void) {
+	FILE *ifp = NULL;
+	int fd = 0;
+
+	my_free(snapshot.tmp_index);
+	asprintf(&snapshot.tmp_index, "%sXXXXXX", SD(snapshot.index_file));
+	if(snapshot.tmp_index == NULL)
+		return NULL;
+
+	if((fd = mkstemp(snapshot.tmp_index)) == -1) {
+		my_free(snapshot.tmp_index);
+		return NULL;
+		}
+	fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH);
+	if((ifp = (FILE *)fdopen(fd, "w")) == NULL) {
 		close(fd);
-		unlink(tmp_log);
+		unlink(snapshot.tmp_index);
+		my_free(snapshot.tmp_index);
+		}
+
+	return ifp;
+	}
 
-		/* log an error */
-		logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Unable to open temp file '%s' for writing status data: %s\n", tmp_log, strerror(errno));
 
-		/* free memory */
-		my_free(tmp_log);
+/* moves the index into place once the status file it describes is */
+static void move_status_index(int status_moved) {
 
+	if(snapshot.tmp_index == NULL)
+		return;
+	if(status_moved == FALSE || rename(snapshot.tmp_index, SD(snapshot.index_file)))
+		unlink(snapshot.tmp_index);
+	my_free(snapshot.tmp_index);
+	}
+
+
+/* writes the snapshot to the status file - may run in the writer thread, so it must not log */
+static int write_status_snapshot(void) {
+	struct sd_host *h;
+	struct sd_service *s;
+	struct sd_contact *c;
+	struct sd_comment *cm;
+	struct sd_downtime *dt;
+	unsigned int i;
+	int fd = 0;
+	FILE *fp = NULL;
+	FILE *ifp = NULL;
+	int result = OK;
+
+	my_free(snapshot.tmp_log);
+	asprintf(&snapshot.tmp_log, "%sXXXXXX", SD(snapshot.temp_file));
+	if(snapshot.tmp_log == NULL) {
+		snprintf(snapshot.error_msg, sizeof(snapshot.error_msg), "Error: Unable to allocate memory for status data temp file name\n");
 		return ERROR;
 		}
 
-	/* generate check statistics */
-	generate_check_stats();
+	if((fd = mkstemp(snapshot.tmp_log)) == -1) {
+		snprintf(snapshot.error_msg, sizeof(snapshot.error_msg), "Error: Unable to create temp file '%s' for writing status data: %s\n", snapshot.tmp_log, strerror(errno));
+		return ERROR;
+		}
+	fp = (FILE *)fdopen(fd, "w");
+	if(fp == NULL) {
+		close(fd);
+		unlink(snapshot.tmp_log);
+		snprintf(snapshot.error_msg, sizeof(snapshot.error_msg), "Error: Unable to open temp file '%s' for writing status data: %s\n", snapshot.tmp_log, strerror(errno));
+		return ERROR;
+		}
+
+	if(*SD(snapshot.index_file) && (ifp = open_status_index()) != NULL)
+		fprintf(ifp, "created=%llu\n", (unsigned long long)snapshot.created);
 
 	/* write version info to status file */
 	fprintf(fp, "########################################\n");
@@ -173,261 +681,260 @@ int xsddefault_save_status_data(void) {
 	fprintf(fp, "# BY NAGIOS.  DO NOT MODIFY THIS FILE!\n");
 	fprintf(fp, "########################################\n\n");
 
-	time(&current_time);
-
 	/* write file info */
 	fprintf(fp, "info {\n");
-	fprintf(fp, "\tcreated=%llu\n", (unsigned long long)current_time);
+	fprintf(fp, "\tcreated=%llu\n", (unsigned long long)snapshot.created);
 	fprintf(fp, "\tversion=%s\n", PROGRAM_VERSION);
-	fprintf(fp, "\tlast_update_check=%llu\n", (unsigned long long)last_update_check);
-	fprintf(fp, "\tupdate_available=%d\n", update_available);
-	fprintf(fp, "\tlast_version=%s\n", (last_program_version == NULL) ? "" : last_program_version);
-	fprintf(fp, "\tnew_version=%s\n", (new_program_version == NULL) ? "" : new_program_version);
+	fprintf(fp, "\tlast_update_check=%llu\n", (unsigned long long)snapshot.last_update_check);
+	fprintf(fp, "\tupdate_available=%d\n", snapshot.update_available);
+	fprintf(fp, "\tlast_version=%s\n", SD(snapshot.last_version));
+	fprintf(fp, "\tnew_version=%s\n", SD(snapshot.new_version));
 	fprintf(fp, "\t}\n\n");
 
 	/* save program status data */
 	fprintf(fp, "programstatus {\n");
-	fprintf(fp, "\tmodified_host_attributes=%lu\n", modified_host_process_attributes);
-	fprintf(fp, "\tmodified_service_attributes=%lu\n", modified_service_process_attributes);
-	fprintf(fp, "\tnagios_pid=%d\n", nagios_pid);
-	fprintf(fp, "\tdaemon_mode=%d\n", daemon_mode);
-	fprintf(fp, "\tprogram_start=%llu\n", (unsigned long long)program_start);
-	fprintf(fp, "\tlast_log_rotation=%llu\n", (unsigned long long)last_log_rotation);
-	fprintf(fp, "\tenable_notifications=%d\n", enable_notifications);
-	fprintf(fp, "\tactive_service_checks_enabled=%d\n", execute_service_checks);
-	fprintf(fp, "\tpassive_service_checks_enabled=%d\n", accept_passive_service_checks);
-	fprintf(fp, "\tactive_host_checks_enabled=%d\n", execute_host_checks);
-	fprintf(fp, "\tpassive_host_checks_enabled=%d\n", accept_passive_host_checks);
-	fprintf(fp, "\tenable_event_handlers=%d\n", enable_event_handlers);
-	fprintf(fp, "\tobsess_over_services=%d\n", obsess_over_services);
-	fprintf(fp, "\tobsess_over_hosts=%d\n", obsess_over_hosts);
-	fprintf(fp, "\tcheck_service_freshness=%d\n", check_service_freshness);
-	fprintf(fp, "\tcheck_host_freshness=%d\n", check_host_freshness);
-	fprintf(fp, "\tenable_flap_detection=%d\n", enable_flap_detection);
-	fprintf(fp, "\tprocess_performance_data=%d\n", process_performance_data);
-	fprintf(fp, "\tglobal_host_event_handler=%s\n", (global_host_event_handler == NULL) ? "" : global_host_event_handler);
-	fprintf(fp, "\tglobal_service_event_handler=%s\n", (global_service_event_handler == NULL) ? "" : global_service_event_handler);
-	fprintf(fp, "\tnext_comment_id=%lu\n", next_comment_id);
-	fprintf(fp, "\tnext_downtime_id=%lu\n", next_downtime_id);
-	fprintf(fp, "\tnext_event_id=%lu\n", next_event_id);
-	fprintf(fp, "\tnext_problem_id=%lu\n", next_problem_id);
-	fprintf(fp, "\tnext_notification_id=%lu\n", next_notification_id);
-	fprintf(fp, "\tactive_scheduled_host_check_stats=%d,%d,%d\n", check_statistics[ACTIVE_SCHEDULED_HOST_CHECK_STATS].minute_stats[0], check_statistics[ACTIVE_SCHEDULED_HOST_CHECK_STATS].minute_stats[1], check_statistics[ACTIVE_SCHEDULED_HOST_CHECK_STATS].minute_stats[2]);
-	fprintf(fp, "\tactive_ondemand_host_check_stats=%d,%d,%d\n", check_statistics[ACTIVE_ONDEMAND_HOST_CHECK_STATS].minute_stats[0], check_statistics[ACTIVE_ONDEMAND_HOST_CHECK_STATS].minute_stats[1], check_statistics[ACTIVE_ONDEMAND_HOST_CHECK_STATS].minute_stats[2]);
-	fprintf(fp, "\tpassive_host_check_stats=%d,%d,%d\n", check_statistics[PASSIVE_HOST_CHECK_STATS].minute_stats[0], check_statistics[PASSIVE_HOST_CHECK_STATS].minute_stats[1], check_statistics[PASSIVE_HOST_CHECK_STATS].minute_stats[2]);
-	fprintf(fp, "\tactive_scheduled_service_check_stats=%d,%d,%d\n", check_statistics[ACTIVE_SCHEDULED_SERVICE_CHECK_STATS].minute_stats[0], check_statistics[ACTIVE_SCHEDULED_SERVICE_CHECK_STATS].minute_stats[1], check_statistics[ACTIVE_SCHEDULED_SERVICE_CHECK_STATS].minute_stats[2]);
-	fprintf(fp, "\tactive_ondemand_service_check_stats=%d,%d,%d\n", check_statistics[ACTIVE_ONDEMAND_SERVICE_CHECK_STATS].minute_stats[0], check_statistics[ACTIVE_ONDEMAND_SERVICE_CHECK_STATS].minute_stats[1], check_statistics[ACTIVE_ONDEMAND_SERVICE_CHECK_STATS].minute_stats[2]);
-	fprintf(fp, "\tpassive_service_check_stats=%d,%d,%d\n", check_statistics[PASSIVE_SERVICE_CHECK_STATS].minute_stats[0], check_statistics[PASSIVE_SERVICE_CHECK_STATS].minute_stats[1], check_statistics[PASSIVE_SERVICE_CHECK_STATS].minute_stats[2]);
-	fprintf(fp, "\tcached_host_check_stats=%d,%d,%d\n", check_statistics[ACTIVE_CACHED_HOST_CHECK_STATS].minute_stats[0], check_statistics[ACTIVE_CACHED_HOST_CHECK_STATS].minute_stats[1], check_statistics[ACTIVE_CACHED_HOST_CHECK_STATS].minute_stats[2]);
-	fprintf(fp, "\tcached_service_check_stats=%d,%d,%d\n", check_statistics[ACTIVE_CACHED_SERVICE_CHECK_STATS].minute_stats[0], check_statistics[ACTIVE_CACHED_SERVICE_CHECK_STATS].minute_stats[1], check_statistics[ACTIVE_CACHED_SERVICE_CHECK_STATS].minute_stats[2]);
-	fprintf(fp, "\texternal_command_stats=%d,%d,%d\n", check_statistics[EXTERNAL_COMMAND_STATS].minute_stats[0], check_statistics[EXTERNAL_COMMAND_STATS].minute_stats[1], check_statistics[EXTERNAL_COMMAND_STATS].minute_stats[2]);
-
-	fprintf(fp, "\tparallel_host_check_stats=%d,%d,%d\n", check_statistics[PARALLEL_HOST_CHECK_STATS].minute_stats[0], check_statistics[PARALLEL_HOST_CHECK_STATS].minute_stats[1], check_statistics[PARALLEL_HOST_CHECK_STATS].minute_stats[2]);
-	fprintf(fp, "\tserial_host_check_stats=%d,%d,%d\n", check_statistics[SERIAL_HOST_CHECK_STATS].minute_stats[0], check_statistics[SERIAL_HOST_CHECK_STATS].minute_stats[1], check_statistics[SERIAL_HOST_CHECK_STATS].minute_stats[2]);
+	fprintf(fp, "\tmodified_host_attributes=%lu\n", snapshot.modified_host_attributes);
+	fprintf(fp, "\tmodified_service_attributes=%lu\n", snapshot.modified_service_attributes);
+	fprintf(fp, "\tnagios_pid=%d\n", snapshot.nagios_pid);
+	fprintf(fp, "\tdaemon_mode=%d\n", snapshot.daemon_mode);
+	fprintf(fp, "\tprogram_start=%llu\n", (unsigned long long)snapshot.program_start);
+	fprintf(fp, "\tlast_log_rotation=%llu\n", (unsigned long long)snapshot.last_log_rotation);
+	fprintf(fp, "\tenable_notifications=%d\n", snapshot.enable_notifications);
+	fprintf(fp, "\tactive_service_checks_enabled=%d\n", snapshot.execute_service_checks);
+	fprintf(fp, "\tpassive_service_checks_enabled=%d\n", snapshot.accept_passive_service_checks);
+	fprintf(fp, "\tactive_host_checks_enabled=%d\n", snapshot.execute_host_checks);
+	fprintf(fp, "\tpassive_host_checks_enabled=%d\n", snapshot.accept_passive_host_checks);
+	fprintf(fp, "\tenable_event_handlers=%d\n", snapshot.enable_event_handlers);
+	fprintf(fp, "\tobsess_over_services=%d\n", snapshot.obsess_over_services);
+	fprintf(fp, "\tobsess_over_hosts=%d\n", snapshot.obsess_over_hosts);
+	fprintf(fp, "\tcheck_service_freshness=%d\n", snapshot.check_service_freshness);
+	fprintf(fp, "\tcheck_host_freshness=%d\n", snapshot.check_host_freshness);
+	fprintf(fp, "\tenable_flap_detection=%d\n", snapshot.enable_flap_detection);
+	fprintf(fp, "\tprocess_performance_data=%d\n", snapshot.process_performance_data);
+	fprintf(fp, "\tglobal_host_event_handler=%s\n", SD(snapshot.global_host_event_handler));
+	fprintf(fp, "\tglobal_service_event_handler=%s\n", SD(snapshot.global_service_event_handler));
+	fprintf(fp, "\tnext_comment_id=%lu\n", snapshot.next_comment_id);
+	fprintf(fp, "\tnext_downtime_id=%lu\n", snapshot.next_downtime_id);
+	fprintf(fp, "\tnext_event_id=%lu\n", snapshot.next_event_id);
+	fprintf(fp, "\tnext_problem_id=%lu\n", snapshot.next_problem_id);
+	fprintf(fp, "\tnext_notification_id=%lu\n", snapshot.next_notification_id);
+	fprintf(fp, "\tactive_scheduled_host_check_stats=%d,%d,%d\n", snapshot.check_stats[ACTIVE_SCHEDULED_HOST_CHECK_STATS][0], snapshot.check_stats[ACTIVE_SCHEDULED_HOST_CHECK_STATS][1], snapshot.check_stats[ACTIVE_SCHEDULED_HOST_CHECK_STATS][2]);
+	fprintf(fp, "\tactive_ondemand_host_check_stats=%d,%d,%d\n", snapshot.check_stats[ACTIVE_ONDEMAND_HOST_CHECK_STATS][0], snapshot.check_stats[ACTIVE_ONDEMAND_HOST_CHECK_STATS][1], snapshot.check_stats[ACTIVE_ONDEMAND_HOST_CHECK_STATS][2]);
+	fprintf(fp, "\tpassive_host_check_stats=%d,%d,%d\n", snapshot.check_stats[PASSIVE_HOST_CHECK_STATS][0], snapshot.check_stats[PASSIVE_HOST_CHECK_STATS][1], snapshot.check_stats[PASSIVE_HOST_CHECK_STATS][2]);
+	fprintf(fp, "\tactive_scheduled_service_check_stats=%d,%d,%d\n", snapshot.check_stats[ACTIVE_SCHEDULED_SERVICE_CHECK_STATS][0], snapshot.check_stats[ACTIVE_SCHEDULED_SERVICE_CHECK_STATS][1], snapshot.check_stats[ACTIVE_SCHEDULED_SERVICE_CHECK_STATS][2]);
+	fprintf(fp, "\tactive_ondemand_service_check_stats=%d,%d,%d\n", snapshot.check_stats[ACTIVE_ONDEMAND_SERVICE_CHECK_STATS][0], snapshot.check_stats[ACTIVE_ONDEMAND_SERVICE_CHECK_STATS][1], snapshot.check_stats[ACTIVE_ONDEMAND_SERVICE_CHECK_STATS][2]);
+	fprintf(fp, "\tpassive_service_check_stats=%d,%d,%d\n", snapshot.check_stats[PASSIVE_SERVICE_CHECK_STATS][0], snapshot.check_stats[PASSIVE_SERVICE_CHECK_STATS][1], snapshot.check_stats[PASSIVE_SERVICE_CHECK_STATS][2]);
+	fprintf(fp, "\tcached_host_check_stats=%d,%d,%d\n", snapshot.check_stats[ACTIVE_CACHED_HOST_CHECK_STATS][0], snapshot.check_stats[ACTIVE_CACHED_HOST_CHECK_STATS][1], snapshot.check_stats[ACTIVE_CACHED_HOST_CHECK_STATS][2]);
+	fprintf(fp, "\tcached_service_check_stats=%d,%d,%d\n", snapshot.check_stats[ACTIVE_CACHED_SERVICE_CHECK_STATS][0], snapshot.check_stats[ACTIVE_CACHED_SERVICE_CHECK_STATS][1], snapshot.check_stats[ACTIVE_CACHED_SERVICE_CHECK_STATS][2]);
+	fprintf(fp, "\texternal_command_stats=%d,%d,%d\n", snapshot.check_stats[EXTERNAL_COMMAND_STATS][0], snapshot.check_stats[EXTERNAL_COMMAND_STATS][1], snapshot.check_stats[EXTERNAL_COMMAND_STATS][2]);
+
+	fprintf(fp, "\tparallel_host_check_stats=%d,%d,%d\n", snapshot.check_stats[PARALLEL_HOST_CHECK_STATS][0], snapshot.check_stats[PARALLEL_HOST_CHECK_STATS][1], snapshot.check_stats[PARALLEL_HOST_CHECK_STATS][2]);
+	fprintf(fp, "\tserial_host_check_stats=%d,%d,%d\n", snapshot.check_stats[SERIAL_HOST_CHECK_STATS][0], snapshot.check_stats[SERIAL_HOST_CHECK_STATS][1], snapshot.check_stats[SERIAL_HOST_CHECK_STATS][2]);
+	fprintf(fp, "\tcoalesced_host_check_stats=%d,%d,%d\n", snapshot.check_stats[COALESCED_HOST_CHECK_STATS][0], snapshot.check_stats[COALESCED_HOST_CHECK_STATS][1], snapshot.check_stats[COALESCED_HOST_CHECK_STATS][2]);
+	fprintf(fp, "\tcoalesced_service_check_stats=%d,%d,%d\n", snapshot.check_stats[COALESCED_SERVICE_CHECK_STATS][0], snapshot.check_stats[COALESCED_SERVICE_CHECK_STATS][1], snapshot.check_stats[COALESCED_SERVICE_CHECK_STATS][2]);
 	fprintf(fp, "\t}\n\n");
 
 
 	/* save host status data */
-	for(temp_host = host_list; temp_host != NULL; temp_host = temp_host->next) {
+	for(i = 0, h = snapshot.hosts.items; i < snapshot.hosts.len; i++, h++) {
 
+		if(ifp)
+			fprintf(ifp, "h\t%lld\t%s\n", (long long)ftello(fp), SD(h->name));
 		fprintf(fp, "hoststatus {\n");
-		fprintf(fp, "\thost_name=%s\n", temp_host->name);
-
-		fprintf(fp, "\tmodified_attributes=%lu\n", temp_host->modified_attributes);
-		fprintf(fp, "\tcheck_command=%s\n", (temp_host->check_command == NULL) ? "" : temp_host->check_command);
-		fprintf(fp, "\tcheck_period=%s\n", (temp_host->check_period == NULL) ? "" : temp_host->check_period);
-		fprintf(fp, "\tnotification_period=%s\n", (temp_host->notification_period == NULL) ? "" : temp_host->notification_period);
-		fprintf(fp, "\tcheck_interval=%f\n", temp_host->check_interval);
-		fprintf(fp, "\tretry_interval=%f\n", temp_host->retry_interval);
-		fprintf(fp, "\tevent_handler=%s\n", (temp_host->event_handler == NULL) ? "" : temp_host->event_handler);
-
-		fprintf(fp, "\thas_been_checked=%d\n", temp_host->has_been_checked);
-		fprintf(fp, "\tshould_be_scheduled=%d\n", temp_host->should_be_scheduled);
-		fprintf(fp, "\tcheck_execution_time=%.3f\n", temp_host->execution_time);
-		fprintf(fp, "\tcheck_latency=%.3f\n", temp_host->latency);
-		fprintf(fp, "\tcheck_type=%d\n", temp_host->check_type);
-		fprintf(fp, "\tcurrent_state=%d\n", temp_host->current_state);
-		fprintf(fp, "\tlast_hard_state=%d\n", temp_host->last_hard_state);
-		fprintf(fp, "\tlast_event_id=%lu\n", temp_host->last_event_id);
-		fprintf(fp, "\tcurrent_event_id=%lu\n", temp_host->current_event_id);
-		fprintf(fp, "\tcurrent_problem_id=%lu\n", temp_host->current_problem_id);
-		fprintf(fp, "\tlast_problem_id=%lu\n", temp_host->last_problem_id);
-		fprintf(fp, "\tplugin_output=%s\n", (temp_host->plugin_output == NULL) ? "" : temp_host->plugin_output);
-		fprintf(fp, "\tlong_plugin_output=%s\n", (temp_host->long_plugin_output == NULL) ? "" : temp_host->long_plugin_output);
-		fprintf(fp, "\tperformance_data=%s\n", (temp_host->perf_data == NULL) ? "" : temp_host->perf_data);
-		fprintf(fp, "\tlast_check=%llu\n", (unsigned long long)temp_host->last_check);
-		fprintf(fp, "\tnext_check=%llu\n", (unsigned long long)temp_host->next_check);
-		fprintf(fp, "\tcheck_options=%d\n", temp_host->check_options);
-		fprintf(fp, "\tcurrent_attempt=%d\n", temp_host->current_attempt);
-		fprintf(fp, "\tmax_attempts=%d\n", temp_host->max_attempts);
-		fprintf(fp, "\tstate_type=%d\n", temp_host->state_type);
-		fprintf(fp, "\tlast_state_change=%llu\n", (unsigned long long)temp_host->last_state_change);
-		fprintf(fp, "\tlast_hard_state_change=%llu\n", (unsigned long long)temp_host->last_hard_state_change);
-		fprintf(fp, "\tlast_time_up=%llu\n", (unsigned long long)temp_host->last_time_up);
-		fprintf(fp, "\tlast_time_down=%llu\n", (unsigned long long)temp_host->last_time_down);
-		fprintf(fp, "\tlast_time_unreachable=%llu\n", (unsigned long long)temp_host->last_time_unreachable);
-		fprintf(fp, "\tlast_notification=%llu\n", (unsigned long long)temp_host->last_notification);
-		fprintf(fp, "\tnext_notification=%llu\n", (unsigned long long)temp_host->next_notification);
-		fprintf(fp, "\tno_more_notifications=%d\n", temp_host->no_more_notifications);
-		fprintf(fp, "\tcurrent_notification_number=%d\n", temp_host->current_notification_number);
-		fprintf(fp, "\tcurrent_notification_id=%lu\n", temp_host->current_notification_id);
-		fprintf(fp, "\tnotifications_enabled=%d\n", temp_host->notifications_enabled);
-		fprintf(fp, "\tproblem_has_been_acknowledged=%d\n", temp_host->problem_has_been_acknowledged);
-		fprintf(fp, "\tacknowledgement_type=%d\n", temp_host->acknowledgement_type);
-		fprintf(fp, "\tactive_checks_enabled=%d\n", temp_host->checks_enabled);
-		fprintf(fp, "\tpassive_checks_enabled=%d\n", temp_host->accept_passive_checks);
-		fprintf(fp, "\tevent_handler_enabled=%d\n", temp_host->event_handler_enabled);
-		fprintf(fp, "\tflap_detection_enabled=%d\n", temp_host->flap_detection_enabled);
-		fprintf(fp, "\tprocess_performance_data=%d\n", temp_host->process_performance_data);
-		fprintf(fp, "\tobsess=%d\n", temp_host->obsess);
-		fprintf(fp, "\tlast_update=%llu\n", (unsigned long long)current_time);
-		fprintf(fp, "\tis_flapping=%d\n", temp_host->is_flapping);
-		fprintf(fp, "\tpercent_state_change=%.2f\n", temp_host->percent_state_change);
-		fprintf(fp, "\tscheduled_downtime_depth=%d\n", temp_host->scheduled_downtime_depth);
+		fprintf(fp, "\thost_name=%s\n", SD(h->name));
+
+		fprintf(fp, "\tmodified_attributes=%lu\n", h->modified_attributes);
+		fprintf(fp, "\tcheck_command=%s\n", SD(h->check_command));
+		fprintf(fp, "\tcheck_period=%s\n", SD(h->check_period));
+		fprintf(fp, "\tnotification_period=%s\n", SD(h->notification_period));
+		fprintf(fp, "\tcheck_interval=%f\n", h->check_interval);
+		fprintf(fp, "\tretry_interval=%f\n", h->retry_interval);
+		fprintf(fp, "\tevent_handler=%s\n", SD(h->event_handler));
+
+		fprintf(fp, "\thas_been_checked=%d\n", h->has_been_checked);
+		fprintf(fp, "\tshould_be_scheduled=%d\n", h->should_be_scheduled);
+		fprintf(fp, "\tcheck_execution_time=%.3f\n", h->execution_time);
+		fprintf(fp, "\tcheck_latency=%.3f\n", h->latency);
+		fprintf(fp, "\tcheck_type=%d\n", h->check_type);
+		fprintf(fp, "\tcurrent_state=%d\n", h->current_state);
+		fprintf(fp, "\tlast_hard_state=%d\n", h->last_hard_state);
+		fprintf(fp, "\tlast_event_id=%lu\n", h->last_event_id);
+		fprintf(fp, "\tcurrent_event_id=%lu\n", h->current_event_id);
+		fprintf(fp, "\tcurrent_problem_id=%lu\n", h->current_problem_id);
+		fprintf(fp, "\tlast_problem_id=%lu\n", h->last_problem_id);
+		fprintf(fp, "\tplugin_output=%s\n", SD(h->plugin_output));
+		fprintf(fp, "\tlong_plugin_output=%s\n", SD(h->long_plugin_output));
+		fprintf(fp, "\tperformance_data=%s\n", SD(h->perf_data));
+		fprintf(fp, "\tlast_check=%llu\n", (unsigned long long)h->last_check);
+		fprintf(fp, "\tnext_check=%llu\n", (unsigned long long)h->next_check);
+		fprintf(fp, "\tcheck_options=%d\n", h->check_options);
+		fprintf(fp, "\tcurrent_attempt=%d\n", h->current_attempt);
+		fprintf(fp, "\tmax_attempts=%d\n", h->max_attempts);
+		fprintf(fp, "\tstate_type=%d\n", h->state_type);
+		fprintf(fp, "\tlast_state_change=%llu\n", (unsigned long long)h->last_state_change);
+		fprintf(fp, "\tlast_hard_state_change=%llu\n", (unsigned long long)h->last_hard_state_change);
+		fprintf(fp, "\tlast_time_up=%llu\n", (unsigned long long)h->last_time_up);
+		fprintf(fp, "\tlast_time_down=%llu\n", (unsigned long long)h->last_time_down);
+		fprintf(fp, "\tlast_time_unreachable=%llu\n", (unsigned long long)h->last_time_unreachable);
+		fprintf(fp, "\tlast_notification=%llu\n", (unsigned long long)h->last_notification);
+		fprintf(fp, "\tnext_notification=%llu\n", (unsigned long long)h->next_notification);
+		fprintf(fp, "\tno_more_notifications=%d\n", h->no_more_notifications);
+		fprintf(fp, "\tcurrent_notification_number=%d\n", h->current_notification_number);
+		fprintf(fp, "\tcurrent_notification_id=%lu\n", h->current_notification_id);
+		fprintf(fp, "\tnotifications_enabled=%d\n", h->notifications_enabled);
+		fprintf(fp, "\tproblem_has_been_acknowledged=%d\n", h->problem_has_been_acknowledged);
+		fprintf(fp, "\tacknowledgement_type=%d\n", h->acknowledgement_type);
+		fprintf(fp, "\tactive_checks_enabled=%d\n", h->checks_enabled);
+		fprintf(fp, "\tpassive_checks_enabled=%d\n", h->accept_passive_checks);
+		fprintf(fp, "\tevent_handler_enabled=%d\n", h->event_handler_enabled);
+		fprintf(fp, "\tflap_detection_enabled=%d\n", h->flap_detection_enabled);
+		fprintf(fp, "\tprocess_performance_data=%d\n", h->process_performance_data);
+		fprintf(fp, "\tobsess=%d\n", h->obsess);
+		fprintf(fp, "\tlast_update=%llu\n", (unsigned long long)snapshot.created);
+		fprintf(fp, "\tis_flapping=%d\n", h->is_flapping);
+		fprintf(fp, "\tpercent_state_change=%.2f\n", h->percent_state_change);
+		fprintf(fp, "\tscheduled_downtime_depth=%d\n", h->scheduled_downtime_depth);
 		/* custom variables */
-		for(temp_customvariablesmember = temp_host->custom_variables; temp_customvariablesmember != NULL; temp_customvariablesmember = temp_customvariablesmember->next) {
-			if(temp_customvariablesmember->variable_name)
-				fprintf(fp, "\t_%s=%d;%s\n", temp_customvariablesmember->variable_name, temp_customvariablesmember->has_been_modified, (temp_customvariablesmember->variable_value == NULL) ? "" : temp_customvariablesmember->variable_value);
-			}
+		write_customvars(fp, h->customvars, h->num_customvars);
 		fprintf(fp, "\t}\n\n");
 		}
 
 	/* save service status data */
-	for(temp_service = service_list; temp_service != NULL; temp_service = temp_service->next) {
+	for(i = 0, s = snapshot.services.items; i < snapshot.services.len; i++, s++) {
 
+		if(ifp)
+			fprintf(ifp, "s\t%lld\t%s\t%s\n", (long long)ftello(fp), SD(s->host_name), SD(s->description));
 		fprintf(fp, "servicestatus {\n");
-		fprintf(fp, "\thost_name=%s\n", temp_service->host_name);
-
-		fprintf(fp, "\tservice_description=%s\n", temp_service->description);
-		fprintf(fp, "\tmodified_attributes=%lu\n", temp_service->modified_attributes);
-		fprintf(fp, "\tcheck_command=%s\n", (temp_service->check_command == NULL) ? "" : temp_service->check_command);
-		fprintf(fp, "\tcheck_period=%s\n", (temp_service->check_period == NULL) ? "" : temp_service->check_period);
-		fprintf(fp, "\tnotification_period=%s\n", (temp_service->notification_period == NULL) ? "" : temp_service->notification_period);
-		fprintf(fp, "\tcheck_interval=%f\n", temp_service->check_interval);
-		fprintf(fp, "\tretry_interval=%f\n", temp_service->retry_interval);
-		fprintf(fp, "\tevent_handler=%s\n", (temp_service->event_handler == NULL) ? "" : temp_service->event_handler);
-
-		fprintf(fp, "\thas_been_checked=%d\n", temp_service->has_been_checked);
-		fprintf(fp, "\tshould_be_scheduled=%d\n", temp_service->should_be_scheduled);
-		fprintf(fp, "\tcheck_execution_time=%.3f\n", temp_service->execution_time);
-		fprintf(fp, "\tcheck_latency=%.3f\n", temp_service->latency);
-		fprintf(fp, "\tcheck_type=%d\n", temp_service->check_type);
-		fprintf(fp, "\tcurrent_state=%d\n", temp_service->current_state);
-		fprintf(fp, "\tlast_hard_state=%d\n", temp_service->last_hard_state);
-		fprintf(fp, "\tlast_event_id=%lu\n", temp_service->last_event_id);
-		fprintf(fp, "\tcurrent_event_id=%lu\n", temp_service->current_event_id);
-		fprintf(fp, "\tcurrent_problem_id=%lu\n", temp_service->current_problem_id);
-		fprintf(fp, "\tlast_problem_id=%lu\n", temp_service->last_problem_id);
-		fprintf(fp, "\tcurrent_attempt=%d\n", temp_service->current_attempt);
-		fprintf(fp, "\tmax_attempts=%d\n", temp_service->max_attempts);
-		fprintf(fp, "\tstate_type=%d\n", temp_service->state_type);
-		fprintf(fp, "\tlast_state_change=%llu\n", (unsigned long long)temp_service->last_state_change);
-		fprintf(fp, "\tlast_hard_state_change=%llu\n", (unsigned long long)temp_service->last_hard_state_change);
-		fprintf(fp, "\tlast_time_ok=%llu\n", (unsigned long long)temp_service->last_time_ok);
-		fprintf(fp, "\tlast_time_warning=%llu\n", (unsigned long long)temp_service->last_time_warning);
-		fprintf(fp, "\tlast_time_unknown=%llu\n", (unsigned long long)temp_service->last_time_unknown);
-		fprintf(fp, "\tlast_time_critical=%llu\n", (unsigned long long)temp_service->last_time_critical);
-		fprintf(fp, "\tplugin_output=%s\n", (temp_service->plugin_output == NULL) ? "" : temp_service->plugin_output);
-		fprintf(fp, "\tlong_plugin_output=%s\n", (temp_service->long_plugin_output == NULL) ? "" : temp_service->long_plugin_output);
-		fprintf(fp, "\tperformance_data=%s\n", (temp_service->perf_data == NULL) ? "" : temp_service->perf_data);
-		fprintf(fp, "\tlast_check=%llu\n", (unsigned long long)temp_service->last_check);
-		fprintf(fp, "\tnext_check=%llu\n", (unsigned long long)temp_service->next_check);
-		fprintf(fp, "\tcheck_options=%d\n", temp_service->check_options);
-		fprintf(fp, "\tcurrent_notification_number=%d\n", temp_service->current_notification_number);
-		fprintf(fp, "\tcurrent_notification_id=%lu\n", temp_service->current_notification_id);
-		fprintf(fp, "\tlast_notification=%llu\n", (unsigned long long)temp_service->last_notification);
-		fprintf(fp, "\tnext_notification=%llu\n", (unsigned long long)temp_service->next_notification);
-		fprintf(fp, "\tno_more_notifications=%d\n", temp_service->no_more_notifications);
-		fprintf(fp, "\tnotifications_enabled=%d\n", temp_service->notifications_enabled);
-		fprintf(fp, "\tactive_checks_enabled=%d\n", temp_service->checks_enabled);
-		fprintf(fp, "\tpassive_checks_enabled=%d\n", temp_service->accept_passive_checks);
-		fprintf(fp, "\tevent_handler_enabled=%d\n", temp_service->event_handler_enabled);
-		fprintf(fp, "\tproblem_has_been_acknowledged=%d\n", temp_service->problem_has_been_acknowledged);
-		fprintf(fp, "\tacknowledgement_type=%d\n", temp_service->acknowledgement_type);
-		fprintf(fp, "\tflap_detection_enabled=%d\n", temp_service->flap_detection_enabled);
-		fprintf(fp, "\tprocess_performance_data=%d\n", temp_service->process_performance_data);
-		fprintf(fp, "\tobsess=%d\n", temp_service->obsess);
-		fprintf(fp, "\tlast_update=%llu\n", (unsigned long long)current_time);
-		fprintf(fp, "\tis_flapping=%d\n", temp_service->is_flapping);
-		fprintf(fp, "\tpercent_state_change=%.2f\n", temp_service->percent_state_change);
-		fprintf(fp, "\tscheduled_downtime_depth=%d\n", temp_service->scheduled_downtime_depth);
+		fprintf(fp, "\thost_name=%s\n", SD(s->host_name));
+
+		fprintf(fp, "\tservice_description=%s\n", SD(s->description));
+		fprintf(fp, "\tmodified_attributes=%lu\n", s->modified_attributes);
+		fprintf(fp, "\tcheck_command=%s\n", SD(s->check_command));
+		fprintf(fp, "\tcheck_period=%s\n", SD(s->check_period));
+		fprintf(fp, "\tnotification_period=%s\n", SD(s->notification_period));
+		fprintf(fp, "\tcheck_interval=%f\n", s->check_interval);
+		fprintf(fp, "\tretry_interval=%f\n", s->retry_interval);
+		fprintf(fp, "\tevent_handler=%s\n", SD(s->event_handler));
+
+		fprintf(fp, "\thas_been_checked=%d\n", s->has_been_checked);
+		fprintf(fp, "\tshould_be_scheduled=%d\n", s->should_be_scheduled);
+		fprintf(fp, "\tcheck_execution_time=%.3f\n", s->execution_time);
+		fprintf(fp, "\tcheck_latency=%.3f\n", s->latency);
+		fprintf(fp, "\tcheck_type=%d\n", s->check_type);
+		fprintf(fp, "\tcurrent_state=%d\n", s->current_state);
+		fprintf(fp, "\tlast_hard_state=%d\n", s->last_hard_state);
+		fprintf(fp, "\tlast_event_id=%lu\n", s->last_event_id);
+		fprintf(fp, "\tcurrent_event_id=%lu\n", s->current_event_id);
+		fprintf(fp, "\tcurrent_problem_id=%lu\n", s->current_problem_id);
+		fprintf(fp, "\tlast_problem_id=%lu\n", s->last_problem_id);
+		fprintf(fp, "\tcurrent_attempt=%d\n", s->current_attempt);
+		fprintf(fp, "\tmax_attempts=%d\n", s->max_attempts);
+		fprintf(fp, "\tstate_type=%d\n", s->state_type);
+		fprintf(fp, "\tlast_state_change=%llu\n", (unsigned long long)s->last_state_change);
+		fprintf(fp, "\tlast_hard_state_change=%llu\n", (unsigned long long)s->last_hard_state_change);
+		fprintf(fp, "\tlast_time_ok=%llu\n", (unsigned long long)s->last_time_ok);
+		fprintf(fp, "\tlast_time_warning=%llu\n", (unsigned long long)s->last_time_warning);
+		fprintf(fp, "\tlast_time_unknown=%llu\n", (unsigned long long)s->last_time_unknown);
+		fprintf(fp, "\tlast_time_critical=%llu\n", (unsigned long long)s->last_time_critical);
+		fprintf(fp, "\tplugin_output=%s\n", SD(s->plugin_output));
+		fprintf(fp, "\tlong_plugin_output=%s\n", SD(s->long_plugin_output));
+		fprintf(fp, "\tperformance_data=%s\n", SD(s->perf_data));
+		fprintf(fp, "\tlast_check=%llu\n", (unsigned long long)s->last_check);
+		fprintf(fp, "\tnext_check=%llu\n", (unsigned long long)s->next_check);
+		fprintf(fp, "\tcheck_options=%d\n", s->check_options);
+		fprintf(fp, "\tcurrent_notification_number=%d\n", s->current_notification_number);
+		fprintf(fp, "\tcurrent_notification_id=%lu\n", s->current_notification_id);
+		fprintf(fp, "\tlast_notification=%llu\n", (unsigned long long)s->last_notification);
+		fprintf(fp, "\tnext_notification=%llu\n", (unsigned long long)s->next_notification);
+		fprintf(fp, "\tno_more_notifications=%d\n", s->no_more_notifications);
+		fprintf(fp, "\tnotifications_enabled=%d\n", s->notifications_enabled);
+		fprintf(fp, "\tactive_checks_enabled=%d\n", s->checks_enabled);
+		fprintf(fp, "\tpassive_checks_enabled=%d\n", s->accept_passive_checks);
+		fprintf(fp, "\tevent_handler_enabled=%d\n", s->event_handler_enabled);
+		fprintf(fp, "\tproblem_has_been_acknowledged=%d\n", s->problem_has_been_acknowledged);
+		fprintf(fp, "\tacknowledgement_type=%d\n", s->acknowledgement_type);
+		fprintf(fp, "\tflap_detection_enabled=%d\n", s->flap_detection_enabled);
+		fprintf(fp, "\tprocess_performance_data=%d\n", s->process_performance_data);
+		fprintf(fp, "\tobsess=%d\n", s->obsess);
+		fprintf(fp, "\tlast_update=%llu\n", (unsigned long long)snapshot.created);
+		fprintf(fp, "\tis_flapping=%d\n", s->is_flapping);
+		fprintf(fp, "\tpercent_state_change=%.2f\n", s->percent_state_change);
+		fprintf(fp, "\tscheduled_downtime_depth=%d\n", s->scheduled_downtime_depth);
 		/* custom variables */
-		for(temp_customvariablesmember = temp_service->custom_variables; temp_customvariablesmember != NULL; temp_customvariablesmember = temp_customvariablesmember->next) {
-			if(temp_customvariablesmember->variable_name)
-				fprintf(fp, "\t_%s=%d;%s\n", temp_customvariablesmember->variable_name, temp_customvariablesmember->has_been_modified, (temp_customvariablesmember->variable_value == NULL) ? "" : temp_customvariablesmember->variable_value);
-			}
+		write_customvars(fp, s->customvars, s->num_customvars);
 		fprintf(fp, "\t}\n\n");
 		}
 
 	/* save contact status data */
-	for(temp_contact = contact_list; temp_contact != NULL; temp_contact = temp_contact->next) {
+	for(i = 0, c = snapshot.contacts.items; i < snapshot.contacts.len; i++, c++) {
 
 		fprintf(fp, "contactstatus {\n");
-		fprintf(fp, "\tcontact_name=%s\n", temp_contact->name);
-
-		fprintf(fp, "\tmodified_attributes=%lu\n", temp_contact->modified_attributes);
-		fprintf(fp, "\tmodified_host_attributes=%lu\n", temp_contact->modified_host_attributes);
-		fprintf(fp, "\tmodified_service_attributes=%lu\n", temp_contact->modified_service_attributes);
-		fprintf(fp, "\thost_notification_period=%s\n", (temp_contact->host_notification_period == NULL) ? "" : temp_contact->host_notification_period);
-		fprintf(fp, "\tservice_notification_period=%s\n", (temp_contact->service_notification_period == NULL) ? "" : temp_contact->service_notification_period);
-
-		fprintf(fp, "\tlast_host_notification=%llu\n", (unsigned long long)temp_contact->last_host_notification);
-		fprintf(fp, "\tlast_service_notification=%llu\n", (unsigned long long)temp_contact->last_service_notification);
-		fprintf(fp, "\thost_notifications_enabled=%d\n", temp_contact->host_notifications_enabled);
-		fprintf(fp, "\tservice_notifications_enabled=%d\n", temp_contact->service_notifications_enabled);
+		fprintf(fp, "\tcontact_name=%s\n", SD(c->name));
+
+		fprintf(fp, "\tmodified_attributes=%lu\n", c->modified_attributes);
+		fprintf(fp, "\tmodified_host_attributes=%lu\n", c->modified_host_attributes);
+		fprintf(fp, "\tmodified_service_attributes=%lu\n", c->modified_service_attributes);
+		fprintf(fp, "\thost_notification_period=%s\n", SD(c->host_notification_period));
+		fprintf(fp, "\tservice_notification_period=%s\n", SD(c->service_notification_period));
+
+		fprintf(fp, "\tlast_host_notification=%llu\n", (unsigned long long)c->last_host_notification);
+		fprintf(fp, "\tlast_service_notification=%llu\n", (unsigned long long)c->last_service_notification);
+		fprintf(fp, "\thost_notifications_enabled=%d\n", c->host_notifications_enabled);
+		fprintf(fp, "\tservice_notifications_enabled=%d\n", c->service_notifications_enabled);
 		/* custom variables */
-		for(temp_customvariablesmember = temp_contact->custom_variables; temp_customvariablesmember != NULL; temp_customvariablesmember = temp_customvariablesmember->next) {
-			if(temp_customvariablesmember->variable_name)
-				fprintf(fp, "\t_%s=%d;%s\n", temp_customvariablesmember->variable_name, temp_customvariablesmember->has_been_modified, (temp_customvariablesmember->variable_value == NULL) ? "" : temp_customvariablesmember->variable_value);
-			}
+		write_customvars(fp, c->customvars, c->num_customvars);
 		fprintf(fp, "\t}\n\n");
 		}
 
+	/* comments and downtime are read in full */
+	if(ifp)
+		fprintf(ifp, "entries=%lld\n", (long long)ftello(fp));
+
 	/* save all comments */
-	for(temp_comment = comment_list; temp_comment != NULL; temp_comment = temp_comment->next) {
+	for(i = 0, cm = snapshot.comments.items; i < snapshot.comments.len; i++, cm++) {
 
-		if(temp_comment->comment_type == HOST_COMMENT)
+		if(cm->comment_type == HOST_COMMENT)
 			fprintf(fp, "hostcomment {\n");
 		else
 			fprintf(fp, "servicecomment {\n");
-		fprintf(fp, "\thost_name=%s\n", temp_comment->host_name);
-		if(temp_comment->comment_type == SERVICE_COMMENT)
-			fprintf(fp, "\tservice_description=%s\n", temp_comment->service_description);
-		fprintf(fp, "\tentry_type=%d\n", temp_comment->entry_type);
-		fprintf(fp, "\tcomment_id=%lu\n", temp_comment->comment_id);
-		fprintf(fp, "\tsource=%d\n", temp_comment->source);
-		fprintf(fp, "\tpersistent=%d\n", temp_comment->persistent);
-		fprintf(fp, "\tentry_time=%llu\n", (unsigned long long)temp_comment->entry_time);
-		fprintf(fp, "\texpires=%d\n", temp_comment->expires);
-		fprintf(fp, "\texpire_time=%llu\n", (unsigned long long)temp_comment->expire_time);
-		fprintf(fp, "\tauthor=%s\n", temp_comment->author);
-		fprintf(fp, "\tcomment_data=%s\n", temp_comment->comment_data);
+		fprintf(fp, "\thost_name=%s\n", SD(cm->host_name));
+		if(cm->comment_type == SERVICE_COMMENT)
+			fprintf(fp, "\tservice_description=%s\n", SD(cm->service_description));
+		fprintf(fp, "\tentry_type=%d\n", cm->entry_type);
+		fprintf(fp, "\tcomment_id=%lu\n", cm->comment_id);
+		fprintf(fp, "\tsource=%d\n", cm->source);
+		fprintf(fp, "\tpersistent=%d\n", cm->persistent);
+		fprintf(fp, "\tentry_time=%llu\n", (unsigned long long)cm->entry_time);
+		fprintf(fp, "\texpires=%d\n", cm->expires);
+		fprintf(fp, "\texpire_time=%llu\n", (unsigned long long)cm->expire_time);
+		fprintf(fp, "\tauthor=%s\n", SD(cm->author));
+		fprintf(fp, "\tcomment_data=%s\n", SD(cm->comment_data));
 		fprintf(fp, "\t}\n\n");
 		}
 
 	/* save all downtime */
-	for(temp_downtime = scheduled_downtime_list; temp_downtime != NULL; temp_downtime = temp_downtime->next) {
+	for(i = 0, dt = snapshot.downtimes.items; i < snapshot.downtimes.len; i++, dt++) {
 
-		if(temp_downtime->type == HOST_DOWNTIME)
+		if(dt->type == HOST_DOWNTIME)
 			fprintf(fp, "hostdowntime {\n");
 		else
 			fprintf(fp, "servicedowntime {\n");
-		fprintf(fp, "\thost_name=%s\n", temp_downtime->host_name);
-		if(temp_downtime->type == SERVICE_DOWNTIME)
-			fprintf(fp, "\tservice_description=%s\n", temp_downtime->service_description);
-		fprintf(fp, "\tdowntime_id=%lu\n", temp_downtime->downtime_id);
-		fprintf(fp, "\tcomment_id=%lu\n", temp_downtime->comment_id);
-		fprintf(fp, "\tentry_time=%llu\n", (unsigned long long)temp_downtime->entry_time);
-		fprintf(fp, "\tstart_time=%llu\n", (unsigned long long)temp_downtime->start_time);
-		fprintf(fp, "\tflex_downtime_start=%llu\n", (unsigned long long)temp_downtime->flex_downtime_start);
-		fprintf(fp, "\tend_time=%llu\n", (unsigned long long)temp_downtime->end_time);
-		fprintf(fp, "\ttriggered_by=%lu\n", temp_downtime->triggered_by);
-		fprintf(fp, "\tfixed=%d\n", temp_downtime->fixed);
-		fprintf(fp, "\tduration=%lu\n", temp_downtime->duration);
-		fprintf(fp, "\tis_in_effect=%d\n", temp_downtime->is_in_effect);
-		fprintf(fp, "\tstart_notification_sent=%d\n", temp_downtime->start_notification_sent);
-		fprintf(fp, "\tauthor=%s\n", temp_downtime->author);
-		fprintf(fp, "\tcomment=%s\n", temp_downtime->comment);
+		fprintf(fp, "\thost_name=%s\n", SD(dt->host_name));
+		if(dt->type == SERVICE_DOWNTIME)
+			fprintf(fp, "\tservice_description=%s\n", SD(dt->service_description));
+		fprintf(fp, "\tdowntime_id=%lu\n", dt->downtime_id);
+		fprintf(fp, "\tcomment_id=%lu\n", dt->comment_id);
+		fprintf(fp, "\tentry_time=%llu\n", (unsigned long long)dt->entry_time);
+		fprintf(fp, "\tstart_time=%llu\n", (unsigned long long)dt->start_time);
+		fprintf(fp, "\tflex_downtime_start=%llu\n", (unsigned long long)dt->flex_downtime_start);
+		fprintf(fp, "\tend_time=%llu\n", (unsigned long long)dt->end_time);
+		fprintf(fp, "\ttriggered_by=%lu\n", dt->triggered_by);
+		fprintf(fp, "\tfixed=%d\n", dt->fixed);
+		fprintf(fp, "\tduration=%lu\n", dt->duration);
+		fprintf(fp, "\tis_in_effect=%d\n", dt->is_in_effect);
+		fprintf(fp, "\tstart_notification_sent=%d\n", dt->start_notification_sent);
+		fprintf(fp, "\tauthor=%s\n", SD(dt->author));
+		fprintf(fp, "\tcomment=%s\n", SD(dt->comment));
 		fprintf(fp, "\t}\n\n");
 		}
 
@@ -438,6 +945,13 @@ int xsddefault_save_status_data(void) {
 	/* flush the file to disk */
 	fflush(fp);
 
+	/* the index is only good for a status file of exactly this size */
+	if(ifp) {
+		fprintf(ifp, "size=%lld\n", (long long)ftello(fp));
+		if(fclose(ifp))
+			move_status_index(FALSE);
+		}
+
 	/* fsync the file so that it is completely written out before moving it */
 	fsync(fd);
 
@@ -450,11 +964,21 @@ int xsddefault_save_status_data(void) {
 		result = OK;
 
 		/* move the temp file to the status log (overwrite the old status log) */
-		if(my_rename(tmp_log, status_file)) {
-			unlink(tmp_log);
-			logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Unable to update status data file '%s': %s", status_file, strerror(errno));
+		if(rename(snapshot.tmp_log, SD(snapshot.status_file))) {
+
+			/* copying across file systems logs its own errors, so the main thread does that */
+			if(errno == EXDEV) {
+				snapshot.copy_pending = TRUE;
+				return OK;
+				}
+
+			move_status_index(FALSE);
+			unlink(snapshot.tmp_log);
+			snprintf(snapshot.error_msg, sizeof(snapshot.error_msg), "Error: Unable to update status data file '%s': %s", SD(snapshot.status_file), strerror(errno));
 			result = ERROR;
 			}
+		else
+			move_status_index(TRUE);
 		}
 
 	/* a problem occurred saving the file */
@@ -462,17 +986,442 @@ int xsddefault_save_status_data(void) {
 
 		result = ERROR;
 
-		/* remove temp file and log an error */
-		unlink(tmp_log);
-		logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Unable to save status file: %s", strerror(errno));
+		/* remove temp files and log an error */
+		move_status_index(FALSE);
+		unlink(snapshot.tmp_log);
+		snprintf(snapshot.error_msg, sizeof(snapshot.error_msg), "Error: Unable to save status file: %s", strerror(errno));
 		}
 
-	/* free memory */
-	my_free(tmp_log);
+	return result;
+	}
+
+
+static void *status_writer_main(void *discard) {
+	int result;
+
+	result = write_status_snapshot();
+
+	pthread_mutex_lock(&status_writer.lock);
+	snapshot.error = result == ERROR;
+	status_writer.done = TRUE;
+	pthread_mutex_unlock(&status_writer.lock);
+
+	return NULL;
+	}
+
+
+/* finishes up after the last write - logs its errors and moves the file into place if need be */
+static int finish_status_write(int result) {
+
+	if(snapshot.error == TRUE)
+		result = ERROR;
+	if(*snapshot.error_msg)
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "%s", snapshot.error_msg);
+	*snapshot.error_msg = 0;
+	snapshot.error = FALSE;
+
+	if(snapshot.copy_pending == TRUE) {
+		snapshot.copy_pending = FALSE;
+		if(my_rename(snapshot.tmp_log, SD(snapshot.status_file))) {
+			unlink(snapshot.tmp_log);
+			logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Unable to update status data file '%s': %s", SD(snapshot.status_file), strerror(errno));
+			result = ERROR;
+			}
+		move_status_index(result == OK);
+		}
 
 	return result;
 	}
 
+
+/*
+ * Reaps the writer thread. Returns TRUE if the snapshot is free for the
+ * next dump. If 'wait' is FALSE and the writer is still busy, we leave
+ * it alone.
+ */
+static int reap_status_writer(int wait) {
+	int done;
+
+	if(status_writer.running == FALSE)
+		return TRUE;
+
+	pthread_mutex_lock(&status_writer.lock);
+	done = status_writer.done;
+	pthread_mutex_unlock(&status_writer.lock);
+	if(done == FALSE && wait == FALSE)
+		return FALSE;
+
+	pthread_join(status_writer.tid, NULL);
+	status_writer.running = FALSE;
+	finish_status_write(OK);
+
+	return TRUE;
+	}
+
+
+static void free_status_snapshot(void) {
+
+	my_free(snapshot.hosts.items);
+	my_free(snapshot.services.items);
+	my_free(snapshot.contacts.items);
+	my_free(snapshot.comments.items);
+	my_free(snapshot.downtimes.items);
+	my_free(snapshot.customvars.items);
+	my_free(snapshot.strings);
+	my_free(snapshot.tmp_log);
+	my_free(snapshot.tmp_index);
+	memset(&snapshot, 0, sizeof(snapshot));
+	}
+
+
+/* write all status data to file */
+int xsddefault_save_status_data(void) {
+	sigset_t all, old;
+	int result = OK;
+
+	log_debug_info(DEBUGL_FUNCTIONS, 0, "save_status_data()\n");
+
+	/* refresh the store's program status and check statistics */
+	sync_status_store(FALSE);
+
+	/* users may not want us to write status data */
+	if(!status_file || !strcmp(status_file, "/dev/null"))
+		return OK;
+
+	/* the last dump hasn't been written yet, so this one is skipped */
+	if(reap_status_writer(FALSE) == FALSE) {
+		log_debug_info(DEBUGL_STATUSDATA, 1, "Still writing the last status data snapshot, skipping this one\n");
+		return OK;
+		}
+
+	if(take_status_snapshot() == ERROR) {
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Unable to allocate memory for status data snapshot\n");
+		return ERROR;
+		}
+
+	log_debug_info(DEBUGL_STATUSDATA, 2, "Took status data snapshot of %u hosts and %u services (%lu bytes of strings)\n", snapshot.hosts.len, snapshot.services.len, (unsigned long)snapshot.strings_len);
+
+	if(status_writer_thread == TRUE) {
+		status_writer.done = FALSE;
+
+		/* signals are for the main thread only */
+		sigfillset(&all);
+		pthread_sigmask(SIG_SETMASK, &all, &old);
+		if(pthread_create(&status_writer.tid, NULL, status_writer_main, NULL) == 0)
+			status_writer.running = TRUE;
+		pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+		if(status_writer.running == TRUE)
+			return OK;
+		log_debug_info(DEBUGL_STATUSDATA, 1, "Unable to start status data writer thread, writing status data on the main thread\n");
+		}
+
+	result = write_status_snapshot();
+
+	return finish_status_write(result);
+	}
+
+
+/******************************************************************/
+/******************* BINARY STATUS STORE OUTPUT *******************/
+/******************************************************************/
+
+static struct xsd_store status_store;
+static int status_store_dirty = FALSE;
+
+#define store_write_begin(rec) do { \
+	((volatile uint32_t *)&(rec)->generation)[0]++; \
+	__sync_synchronize(); \
+	} while(0)
+#define store_write_end(rec) do { \
+	__sync_synchronize(); \
+	((volatile uint32_t *)&(rec)->generation)[0]++; \
+	} while(0)
+
+static void store_copy_string(char *dest, const char *src, size_t size) {
+	size_t len = src ? strlen(src) : 0;
+
+	if(len >= size)
+		len = size - 1;
+	memcpy(dest, src ? src : "", len);
+	dest[len] = 0;
+	}
+
+
+static void store_host(host *hst, time_t now) {
+	struct xsd_store_host *rec;
+
+	if(status_store.map == NULL || hst->id >= status_store.header->num_hosts)
+		return;
+
+	rec = &status_store.hosts[hst->id];
+	store_write_begin(rec);
+	rec->last_update = now;
+	rec->last_check = hst->last_check;
+	rec->next_check = hst->next_check;
+	rec->last_state_change = hst->last_state_change;
+	rec->last_hard_state_change = hst->last_hard_state_change;
+	rec->last_time_up = hst->last_time_up;
+	rec->last_time_down = hst->last_time_down;
+	rec->last_time_unreachable = hst->last_time_unreachable;
+	rec->last_notification = hst->last_notification;
+	rec->next_notification = hst->next_notification;
+	rec->execution_time = hst->execution_time;
+	rec->latency = hst->latency;
+	rec->percent_state_change = hst->percent_state_change;
+	rec->current_state = hst->current_state;
+	rec->last_hard_state = hst->last_hard_state;
+	rec->state_type = hst->state_type;
+	rec->check_type = hst->check_type;
+	rec->check_options = hst->check_options;
+	rec->has_been_checked = hst->has_been_checked;
+	rec->should_be_scheduled = hst->should_be_scheduled;
+	rec->current_attempt = hst->current_attempt;
+	rec->max_attempts = hst->max_attempts;
+	rec->no_more_notifications = hst->no_more_notifications;
+	rec->current_notification_number = hst->current_notification_number;
+	rec->notifications_enabled = hst->notifications_enabled;
+	rec->problem_has_been_acknowledged = hst->problem_has_been_acknowledged;
+	rec->acknowledgement_type = hst->acknowledgement_type;
+	rec->checks_enabled = hst->checks_enabled;
+	rec->accept_passive_checks = hst->accept_passive_checks;
+	rec->event_handler_enabled = hst->event_handler_enabled;
+	rec->flap_detection_enabled = hst->flap_detection_enabled;
+	rec->process_performance_data = hst->process_performance_data;
+	rec->obsess = hst->obsess;
+	rec->is_flapping = hst->is_flapping;
+	rec->scheduled_downtime_depth = hst->scheduled_downtime_depth;
+	store_copy_string(rec->plugin_output, hst->plugin_output, sizeof(rec->plugin_output));
+	store_copy_string(rec->perf_data, hst->perf_data, sizeof(rec->perf_data));
+	store_write_end(rec);
+	}
+
+
+static void store_service(service *svc, time_t now) {
+	struct xsd_store_service *rec;
+
+	if(status_store.map == NULL || svc->id >= status_store.header->num_services)
+		return;
+
+	rec = &status_store.services[svc->id];
+	store_write_begin(rec);
+	rec->last_update = now;
+	rec->last_check = svc->last_check;
+	rec->next_check = svc->next_check;
+	rec->last_state_change = svc->last_state_change;
+	rec->last_hard_state_change = svc->last_hard_state_change;
+	rec->last_time_ok = svc->last_time_ok;
+	rec->last_time_warning = svc->last_time_warning;
+	rec->last_time_unknown = svc->last_time_unknown;
+	rec->last_time_critical = svc->last_time_critical;
+	rec->last_notification = svc->last_notification;
+	rec->next_notification = svc->next_notification;
+	rec->execution_time = svc->execution_time;
+	rec->latency = svc->latency;
+	rec->percent_state_change = svc->percent_state_change;
+	rec->current_state = svc->current_state;
+	rec->last_hard_state = svc->last_hard_state;
+	rec->state_type = svc->state_type;
+	rec->check_type = svc->check_type;
+	rec->check_options = svc->check_options;
+	rec->has_been_checked = svc->has_been_checked;
+	rec->should_be_scheduled = svc->should_be_scheduled;
+	rec->current_attempt = svc->current_attempt;
+	rec->max_attempts = svc->max_attempts;
+	rec->no_more_notifications = svc->no_more_notifications;
+	rec->current_notification_number = svc->current_notification_number;
+	rec->notifications_enabled = svc->notifications_enabled;
+	rec->problem_has_been_acknowledged = svc->problem_has_been_acknowledged;
+	rec->acknowledgement_type = svc->acknowledgement_type;
+	rec->checks_enabled = svc->checks_enabled;
+	rec->accept_passive_checks = svc->accept_passive_checks;
+	rec->event_handler_enabled = svc->event_handler_enabled;
+	rec->flap_detection_enabled = svc->flap_detection_enabled;
+	rec->process_performance_data = svc->process_performance_data;
+	rec->obsess = svc->obsess;
+	rec->is_flapping = svc->is_flapping;
+	rec->scheduled_downtime_depth = svc->scheduled_downtime_depth;
+	store_copy_string(rec->plugin_output, svc->plugin_output, sizeof(rec->plugin_output));
+	store_copy_string(rec->perf_data, svc->perf_data, sizeof(rec->perf_data));
+	store_write_end(rec);
+	}
+
+
+/*
+ * Refreshes the program status in the store. Hosts and services are
+ * kept current by their update calls, so records are only rewritten
+ * when asked to or when the store has been marked dirty by something
+ * that changed objects without updating them, such as reading
+ * retention data after the store was built.
+ */
+static void sync_status_store(int all_records) {
+	struct xsd_store_header *hdr = status_store.header;
+	host *temp_host;
+	service *temp_service;
+	time_t now;
+	int x;
+
+	if(status_store.map == NULL)
+		return;
+
+	time(&now);
+	generate_check_stats();
+
+	store_write_begin(hdr);
+	hdr->nagios_pid = nagios_pid;
+	hdr->program_start = program_start;
+	hdr->last_update = now;
+	for(x = 0; x < MAX_CHECK_STATS_TYPES && x < XSD_STORE_CHECK_STATS; x++) {
+		hdr->check_stats[x][0] = check_statistics[x].minute_stats[0];
+		hdr->check_stats[x][1] = check_statistics[x].minute_stats[1];
+		hdr->check_stats[x][2] = check_statistics[x].minute_stats[2];
+		}
+	store_write_end(hdr);
+
+	if(all_records == FALSE && status_store_dirty == FALSE)
+		return;
+
+	for(temp_host = host_list; temp_host != NULL; temp_host = temp_host->next)
+		store_host(temp_host, now);
+	for(temp_service = service_list; temp_service != NULL; temp_service = temp_service->next)
+		store_service(temp_service, now);
+	status_store_dirty = FALSE;
+	}
+
+
+/*
+ * Creates the status store for the objects we have now. It's built
+ * under a temporary name and renamed into place, so readers either
+ * see the old store or a complete new one.
+ */
+static int open_status_store(void) {
+	struct xsd_store_header *hdr;
+	host *temp_host;
+	service *temp_service;
+	char *tmp_path = NULL, *names;
+	size_t names_size = 1, size, len;
+	uint32_t *offset;
+	int fd;
+
+	if(!status_store_file)
+		return OK;
+
+	for(temp_host = host_list; temp_host != NULL; temp_host = temp_host->next)
+		names_size += strlen(temp_host->name) + 1;
+	for(temp_service = service_list; temp_service != NULL; temp_service = temp_service->next)
+		names_size += strlen(temp_service->host_name) + strlen(temp_service->description) + 2;
+	if(names_size > UINT32_MAX) {
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Too many object names for status store '%s'\n", status_store_file);
+		return ERROR;
+		}
+
+	size = sizeof(*hdr) + num_objects.hosts * sizeof(struct xsd_store_host) + num_objects.services * sizeof(struct xsd_store_service) + names_size;
+
+	asprintf(&tmp_path, "%s.XXXXXX", status_store_file);
+	if(tmp_path == NULL)
+		return ERROR;
+	if((fd = mkstemp(tmp_path)) == -1) {
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Unable to create temp file '%s' for status store: %s\n", tmp_path, strerror(errno));
+		my_free(tmp_path);
+		return ERROR;
+		}
+	fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH);
+
+	/* the file starts out zeroed, so every generation is even */
+	if(ftruncate(fd, size) == -1 || (status_store.map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Unable to map status store '%s': %s\n", tmp_path, strerror(errno));
+		status_store.map = NULL;
+		close(fd);
+		unlink(tmp_path);
+		my_free(tmp_path);
+		return ERROR;
+		}
+	close(fd);
+
+	status_store.size = size;
+	status_store.header = hdr = (struct xsd_store_header *)status_store.map;
+	status_store.hosts = (struct xsd_store_host *)(status_store.map + sizeof(*hdr));
+	status_store.services = (struct xsd_store_service *)(status_store.hosts + num_objects.hosts);
+	status_store.names = names = status_store.map + size - names_size;
+
+	hdr->magic = XSD_STORE_MAGIC;
+	hdr->version = XSD_STORE_VERSION;
+	hdr->header_size = sizeof(*hdr);
+	hdr->host_size = sizeof(struct xsd_store_host);
+	hdr->service_size = sizeof(struct xsd_store_service);
+	hdr->num_hosts = num_objects.hosts;
+	hdr->num_services = num_objects.services;
+	hdr->names_offset = size - names_size;
+	hdr->names_size = names_size;
+	hdr->created = time(NULL);
+	strncpy(hdr->program_version, PROGRAM_VERSION, sizeof(hdr->program_version) - 1);
+
+	/* offset 0 is the empty string */
+	names_size = 1;
+	for(temp_host = host_list; temp_host != NULL; temp_host = temp_host->next) {
+		len = strlen(temp_host->name) + 1;
+		memcpy(names + names_size, temp_host->name, len);
+		status_store.hosts[temp_host->id].name = names_size;
+		names_size += len;
+		}
+	for(temp_service = service_list; temp_service != NULL; temp_service = temp_service->next) {
+		offset = &status_store.services[temp_service->id].host_name;
+		len = strlen(temp_service->host_name) + 1;
+		memcpy(names + names_size, temp_service->host_name, len);
+		*offset = names_size;
+		names_size += len;
+		offset = &status_store.services[temp_service->id].description;
+		len = strlen(temp_service->description) + 1;
+		memcpy(names + names_size, temp_service->description, len);
+		*offset = names_size;
+		names_size += len;
+		}
+
+	sync_status_store(TRUE);
+
+	/* retention data is read after this, without any update calls */
+	status_store_dirty = TRUE;
+
+	if(my_rename(tmp_path, status_store_file)) {
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Unable to move status store into place as '%s': %s\n", status_store_file, strerror(errno));
+		unlink(tmp_path);
+		my_free(tmp_path);
+		close_status_store();
+		return ERROR;
+		}
+	my_free(tmp_path);
+
+	log_debug_info(DEBUGL_STATUSDATA, 1, "Created status store '%s' for %u hosts and %u services\n", status_store_file, num_objects.hosts, num_objects.services);
+
+	return OK;
+	}
+
+
+static void close_status_store(void) {
+
+	if(status_store.map)
+		munmap(status_store.map, status_store.size);
+	memset(&status_store, 0, sizeof(status_store));
+	}
+
+
+/* updates a host's record in the status store */
+int xsddefault_update_host_status(host *hst) {
+
+	store_host(hst, time(NULL));
+
+	return OK;
+	}
+
+
+/* updates a service's record in the status store */
+int xsddefault_update_service_status(service *svc) {
+
+	store_service(svc, time(NULL));
+
+	return OK;
+	}
+
 #endif
 
 
@@ -483,551 +1432,901 @@ int xsddefault_save_status_data(void) {
 /****************** DEFAULT DATA INPUT FUNCTIONS ******************/
 /******************************************************************/
 
-/* read all program, host, and service status information */
-int xsddefault_read_status_data(const char *status_file_name, int options) {
-#ifdef NO_MMAP
-	char input[MAX_PLUGIN_OUTPUT_LENGTH] = "";
-	FILE *fp = NULL;
-#else
-	char *input = NULL;
-	mmapfile *thefile = NULL;
-#endif
-	int data_type = XSDDEFAULT_NO_DATA;
-	hoststatus *temp_hoststatus = NULL;
-	servicestatus *temp_servicestatus = NULL;
-	char *var = NULL;
-	char *val = NULL;
-	char *ptr = NULL;
-	/* comment and downtime vars */
-	unsigned long comment_id = 0;
-	int persistent = FALSE;
-	int expires = FALSE;
-	time_t expire_time = 0L;
-	int entry_type = USER_COMMENT;
-	int source = COMMENTSOURCE_INTERNAL;
-	time_t entry_time = 0L;
-	char *host_name = NULL;
-	char *service_description = NULL;
-	char *author = NULL;
-	char *comment_data = NULL;
-	scheduled_downtime *temp_downtime;
-	unsigned long downtime_id = 0;
-	time_t start_time = 0L;
-	time_t flex_downtime_start = 0L;
-	time_t end_time = 0L;
-	int fixed = FALSE;
-	unsigned long triggered_by = 0;
-	unsigned long duration = 0L;
-	int x = 0;
-	int is_in_effect = FALSE;
-	int start_notification_sent = FALSE;
+/* reads host and service status from the status store */
+static int read_status_store(int options) {
+	struct xsd_store store;
+	struct xsd_store_host hst;
+	struct xsd_store_service svc;
+	hoststatus *temp_hoststatus;
+	servicestatus *temp_servicestatus;
+	unsigned int i;
+	int result = OK;
 
+	if(xsd_store_open(&store, status_store_file) == ERROR)
+		return ERROR;
 
-	/* initialize some vars */
-	for(x = 0; x < MAX_CHECK_STATS_TYPES; x++) {
-		program_stats[x][0] = 0;
-		program_stats[x][1] = 0;
-		program_stats[x][2] = 0;
+	for(i = 0; (options & READ_HOST_STATUS) && i < store.header->num_hosts; i++) {
+		/* one the core keeps rewriting is left out rather than torn */
+		if(xsd_store_read_host(&store, i, &hst) == ERROR)
+			continue;
+		if(hoststatus_filter_match(xsd_store_name(&store, hst.name)) == FALSE)
+			continue;
+		if((temp_hoststatus = (hoststatus *)calloc(1, sizeof(hoststatus))) == NULL) {
+			result = ERROR;
+			break;
+			}
+		temp_hoststatus->host_name = (char *)strdup(xsd_store_name(&store, hst.name));
+		temp_hoststatus->plugin_output = (char *)strdup(hst.plugin_output);
+		temp_hoststatus->perf_data = (char *)strdup(hst.perf_data);
+		temp_hoststatus->status = hst.current_state;
+		temp_hoststatus->last_update = hst.last_update;
+		temp_hoststatus->has_been_checked = hst.has_been_checked;
+		temp_hoststatus->should_be_scheduled = hst.should_be_scheduled;
+		temp_hoststatus->current_attempt = hst.current_attempt;
+		temp_hoststatus->max_attempts = hst.max_attempts;
+		temp_hoststatus->last_check = hst.last_check;
+		temp_hoststatus->next_check = hst.next_check;
+		temp_hoststatus->check_options = hst.check_options;
+		temp_hoststatus->check_type = hst.check_type;
+		temp_hoststatus->last_state_change = hst.last_state_change;
+		temp_hoststatus->last_hard_state_change = hst.last_hard_state_change;
+		temp_hoststatus->last_hard_state = hst.last_hard_state;
+		temp_hoststatus->last_time_up = hst.last_time_up;
+		temp_hoststatus->last_time_down = hst.last_time_down;
+		temp_hoststatus->last_time_unreachable = hst.last_time_unreachable;
+		temp_hoststatus->state_type = hst.state_type;
+		temp_hoststatus->last_notification = hst.last_notification;
+		temp_hoststatus->next_notification = hst.next_notification;
+		temp_hoststatus->no_more_notifications = hst.no_more_notifications;
+		temp_hoststatus->notifications_enabled = hst.notifications_enabled;
+		temp_hoststatus->problem_has_been_acknowledged = hst.problem_has_been_acknowledged;
+		temp_hoststatus->acknowledgement_type = hst.acknowledgement_type;
+		temp_hoststatus->current_notification_number = hst.current_notification_number;
+		temp_hoststatus->accept_passive_checks = hst.accept_passive_checks;
+		temp_hoststatus->event_handler_enabled = hst.event_handler_enabled;
+		temp_hoststatus->checks_enabled = hst.checks_enabled;
+		temp_hoststatus->flap_detection_enabled = hst.flap_detection_enabled;
+		temp_hoststatus->is_flapping = hst.is_flapping;
+		temp_hoststatus->percent_state_change = hst.percent_state_change;
+		temp_hoststatus->latency = hst.latency;
+		temp_hoststatus->execution_time = hst.execution_time;
+		temp_hoststatus->scheduled_downtime_depth = hst.scheduled_downtime_depth < 0 ? 0 : hst.scheduled_downtime_depth;
+		temp_hoststatus->process_performance_data = hst.process_performance_data;
+		temp_hoststatus->obsess = hst.obsess;
+		add_host_status(temp_hoststatus);
 		}
 
-	/* open the status file for reading */
+	for(i = 0; result == OK && (options & READ_SERVICE_STATUS) && i < store.header->num_services; i++) {
+		if(xsd_store_read_service(&store, i, &svc) == ERROR)
+			continue;
+		if(servicestatus_filter_match(xsd_store_name(&store, svc.host_name), xsd_store_name(&store, svc.description)) == FALSE)
+			continue;
+		if((temp_servicestatus = (servicestatus *)calloc(1, sizeof(servicestatus))) == NULL) {
+			result = ERROR;
+			break;
+			}
+		temp_servicestatus->host_name = (char *)strdup(xsd_store_name(&store, svc.host_name));
+		temp_servicestatus->description = (char *)strdup(xsd_store_name(&store, svc.description));
+		temp_servicestatus->plugin_output = (char *)strdup(svc.plugin_output);
+		temp_servicestatus->perf_data = (char *)strdup(svc.perf_data);
+		temp_servicestatus->status = svc.current_state;
+		temp_servicestatus->last_update = svc.last_update;
+		temp_servicestatus->has_been_checked = svc.has_been_checked;
+		temp_servicestatus->should_be_scheduled = svc.should_be_scheduled;
+		temp_servicestatus->current_attempt = svc.current_attempt;
+		temp_servicestatus->max_attempts = svc.max_attempts;
+		temp_servicestatus->last_check = svc.last_check;
+		temp_servicestatus->next_check = svc.next_check;
+		temp_servicestatus->check_options = svc.check_options;
+		temp_servicestatus->check_type = svc.check_type;
+		temp_servicestatus->checks_enabled = svc.checks_enabled;
+		temp_servicestatus->last_state_change = svc.last_state_change;
+		temp_servicestatus->last_hard_state_change = svc.last_hard_state_change;
+		temp_servicestatus->last_hard_state = svc.last_hard_state;
+		temp_servicestatus->last_time_ok = svc.last_time_ok;
+		temp_servicestatus->last_time_warning = svc.last_time_warning;
+		temp_servicestatus->last_time_unknown = svc.last_time_unknown;
+		temp_servicestatus->last_time_critical = svc.last_time_critical;
+		temp_servicestatus->state_type = svc.state_type;
+		temp_servicestatus->last_notification = svc.last_notification;
+		temp_servicestatus->next_notification = svc.next_notification;
+		temp_servicestatus->no_more_notifications = svc.no_more_notifications;
+		temp_servicestatus->notifications_enabled = svc.notifications_enabled;
+		temp_servicestatus->problem_has_been_acknowledged = svc.problem_has_been_acknowledged;
+		temp_servicestatus->acknowledgement_type = svc.acknowledgement_type;
+		temp_servicestatus->current_notification_number = svc.current_notification_number;
+		temp_servicestatus->accept_passive_checks = svc.accept_passive_checks;
+		temp_servicestatus->event_handler_enabled = svc.event_handler_enabled;
+		temp_servicestatus->flap_detection_enabled = svc.flap_detection_enabled;
+		temp_servicestatus->is_flapping = svc.is_flapping;
+		temp_servicestatus->percent_state_change = svc.percent_state_change;
+		temp_servicestatus->latency = svc.latency;
+		temp_servicestatus->execution_time = svc.execution_time;
+		temp_servicestatus->scheduled_downtime_depth = svc.scheduled_downtime_depth < 0 ? 0 : svc.scheduled_downtime_depth;
+		temp_servicestatus->process_performance_data = svc.process_performance_data;
+		temp_servicestatus->obsess = svc.obsess;
+		add_service_status(temp_servicestatus);
+		}
+
+	xsd_store_close(&store);
+
+	return result;
+	}
+
+
+/*
+ * Status data keys are looked up in a table per block type, which
+ * says where the value goes and how to parse it, so reading a line
+ * is a hash lookup rather than a strcmp() for every known key.
+ */
+enum {
+	XSD_INT,
+	XSD_BOOL,
+	XSD_TIME,
+	XSD_ULONG,
+	XSD_DOUBLE,
+	XSD_STRING,
+	XSD_OUTPUT,   /* string with escaped newlines */
+	XSD_DEPTH,    /* int that can't be negative */
+	XSD_STATS,    /* "1min,5min,15min" check stats */
+	};
+
+struct xsd_field {
+	const char *name;
+	int type;
+	size_t offset; /* into the block's struct... */
+	void *addr;    /* ...or a global to set */
+	};
+
+#define XSD_FIELD_SLOTS 256
+
+struct xsd_field_table {
+	const struct xsd_field *fields;
+	unsigned int num_fields;
+	int indexed;
+	unsigned char slot[XSD_FIELD_SLOTS]; /* field index + 1, 0 is empty */
+	};
+
+/* comments and downtimes, as they're read */
+struct xsd_entry {
+	char *host_name, *service_description, *author, *comment_data;
+	unsigned long comment_id, downtime_id, triggered_by, duration;
+	time_t entry_time, expire_time, start_time, flex_downtime_start, end_time;
+	int entry_type, source, persistent, expires, fixed, is_in_effect, start_notification_sent;
+	};
+
+#define HOST_FIELD(name, type, member) { name, type, offsetof(hoststatus, member), NULL }
+#define SERVICE_FIELD(name, type, member) { name, type, offsetof(servicestatus, member), NULL }
+#define ENTRY_FIELD(name, type, member) { name, type, offsetof(struct xsd_entry, member), NULL }
+#define GLOBAL_FIELD(name, type, var) { name, type, 0, &(var) }
+
+/* when the status file we're reading was written */
+static time_t status_file_created;
+
+static const struct xsd_field info_fields[] = {
+	GLOBAL_FIELD("created", XSD_TIME, status_file_created),
+	};
+
+/* NOTE: some vars are not read, as they are not used by the CGIs (modified attributes, event handler commands, etc.) */
+static const struct xsd_field program_fields[] = {
+	GLOBAL_FIELD("nagios_pid", XSD_INT, nagios_pid),
+	GLOBAL_FIELD("daemon_mode", XSD_BOOL, daemon_mode),
+	GLOBAL_FIELD("program_start", XSD_TIME, program_start),
+	GLOBAL_FIELD("last_log_rotation", XSD_TIME, last_log_rotation),
+	GLOBAL_FIELD("enable_notifications", XSD_BOOL, enable_notifications),
+	GLOBAL_FIELD("active_service_checks_enabled", XSD_BOOL, execute_service_checks),
+	GLOBAL_FIELD("passive_service_checks_enabled", XSD_BOOL, accept_passive_service_checks),
+	GLOBAL_FIELD("active_host_checks_enabled", XSD_BOOL, execute_host_checks),
+	GLOBAL_FIELD("passive_host_checks_enabled", XSD_BOOL, accept_passive_host_checks),
+	GLOBAL_FIELD("enable_event_handlers", XSD_BOOL, enable_event_handlers),
+	GLOBAL_FIELD("obsess_over_services", XSD_BOOL, obsess_over_services),
+	GLOBAL_FIELD("obsess_over_hosts", XSD_BOOL, obsess_over_hosts),
+	GLOBAL_FIELD("check_service_freshness", XSD_BOOL, check_service_freshness),
+	GLOBAL_FIELD("check_host_freshness", XSD_BOOL, check_host_freshness),
+	GLOBAL_FIELD("enable_flap_detection", XSD_BOOL, enable_flap_detection),
+	GLOBAL_FIELD("process_performance_data", XSD_BOOL, process_performance_data),
+	GLOBAL_FIELD("active_scheduled_host_check_stats", XSD_STATS, program_stats[ACTIVE_SCHEDULED_HOST_CHECK_STATS]),
+	GLOBAL_FIELD("active_ondemand_host_check_stats", XSD_STATS, program_stats[ACTIVE_ONDEMAND_HOST_CHECK_STATS]),
+	GLOBAL_FIELD("passive_host_check_stats", XSD_STATS, program_stats[PASSIVE_HOST_CHECK_STATS]),
+	GLOBAL_FIELD("active_scheduled_service_check_stats", XSD_STATS, program_stats[ACTIVE_SCHEDULED_SERVICE_CHECK_STATS]),
+	GLOBAL_FIELD("active_ondemand_service_check_stats", XSD_STATS, program_stats[ACTIVE_ONDEMAND_SERVICE_CHECK_STATS]),
+	GLOBAL_FIELD("passive_service_check_stats", XSD_STATS, program_stats[PASSIVE_SERVICE_CHECK_STATS]),
+	GLOBAL_FIELD("cached_host_check_stats", XSD_STATS, program_stats[ACTIVE_CACHED_HOST_CHECK_STATS]),
+	GLOBAL_FIELD("cached_service_check_stats", XSD_STATS, program_stats[ACTIVE_CACHED_SERVICE_CHECK_STATS]),
+	GLOBAL_FIELD("external_command_stats", XSD_STATS, program_stats[EXTERNAL_COMMAND_STATS]),
+	GLOBAL_FIELD("parallel_host_check_stats", XSD_STATS, program_stats[PARALLEL_HOST_CHECK_STATS]),
+	GLOBAL_FIELD("serial_host_check_stats", XSD_STATS, program_stats[SERIAL_HOST_CHECK_STATS]),
+	GLOBAL_FIELD("coalesced_host_check_stats", XSD_STATS, program_stats[COALESCED_HOST_CHECK_STATS]),
+	GLOBAL_FIELD("coalesced_service_check_stats", XSD_STATS, program_stats[COALESCED_SERVICE_CHECK_STATS]),
+	};
+
+static const struct xsd_field host_fields[] = {
+	HOST_FIELD("host_name", XSD_STRING, host_name),
+	HOST_FIELD("has_been_checked", XSD_BOOL, has_been_checked),
+	HOST_FIELD("should_be_scheduled", XSD_BOOL, should_be_scheduled),
+	HOST_FIELD("check_execution_time", XSD_DOUBLE, execution_time),
+	HOST_FIELD("check_latency", XSD_DOUBLE, latency),
+	HOST_FIELD("check_type", XSD_INT, check_type),
+	HOST_FIELD("current_state", XSD_INT, status),
+	HOST_FIELD("last_hard_state", XSD_INT, last_hard_state),
+	HOST_FIELD("plugin_output", XSD_OUTPUT, plugin_output),
+	HOST_FIELD("long_plugin_output", XSD_OUTPUT, long_plugin_output),
+	HOST_FIELD("performance_data", XSD_STRING, perf_data),
+	HOST_FIELD("current_attempt", XSD_INT, current_attempt),
+	HOST_FIELD("max_attempts", XSD_INT, max_attempts),
+	HOST_FIELD("last_check", XSD_TIME, last_check),
+	HOST_FIELD("next_check", XSD_TIME, next_check),
+	HOST_FIELD("check_options", XSD_INT, check_options),
+	HOST_FIELD("state_type", XSD_INT, state_type),
+	HOST_FIELD("last_state_change", XSD_TIME, last_state_change),
+	HOST_FIELD("last_hard_state_change", XSD_TIME, last_hard_state_change),
+	HOST_FIELD("last_time_up", XSD_TIME, last_time_up),
+	HOST_FIELD("last_time_down", XSD_TIME, last_time_down),
+	HOST_FIELD("last_time_unreachable", XSD_TIME, last_time_unreachable),
+	HOST_FIELD("last_notification", XSD_TIME, last_notification),
+	HOST_FIELD("next_notification", XSD_TIME, next_notification),
+	HOST_FIELD("no_more_notifications", XSD_BOOL, no_more_notifications),
+	HOST_FIELD("current_notification_number", XSD_INT, current_notification_number),
+	HOST_FIELD("notifications_enabled", XSD_BOOL, notifications_enabled),
+	HOST_FIELD("problem_has_been_acknowledged", XSD_BOOL, problem_has_been_acknowledged),
+	HOST_FIELD("acknowledgement_type", XSD_INT, acknowledgement_type),
+	HOST_FIELD("active_checks_enabled", XSD_BOOL, checks_enabled),
+	HOST_FIELD("passive_checks_enabled", XSD_BOOL, accept_passive_checks),
+	HOST_FIELD("event_handler_enabled", XSD_BOOL, event_handler_enabled),
+	HOST_FIELD("flap_detection_enabled", XSD_BOOL, flap_detection_enabled),
+	HOST_FIELD("process_performance_data", XSD_BOOL, process_performance_data),
+	HOST_FIELD("obsess_over_host", XSD_BOOL, obsess),
+	HOST_FIELD("obsess", XSD_BOOL, obsess),
+	HOST_FIELD("last_update", XSD_TIME, last_update),
+	HOST_FIELD("is_flapping", XSD_BOOL, is_flapping),
+	HOST_FIELD("percent_state_change", XSD_DOUBLE, percent_state_change),
+	HOST_FIELD("scheduled_downtime_depth", XSD_DEPTH, scheduled_downtime_depth),
+	};
+
+static const struct xsd_field service_fields[] = {
+	SERVICE_FIELD("host_name", XSD_STRING, host_name),
+	SERVICE_FIELD("service_description", XSD_STRING, description),
+	SERVICE_FIELD("has_been_checked", XSD_BOOL, has_been_checked),
+	SERVICE_FIELD("should_be_scheduled", XSD_BOOL, should_be_scheduled),
+	SERVICE_FIELD("check_execution_time", XSD_DOUBLE, execution_time),
+	SERVICE_FIELD("check_latency", XSD_DOUBLE, latency),
+	SERVICE_FIELD("check_type", XSD_INT, check_type),
+	SERVICE_FIELD("current_state", XSD_INT, status),
+	SERVICE_FIELD("last_hard_state", XSD_INT, last_hard_state),
+	SERVICE_FIELD("current_attempt", XSD_INT, current_attempt),
+	SERVICE_FIELD("max_attempts", XSD_INT, max_attempts),
+	SERVICE_FIELD("state_type", XSD_INT, state_type),
+	SERVICE_FIELD("last_state_change", XSD_TIME, last_state_change),
+	SERVICE_FIELD("last_hard_state_change", XSD_TIME, last_hard_state_change),
+	SERVICE_FIELD("last_time_ok", XSD_TIME, last_time_ok),
+	SERVICE_FIELD("last_time_warning", XSD_TIME, last_time_warning),
+	SERVICE_FIELD("last_time_unknown", XSD_TIME, last_time_unknown),
+	SERVICE_FIELD("last_time_critical", XSD_TIME, last_time_critical),
+	SERVICE_FIELD("plugin_output", XSD_OUTPUT, plugin_output),
+	SERVICE_FIELD("long_plugin_output", XSD_OUTPUT, long_plugin_output),
+	SERVICE_FIELD("performance_data", XSD_STRING, perf_data),
+	SERVICE_FIELD("last_check", XSD_TIME, last_check),
+	SERVICE_FIELD("next_check", XSD_TIME, next_check),
+	SERVICE_FIELD("check_options", XSD_INT, check_options),
+	SERVICE_FIELD("current_notification_number", XSD_INT, current_notification_number),
+	SERVICE_FIELD("last_notification", XSD_TIME, last_notification),
+	SERVICE_FIELD("next_notification", XSD_TIME, next_notification),
+	SERVICE_FIELD("no_more_notifications", XSD_BOOL, no_more_notifications),
+	SERVICE_FIELD("notifications_enabled", XSD_BOOL, notifications_enabled),
+	SERVICE_FIELD("active_checks_enabled", XSD_BOOL, checks_enabled),
+	SERVICE_FIELD("passive_checks_enabled", XSD_BOOL, accept_passive_checks),
+	SERVICE_FIELD("event_handler_enabled", XSD_BOOL, event_handler_enabled),
+	SERVICE_FIELD("problem_has_been_acknowledged", XSD_BOOL, problem_has_been_acknowledged),
+	SERVICE_FIELD("acknowledgement_type", XSD_INT, acknowledgement_type),
+	SERVICE_FIELD("flap_detection_enabled", XSD_BOOL, flap_detection_enabled),
+	SERVICE_FIELD("process_performance_data", XSD_BOOL, process_performance_data),
+	SERVICE_FIELD("obsess_over_service", XSD_BOOL, obsess),
+	SERVICE_FIELD("obsess", XSD_BOOL, obsess),
+	SERVICE_FIELD("last_update", XSD_TIME, last_update),
+	SERVICE_FIELD("is_flapping", XSD_BOOL, is_flapping),
+	SERVICE_FIELD("percent_state_change", XSD_DOUBLE, percent_state_change),
+	SERVICE_FIELD("scheduled_downtime_depth", XSD_DEPTH, scheduled_downtime_depth),
+	};
+
+static const struct xsd_field comment_fields[] = {
+	ENTRY_FIELD("host_name", XSD_STRING, host_name),
+	ENTRY_FIELD("service_description", XSD_STRING, service_description),
+	ENTRY_FIELD("entry_type", XSD_INT, entry_type),
+	ENTRY_FIELD("comment_id", XSD_ULONG, comment_id),
+	ENTRY_FIELD("source", XSD_INT, source),
+	ENTRY_FIELD("persistent", XSD_BOOL, persistent),
+	ENTRY_FIELD("entry_time", XSD_TIME, entry_time),
+	ENTRY_FIELD("expires", XSD_BOOL, expires),
+	ENTRY_FIELD("expire_time", XSD_TIME, expire_time),
+	ENTRY_FIELD("author", XSD_STRING, author),
+	ENTRY_FIELD("comment_data", XSD_STRING, comment_data),
+	};
+
+static const struct xsd_field downtime_fields[] = {
+	ENTRY_FIELD("host_name", XSD_STRING, host_name),
+	ENTRY_FIELD("service_description", XSD_STRING, service_description),
+	ENTRY_FIELD("downtime_id", XSD_ULONG, downtime_id),
+	ENTRY_FIELD("comment_id", XSD_ULONG, comment_id),
+	ENTRY_FIELD("entry_time", XSD_TIME, entry_time),
+	ENTRY_FIELD("start_time", XSD_TIME, start_time),
+	ENTRY_FIELD("flex_downtime_start", XSD_TIME, flex_downtime_start),
+	ENTRY_FIELD("end_time", XSD_TIME, end_time),
+	ENTRY_FIELD("fixed", XSD_BOOL, fixed),
+	ENTRY_FIELD("triggered_by", XSD_ULONG, triggered_by),
+	ENTRY_FIELD("duration", XSD_ULONG, duration),
+	ENTRY_FIELD("is_in_effect", XSD_BOOL, is_in_effect),
+	ENTRY_FIELD("start_notification_sent", XSD_BOOL, start_notification_sent),
+	ENTRY_FIELD("author", XSD_STRING, author),
+	ENTRY_FIELD("comment", XSD_STRING, comment_data),
+	};
+
+#define XSD_FIELD_TABLE(fields) { fields, sizeof(fields) / sizeof(fields[0]), FALSE, { 0 } }
+
+static struct xsd_field_table info_table = XSD_FIELD_TABLE(info_fields);
+static struct xsd_field_table program_table = XSD_FIELD_TABLE(program_fields);
+static struct xsd_field_table host_table = XSD_FIELD_TABLE(host_fields);
+static struct xsd_field_table service_table = XSD_FIELD_TABLE(service_fields);
+static struct xsd_field_table comment_table = XSD_FIELD_TABLE(comment_fields);
+static struct xsd_field_table downtime_table = XSD_FIELD_TABLE(downtime_fields);
+
+
+static unsigned int xsd_hash_key(const char *key, size_t len) {
+	unsigned int h = 2166136261U;
+
+	while(len--)
+		h = (h ^ (unsigned char)*key++) * 16777619U;
+
+	return h & (XSD_FIELD_SLOTS - 1);
+	}
+
+
+static const struct xsd_field *xsd_find_field(struct xsd_field_table *table, const char *key, size_t len) {
+	const struct xsd_field *f;
+	unsigned int i, h;
+
+	if(table->indexed == FALSE) {
+		for(i = 0; i < table->num_fields; i++) {
+			f = &table->fields[i];
+			for(h = xsd_hash_key(f->name, strlen(f->name)); table->slot[h]; h = (h + 1) & (XSD_FIELD_SLOTS - 1));
+			table->slot[h] = i + 1;
+			}
+		table->indexed = TRUE;
+		}
+
+	for(h = xsd_hash_key(key, len); table->slot[h]; h = (h + 1) & (XSD_FIELD_SLOTS - 1)) {
+		f = &table->fields[table->slot[h] - 1];
+		if(!strncmp(f->name, key, len) && f->name[len] == '\x0')
+			return f;
+		}
+
+	return NULL;
+	}
+
+
+/* parses a value straight from the status file into its field */
+static void xsd_set_field(const struct xsd_field *f, void *base, const char *val, size_t len) {
+	char *dest = f->addr ? (char *)f->addr : (char *)base + f->offset;
+	char num[64], *str, *ptr;
+	int *stats, x;
+
+	if(f->type == XSD_STRING || f->type == XSD_OUTPUT) {
+		if((str = strndup(val, len)) == NULL)
+			return;
+		if(f->type == XSD_OUTPUT)
+			unescape_newlines(str);
+		my_free(*(char **)dest);
+		*(char **)dest = str;
+		return;
+		}
+
+	/* numbers are copied out, as the value isn't terminated */
+	if(len >= sizeof(num))
+		len = sizeof(num) - 1;
+	memcpy(num, val, len);
+	num[len] = '\x0';
+
+	switch(f->type) {
+		case XSD_INT:
+			*(int *)dest = atoi(num);
+			break;
+		case XSD_BOOL:
+			*(int *)dest = (atoi(num) > 0) ? TRUE : FALSE;
+			break;
+		case XSD_DEPTH:
+			x = atoi(num);
+			*(int *)dest = (x < 0) ? 0 : x;
+			break;
+		case XSD_TIME:
+			*(time_t *)dest = strtoul(num, NULL, 10);
+			break;
+		case XSD_ULONG:
+			*(unsigned long *)dest = strtoul(num, NULL, 10);
+			break;
+		case XSD_DOUBLE:
+			*(double *)dest = strtod(num, NULL);
+			break;
+		case XSD_STATS:
+			stats = (int *)dest;
+			for(x = 0, ptr = num; x < 3 && ptr; x++) {
+				stats[x] = atoi(ptr);
+				if((ptr = strchr(ptr, ',')))
+					ptr++;
+				}
+			break;
+		}
+	}
+
+
+static void xsd_reset_entry(struct xsd_entry *entry) {
+
+	my_free(entry->host_name);
+	my_free(entry->service_description);
+	my_free(entry->author);
+	my_free(entry->comment_data);
+	memset(entry, 0, sizeof(*entry));
+	entry->entry_type = USER_COMMENT;
+	entry->source = COMMENTSOURCE_INTERNAL;
+	}
+
+
+#define LINE_IS(str) (len == sizeof(str) - 1 && !memcmp(line, str, sizeof(str) - 1))
+
+/* where we are in the status file */
+struct xsd_reader {
 #ifdef NO_MMAP
-	if((fp = fopen(status_file_name, "r")) == NULL)
-		return ERROR;
+	FILE *fp;
+	char input[MAX_PLUGIN_OUTPUT_LENGTH];
 #else
-	if((thefile = mmap_fopen(status_file_name)) == NULL)
-		return ERROR;
+	mmapfile *thefile;
 #endif
+	int options;
+	int from_store;
+	int block_type;    /* the block we're in... */
+	int data_type;     /* ...and what we do with it, which may be to skip it */
+	int filter_pending; /* the block may yet be filtered out */
+	struct xsd_field_table *table;
+	void *base;
+	hoststatus *temp_hoststatus;
+	servicestatus *temp_servicestatus;
+	struct xsd_entry entry;
+	};
+
+
+static const char *xsd_next_line(struct xsd_reader *r, size_t *len) {
+	const char *line;
 
-	/* Big speedup when reading status.dat in bulk */
-	defer_downtime_sorting = 1;
-	defer_comment_sorting = 1;
+#ifdef NO_MMAP
+	if(fgets(r->input, sizeof(r->input), r->fp) == NULL)
+		return NULL;
+	line = r->input;
+	*len = strlen(r->input);
+#else
+	/* lines point straight into the file, they're never copied */
+	if((line = mmap_next_line(r->thefile, len)) == NULL)
+		return NULL;
+#endif
 
-	/* read all lines in the status file */
-	while(1) {
+	/* skip leading and trailing white space, like strip() would */
+	while(*len > 0 && (*line == ' ' || *line == '\t' || *line == '\r' || *line == '\n')) {
+		line++;
+		(*len)--;
+		}
+	while(*len > 0 && (line[*len - 1] == ' ' || line[*len - 1] == '\t' || line[*len - 1] == '\r' || line[*len - 1] == '\n'))
+		(*len)--;
 
-#ifdef NO_MMAP
-		strcpy(input, "");
-		if(fgets(input, sizeof(input), fp) == NULL)
+	return line;
+	}
+
+
+/* throws away what we have of the current block and skips the rest of it */
+static void xsd_skip_block(struct xsd_reader *r) {
+
+	if(r->temp_hoststatus) {
+		my_free(r->temp_hoststatus->host_name);
+		my_free(r->temp_hoststatus->plugin_output);
+		my_free(r->temp_hoststatus->long_plugin_output);
+		my_free(r->temp_hoststatus->perf_data);
+		my_free(r->temp_hoststatus);
+		}
+	if(r->temp_servicestatus) {
+		my_free(r->temp_servicestatus->host_name);
+		my_free(r->temp_servicestatus->description);
+		my_free(r->temp_servicestatus->plugin_output);
+		my_free(r->temp_servicestatus->long_plugin_output);
+		my_free(r->temp_servicestatus->perf_data);
+		my_free(r->temp_servicestatus);
+		}
+	xsd_reset_entry(&r->entry);
+
+	r->data_type = XSDDEFAULT_SKIPPED_DATA;
+	r->filter_pending = FALSE;
+	r->table = NULL;
+	r->base = NULL;
+	}
+
+
+/* once we know what a block is for, drops it if it doesn't match the status filter */
+static void xsd_filter_block(struct xsd_reader *r) {
+	const char *host_name = NULL;
+	const char *svc_description = NULL;
+	int is_service = FALSE;
+	int match = FALSE;
+
+	switch(r->data_type) {
+		case XSDDEFAULT_HOSTSTATUS_DATA:
+			host_name = r->temp_hoststatus->host_name;
 			break;
-#else
-		/* free memory */
-		my_free(input);
+		case XSDDEFAULT_SERVICESTATUS_DATA:
+			host_name = r->temp_servicestatus->host_name;
+			svc_description = r->temp_servicestatus->description;
+			is_service = TRUE;
+			break;
+		case XSDDEFAULT_HOSTCOMMENT_DATA:
+		case XSDDEFAULT_HOSTDOWNTIME_DATA:
+			host_name = r->entry.host_name;
+			break;
+		case XSDDEFAULT_SERVICECOMMENT_DATA:
+		case XSDDEFAULT_SERVICEDOWNTIME_DATA:
+			host_name = r->entry.host_name;
+			svc_description = r->entry.service_description;
+			is_service = TRUE;
+			break;
+		default:
+			r->filter_pending = FALSE;
+			return;
+		}
+
+	/* not yet */
+	if(host_name == NULL || (is_service == TRUE && svc_description == NULL))
+		return;
+
+	r->filter_pending = FALSE;
+	if(is_service == TRUE)
+		match = servicestatus_filter_match(host_name, svc_description);
+	else
+		match = hoststatus_filter_match(host_name);
+	if(match == FALSE)
+		xsd_skip_block(r);
+	}
+
+
+/* starts a block, unless we don't want what's in it */
+static void xsd_start_block(struct xsd_reader *r, int type) {
+	int wanted = TRUE;
+
+	r->block_type = r->data_type = type;
+	r->table = NULL;
+	r->base = NULL;
+	r->filter_pending = FALSE;
 
-		/* read the next line */
-		if((input = mmap_fgets(thefile)) == NULL)
+	switch(type) {
+		case XSDDEFAULT_INFO_DATA:
+			r->table = &info_table;
 			break;
-#endif
+		case XSDDEFAULT_PROGRAMSTATUS_DATA:
+			wanted = (r->options & READ_PROGRAM_STATUS) ? TRUE : FALSE;
+			r->table = &program_table;
+			break;
+		case XSDDEFAULT_HOSTSTATUS_DATA:
+			if((wanted = ((r->options & READ_HOST_STATUS) && r->from_store == FALSE) ? TRUE : FALSE) == FALSE)
+				break;
+			r->table = &host_table;
+			r->base = r->temp_hoststatus = (hoststatus *)calloc(1, sizeof(hoststatus));
+			break;
+		case XSDDEFAULT_SERVICESTATUS_DATA:
+			if((wanted = ((r->options & READ_SERVICE_STATUS) && r->from_store == FALSE) ? TRUE : FALSE) == FALSE)
+				break;
+			r->table = &service_table;
+			r->base = r->temp_servicestatus = (servicestatus *)calloc(1, sizeof(servicestatus));
+			break;
+		case XSDDEFAULT_HOSTCOMMENT_DATA:
+		case XSDDEFAULT_SERVICECOMMENT_DATA:
+		case XSDDEFAULT_HOSTDOWNTIME_DATA:
+		case XSDDEFAULT_SERVICEDOWNTIME_DATA:
+			/* comments and downtime come with the status of what they're for */
+			if(type == XSDDEFAULT_HOSTCOMMENT_DATA || type == XSDDEFAULT_HOSTDOWNTIME_DATA)
+				wanted = (r->options & READ_HOST_STATUS) ? TRUE : FALSE;
+			else
+				wanted = (r->options & READ_SERVICE_STATUS) ? TRUE : FALSE;
+			r->table = (type == XSDDEFAULT_HOSTCOMMENT_DATA || type == XSDDEFAULT_SERVICECOMMENT_DATA) ? &comment_table : &downtime_table;
+			r->base = &r->entry;
+			break;
+		default:
+			/* contact status is unimplemented */
+			break;
+		}
+
+	if(wanted == FALSE) {
+		r->data_type = XSDDEFAULT_SKIPPED_DATA;
+		r->table = NULL;
+		r->base = NULL;
+		}
+	else if(r->base != NULL && status_filter_is_set() == TRUE)
+		r->filter_pending = TRUE;
+	}
+
+
+/* adds what we read in the block that just ended */
+static void xsd_end_block(struct xsd_reader *r) {
+	struct xsd_entry *entry = &r->entry;
+	scheduled_downtime *temp_downtime;
+
+	switch(r->data_type) {
+
+		case XSDDEFAULT_HOSTSTATUS_DATA:
+			add_host_status(r->temp_hoststatus);
+			r->temp_hoststatus = NULL;
+			break;
+
+		case XSDDEFAULT_SERVICESTATUS_DATA:
+			add_service_status(r->temp_servicestatus);
+			r->temp_servicestatus = NULL;
+			break;
+
+		case XSDDEFAULT_HOSTCOMMENT_DATA:
+		case XSDDEFAULT_SERVICECOMMENT_DATA:
+
+			/* add the comment */
+			add_comment((r->data_type == XSDDEFAULT_HOSTCOMMENT_DATA) ? HOST_COMMENT : SERVICE_COMMENT, entry->entry_type, entry->host_name, entry->service_description, entry->entry_time, entry->author, entry->comment_data, entry->comment_id, entry->persistent, entry->expires, entry->expire_time, entry->source);
+			xsd_reset_entry(entry);
+			break;
+
+		case XSDDEFAULT_HOSTDOWNTIME_DATA:
+		case XSDDEFAULT_SERVICEDOWNTIME_DATA:
+
+			/* add the downtime */
+			if(r->data_type == XSDDEFAULT_HOSTDOWNTIME_DATA) {
+				add_host_downtime(entry->host_name, entry->entry_time, entry->author, entry->comment_data, entry->start_time, entry->flex_downtime_start, entry->end_time, entry->fixed, entry->triggered_by, entry->duration, entry->downtime_id, entry->is_in_effect, entry->start_notification_sent);
+				temp_downtime = find_downtime(HOST_DOWNTIME, entry->downtime_id);
+			} else {
+				add_service_downtime(entry->host_name, entry->service_description, entry->entry_time, entry->author, entry->comment_data, entry->start_time, entry->flex_downtime_start, entry->end_time, entry->fixed, entry->triggered_by, entry->duration, entry->downtime_id, entry->is_in_effect, entry->start_notification_sent);
+				temp_downtime = find_downtime(SERVICE_DOWNTIME, entry->downtime_id);
+			}
+
+			if (temp_downtime)
+				temp_downtime->comment_id = entry->comment_id;
+
+			xsd_reset_entry(entry);
+			break;
+
+		default:
+			break;
+		}
 
-		strip(input);
+	r->block_type = r->data_type = XSDDEFAULT_NO_DATA;
+	r->filter_pending = FALSE;
+	r->table = NULL;
+	r->base = NULL;
+	}
+
+
+/*
+ * Reads lines until a block of the given type has ended, or to the end
+ * of the file for XSDDEFAULT_NO_DATA. Returns FALSE at the end of the file.
+ */
+static int xsd_read_blocks(struct xsd_reader *r, int until) {
+	const char *line, *var, *val;
+	size_t len, var_len, val_len;
+	const struct xsd_field *field;
+	int ended;
+
+	while((line = xsd_next_line(r, &len)) != NULL) {
 
 		/* skip blank lines and comments */
-		if(input[0] == '#' || input[0] == '\x0')
+		if(len == 0 || line[0] == '#')
 			continue;
 
-		else if(!strcmp(input, "info {"))
-			data_type = XSDDEFAULT_INFO_DATA;
-		else if(!strcmp(input, "programstatus {"))
-			data_type = XSDDEFAULT_PROGRAMSTATUS_DATA;
-		else if(!strcmp(input, "hoststatus {")) {
-			data_type = XSDDEFAULT_HOSTSTATUS_DATA;
-			temp_hoststatus = (hoststatus *)calloc(1, sizeof(hoststatus));
+		else if(LINE_IS("info {"))
+			xsd_start_block(r, XSDDEFAULT_INFO_DATA);
+		else if(LINE_IS("programstatus {"))
+			xsd_start_block(r, XSDDEFAULT_PROGRAMSTATUS_DATA);
+		else if(LINE_IS("hoststatus {"))
+			xsd_start_block(r, XSDDEFAULT_HOSTSTATUS_DATA);
+		else if(LINE_IS("servicestatus {"))
+			xsd_start_block(r, XSDDEFAULT_SERVICESTATUS_DATA);
+		else if(LINE_IS("contactstatus {"))
+			xsd_start_block(r, XSDDEFAULT_CONTACTSTATUS_DATA);
+		else if(LINE_IS("hostcomment {"))
+			xsd_start_block(r, XSDDEFAULT_HOSTCOMMENT_DATA);
+		else if(LINE_IS("servicecomment {"))
+			xsd_start_block(r, XSDDEFAULT_SERVICECOMMENT_DATA);
+		else if(LINE_IS("hostdowntime {"))
+			xsd_start_block(r, XSDDEFAULT_HOSTDOWNTIME_DATA);
+		else if(LINE_IS("servicedowntime {"))
+			xsd_start_block(r, XSDDEFAULT_SERVICEDOWNTIME_DATA);
+
+		else if(LINE_IS("}")) {
+			ended = r->block_type;
+			xsd_end_block(r);
+			if(until != XSDDEFAULT_NO_DATA && ended == until)
+				return TRUE;
 			}
-		else if(!strcmp(input, "servicestatus {")) {
-			data_type = XSDDEFAULT_SERVICESTATUS_DATA;
-			temp_servicestatus = (servicestatus *)calloc(1, sizeof(servicestatus));
-			}
-		else if(!strcmp(input, "contactstatus {")) {
-			data_type = XSDDEFAULT_CONTACTSTATUS_DATA;
-			/* unimplemented */
-			}
-		else if(!strcmp(input, "hostcomment {"))
-			data_type = XSDDEFAULT_HOSTCOMMENT_DATA;
-		else if(!strcmp(input, "servicecomment {"))
-			data_type = XSDDEFAULT_SERVICECOMMENT_DATA;
-		else if(!strcmp(input, "hostdowntime {"))
-			data_type = XSDDEFAULT_HOSTDOWNTIME_DATA;
-		else if(!strcmp(input, "servicedowntime {"))
-			data_type = XSDDEFAULT_SERVICEDOWNTIME_DATA;
 
-		else if(!strcmp(input, "}")) {
+		/* inside a block we read values from - anything else is skipped untouched */
+		else if(r->table != NULL) {
 
-			switch(data_type) {
+			if(mmap_split_var(line, len, &var, &var_len, &val, &val_len) == FALSE || val_len == 0)
+				continue;
 
-				case XSDDEFAULT_INFO_DATA:
-					break;
+			if((field = xsd_find_field(r->table, var, var_len)) == NULL)
+				continue;
 
-				case XSDDEFAULT_PROGRAMSTATUS_DATA:
-					break;
+			/* a struct we couldn't allocate has nowhere to put its fields */
+			if(field->addr == NULL && r->base == NULL)
+				continue;
 
-				case XSDDEFAULT_HOSTSTATUS_DATA:
-					add_host_status(temp_hoststatus);
-					temp_hoststatus = NULL;
-					break;
+			xsd_set_field(field, r->base, val, val_len);
 
-				case XSDDEFAULT_SERVICESTATUS_DATA:
-					add_service_status(temp_servicestatus);
-					temp_servicestatus = NULL;
-					break;
+			/* the names come first, so most of a filtered out block isn't parsed */
+			if(r->filter_pending == TRUE)
+				xsd_filter_block(r);
+			}
+		}
 
-				case XSDDEFAULT_CONTACTSTATUS_DATA:
-					/* unimplemented */
-					break;
+	return FALSE;
+	}
 
-				case XSDDEFAULT_HOSTCOMMENT_DATA:
-				case XSDDEFAULT_SERVICECOMMENT_DATA:
 
-					/* add the comment */
-					add_comment((data_type == XSDDEFAULT_HOSTCOMMENT_DATA) ? HOST_COMMENT : SERVICE_COMMENT, entry_type, host_name, service_description, entry_time, author, comment_data, comment_id, persistent, expires, expire_time, source);
+#ifndef NO_MMAP
+struct xsd_index_entry {
+	unsigned long offset;
+	int type;
+	};
 
-					/* free temp memory */
-					my_free(host_name);
-					my_free(service_description);
-					my_free(author);
-					my_free(comment_data);
+/* checks an index offset points to the start of the block it should */
+static int xsd_index_offset_ok(mmapfile *thefile, unsigned long offset, const char *block) {
+	const char *buf = (const char *)thefile->mmap_buf;
+	size_t len = strlen(block);
 
-					/* reset defaults */
-					entry_type = USER_COMMENT;
-					comment_id = 0;
-					source = COMMENTSOURCE_INTERNAL;
-					persistent = FALSE;
-					entry_time = 0L;
-					expires = FALSE;
-					expire_time = 0L;
+	if(offset == 0 || offset + len > thefile->file_size || buf[offset - 1] != '\n')
+		return FALSE;
 
-					break;
+	return memcmp(buf + offset, block, len) ? FALSE : TRUE;
+	}
 
-				case XSDDEFAULT_HOSTDOWNTIME_DATA:
-				case XSDDEFAULT_SERVICEDOWNTIME_DATA:
 
-					/* add the downtime */
-					if(data_type == XSDDEFAULT_HOSTDOWNTIME_DATA) {
-						add_host_downtime(host_name, entry_time, author, comment_data, start_time, flex_downtime_start, end_time, fixed, triggered_by, duration, downtime_id, is_in_effect, start_notification_sent);
-						temp_downtime = find_downtime(HOST_DOWNTIME, downtime_id);
-					} else {
-						add_service_downtime(host_name, service_description, entry_time, author, comment_data, start_time, flex_downtime_start, end_time, fixed, triggered_by, duration, downtime_id, is_in_effect, start_notification_sent);
-						temp_downtime = find_downtime(SERVICE_DOWNTIME, downtime_id);
-					}
+/*
+ * Reads the hosts and services that match the status filter by seeking
+ * to them with the status index, then the comments and downtime. Returns
+ * ERROR before reading anything if the index doesn't match the status
+ * file, so it can be read in full instead.
+ */
+static int read_indexed_status(struct xsd_reader *r) {
+	mmapfile *index = NULL;
+	struct xsd_index_entry *entries = NULL, *new_entries;
+	unsigned int num_entries = 0, max_entries = 0, i;
+	unsigned long size = 0, entries_offset = 0;
+	time_t created = 0;
+	char *input = NULL, *host_name, *svc_description;
+	size_t input_size = 0;
+	int type, result = OK;
+
+	if((index = mmap_fopen(status_index_file)) == NULL)
+		return ERROR;
 
-					if (temp_downtime)
-						temp_downtime->comment_id = comment_id;
-
-					/* free temp memory */
-					my_free(host_name);
-					my_free(service_description);
-					my_free(author);
-					my_free(comment_data);
-
-					/* reset defaults */
-					downtime_id = 0;
-					comment_id = 0;
-					entry_time = 0L;
-					start_time = 0L;
-					end_time = 0L;
-					fixed = FALSE;
-					triggered_by = 0;
-					duration = 0L;
-					is_in_effect = FALSE;
-					start_notification_sent = FALSE;
+	while(result == OK && mmap_getline(index, &input, &input_size) >= 0) {
 
-					break;
+		if(!strncmp(input, "created=", 8))
+			created = strtoul(input + 8, NULL, 10);
+		else if(!strncmp(input, "size=", 5))
+			size = strtoul(input + 5, NULL, 10);
+		else if(!strncmp(input, "entries=", 8))
+			entries_offset = strtoul(input + 8, NULL, 10);
+
+		/* "h <offset> <host>" or "s <offset> <host> <service>", tab separated */
+		else if((input[0] == 'h' || input[0] == 's') && input[1] == '\t') {
+
+			type = (input[0] == 'h') ? XSDDEFAULT_HOSTSTATUS_DATA : XSDDEFAULT_SERVICESTATUS_DATA;
+			if(r->from_store == TRUE)
+				continue;
+			if((host_name = strchr(input + 2, '\t')) == NULL)
+				continue;
+			*host_name++ = '\x0';
+			svc_description = NULL;
+			if(type == XSDDEFAULT_SERVICESTATUS_DATA) {
+				if((svc_description = strchr(host_name, '\t')) == NULL)
+					continue;
+				*svc_description++ = '\x0';
+				}
 
-				default:
+			if(type == XSDDEFAULT_HOSTSTATUS_DATA && (!(r->options & READ_HOST_STATUS) || hoststatus_filter_match(host_name) == FALSE))
+				continue;
+			if(type == XSDDEFAULT_SERVICESTATUS_DATA && (!(r->options & READ_SERVICE_STATUS) || servicestatus_filter_match(host_name, svc_description) == FALSE))
+				continue;
+
+			if(num_entries == max_entries) {
+				max_entries = max_entries ? max_entries * 2 : 16;
+				if((new_entries = (struct xsd_index_entry *)realloc(entries, max_entries * sizeof(*entries))) == NULL) {
+					result = ERROR;
 					break;
+					}
+				entries = new_entries;
 				}
+			entries[num_entries].offset = strtoul(input + 2, NULL, 10);
+			entries[num_entries].type = type;
+			num_entries++;
+			}
+		}
 
-			data_type = XSDDEFAULT_NO_DATA;
+	my_free(input);
+	mmap_fclose(index);
+
+	/* the index has to be for this very status file */
+	if(created == 0 || created != status_file_created || size != r->thefile->file_size || entries_offset == 0 || entries_offset > size)
+		result = ERROR;
+	for(i = 0; result == OK && i < num_entries; i++) {
+		if(xsd_index_offset_ok(r->thefile, entries[i].offset, (entries[i].type == XSDDEFAULT_HOSTSTATUS_DATA) ? "hoststatus {\n" : "servicestatus {\n") == FALSE)
+			result = ERROR;
+		}
+
+	if(result == OK) {
+		for(i = 0; i < num_entries; i++) {
+			r->thefile->current_position = entries[i].offset;
+			xsd_read_blocks(r, entries[i].type);
 			}
 
-		else if(data_type != XSDDEFAULT_NO_DATA) {
+		/* comments and downtime are few, so they're all looked at */
+		r->thefile->current_position = entries_offset;
+		xsd_read_blocks(r, XSDDEFAULT_NO_DATA);
+		}
 
-			var = strtok(input, "=");
-			val = strtok(NULL, "\n");
-			if(val == NULL)
-				continue;
+	my_free(entries);
 
-			switch(data_type) {
+	return result;
+	}
+#endif
 
-				case XSDDEFAULT_INFO_DATA:
-					break;
 
-				case XSDDEFAULT_PROGRAMSTATUS_DATA:
-					/* NOTE: some vars are not read, as they are not used by the CGIs (modified attributes, event handler commands, etc.) */
-					if(!strcmp(var, "nagios_pid"))
-						nagios_pid = atoi(val);
-					else if(!strcmp(var, "daemon_mode"))
-						daemon_mode = (atoi(val) > 0) ? TRUE : FALSE;
-					else if(!strcmp(var, "program_start"))
-						program_start = strtoul(val, NULL, 10);
-					else if(!strcmp(var, "last_log_rotation"))
-						last_log_rotation = strtoul(val, NULL, 10);
-					else if(!strcmp(var, "enable_notifications"))
-						enable_notifications = (atoi(val) > 0) ? TRUE : FALSE;
-					else if(!strcmp(var, "active_service_checks_enabled"))
-						execute_service_checks = (atoi(val) > 0) ? TRUE : FALSE;
-					else if(!strcmp(var, "passive_service_checks_enabled"))
-						accept_passive_service_checks = (atoi(val) > 0) ? TRUE : FALSE;
-					else if(!strcmp(var, "active_host_checks_enabled"))
-						execute_host_checks = (atoi(val) > 0) ? TRUE : FALSE;
-					else if(!strcmp(var, "passive_host_checks_enabled"))
-						accept_passive_host_checks = (atoi(val) > 0) ? TRUE : FALSE;
-					else if(!strcmp(var, "enable_event_handlers"))
-						enable_event_handlers = (atoi(val) > 0) ? TRUE : FALSE;
-					else if(!strcmp(var, "obsess_over_services"))
-						obsess_over_services = (atoi(val) > 0) ? TRUE : FALSE;
-					else if(!strcmp(var, "obsess_over_hosts"))
-						obsess_over_hosts = (atoi(val) > 0) ? TRUE : FALSE;
-					else if(!strcmp(var, "check_service_freshness"))
-						check_service_freshness = (atoi(val) > 0) ? TRUE : FALSE;
-					else if(!strcmp(var, "check_host_freshness"))
-						check_host_freshness = (atoi(val) > 0) ? TRUE : FALSE;
-					else if(!strcmp(var, "enable_flap_detection"))
-						enable_flap_detection = (atoi(val) > 0) ? TRUE : FALSE;
-					else if(!strcmp(var, "process_performance_data"))
-						process_performance_data = (atoi(val) > 0) ? TRUE : FALSE;
-
-					else if(strstr(var, "_stats")) {
-
-						x = -1;
-						if(!strcmp(var, "active_scheduled_host_check_stats"))
-							x = ACTIVE_SCHEDULED_HOST_CHECK_STATS;
-						if(!strcmp(var, "active_ondemand_host_check_stats"))
-							x = ACTIVE_ONDEMAND_HOST_CHECK_STATS;
-						if(!strcmp(var, "passive_host_check_stats"))
-							x = PASSIVE_HOST_CHECK_STATS;
-						if(!strcmp(var, "active_scheduled_service_check_stats"))
-							x = ACTIVE_SCHEDULED_SERVICE_CHECK_STATS;
-						if(!strcmp(var, "active_ondemand_service_check_stats"))
-							x = ACTIVE_ONDEMAND_SERVICE_CHECK_STATS;
-						if(!strcmp(var, "passive_service_check_stats"))
-							x = PASSIVE_SERVICE_CHECK_STATS;
-						if(!strcmp(var, "cached_host_check_stats"))
-							x = ACTIVE_CACHED_HOST_CHECK_STATS;
-						if(!strcmp(var, "cached_service_check_stats"))
-							x = ACTIVE_CACHED_SERVICE_CHECK_STATS;
-						if(!strcmp(var, "external_command_stats"))
-							x = EXTERNAL_COMMAND_STATS;
-						if(!strcmp(var, "parallel_host_check_stats"))
-							x = PARALLEL_HOST_CHECK_STATS;
-						if(!strcmp(var, "serial_host_check_stats"))
-							x = SERIAL_HOST_CHECK_STATS;
-
-						if(x >= 0) {
-							if((ptr = strtok(val, ","))) {
-								program_stats[x][0] = atoi(ptr);
-								if((ptr = strtok(NULL, ","))) {
-									program_stats[x][1] = atoi(ptr);
-									if((ptr = strtok(NULL, "\n")))
-										program_stats[x][2] = atoi(ptr);
-									}
-								}
-							}
-						}
-					break;
+/* read all program, host, and service status information */
+int xsddefault_read_status_data(const char *status_file_name, int options) {
+	struct xsd_reader reader;
+	int x = 0;
 
-				case XSDDEFAULT_HOSTSTATUS_DATA:
-					/* NOTE: some vars are not read, as they are not used by the CGIs (modified attributes, event handler commands, etc.) */
-					if(temp_hoststatus != NULL) {
-						if(!strcmp(var, "host_name"))
-							temp_hoststatus->host_name = (char *)strdup(val);
-						else if(!strcmp(var, "has_been_checked"))
-							temp_hoststatus->has_been_checked = (atoi(val) > 0) ? TRUE : FALSE;
-						else if(!strcmp(var, "should_be_scheduled"))
-							temp_hoststatus->should_be_scheduled = (atoi(val) > 0) ? TRUE : FALSE;
-						else if(!strcmp(var, "check_execution_time"))
-							temp_hoststatus->execution_time = strtod(val, NULL);
-						else if(!strcmp(var, "check_latency"))
-							temp_hoststatus->latency = strtod(val, NULL);
-						else if(!strcmp(var, "check_type"))
-							temp_hoststatus->check_type = atoi(val);
-						else if(!strcmp(var, "current_state"))
-							temp_hoststatus->status = atoi(val);
-						else if(!strcmp(var, "last_hard_state"))
-							temp_hoststatus->last_hard_state = atoi(val);
-						else if(!strcmp(var, "plugin_output")) {
-							temp_hoststatus->plugin_output = (char *)strdup(val);
-							unescape_newlines(temp_hoststatus->plugin_output);
-							}
-						else if(!strcmp(var, "long_plugin_output")) {
-							temp_hoststatus->long_plugin_output = (char *)strdup(val);
-							unescape_newlines(temp_hoststatus->long_plugin_output);
-							}
-						else if(!strcmp(var, "performance_data"))
-							temp_hoststatus->perf_data = (char *)strdup(val);
-						else if(!strcmp(var, "current_attempt"))
-							temp_hoststatus->current_attempt = atoi(val);
-						else if(!strcmp(var, "max_attempts"))
-							temp_hoststatus->max_attempts = atoi(val);
-						else if(!strcmp(var, "last_check"))
-							temp_hoststatus->last_check = strtoul(val, NULL, 10);
-						else if(!strcmp(var, "next_check"))
-							temp_hoststatus->next_check = strtoul(val, NULL, 10);
-						else if(!strcmp(var, "check_options"))
-							temp_hoststatus->check_options = atoi(val);
-						else if(!strcmp(var, "state_type"))
-							temp_hoststatus->state_type = atoi(val);
-						else if(!strcmp(var, "last_state_change"))
-							temp_hoststatus->last_state_change = strtoul(val, NULL, 10);
-						else if(!strcmp(var, "last_hard_state_change"))
-							temp_hoststatus->last_hard_state_change = strtoul(val, NULL, 10);
-						else if(!strcmp(var, "last_time_up"))
-							temp_hoststatus->last_time_up = strtoul(val, NULL, 10);
-						else if(!strcmp(var, "last_time_down"))
-							temp_hoststatus->last_time_down = strtoul(val, NULL, 10);
-						else if(!strcmp(var, "last_time_unreachable"))
-							temp_hoststatus->last_time_unreachable = strtoul(val, NULL, 10);
-						else if(!strcmp(var, "last_notification"))
-							temp_hoststatus->last_notification = strtoul(val, NULL, 10);
-						else if(!strcmp(var, "next_notification"))
-							temp_hoststatus->next_notification = strtoul(val, NULL, 10);
-						else if(!strcmp(var, "no_more_notifications"))
-							temp_hoststatus->no_more_notifications = (atoi(val) > 0) ? TRUE : FALSE;
-						else if(!strcmp(var, "current_notification_number"))
-							temp_hoststatus->current_notification_number = atoi(val);
-						else if(!strcmp(var, "notifications_enabled"))
-							temp_hoststatus->notifications_enabled = (atoi(val) > 0) ? TRUE : FALSE;
-						else if(!strcmp(var, "problem_has_been_acknowledged"))
-							temp_hoststatus->problem_has_been_acknowledged = (atoi(val) > 0) ? TRUE : FALSE;
-						else if(!strcmp(var, "acknowledgement_type"))
-							temp_hoststatus->acknowledgement_type = atoi(val);
-						else if(!strcmp(var, "active_checks_enabled"))
-							temp_hoststatus->checks_enabled = (atoi(val) > 0) ? TRUE : FALSE;
-						else if(!strcmp(var, "passive_checks_enabled"))
-							temp_hoststatus->accept_passive_checks = (atoi(val) > 0) ? TRUE : FALSE;
-						else if(!strcmp(var, "event_handler_enabled"))
-							temp_hoststatus->event_handler_enabled = (atoi(val) > 0) ? TRUE : FALSE;
-						else if(!strcmp(var, "flap_detection_enabled"))
-							temp_hoststatus->flap_detection_enabled = (atoi(val) > 0) ? TRUE : FALSE;
-						else if(!strcmp(var, "process_performance_data"))
-							temp_hoststatus->process_performance_data = (atoi(val) > 0) ? TRUE : FALSE;
-						else if(!strcmp(var, "obsess_over_host") || !strcmp(var, "obsess"))
-							temp_hoststatus->obsess = (atoi(val) > 0) ? TRUE : FALSE;
-						else if(!strcmp(var, "last_update"))
-							temp_hoststatus->last_update = strtoul(val, NULL, 10);
-						else if(!strcmp(var, "is_flapping"))
-							temp_hoststatus->is_flapping = (atoi(val) > 0) ? TRUE : FALSE;
-						else if(!strcmp(var, "percent_state_change"))
-							temp_hoststatus->percent_state_change = strtod(val, NULL);
-						else if(!strcmp(var, "scheduled_downtime_depth")) {
-							temp_hoststatus->scheduled_downtime_depth = atoi(val);
-							if (temp_hoststatus->scheduled_downtime_depth < 0)
-								temp_hoststatus->scheduled_downtime_depth = 0;
-							}
-						}
-					break;
 
-				case XSDDEFAULT_SERVICESTATUS_DATA:
-					/* NOTE: some vars are not read, as they are not used by the CGIs (modified attributes, event handler commands, etc.) */
-					if(temp_servicestatus != NULL) {
-						if(!strcmp(var, "host_name"))
-							temp_servicestatus->host_name = (char *)strdup(val);
-						else if(!strcmp(var, "service_description"))
-							temp_servicestatus->description = (char *)strdup(val);
-						else if(!strcmp(var, "has_been_checked"))
-							temp_servicestatus->has_been_checked = (atoi(val) > 0) ? TRUE : FALSE;
-						else if(!strcmp(var, "should_be_scheduled"))
-							temp_servicestatus->should_be_scheduled = (atoi(val) > 0) ? TRUE : FALSE;
-						else if(!strcmp(var, "check_execution_time"))
-							temp_servicestatus->execution_time = strtod(val, NULL);
-						else if(!strcmp(var, "check_latency"))
-							temp_servicestatus->latency = strtod(val, NULL);
-						else if(!strcmp(var, "check_type"))
-							temp_servicestatus->check_type = atoi(val);
-						else if(!strcmp(var, "current_state"))
-							temp_servicestatus->status = atoi(val);
-						else if(!strcmp(var, "last_hard_state"))
-							temp_servicestatus->last_hard_state = atoi(val);
-						else if(!strcmp(var, "current_attempt"))
-							temp_servicestatus->current_attempt = atoi(val);
-						else if(!strcmp(var, "max_attempts"))
-							temp_servicestatus->max_attempts = atoi(val);
-						else if(!strcmp(var, "state_type"))
-							temp_servicestatus->state_type = atoi(val);
-						else if(!strcmp(var, "last_state_change"))
-							temp_servicestatus->last_state_change = strtoul(val, NULL, 10);
-						else if(!strcmp(var, "last_hard_state_change"))
-							temp_servicestatus->last_hard_state_change = strtoul(val, NULL, 10);
-						else if(!strcmp(var, "last_time_ok"))
-							temp_servicestatus->last_time_ok = strtoul(val, NULL, 10);
-						else if(!strcmp(var, "last_time_warning"))
-							temp_servicestatus->last_time_warning = strtoul(val, NULL, 10);
-						else if(!strcmp(var, "last_time_unknown"))
-							temp_servicestatus->last_time_unknown = strtoul(val, NULL, 10);
-						else if(!strcmp(var, "last_time_critical"))
-							temp_servicestatus->last_time_critical = strtoul(val, NULL, 10);
-						else if(!strcmp(var, "plugin_output")) {
-							temp_servicestatus->plugin_output = (char *)strdup(val);
-							unescape_newlines(temp_servicestatus->plugin_output);
-							}
-						else if(!strcmp(var, "long_plugin_output")) {
-							temp_servicestatus->long_plugin_output = (char *)strdup(val);
-							unescape_newlines(temp_servicestatus->long_plugin_output);
-							}
-						else if(!strcmp(var, "performance_data"))
-							temp_servicestatus->perf_data = (char *)strdup(val);
-						else if(!strcmp(var, "last_check"))
-							temp_servicestatus->last_check = strtoul(val, NULL, 10);
-						else if(!strcmp(var, "next_check"))
-							temp_servicestatus->next_check = strtoul(val, NULL, 10);
-						else if(!strcmp(var, "check_options"))
-							temp_servicestatus->check_options = atoi(val);
-						else if(!strcmp(var, "current_notification_number"))
-							temp_servicestatus->current_notification_number = atoi(val);
-						else if(!strcmp(var, "last_notification"))
-							temp_servicestatus->last_notification = strtoul(val, NULL, 10);
-						else if(!strcmp(var, "next_notification"))
-							temp_servicestatus->next_notification = strtoul(val, NULL, 10);
-						else if(!strcmp(var, "no_more_notifications"))
-							temp_servicestatus->no_more_notifications = (atoi(val) > 0) ? TRUE : FALSE;
-						else if(!strcmp(var, "notifications_enabled"))
-							temp_servicestatus->notifications_enabled = (atoi(val) > 0) ? TRUE : FALSE;
-						else if(!strcmp(var, "active_checks_enabled"))
-							temp_servicestatus->checks_enabled = (atoi(val) > 0) ? TRUE : FALSE;
-						else if(!strcmp(var, "passive_checks_enabled"))
-							temp_servicestatus->accept_passive_checks = (atoi(val) > 0) ? TRUE : FALSE;
-						else if(!strcmp(var, "event_handler_enabled"))
-							temp_servicestatus->event_handler_enabled = (atoi(val) > 0) ? TRUE : FALSE;
-						else if(!strcmp(var, "problem_has_been_acknowledged"))
-							temp_servicestatus->problem_has_been_acknowledged = (atoi(val) > 0) ? TRUE : FALSE;
-						else if(!strcmp(var, "acknowledgement_type"))
-							temp_servicestatus->acknowledgement_type = atoi(val);
-						else if(!strcmp(var, "flap_detection_enabled"))
-							temp_servicestatus->flap_detection_enabled = (atoi(val) > 0) ? TRUE : FALSE;
-						else if(!strcmp(var, "process_performance_data"))
-							temp_servicestatus->process_performance_data = (atoi(val) > 0) ? TRUE : FALSE;
-						else if(!strcmp(var, "obsess_over_service") || !strcmp(var, "obsess"))
-							temp_servicestatus->obsess = (atoi(val) > 0) ? TRUE : FALSE;
-						else if(!strcmp(var, "last_update"))
-							temp_servicestatus->last_update = strtoul(val, NULL, 10);
-						else if(!strcmp(var, "is_flapping"))
-							temp_servicestatus->is_flapping = (atoi(val) > 0) ? TRUE : FALSE;
-						else if(!strcmp(var, "percent_state_change"))
-							temp_servicestatus->percent_state_change = strtod(val, NULL);
-						else if(!strcmp(var, "scheduled_downtime_depth")) {
-							temp_servicestatus->scheduled_downtime_depth = atoi(val);
-							if (temp_servicestatus->scheduled_downtime_depth < 0)
-								temp_servicestatus->scheduled_downtime_depth = 0;
-							}
-						}
-					break;
+	/* initialize some vars */
+	for(x = 0; x < MAX_CHECK_STATS_TYPES; x++) {
+		program_stats[x][0] = 0;
+		program_stats[x][1] = 0;
+		program_stats[x][2] = 0;
+		}
+	memset(&reader, 0, sizeof(reader));
+	reader.options = options;
+	xsd_reset_entry(&reader.entry);
+	status_file_created = 0;
 
-				case XSDDEFAULT_CONTACTSTATUS_DATA:
-					/* unimplemented */
-					break;
+	/* open the status file for reading */
+#ifdef NO_MMAP
+	if((reader.fp = fopen(status_file_name, "r")) == NULL)
+		return ERROR;
+#else
+	if((reader.thefile = mmap_fopen(status_file_name)) == NULL)
+		return ERROR;
+#endif
 
-				case XSDDEFAULT_HOSTCOMMENT_DATA:
-				case XSDDEFAULT_SERVICECOMMENT_DATA:
-					if(!strcmp(var, "host_name"))
-						host_name = (char *)strdup(val);
-					else if(!strcmp(var, "service_description"))
-						service_description = (char *)strdup(val);
-					else if(!strcmp(var, "entry_type"))
-						entry_type = atoi(val);
-					else if(!strcmp(var, "comment_id"))
-						comment_id = strtoul(val, NULL, 10);
-					else if(!strcmp(var, "source"))
-						source = atoi(val);
-					else if(!strcmp(var, "persistent"))
-						persistent = (atoi(val) > 0) ? TRUE : FALSE;
-					else if(!strcmp(var, "entry_time"))
-						entry_time = strtoul(val, NULL, 10);
-					else if(!strcmp(var, "expires"))
-						expires = (atoi(val) > 0) ? TRUE : FALSE;
-					else if(!strcmp(var, "expire_time"))
-						expire_time = strtoul(val, NULL, 10);
-					else if(!strcmp(var, "author"))
-						author = (char *)strdup(val);
-					else if(!strcmp(var, "comment_data"))
-						comment_data = (char *)strdup(val);
-					break;
+	/* host and service status come from the status store if we have one */
+	if(status_store_file && (options & (READ_HOST_STATUS | READ_SERVICE_STATUS)) && read_status_store(options) == OK)
+		reader.from_store = TRUE;
 
-				case XSDDEFAULT_HOSTDOWNTIME_DATA:
-				case XSDDEFAULT_SERVICEDOWNTIME_DATA:
-					if(!strcmp(var, "host_name"))
-						host_name = (char *)strdup(val);
-					else if(!strcmp(var, "service_description"))
-						service_description = (char *)strdup(val);
-					else if(!strcmp(var, "downtime_id"))
-						downtime_id = strtoul(val, NULL, 10);
-					else if(!strcmp(var, "comment_id"))
-						comment_id = strtoul(val, NULL, 10);
-					else if(!strcmp(var, "entry_time"))
-						entry_time = strtoul(val, NULL, 10);
-					else if(!strcmp(var, "start_time"))
-						start_time = strtoul(val, NULL, 10);
-					else if(!strcmp(var, "flex_downtime_start"))
-						flex_downtime_start = strtoul(val, NULL, 10);
-					else if(!strcmp(var, "end_time"))
-						end_time = strtoul(val, NULL, 10);
-					else if(!strcmp(var, "fixed"))
-						fixed = (atoi(val) > 0) ? TRUE : FALSE;
-					else if(!strcmp(var, "triggered_by"))
-						triggered_by = strtoul(val, NULL, 10);
-					else if(!strcmp(var, "duration"))
-						duration = strtoul(val, NULL, 10);
-					else if(!strcmp(var, "is_in_effect"))
-						is_in_effect = (atoi(val) > 0) ? TRUE : FALSE;
-					else if(!strcmp(var, "start_notification_sent"))
-						start_notification_sent = (atoi(val) > 0) ? TRUE : FALSE;
-					else if(!strcmp(var, "author"))
-						author = (char *)strdup(val);
-					else if(!strcmp(var, "comment"))
-						comment_data = (char *)strdup(val);
-					break;
+	/* Big speedup when reading status.dat in bulk */
+	defer_downtime_sorting = 1;
+	defer_comment_sorting = 1;
 
-				default:
-					break;
-				}
+	/* the file info and program status come first */
+	if(xsd_read_blocks(&reader, XSDDEFAULT_PROGRAMSTATUS_DATA) == TRUE && (options & (READ_HOST_STATUS | READ_SERVICE_STATUS))) {
 
-			}
+		/* a few hosts or services can be found with the index, if there is one */
+#ifndef NO_MMAP
+		if(status_filter_is_set() == FALSE || status_index_file == NULL || read_indexed_status(&reader) == ERROR)
+#endif
+			xsd_read_blocks(&reader, XSDDEFAULT_NO_DATA);
 		}
 
 	/* free memory and close the file */
+	xsd_skip_block(&reader);
 #ifdef NO_MMAP
-	fclose(fp);
+	fclose(reader.fp);
 #else
-	my_free(input);
-	mmap_fclose(thefile);
+	mmap_fclose(reader.thefile);
 #endif
 
 	if(sort_downtime() != OK)
@@ -23,10 +23,108 @@
 #ifndef NAGIOS_XSDDEFAULT_H_INCLUDED
 #define NAGIOS_XSDDEFAULT_H_INCLUDED
 
+#include <stdint.h>
+
+/*
+ * The binary status store is a file of fixed-size host and service
+ * records, indexed by object id, that the core keeps mmap()'ed and
+ * updates in place whenever update_host_status() or
+ * update_service_status() is called. Each record (and the program
+ * part of the header) starts with a generation counter that is odd
+ * while the record is being written, so readers can copy a record,
+ * compare the counter and retry if they raced with the core. The
+ * names all live in a table after the records and never change
+ * until the file is recreated on the next (re)start.
+ */
+#define XSD_STORE_MAGIC          0x4e535344 /* "NSSD" */
+#define XSD_STORE_VERSION        1
+#define XSD_STORE_OUTPUT_LENGTH  256
+#define XSD_STORE_PERFDATA_LENGTH 256
+#define XSD_STORE_CHECK_STATS    16
+
+struct xsd_store_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t header_size;
+	uint32_t host_size;
+	uint32_t service_size;
+	uint32_t num_hosts;
+	uint32_t num_services;
+	uint32_t names_size;
+	uint64_t names_offset;
+	int64_t created;
+	char program_version[16];
+
+	/* program status, guarded by generation */
+	uint32_t generation;
+	int32_t nagios_pid;
+	int64_t program_start;
+	int64_t last_update;
+	int32_t check_stats[XSD_STORE_CHECK_STATS][3];
+	};
+
+struct xsd_store_host {
+	uint32_t generation;
+	uint32_t name;
+	int64_t last_update, last_check, next_check;
+	int64_t last_state_change, last_hard_state_change;
+	int64_t last_time_up, last_time_down, last_time_unreachable;
+	int64_t last_notification, next_notification;
+	double execution_time, latency, percent_state_change;
+	int32_t current_state, last_hard_state, state_type, check_type, check_options;
+	int32_t has_been_checked, should_be_scheduled, current_attempt, max_attempts;
+	int32_t no_more_notifications, current_notification_number, notifications_enabled;
+	int32_t problem_has_been_acknowledged, acknowledgement_type;
+	int32_t checks_enabled, accept_passive_checks, event_handler_enabled, flap_detection_enabled;
+	int32_t process_performance_data, obsess, is_flapping, scheduled_downtime_depth;
+	char plugin_output[XSD_STORE_OUTPUT_LENGTH];
+	char perf_data[XSD_STORE_PERFDATA_LENGTH];
+	};
+
+struct xsd_store_service {
+	uint32_t generation;
+	uint32_t host_name;
+	uint32_t description;
+	int32_t current_state;
+	int64_t last_update, last_check, next_check;
+	int64_t last_state_change, last_hard_state_change;
+	int64_t last_time_ok, last_time_warning, last_time_unknown, last_time_critical;
+	int64_t last_notification, next_notification;
+	double execution_time, latency, percent_state_change;
+	int32_t last_hard_state, state_type, check_type, check_options;
+	int32_t has_been_checked, should_be_scheduled, current_attempt, max_attempts;
+	int32_t no_more_notifications, current_notification_number, notifications_enabled;
+	int32_t problem_has_been_acknowledged, acknowledgement_type;
+	int32_t checks_enabled, accept_passive_checks, event_handler_enabled, flap_detection_enabled;
+	int32_t process_performance_data, obsess, is_flapping, scheduled_downtime_depth;
+	char plugin_output[XSD_STORE_OUTPUT_LENGTH];
+	char perf_data[XSD_STORE_PERFDATA_LENGTH];
+	};
+
+/* an open, validated status store */
+struct xsd_store {
+	char *map;
+	size_t size;
+	struct xsd_store_header *header;
+	struct xsd_store_host *hosts;
+	struct xsd_store_service *services;
+	const char *names;
+	};
+
+int xsd_store_open(struct xsd_store *, const char *);
+void xsd_store_close(struct xsd_store *);
+int xsd_store_read_header(const struct xsd_store *, struct xsd_store_header *);
+int xsd_store_read_host(const struct xsd_store *, unsigned int, struct xsd_store_host *);
+int xsd_store_read_service(const struct xsd_store *, unsigned int, struct xsd_store_service *);
+#define xsd_store_name(store, off) ((off) < (store)->header->names_size ? (store)->names + (off) : "")
+
 #ifdef NSCORE
 int xsddefault_initialize_status_data(const char *);
+int xsddefault_reload_status_data(void);
 int xsddefault_cleanup_status_data(int);
 int xsddefault_save_status_data(void);
+int xsddefault_update_host_status(host *);
+int xsddefault_update_service_status(service *);
 #endif
 
 #ifdef NSCGI
@@ -41,6 +139,7 @@ int xsddefault_save_status_data(void);
 #define XSDDEFAULT_SERVICECOMMENT_DATA   7
 #define XSDDEFAULT_HOSTDOWNTIME_DATA     8
 #define XSDDEFAULT_SERVICEDOWNTIME_DATA  9
+#define XSDDEFAULT_SKIPPED_DATA          10
 
 int xsddefault_read_status_data(const char *, int);
 #endif
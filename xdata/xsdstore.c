@@ -0,0 +1,144 @@
+/*****************************************************************************
+ *
+ * XSDSTORE.C - Binary status store reader, shared by the CGIs and nagiostats
+ *
+ *
+ * License:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *****************************************************************************/
+
+#include "../include/config.h"
+#include "../include/common.h"
+#include "../include/objects.h"
+#include "xsddefault.h"
+
+/* copies out a record the core may be updating, retrying if we raced with it */
+static int xsd_store_copy(void *dest, const void *src, size_t size) {
+	const volatile uint32_t *generation = src;
+	uint32_t before;
+	int tries;
+
+	for(tries = 0; tries < 1000; tries++) {
+		before = *generation;
+		__sync_synchronize();
+		if(before & 1)
+			continue;
+		memcpy(dest, src, size);
+		__sync_synchronize();
+		if(*generation == before)
+			return OK;
+		}
+
+	return ERROR;
+	}
+
+
+/*
+ * maps a status store and makes sure it's one we can read, with a
+ * name table that ends in a NUL so no name runs past the mapping
+ */
+int xsd_store_open(struct xsd_store *store, const char *path) {
+	struct xsd_store_header *hdr;
+	struct stat st;
+	size_t records;
+	int fd;
+
+	memset(store, 0, sizeof(*store));
+	if(path == NULL || (fd = open(path, O_RDONLY)) < 0)
+		return ERROR;
+	if(fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(*hdr)) {
+		close(fd);
+		return ERROR;
+		}
+	store->size = st.st_size;
+	store->map = mmap(NULL, store->size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(store->map == MAP_FAILED) {
+		store->map = NULL;
+		return ERROR;
+		}
+
+	hdr = (struct xsd_store_header *)store->map;
+	records = hdr->header_size + (size_t)hdr->num_hosts * hdr->host_size + (size_t)hdr->num_services * hdr->service_size;
+	if(hdr->magic != XSD_STORE_MAGIC || hdr->version != XSD_STORE_VERSION
+	        || hdr->header_size != sizeof(struct xsd_store_header)
+	        || hdr->host_size != sizeof(struct xsd_store_host)
+	        || hdr->service_size != sizeof(struct xsd_store_service)
+	        || hdr->names_offset < records || hdr->names_size == 0
+	        || hdr->names_size > store->size || hdr->names_offset > store->size - hdr->names_size
+	        || store->map[hdr->names_offset + hdr->names_size - 1] != '\0') {
+		xsd_store_close(store);
+		return ERROR;
+		}
+
+	store->header = hdr;
+	store->hosts = (struct xsd_store_host *)(store->map + hdr->header_size);
+	store->services = (struct xsd_store_service *)(store->hosts + hdr->num_hosts);
+	store->names = store->map + hdr->names_offset;
+
+	return OK;
+	}
+
+
+void xsd_store_close(struct xsd_store *store) {
+
+	if(store->map)
+		munmap(store->map, store->size);
+	memset(store, 0, sizeof(*store));
+	}
+
+
+int xsd_store_read_header(const struct xsd_store *store, struct xsd_store_header *hdr) {
+	struct xsd_store_header *src = store->header;
+
+	/* only the program part is guarded by the generation counter */
+	if(xsd_store_copy(&hdr->generation, &src->generation, sizeof(*hdr) - offsetof(struct xsd_store_header, generation)) == ERROR)
+		return ERROR;
+	memcpy(hdr, src, offsetof(struct xsd_store_header, generation));
+
+	return OK;
+	}
+
+
+int xsd_store_read_host(const struct xsd_store *store, unsigned int id, struct xsd_store_host *hst) {
+
+	if(id >= store->header->num_hosts)
+		return ERROR;
+
+	if(xsd_store_copy(hst, &store->hosts[id], sizeof(*hst)) == ERROR)
+		return ERROR;
+
+	/* a damaged record mustn't send readers past the end of a string */
+	if(hst->plugin_output[sizeof(hst->plugin_output) - 1] || hst->perf_data[sizeof(hst->perf_data) - 1])
+		return ERROR;
+
+	return OK;
+	}
+
+
+int xsd_store_read_service(const struct xsd_store *store, unsigned int id, struct xsd_store_service *svc) {
+
+	if(id >= store->header->num_services)
+		return ERROR;
+
+	if(xsd_store_copy(svc, &store->services[id], sizeof(*svc)) == ERROR)
+		return ERROR;
+
+	if(svc->plugin_output[sizeof(svc->plugin_output) - 1] || svc->perf_data[sizeof(svc->perf_data) - 1])
+		return ERROR;
+
+	return OK;
+	}